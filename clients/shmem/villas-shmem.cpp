@@ -94,15 +94,16 @@ protected:
 		struct sample *insmps[vectorize], *outsmps[vectorize];
 
 		while (!stop) {
-			readcnt = shmem_int_read(&shm, insmps, vectorize);
+			/* The samples are echoed from one ring into the other without intermediate copies */
+			readcnt = shmem_int_peek(&shm, insmps, vectorize);
 			if (readcnt == -1) {
 				logger->info("Node stopped, exiting");
 				break;
 			}
 
-			avail = shmem_int_alloc(&shm, outsmps, readcnt);
+			avail = shmem_int_reserve(&shm, outsmps, readcnt);
 			if (avail < readcnt)
-				logger->warn("Pool underrun: %d / %d\n", avail, readcnt);
+				logger->warn("Queue overrun: {} / {}", avail, readcnt);
 
 			for (int i = 0; i < avail; i++) {
 				outsmps[i]->sequence = insmps[i]->sequence;
@@ -114,12 +115,13 @@ protected:
 				outsmps[i]->length = len;
 			}
 
-			for (int i = 0; i < readcnt; i++)
-				sample_decref(insmps[i]);
+			if (readcnt > 0)
+				shmem_int_consume(&shm, readcnt);
 
-			writecnt = shmem_int_write(&shm, outsmps, avail);
-			if (writecnt < avail)
-				logger->warn("Short write");
+			if (avail > 0)
+				writecnt = shmem_int_publish(&shm, avail);
+			else
+				writecnt = 0;
 
 			logger->info("Read / Write: {}/{}", readcnt, writecnt);
 		}
@@ -29,6 +29,8 @@
 #include <atomic>
 #include <thread>
 #include <list>
+#include <mutex>
+#include <condition_variable>
 
 #include <villas/log.hpp>
 #include <villas/common.h>
@@ -81,7 +83,19 @@ public:
 		return super_node;
 	}
 
+	/** Register a session. May be called from any of the web service threads. */
+	void addSession(api::Session *s);
+
+	/** Unregister a session before it is destroyed.
+	 *
+	 * Waits until the actions of the session which are currently run by the API thread are finished.
+	 */
+	void removeSession(api::Session *s);
+
+	std::mutex sessionsMutex;			/**< Protects Api::sessions and Api::busy. */
+	std::condition_variable sessionsCv;		/**< Signalled when the API thread is done with Api::busy. */
 	std::list<api::Session *> sessions;		/**< List of currently active connections */
+	api::Session *busy;				/**< The session whose actions are currently run by the API thread. */
 	villas::QueueSignalled<api::Session *> pending;	/**< A queue of api_sessions which have pending requests. */
 };
 
@@ -44,6 +44,7 @@ class Wsi : public Session {
 
 protected:
 	lws *wsi;
+	int tsi;		/**< The web service thread which owns Wsi::wsi. */
 
 	Web *web;
 
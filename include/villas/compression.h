@@ -0,0 +1,78 @@
+/** Streaming compression for file streams.
+ *
+ * @file
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+/**
+ * @addtogroup compression Streaming compression
+ * @{
+ */
+
+#pragma once
+
+#include <cstdio>
+
+enum class CompressionType {
+	AUTO,		/**< Derived from the suffix of the file name. */
+	NONE,
+	ZSTD,		/**< Zstandard frames (*.zst) */
+	LZ4		/**< LZ4 frames (*.lz4) */
+};
+
+struct compression {
+	enum CompressionType type;
+	int level;		/**< Compression level or 0 for the default of the algorithm. */
+	int threads;		/**< Number of compression threads or 0 to compress in the calling thread. Only for zstd. */
+};
+
+/* Forward declarations */
+struct compressor;
+
+/** Parse the name of a compression algorithm.
+ *
+ * @retval 0	The algorithm is known and supported by this build.
+ * @retval -1	The algorithm is unknown or not supported.
+ */
+int compression_parse(const char *name, enum CompressionType *type);
+
+const char * compression_name(enum CompressionType type);
+
+/** Derive the compression algorithm from the suffix of \p uri. */
+enum CompressionType compression_from_uri(const char *uri);
+
+/** Open a stream which transparently (de-)compresses the data of stream \p f.
+ *
+ * The returned stream takes ownership of \p f and closes it.
+ * Input streams can only be rewound but not seeked.
+ *
+ * @param mode	Either "r" for decompression or "w" for compression.
+ * @param cp	The compressor of the new stream which is required for compressor_flush().
+ * @return	A new stream or nullptr on error. The caller still owns \p f in this case.
+ */
+FILE * compressor_open(FILE *f, const struct compression *c, const char *mode, struct compressor **cp);
+
+/** Write all data which has been written to the stream so far as a complete block.
+ *
+ * The stream itself must be flushed by fflush() before.
+ */
+int compressor_flush(struct compressor *c);
+
+/** @} */
@@ -0,0 +1,63 @@
+/** Vectorized conversion kernels for binary formats.
+ *
+ * @file
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/** @addtogroup formats
+ *
+ * The kernels narrow / widen whole arrays of sample values and optionally
+ * reverse the byte order of the values in the narrow (wire) representation.
+ * All buffers may be unaligned. Depending on the capabilities of the CPU,
+ * an AVX2, SSE2 or scalar implementation is selected at startup.
+ * @{
+ */
+
+/** Narrow \p cnt doubles to floats. */
+void convert_f64_to_f32(void *dst, const double *src, size_t cnt, bool swap);
+
+/** Widen \p cnt floats to doubles. */
+void convert_f32_to_f64(double *dst, const void *src, size_t cnt, bool swap);
+
+/** Truncate \p cnt 64-bit integers to 32-bit. */
+void convert_i64_to_i32(void *dst, const int64_t *src, size_t cnt, bool swap);
+
+/** Extend \p cnt 32-bit integers to 64-bit. Values are sign-extended if \p sign is set. */
+void convert_i32_to_i64(int64_t *dst, const void *src, size_t cnt, bool swap, bool sign);
+
+/** Copy \p cnt 64-bit values. */
+void convert_copy64(void *dst, const void *src, size_t cnt, bool swap);
+
+/** Name of the selected implementation: "avx2", "sse2" or "scalar". */
+const char * convert_implementation();
+
+/** Select an implementation by name or the fastest one supported by the CPU if \p name is nullptr.
+ *
+ * @retval 0 The implementation has been selected.
+ * @retval -1 The implementation is unknown or not supported by the CPU.
+ */
+int convert_select(const char *name);
+
+/** @} */
@@ -30,6 +30,13 @@ struct sample;
 int json_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt);
 int json_sscan(struct io *io, const char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt);
 
+/** Reference implementations which build a jansson object tree.
+ *
+ * json_sscan() falls back to json_sscan_jansson() for documents it can not handle itself.
+ */
+int json_sprint_jansson(struct io *io, char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt);
+int json_sscan_jansson(struct io *io, const char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt);
+
 int json_print(struct io *io, struct sample *smps[], unsigned cnt);
 int json_scan(struct io *io, struct sample *smps[], unsigned cnt);
 
@@ -49,8 +49,14 @@ void msg_hdr_ntoh(struct msg *m);
  */
 int msg_verify(struct msg *m);
 
-/** Copy fields from \p msg into \p smp. */
-int msg_to_sample(struct msg *msg, struct sample *smp, struct vlist *signals);
+/** Copy fields from \p msg into \p smp.
+ *
+ * If \p ntoh is set, the message is expected in network byte order.
+ */
+int msg_to_sample(struct msg *msg, struct sample *smp, struct vlist *signals, bool ntoh);
 
-/** Copy fields form \p smp into \p msg. */
-int msg_from_sample(struct msg *msg, struct sample *smp, struct vlist *signals);
+/** Copy fields form \p smp into \p msg.
+ *
+ * If \p hton is set, the message is converted to network byte order.
+ */
+int msg_from_sample(struct msg *msg, struct sample *smp, struct vlist *signals, bool hton);
@@ -24,10 +24,50 @@
 #pragma once
 
 #include <cstdlib>
+#include <cstddef>
+
+#include <protobuf-c/protobuf-c.h>
 
 /* Forward declarations */
 struct sample;
 
+/** An overflow allocation which did not fit into the arena. */
+struct protobuf_chunk {
+	struct protobuf_chunk *next;
+	alignas(max_align_t) char data[];
+};
+
+/** A ProtobufCAllocator which carves all allocations of a message from a reusable buffer.
+ *
+ * Allocations which do not fit are served by malloc() and the buffer
+ * is enlarged by protobuf_arena_reset(). In steady state, encoding and
+ * decoding a message does not call malloc() at all.
+ */
+struct protobuf_arena {
+	ProtobufCAllocator allocator;
+
+	char *buffer;
+	size_t size;
+	size_t used;
+
+	struct protobuf_chunk *chunks;	/**< Overflow allocations since the last reset. */
+	size_t overflow;		/**< Total size of protobuf_arena::chunks. */
+};
+
+struct protobuf {
+	bool packed;			/**< Use Sample::values_f / Sample::values_i instead of one Value per signal. */
+
+	struct protobuf_arena out;	/**< Used by protobuf_sprint() */
+	struct protobuf_arena in;	/**< Used by protobuf_sscan() */
+};
+
+int protobuf_arena_init(struct protobuf_arena *a, size_t size);
+
+int protobuf_arena_destroy(struct protobuf_arena *a);
+
+/** Release all allocations and enlarge the buffer if it has overflown. */
+void protobuf_arena_reset(struct protobuf_arena *a);
+
 /** Copy / read struct msg's from buffer \p buf to / fram samples \p smps. */
 int protobuf_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt);
 
@@ -133,6 +133,37 @@ public:
 		return Reason::OK;
 	};
 
+	/** Called whenever a batch of samples is processed.
+	 *
+	 * Samples which are passed on to the next hook are moved to the front
+	 * of \p smps. Skipped samples are moved behind them so that the array
+	 * still contains all samples afterwards. The relative order of the
+	 * passed samples must be preserved.
+	 *
+	 * The default implementation calls process(sample *) for each sample.
+	 * Reason::STOP_PROCESSING drops the current and all following samples.
+	 *
+	 * @return The number of samples which have not been skipped or -1 on error.
+	 */
+	virtual int process(sample *smps[], unsigned cnt);
+
+	/** Process a single sample with process(sample *smps[], unsigned).
+	 *
+	 * Hooks which implement the batched process() use this for their
+	 * scalar process(sample *), so that both entry points behave the same.
+	 */
+	Reason processOne(sample *smp);
+
+	/** Returns true if the hook never modifies the samples it processes.
+	 *
+	 * Samples which are shared between the destinations of a path do not
+	 * need to be cloned before passing them to read-only hooks.
+	 */
+	virtual bool isReadOnly() const
+	{
+		return false;
+	}
+
 	int getPriority() const
 	{
 		return priority;
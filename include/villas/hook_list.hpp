@@ -65,8 +65,25 @@ int hook_list_prepare_signals(struct vlist *hs, struct vlist *signals);
 
 int hook_list_add(struct vlist *hs, int mask, struct path *p, struct node *n);
 
+/** Run the hooks of a list over a batch of samples.
+ *
+ * Each hook processes the whole batch before it is handed to the next hook.
+ * Samples which are skipped by a hook are not seen by any later hook.
+ * A hook returning Hook::Reason::STOP_PROCESSING for a sample drops this and
+ * all following samples of the batch. Hooks earlier in the list have already
+ * processed those samples at that point.
+ *
+ * The samples which passed all hooks are moved to the front of \p smps in
+ * their original order. The skipped samples are kept behind them so that
+ * the caller can still release all \p cnt samples.
+ *
+ * @return The number of samples which passed all hooks or -1 on error.
+ */
 int hook_list_process(struct vlist *hs, struct sample *smps[], unsigned cnt);
 
+/** Check if none of the hooks in the list modifies samples. */
+bool hook_list_is_read_only(struct vlist *hs);
+
 void hook_list_periodic(struct vlist *hs);
 
 void hook_list_start(struct vlist *hs);
@@ -60,7 +60,17 @@ public:
 
 	virtual void parse(json_t *cfg);
 
-	virtual Hook::Reason process(sample *smp);
+	virtual bool isReadOnly() const
+	{
+		return true;
+	}
+
+	virtual Hook::Reason process(sample *smp)
+	{
+		return processOne(smp);
+	}
+
+	virtual int process(sample *smps[], unsigned cnt);
 };
 
 } /* namespace node */
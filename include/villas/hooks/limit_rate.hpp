@@ -58,6 +58,11 @@ public:
 
 	virtual void parse(json_t *cfg);
 
+	virtual bool isReadOnly() const
+	{
+		return true;
+	}
+
 	virtual Hook::Reason process(sample *smp);
 };
 
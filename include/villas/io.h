@@ -27,6 +27,7 @@
 #include <villas/common.h>
 #include <villas/node.h>
 #include <villas/signal.h>
+#include <villas/compression.h>
 
 /* Forward declarations */
 struct sample;
@@ -38,7 +39,8 @@ enum class IOFlags {
 	NONBLOCK		= (1 << 9),	/**< Dont block io_read() while waiting for new samples. */
 	NEWLINES		= (1 << 10),	/**< The samples of this format are newline delimited. */
 	DESTROY_SIGNALS		= (1 << 11),	/**< Signal descriptors are managed by this IO instance. Destroy them in io_destoy() */
-	HAS_BINARY_PAYLOAD	= (1 << 12)	/**< This IO instance en/decodes binary payloads. */
+	HAS_BINARY_PAYLOAD	= (1 << 12),	/**< This IO instance en/decodes binary payloads. */
+	PRINTF_COMPAT		= (1 << 13)	/**< Print numbers with printf() like in previous versions instead of their shortest representation. */
 };
 
 enum class IOMode {
@@ -65,8 +67,12 @@ struct io {
 
 		char *buffer;
 		size_t buflen;
+
+		struct compressor *compressor;	/**< Set if the stream is (de-)compressed by io_stream_open(). */
 	} in, out;
 
+	struct compression compression;		/**< Compression of local files. Must be set before io_open(). */
+
 	struct vlist *signals;			/**< Signal meta data for parsed samples by io_scan() */
 	bool header_printed;
 
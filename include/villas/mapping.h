@@ -84,6 +84,33 @@ struct mapping_entry {
 	};
 };
 
+/** A contiguous block of values which is copied by a single memcpy(). */
+struct mapping_range {
+	unsigned offset;		/**< Offset of the first value within the remapped sample. */
+	unsigned source;		/**< Offset of the first value within the original sample. */
+	unsigned length;		/**< Number of values. */
+
+	unsigned first;			/**< Index of the first mapping entry covered by this range in mapping_plan::entries. */
+	unsigned count;			/**< Number of mapping entries covered by this range. */
+};
+
+/** A mapping list compiled into a flat list of copy operations.
+ *
+ * Adjacent data mappings are merged into a single mapping_range.
+ * All other mappings (header, timestamp and stats) are kept as fixups.
+ */
+struct mapping_plan {
+	const struct mapping_entry **entries;	/**< The data mapping entries in the order of the ranges. */
+
+	struct mapping_range *ranges;
+	unsigned nranges;
+
+	const struct mapping_entry **fixups;	/**< Non-data mappings which are applied by mapping_update(). */
+	unsigned nfixups;
+
+	unsigned length;		/**< Minimum capacity of a remapped sample. */
+};
+
 int mapping_update(const struct mapping_entry *e, struct sample *remapped, const struct sample *original);
 
 int mapping_parse(struct mapping_entry *e, json_t *cfg, struct vlist *nodes);
@@ -97,3 +124,14 @@ int mapping_list_parse(struct vlist *ml, json_t *cfg, struct vlist *nodes);
 int mapping_list_prepare(struct vlist *ml);
 
 int mapping_list_remap(const struct vlist *ml, struct sample *remapped, const struct sample *original);
+
+/** Compile a prepared mapping list into a plan.
+ *
+ * The offsets of the entries must have been assigned by mapping_list_prepare() before.
+ */
+int mapping_plan_init(struct mapping_plan *mp, const struct vlist *ml);
+
+int mapping_plan_destroy(struct mapping_plan *mp);
+
+/** Same as mapping_list_remap() but uses a compiled plan. */
+int mapping_plan_remap(const struct mapping_plan *mp, struct sample *remapped, const struct sample *original);
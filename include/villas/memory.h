@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 
@@ -32,11 +33,14 @@
 /* Forward declarations */
 struct node;
 
-/** Descriptor of a memory block. Associated block always starts at
- * &m + sizeof(struct memory_block). */
+/** Descriptor of a block in a managed memory region.
+ *
+ * The descriptor is placed in front of each block. As the region might be
+ * mapped at different addresses by multiple processes, only offsets relative
+ * to the region are stored.
+ */
 struct memory_block {
-	struct memory_block *prev;
-	struct memory_block *next;
+	std::atomic<size_t> next; /**< Offset of the next free block of the same size class */
 	size_t length; /**< Length of the block; doesn't include the descriptor itself */
 	bool used;
 };
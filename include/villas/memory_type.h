@@ -56,9 +56,77 @@ extern struct memory_type memory_heap;
 extern struct memory_type memory_hugepage;
 
 struct memory_type * memory_ib(struct node *n, struct memory_type *parent);
+/** Statistics of a managed memory region. See memory_managed_stats(). */
+struct memory_managed_stats {
+	size_t total;		/**< Number of bytes which are available for blocks. */
+	size_t used;		/**< Number of bytes in allocated blocks including their descriptors. */
+	size_t requested;	/**< Number of bytes which have been requested by the current allocations. */
+	size_t cached;		/**< Number of bytes in free blocks which can be reused. */
+	size_t remaining;	/**< Number of bytes which have never been handed out. */
+	size_t largest;		/**< Length of the largest allocation which currently succeeds. */
+
+	size_t allocs;		/**< Total number of allocations. */
+	size_t frees;		/**< Total number of releases. */
+
+	double fragmentation;	/**< Share of the consumed memory which is not used by current allocations. */
+};
+
+/** Create a memory type which manages the memory region \p ptr.
+ *
+ * Blocks are taken from lock-free free lists of power-of-two size classes or
+ * carved from the unused remainder of the region. The allocator state is
+ * kept inside the region and only contains relative offsets. So the region
+ * can be shared between processes.
+ */
 struct memory_type * memory_managed(void *ptr, size_t len);
 
+int memory_managed_stats(struct memory_type *m, struct memory_managed_stats *s);
+
+/** Number of bytes of a region which are used by memory_managed() itself. */
+size_t memory_managed_overhead();
+
+/** Maximum number of bytes which an allocation of \p len bytes consumes within a managed region. */
+size_t memory_managed_size(size_t len, size_t alignment);
+
+/** Get the address of the first allocation in a managed region which is mapped at \p ptr.
+ *
+ * This is only valid if the first allocation did not request an alignment beyond pointer size.
+ */
+void * memory_managed_first(void *ptr);
+
+/** Hugepage backed memory which is placed on the given NUMA node.
+ *
+ * @return A memory type or nullptr if the NUMA node does not exist.
+ */
+struct memory_type * memory_numa(int node);
+
 int memory_hugepage_init(int hugepages);
 
+/** Accounting of an arena from which small hugepage allocations are carved. */
+struct memory_arena_stats {
+	void *address;
+	size_t length;
+	size_t pagesize;	/**< Size of the pages which back the arena. */
+	int node;		/**< NUMA node to which the arena is bound or -1. */
+
+	struct memory_managed_stats managed;
+};
+
+/** Configure the arenas which serve small hugepage allocations.
+ *
+ * Only arenas which are mapped afterwards are affected.
+ *
+ * @param size The size of each arena in bytes or 0 to map each allocation separately.
+ * @param gigantic Back the arenas by 1 GiB pages if the kernel provides them.
+ */
+void memory_hugepage_arenas(size_t size, bool gigantic);
+
+/** Allocate hugepage backed memory which is bound to the NUMA node \p node or -1 for no binding. */
+struct memory_allocation * memory_hugepage_alloc_node(size_t len, size_t alignment, int node);
+
+size_t memory_hugepage_arena_count();
+
+int memory_hugepage_arena_stats(size_t idx, struct memory_arena_stats *s);
+
 struct memory_type * memory_type_lookup(enum MemoryFlags flags);
 
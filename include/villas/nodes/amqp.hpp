@@ -59,6 +59,23 @@ struct amqp {
 	amqp_connection_state_t producer;
 	amqp_connection_state_t consumer;
 
+	int prefetch;			/**< Maximum number of unacknowledged deliveries (basic.qos) or 0 to disable acknowledgements. */
+	unsigned msg_samples;		/**< Largest number of samples decoded from a single message so far. */
+
+	/** Pipelined publisher confirms */
+	struct {
+		int window;		/**< Maximum number of unconfirmed messages or 0 to disable confirms. */
+		char *pending;		/**< Ring of flags for outstanding delivery tags. */
+		uint64_t next;		/**< Delivery tag of the next published message. */
+		uint64_t lowest;	/**< Lowest unconfirmed delivery tag. */
+	} confirm;
+
+	/* Statistics */
+	uint64_t published;		/**< Number of published messages. */
+	uint64_t acked;			/**< Number of messages confirmed by the broker. */
+	uint64_t nacked;		/**< Number of messages rejected by the broker. */
+	uint64_t received;		/**< Number of received messages. */
+
 	struct format_type *format;
 	struct io io;
 };
@@ -29,15 +29,31 @@
 
 #pragma once
 
+#include <atomic>
+
+#include <pthread.h>
+
 #include <villas/io.h>
 #include <villas/node.h>
+#include <villas/pool.h>
 #include <villas/task.h>
+#include <villas/recording.h>
+#include <villas/queue_signalled.h>
 
 #define FILE_MAX_PATHLEN	512
 
+/** Maximum number of samples which are written by the asynchronous writer at once. */
+#define FILE_ASYNC_BATCH	64
+
 struct file {
 	struct io io;			/**< Format and file IO */
 	struct format_type *format;
+	struct compression compression;	/**< Streaming compression of the file (see io::compression). */
+
+	int recording;			/**< Use the indexed binary format instead of file::format (villas.recording). */
+	struct recording reader;
+	struct recording writer;	/**< Opened with the first sample which is written. */
+	unsigned chunk_samples;		/**< Number of samples per chunk of a new recording. */
 
 	char *uri_tmpl;			/**< Format string for file name. */
 	char *uri;			/**< Real file name. */
@@ -63,8 +79,33 @@ struct file {
 		SUSPEND			/**< Blocking wait when EOF is reached. */
 	} eof_mode;
 
+	enum class OverflowPolicy {
+		DROP,			/**< Drop samples if the queue of the asynchronous writer is full. */
+		BLOCK			/**< Wait until the asynchronous writer has caught up. */
+	};
+
+	/** Written samples are handed over to a separate I/O thread. */
+	struct {
+		int enabled;
+		int queuelen;
+		enum OverflowPolicy overflow;
+
+		struct pool pool;		/**< Copies of the samples which have not been written yet. */
+		struct queue_signalled queue;	/**< Samples of file::async::pool which are waiting for the I/O thread. */
+		pthread_t thread;
+
+		pthread_mutex_t mutex;
+		pthread_cond_t cv;		/**< Signalled by the I/O thread after it has released samples. */
+
+		std::atomic<uint64_t> written;	/**< Number of samples which have been written successfully. */
+		std::atomic<uint64_t> dropped;
+		std::atomic<uint64_t> blocked;	/**< Number of writes which had to wait for the I/O thread. */
+		std::atomic<uint64_t> errors;	/**< Number of samples which the I/O thread failed to write. */
+	} async;
+
 	struct timespec first;		/**< The first timestamp in the file file::{read,write}::uri */
 	struct timespec epoch;		/**< The epoch timestamp from the configuration. */
+	struct timespec start;		/**< Replay starts at the first sample at or after this timestamp. Only for recordings. */
 	struct timespec offset;		/**< An offset between the timestamp in the input file and the current time */
 };
 
@@ -29,8 +29,16 @@
 
 #pragma once
 
+#include <atomic>
+
+#include <pthread.h>
+
 #include <villas/list.h>
 
+#define DEFAULT_INFLUXDB_BUFFER_SIZE	(1 << 20)
+#define DEFAULT_INFLUXDB_PACKET_SIZE	8192
+#define DEFAULT_INFLUXDB_FLUSH_INTERVAL	0.1
+
 /* Forward declarations */
 struct node;
 struct sample;
@@ -46,6 +54,28 @@ struct influxdb {
 	struct vlist fields;
 
 	int sd;
+
+	size_t buffer_size;		/**< Maximum number of bytes which are buffered before samples get dropped. */
+	size_t packet_size;		/**< Maximum size of a datagram. A single line is never split. */
+	double flush_interval;		/**< Maximum time in seconds for which lines are buffered. */
+
+	/** Lines are appended to the front buffer by influxdb_write()
+	 * while the flush thread sends the back buffer. */
+	struct {
+		char *data;
+		size_t len;
+	} front, back;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;		/**< Protects influxdb::front and influxdb::stopping */
+	pthread_cond_t cv;
+	bool stopping;
+
+	/* Statistics */
+	std::atomic<uint64_t> sent;	/**< Number of lines sent. */
+	std::atomic<uint64_t> dropped;	/**< Number of samples dropped because the buffer was full. */
+	std::atomic<uint64_t> packets;	/**< Number of datagrams sent. */
+	std::atomic<uint64_t> errors;	/**< Number of datagrams which failed to send. */
 };
 
 /** @see node_type::print */
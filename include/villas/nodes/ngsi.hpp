@@ -45,6 +45,32 @@
 /* Forward declarations */
 struct node;
 
+/** An HTTP request which is executed by the request engine.
+ *
+ * A node has at most one request of each kind in flight. Updates which
+ * are written while the previous one is still in flight are coalesced:
+ * only the latest one is kept in ngsi_transfer::pending.
+ */
+struct ngsi_transfer {
+	CURL *handle;			/**< libcurl: easy handle which is reused to keep the connection alive */
+
+	char *pending;			/**< The body of the next request or nullptr. */
+	struct timespec queued;		/**< Time at which ngsi_transfer::pending has been queued. */
+
+	char *body;			/**< The body of the request in flight or nullptr. */
+	struct timespec started;	/**< Time at which the request in flight has been queued. */
+
+	char *response;			/**< The response to the request in flight. */
+	size_t response_len;
+
+	/* Statistics */
+	uint64_t requests;		/**< Number of completed requests. */
+	uint64_t failed;		/**< Number of failed requests. */
+	uint64_t coalesced;		/**< Number of requests which have been superseded by a newer one. */
+	double latency_total;		/**< Sum of the time between queuing and completion in seconds. */
+	double latency_max;
+};
+
 struct ngsi {
 	const char *endpoint;		/**< The NGSI context broker endpoint URL. */
 	const char *entity_id;		/**< The context broker entity id related to this node */
@@ -59,7 +85,14 @@ struct ngsi {
 
 	struct curl_slist *headers;	/**< List of HTTP request headers for libcurl */
 
-	CURL *curl;			/**< libcurl: handle */
+	CURL *curl;			/**< libcurl: handle for the synchronous requests in ngsi_start() and ngsi_stop() */
+
+	struct ngsi_transfer update;	/**< Context updates issued by ngsi_write(). */
+	struct ngsi_transfer query;	/**< Context queries issued by ngsi_read(). */
+
+	json_t *result;			/**< The entity returned by the latest completed query. */
+
+	bool detach;			/**< The node is about to be removed from the request engine. */
 
 	struct vlist mapping;		/**< A mapping between indices of the VILLASnode samples and the attributes in ngsi::context */
 };
@@ -40,9 +40,15 @@ struct format_type;
 /** The maximum length of a packet which contains stuct msg. */
 #define SOCKET_INITIAL_BUFFER_LEN (64*1024)
 
+/** The maximum length of a single datagram received in batched mode. */
+#define SOCKET_BATCH_BUFFER_LEN (9*1024)
+
 struct socket {
 	int sd;				/**< The socket descriptor */
 	int verify_source;		/**< Verify the source address of incoming packets against socket::remote. */
+	int batch;			/**< Receive / send multiple datagrams per system call with recvmmsg() / sendmmsg(). */
+	int busy_poll;			/**< Busy poll timeout in micro seconds for SO_BUSY_POLL or 0. */
+	int rcvbuf;			/**< Size of the receive buffer (SO_RCVBUF) in bytes or 0 for the system default. */
 
 	enum SocketLayer layer;		/**< The OSI / IP layer which should be used for this socket */
 
@@ -61,6 +67,12 @@ struct socket {
 		char *buf;		/**< Buffer for receiving messages */
 		size_t buflen;
 		union sockaddr_union saddr;	/**< Remote address of the socket */
+
+		/* Batched mode */
+		struct mmsghdr *msgs;	/**< Message headers for recvmmsg() / sendmmsg(). */
+		struct iovec *iovs;	/**< One I/O vector per message pointing into socket::buf. */
+		union sockaddr_union *addrs;	/**< Source addresses of received messages. */
+		unsigned nmsgs;		/**< Number of message headers. */
 	} in, out;
 };
 
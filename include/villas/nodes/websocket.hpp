@@ -29,6 +29,10 @@
 
 #pragma once
 
+#include <atomic>
+
+#include <pthread.h>
+
 #include <villas/node.h>
 #include <villas/pool.h>
 #include <villas/queue_signalled.h>
@@ -39,16 +43,51 @@
 
 #define DEFAULT_WEBSOCKET_QUEUE_LENGTH	(DEFAULT_QUEUE_LENGTH * 64)
 #define DEFAULT_WEBSOCKET_SAMPLE_LENGTH	DEFAULT_SAMPLE_LENGTH
+#define DEFAULT_WEBSOCKET_BATCH_SAMPLES	128
+#define DEFAULT_WEBSOCKET_BATCH_BYTES	(1 << 16)
+#define DEFAULT_WEBSOCKET_BATCH_DELAY	10e-3
 
 /* Forward declaration */
 struct lws;
 
+/** An encoded message which is shared by all connections using the same format. */
+struct websocket_frame {
+	std::atomic<int> refcnt;
+	bool binary;				/**< Send as binary instead of text message. */
+	unsigned cnt;				/**< Number of samples in this frame. */
+	size_t len;
+	char data[];				/**< The message starts after LWS_PRE bytes of headroom. */
+};
+
+/** Serializes the samples of a node once for all connections which use the same format. */
+struct websocket_encoder {
+	struct format_type *format;
+	struct io io;
+};
+
 /** Internal data per websocket node */
 struct websocket {
 	struct vlist destinations;		/**< List of websocket servers connect to in client mode (struct websocket_destination). */
 
 	struct pool pool;
 	struct queue_signalled queue;		/**< For samples which are received from WebSockets */
+
+	int queuelen;				/**< Maximum number of frames which are queued per connection. */
+
+	struct {
+		unsigned samples;		/**< Maximum number of samples per frame. */
+		size_t bytes;			/**< Maximum size of a frame. */
+		double delay;			/**< Maximum time for which samples are held back to build larger frames. */
+	} batch;
+
+	int compression_level;			/**< zlib level for permessage-deflate or -1 for the default. */
+
+	pthread_mutex_t mutex;			/**< Protects the following members. */
+	struct vlist encoders;			/**< One encoder per format used by a connection (struct websocket_encoder). */
+	struct sample **pending;		/**< Samples which have been written but not encoded yet. */
+	unsigned npending;
+	struct timespec first;			/**< Time at which the oldest pending sample has been written. */
+	char *buffer;				/**< Scratch buffer for encoding websocket::batch::bytes. */
 };
 
 /* Internal datastructures */
@@ -69,16 +108,18 @@ struct websocket_connection {
 	} mode;
 
 	struct lws *wsi;
+	int tsi;				/**< The web service thread which owns websocket_connection::wsi. */
 	struct node *node;
-	struct io io;
-	struct queue queue;			/**< For samples which are sent to the WebSocket */
+	struct io io;				/**< For parsing received messages. */
+	struct queue queue;			/**< For frames which are sent to the WebSocket (struct websocket_frame). */
 
 	struct format_type *format;
+	struct websocket_encoder *encoder;
 	struct websocket_destination *destination;
 
 	struct {
 		struct buffer recv;		/**< A buffer for reconstructing fragmented messags. */
-		struct buffer send;		/**< A buffer for contsructing messages before calling lws_write() */
+		struct buffer send;		/**< A buffer with room for LWS_PRE in front of the frame passed to lws_write() */
 	} buffers;
 
 	char *_name;
@@ -47,6 +47,14 @@
 struct stats;
 struct node;
 
+namespace villas {
+namespace node {
+
+class PathScheduler;
+
+} // namespace node
+} // namespace villas
+
 /** The register mode determines under which condition the path is triggered. */
 enum class PathMode {
 	ANY,				/**< The path is triggered whenever one of the sources receives samples. */
@@ -82,11 +90,28 @@ struct path {
 	int reverse;			/**< This path as a matching reverse path. */
 	int builtin;			/**< This path should use built-in hooks by default. */
 	int original_sequence_no;       /**< Use original source sequence number when multiplexing */
+	int copy_on_write;		/**< Destinations share the muxed samples by reference instead of receiving clones. */
+	int last_shared;		/**< path::last_sample references the last muxed sample instead of holding a copy. */
 	unsigned queuelen;			/**< The queue length for each path_destination::queue */
 
+	int affinity;			/**< Mask of CPU cores to which the path thread is pinned or 0. */
+	int priority;			/**< Real-time priority of the path thread or 0 for no change. */
+	int sched;			/**< Scheduling policy of the path thread (SCHED_FIFO, SCHED_RR). */
+	int numa_node;			/**< NUMA node on which the pool and queues of the path are allocated or -1. */
+
+	int busy_poll;			/**< Time in us to spin on the sources before blocking in poll(2). 0 disables spinning, -1 never blocks. */
+
+	struct {
+		uint64_t spins;			/**< Number of times the sources became ready while spinning. */
+		uint64_t sleeps;		/**< Number of times the path blocked in poll(2). */
+		double spin_time;		/**< Total time spent spinning in seconds. */
+		double sleep_time;		/**< Total time spent blocked in poll(2) in seconds. */
+	} busy;
+
 	char *_name;			/**< Singleton: A string which is used to print this path to screen. */
 
 	pthread_t tid;			/**< The thread id for this path. */
+	villas::node::PathScheduler *scheduler;	/**< The scheduler which runs this path or nullptr if the path has its own thread. */
 	json_t *cfg;			/**< A JSON object containing the configuration of the path. */
 
 	villas::Logger logger;
@@ -121,6 +146,16 @@ int path_start(struct path *p);
  */
 int path_stop(struct path *p);
 
+/** Handle a file descriptor of the path reader which is ready for reading.
+ *
+ * @param p A pointer to the path structure.
+ * @param i The index of the file descriptor in path::reader::pfds.
+ */
+void path_process_fd(struct path *p, int i);
+
+/** Write all samples which are queued for the destinations of a path. */
+void path_write_destinations(struct path *p);
+
 /** Destroy path by freeing dynamically allocated memory.
  *
  * @param i A pointer to the path structure.
@@ -34,14 +34,17 @@
 /* Forward declarations */
 struct path;
 struct sample;
+struct memory_type;
 
 struct path_destination {
 	struct node *node;
 
 	struct queue queue;
+
+	bool unshare;		/**< Clone shared samples before they are modified by the write hooks of the node. */
 };
 
-int path_destination_init(struct path_destination *pd, int queuelen);
+int path_destination_init(struct path_destination *pd, int queuelen, struct memory_type *mt, enum QueueMode mode = QueueMode::MPMC);
 
 int path_destination_destroy(struct path_destination *pd);
 
@@ -49,4 +52,11 @@ void path_destination_enqueue(struct path *p, struct sample *smps[], unsigned cn
 
 void path_destination_write(struct path_destination *pd, struct path *p);
 
+/** Replace samples which are also referenced by others with private clones.
+ *
+ * @retval 0 All samples in \p smps are exclusively owned by the caller.
+ * @retval -1 The pool of a sample is exhausted.
+ */
+int path_destination_unshare(struct sample *smps[], int cnt);
+
 /** @} */
@@ -0,0 +1,159 @@
+/** A scheduler which multiplexes paths onto a pool of worker threads.
+ *
+ * @file
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+/**
+ * @addtogroup path Path
+ * @{
+ */
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <vector>
+
+#include <jansson.h>
+
+#include <villas/log.hpp>
+#include <villas/common.h>
+
+/* Forward declarations */
+struct path;
+
+namespace villas {
+namespace node {
+
+/** Runs all polling paths of a super-node on a fixed set of worker threads.
+ *
+ * Each worker owns an epoll(7) set which contains the file descriptors
+ * of the paths assigned to it. Ready paths are put into the run queue
+ * of the worker. Idle workers steal paths from the run queues of
+ * their busy siblings.
+ */
+class PathScheduler {
+
+public:
+	struct Worker;
+	struct Task;
+
+	/** A file descriptor of a path which is registered in the epoll set of a worker. */
+	struct Event {
+		Task *task;
+		int index;			/**< Index of the file descriptor in path::reader::pfds */
+		std::atomic<bool> ready;	/**< The file descriptor has been signalled by epoll_wait() */
+	};
+
+	/** A path which is executed by the scheduler. */
+	struct Task {
+		struct path *path;
+		Worker *home;			/**< The worker in whose epoll set the file descriptors are registered. */
+
+		std::atomic<bool> queued;	/**< The task is either in a run queue or currently executed. */
+		std::atomic<int> active;	/**< Number of workers which currently execute the task. Never more than one. */
+
+		Event *events;
+		int nevents;
+	};
+
+	struct Worker {
+		int id;
+		int core;			/**< The CPU core to which this worker is pinned or -1. */
+
+		int epfd;			/**< File descriptor of the epoll set. */
+		int wakefd;			/**< An eventfd which is used to wake up the worker. */
+
+		std::atomic<bool> sleeping;	/**< The worker is blocked in epoll_wait(). */
+
+		std::mutex mtx;			/**< Protects Worker::runqueue. */
+		std::deque<Task *> runqueue;
+
+		std::thread thread;
+
+		/* Statistics */
+		uint64_t runs;			/**< Number of times a path has been executed by this worker. */
+		uint64_t steals;		/**< Number of paths stolen from other workers. */
+	};
+
+protected:
+	enum State state;
+
+	Logger logger;
+
+	int enabled;			/**< Use the scheduler instead of a thread per path. */
+	int priority;			/**< Real-time priority of the workers or 0 for no change. */
+	int affinity;			/**< Mask of CPU cores to which the workers are pinned. */
+	int count;			/**< Number of worker threads. */
+
+	std::atomic<bool> running;	/**< Atomic flag for signalizing thread termination. */
+
+	std::vector<Worker *> workers;
+	std::vector<Task *> tasks;
+
+	size_t next;			/**< Index of the worker which gets the next path assigned. */
+
+	void work(Worker *w);
+	void run(Worker *w, Task *t);
+
+	/** Put a task into the run queue of a worker if it is not already queued. */
+	bool enqueue(Worker *w, Task *t);
+
+	Task * dequeue(Worker *w);
+	Task * steal(Worker *w);
+
+	/** Wake a sleeping sibling of worker \p w so that it can steal queued tasks. */
+	void wakeIdle(Worker *w);
+	void wake(Worker *w);
+
+public:
+	PathScheduler();
+	~PathScheduler();
+
+	/** Parse scheduler related options */
+	void parse(json_t *cfg);
+
+	/** Create the workers and their epoll sets. */
+	void prepare();
+
+	/** Register the file descriptors of a started path with one of the workers. */
+	void add(struct path *p);
+
+	void start();
+	void stop();
+
+	bool isEnabled() const
+	{
+		return enabled;
+	}
+
+	enum State getState() const
+	{
+		return state;
+	}
+};
+
+} // namespace node
+} // namespace villas
+
+/** @} */
@@ -31,6 +31,7 @@
 
 #include <villas/pool.h>
 #include <villas/list.h>
+#include <villas/mapping.h>
 
 /* Forward declarations */
 struct path;
@@ -43,6 +44,7 @@ struct path_source {
 
 	struct pool pool;
 	struct vlist mappings;			/**< List of mappings (struct mapping_entry). */
+	struct mapping_plan plan;		/**< The mappings compiled by mapping_plan_init(). */
 };
 
 int path_source_init(struct path_source *ps);
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <sys/types.h>
 
@@ -32,6 +33,23 @@
 #include <villas/common.h>
 #include <villas/memory.h>
 
+#define POOL_CACHE_SLOTS	16	/**< Number of per-thread caches of a pool */
+#define POOL_CACHE_SIZE		64	/**< Maximum number of blocks in a single per-thread cache */
+#define POOL_CACHE_THREAD_POOLS	8	/**< Number of pools for which a thread remembers its cache slot */
+
+/** A magazine of free blocks which is used by a single thread.
+ *
+ * Each pool assigns the threads which use it round-robin to one of its
+ * POOL_CACHE_SLOTS caches. If two threads share the same slot, the one
+ * which does not get hold of pool_cache::busy uses the global queue of
+ * the pool instead.
+ */
+struct pool_cache {
+	std::atomic<bool> busy;		/**< The cache is currently used by a thread. */
+	size_t count;			/**< Number of blocks in pool_cache::blocks. */
+	void *blocks[POOL_CACHE_SIZE];
+} __attribute__((aligned(CACHELINE_SIZE)));
+
 /** A thread-safe memory pool */
 struct pool {
 	enum State state;
@@ -43,6 +61,10 @@ struct pool {
 	size_t alignment;	/**< Alignment of a block in bytes */
 
 	struct queue queue; /**< The queue which is used to keep track of free blocks */
+
+	struct pool_cache *cache; /**< Per-thread caches or nullptr. See pool_cache_init() */
+	size_t cachesz;		/**< Maximum number of blocks in each per-thread cache */
+	std::atomic<unsigned> cache_next; /**< The cache slot which is assigned to the next thread */
 };
 
 #define INLINE static inline __attribute__((unused))
@@ -62,6 +84,29 @@ int pool_init(struct pool *p, size_t cnt, size_t blocksz, struct memory_type *me
 /** Destroy and release memory used by pool. */
 int pool_destroy(struct pool *p);
 
+/** Enable per-thread caches of free blocks for a pool.
+ *
+ * Blocks are moved between the caches and the queue of the pool in batches.
+ * This avoids contention on the queue if samples are allocated and released by
+ * the same thread or if they are released in bulk by another thread.
+ *
+ * The caches hold at most an eighth of the blocks of the pool. Small pools are left uncached.
+ * If the queue runs dry, pool_get_many() takes the remaining blocks from the
+ * caches of other threads. Caches can not be used for pools which are shared
+ * between processes.
+ */
+int pool_cache_init(struct pool *p);
+
+/** Return the blocks of all per-thread caches which are currently not in use to the queue.
+ *
+ * This should be called once the threads which use the pool have been stopped.
+ */
+int pool_cache_flush(struct pool *p);
+
+ssize_t pool_cache_get_many(struct pool *p, void *blocks[], size_t cnt);
+
+ssize_t pool_cache_put_many(struct pool *p, void *blocks[], size_t cnt);
+
 /** Pop up to \p cnt values from the stack an place them in the array \p blocks.
  *
  * @return The number of blocks actually retrieved from the pool.
@@ -70,12 +115,18 @@ int pool_destroy(struct pool *p);
  */
 INLINE ssize_t pool_get_many(struct pool *p, void *blocks[], size_t cnt)
 {
+	if (p->cache)
+		return pool_cache_get_many(p, blocks, cnt);
+
 	return queue_pull_many(&p->queue, blocks, cnt);
 }
 
 /** Push \p cnt values which are giving by the array values to the stack. */
 INLINE ssize_t pool_put_many(struct pool *p, void *blocks[], size_t cnt)
 {
+	if (p->cache)
+		return pool_cache_put_many(p, blocks, cnt);
+
 	return queue_push_many(&p->queue, blocks, cnt);
 }
 
@@ -83,11 +134,18 @@ INLINE ssize_t pool_put_many(struct pool *p, void *blocks[], size_t cnt)
 INLINE void * pool_get(struct pool *p)
 {
 	void *ptr;
+
+	if (p->cache)
+		return pool_cache_get_many(p, &ptr, 1) == 1 ? ptr : nullptr;
+
 	return queue_pull(&p->queue, &ptr) == 1 ? ptr : nullptr;
 }
 
 /** Release a memory block back to the pool. */
 INLINE int pool_put(struct pool *p, void *buf)
 {
+	if (p->cache)
+		return pool_cache_put_many(p, &buf, 1);
+
 	return queue_push(&p->queue, buf);
 }
@@ -52,28 +52,42 @@ struct queue_cell {
 	off_t data_off; /**< Pointer relative to the queue struct */
 };
 
-/** A lock-free multiple-producer, multiple-consumer (MPMC) queue. */
+enum class QueueMode {
+	MPMC,	/**< Multiple producers and consumers */
+	SPSC	/**< A single producer and a single consumer */
+};
+
+/** A lock-free multiple-producer, multiple-consumer (MPMC) queue.
+ *
+ * In QueueMode::SPSC the queue is a plain ring buffer: the per-cell sequence
+ * numbers are not used and each batch is published by a single store to
+ * queue::tail or queue::head. Producer and consumer may change over time as
+ * long as there are never two threads on the same side at once.
+ */
 struct queue {
 	std::atomic<enum State> state;
 
 	cacheline_pad_t _pad0;	/**< Shared area: all threads read */
 
+	enum QueueMode mode;
 	size_t buffer_mask;
 	off_t buffer_off;	/**< Relative pointer to struct queue_cell[] */
 
 	cacheline_pad_t	_pad1;	/**< Producer area: only producers read & write */
 
 	std::atomic<size_t>	tail;	/**< Queue tail pointer */
+	size_t head_cache;	/**< Last known value of queue::head (SPSC only) */
 
 	cacheline_pad_t	_pad2;	/**< Consumer area: only consumers read & write */
 
 	std::atomic<size_t>	head;	/**< Queue head pointer */
+	size_t tail_cache;	/**< Last known value of queue::tail (SPSC only) */
 
 	cacheline_pad_t	_pad3;	/**< @todo Why needed? */
 };
 
 /** Initialize MPMC queue */
-int queue_init(struct queue *q, size_t size, struct memory_type *mem);
+int queue_init(struct queue *q, size_t size, struct memory_type *mem, enum QueueMode mode = QueueMode::MPMC);
 
 /** Desroy MPMC queue and release memory */
 int queue_destroy(struct queue *q);
@@ -0,0 +1,166 @@
+/** An indexed, columnar binary format for recording and replaying samples.
+ *
+ * @file
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+/**
+ * @addtogroup recording Indexed binary recordings
+ * @{
+ *
+ * A recording starts with a struct recording_header which is followed by
+ * one type byte per signal. Then a sequence of chunks follows. Each chunk is
+ * a struct recording_chunk followed by the columns of its samples:
+ *
+ *   int64_t  origin[count]	Origin timestamps in nanoseconds
+ *   int64_t  received[count]	Receive timestamps in nanoseconds
+ *   uint64_t sequence[count]
+ *   uint32_t length[count]
+ *   uint32_t flags[count]
+ *   union signal_data values[signals][count]
+ *
+ * A recording which has been closed properly ends with an index of all
+ * chunks (struct recording_index). Otherwise the index is rebuilt by
+ * walking the chunk headers. Recordings are read through mmap(2) without
+ * any parsing.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+#include <villas/sample.h>
+
+#define RECORDING_MAGIC		"VILLASRC"
+#define RECORDING_VERSION	1
+#define RECORDING_CHUNK_MAGIC	0x4b4e4843u	/**< "CHNK" */
+
+/** Default number of samples per chunk. */
+#define DEFAULT_RECORDING_CHUNK_SAMPLES	4096u
+
+struct recording_header {
+	char magic[8];			/**< Always RECORDING_MAGIC */
+	uint32_t version;		/**< See RECORDING_VERSION */
+	uint32_t signals;		/**< Number of value columns in each chunk. */
+	uint32_t chunk_samples;		/**< Maximum number of samples per chunk. */
+	uint32_t _reserved;
+
+	uint64_t index_offset;		/**< Offset of the index or 0 if the recording has not been closed. */
+	uint64_t chunks;		/**< Number of chunks in the index. */
+	uint64_t samples;		/**< Number of samples in the index. */
+};
+
+struct recording_chunk {
+	uint32_t magic;			/**< Always RECORDING_CHUNK_MAGIC */
+	uint32_t count;			/**< Number of samples in this chunk. */
+	uint64_t length;		/**< Length of the chunk in bytes including this header. */
+};
+
+/** An entry of the index which is stored at the end of a recording. */
+struct recording_index {
+	uint64_t offset;		/**< Offset of the chunk in the file. */
+	int64_t first;			/**< Origin timestamp of the first sample of the chunk in nanoseconds. */
+	int64_t last;			/**< Origin timestamp of the last sample of the chunk in nanoseconds. */
+	uint64_t sequence;		/**< Sequence number of the first sample of the chunk. */
+	uint64_t count;			/**< Number of samples in the chunk. */
+};
+
+enum class RecordingMode {
+	READ,
+	WRITE
+};
+
+struct recording {
+	enum RecordingMode mode;
+	int fd;
+
+	unsigned signals;		/**< Number of values per sample. */
+	unsigned chunk_samples;		/**< Maximum number of samples per chunk. */
+	uint8_t *types;			/**< enum SignalType of each value column. */
+
+	struct recording_index *index;	/**< Index of all chunks which are known so far. */
+	size_t chunks;
+	size_t allocated;		/**< Number of entries which are allocated for recording::index. */
+	size_t samples;			/**< Total number of samples in all known chunks. */
+	size_t end;			/**< Offset behind the last known chunk. */
+
+	/* Reader */
+	char *base;			/**< Address at which the file is mapped. */
+	size_t length;			/**< Length of the mapping. */
+	size_t chunk;			/**< Chunk of the next sample which is read. */
+	size_t pos;			/**< Position of the next sample within recording::chunk. */
+
+	/* Writer */
+	unsigned count;			/**< Number of samples in the chunk buffer. */
+	int64_t *origin;		/**< Column buffers of the current chunk */
+	int64_t *received;
+	uint64_t *sequence;
+	uint32_t *lengths;
+	uint32_t *flags;
+	union signal_data *values;	/**< recording::signals columns of recording::chunk_samples values each. */
+};
+
+/** Open a recording.
+ *
+ * In RecordingMode::WRITE new samples are appended to an existing recording.
+ * A new file is created if it does not exist or is empty.
+ *
+ * @param chunk_samples Maximum number of samples per chunk of a new recording or 0 for the default.
+ */
+int recording_open(struct recording *r, const char *uri, enum RecordingMode mode, unsigned chunk_samples = 0);
+
+/** Write the buffered samples and the index and close the recording. */
+int recording_close(struct recording *r);
+
+/** Read up to \p cnt samples starting at the current position. */
+int recording_read(struct recording *r, struct sample *smps[], unsigned cnt);
+
+/** Append samples to the recording.
+ *
+ * The samples are buffered until a chunk is complete. The number of values
+ * of the first sample which is written to a new recording determines the
+ * number of value columns.
+ */
+int recording_write(struct recording *r, struct sample *smps[], unsigned cnt);
+
+/** Write all buffered samples as a separate chunk. */
+int recording_flush(struct recording *r);
+
+/** Move the read position to the first sample whose origin timestamp is not before \p ts.
+ *
+ * The origin timestamps of the recording must be monotonic.
+ */
+int recording_seek(struct recording *r, const struct timespec *ts);
+
+/** Move the read position to the first sample of the recording. */
+void recording_rewind(struct recording *r);
+
+/** Check whether all known samples have been read. */
+int recording_eof(struct recording *r);
+
+/** Map chunks which have been appended to the file since it has been opened. */
+int recording_refresh(struct recording *r);
+
+/** Get the origin timestamp of the first sample in the recording. */
+int recording_first(struct recording *r, struct timespec *ts);
+
+/** @} */
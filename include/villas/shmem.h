@@ -29,27 +29,70 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+
+#include <pthread.h>
+
 #include <villas/pool.h>
 #include <villas/queue.h>
-#include <villas/queue_signalled.h>
 #include <villas/sample.h>
 
 #define DEFAULT_SHMEM_QUEUELEN	512u
 #define DEFAULT_SHMEM_SAMPLELEN	64u
 
+#define SHMEM_MAGIC		0x564e534du	/**< "VNSM" */
+#define SHMEM_VERSION		2
+
+/** Bounds for the number of iterations a consumer spins before it sleeps on the futex. */
+#define SHMEM_SPIN_MIN		64u
+#define SHMEM_SPIN_MAX		(1u << 16)
+
 /** Struct containing all parameters that need to be known when creating a new
  * shared memory object. */
 struct shmem_conf {
-	int polling;			/**< Whether to use polling instead of POSIX CVs */
+	int polling;			/**< Whether to spin instead of sleeping on a futex */
 	int queuelen;			/**< Size of the queues (in elements) */
 	int samplelen;			/**< Maximum number of data entries in a single sample */
 };
 
-/** The structure that actually resides in the shared memory. */
+/** The structure that actually resides in the shared memory.
+ *
+ * Each region is a ring of fixed-size sample slots. The process that created
+ * the region is its producer: it fills the slots and writes the producer area
+ * (head, tail_cache, futex and closed). The other process is the consumer and
+ * only writes the consumer area (tail, head_cache and waiting). The only
+ * exception is shmem_int_close() which also bumps the futex of the region it
+ * reads from to wake up its own blocked reader.
+ *
+ * The samples are stored in the slots themselves, so neither side needs
+ * access to the memory pools of the other one.
+ */
 struct shmem_shared {
-	int polling;			/**< Whether to use a pthread_cond_t to signal if new samples are written to incoming queue. */
-	struct queue_signalled queue;	/**< Queue for samples passed in both directions. */
-	struct pool pool;		/**< Pool for the samples in the queues. */
+	uint32_t magic;			/**< Always SHMEM_MAGIC */
+	uint32_t version;		/**< Version of the protocol, see SHMEM_VERSION */
+
+	int polling;			/**< The consumer does not sleep on shmem_shared::futex. */
+	size_t mask;			/**< Number of slots minus one. The number of slots is a power of two. */
+	size_t slotsz;			/**< Size of a slot in bytes. */
+	unsigned capacity;		/**< Maximum number of values of the sample in each slot. */
+
+	cacheline_pad_t _pad0;	/**< Producer area */
+
+	std::atomic<size_t> head;	/**< Number of published slots. */
+	size_t tail_cache;		/**< Last known value of shmem_shared::tail */
+	std::atomic<uint32_t> futex;	/**< Changed by the producer to wake up a sleeping consumer. */
+	std::atomic<uint32_t> closed;	/**< The producer has closed the interface. */
+
+	cacheline_pad_t _pad1;	/**< Consumer area */
+
+	std::atomic<size_t> tail;	/**< Number of consumed slots. */
+	size_t head_cache;		/**< Last known value of shmem_shared::head */
+	std::atomic<uint32_t> waiting;	/**< The consumer sleeps or is about to sleep on shmem_shared::futex. */
+
+	cacheline_pad_t _pad2;
+
+	char slots[];			/**< The sample slots. The first one starts at the next cacheline boundary. */
 };
 
 /** Relevant information for one direction of the interface. */
@@ -58,6 +101,17 @@ struct shmem_dir {
 	const char *name;		/**< Name of the shmem object. */
 	size_t len;			/**< Total size of the region. */
 	struct shmem_shared *shared;	/**< Actually shared datastructure */
+
+	struct pool pool;		/**< Process-local pool used by shmem_int_alloc() and shmem_int_read(). */
+	unsigned spin;			/**< Current spin budget of the consumer. */
+
+	/** Serializes the threads of this process which use this direction.
+	 *
+	 * The ring only supports a single producer and a single consumer. The
+	 * mutex is held from shmem_int_reserve() until shmem_int_publish() and
+	 * from shmem_int_peek() until shmem_int_consume().
+	 */
+	pthread_mutex_t mutex;
 };
 
 /** Main structure representing the shared memory interface. */
@@ -88,6 +142,9 @@ int shmem_int_open(const char* wname, const char* rname, struct shmem_int* shm,
 int shmem_int_close(struct shmem_int *shm);
 
 /** Read samples from the interface.
+ *
+ * Blocks until at least one sample is available. The samples are copied out
+ * of the ring. Use shmem_int_peek() and shmem_int_consume() to avoid the copy.
  *
  * @param shm The shared memory interface.
  * @param smps  An array where the pointers to the samples will be written. The samples
@@ -99,6 +156,9 @@ int shmem_int_close(struct shmem_int *shm);
 int shmem_int_read(struct shmem_int *shm, struct sample *smps[], unsigned cnt);
 
 /** Write samples to the interface.
+ *
+ * The samples are copied into the ring and released afterwards.
+ * Use shmem_int_reserve() and shmem_int_publish() to avoid the copy.
  *
  * @param shm The shared memory interface.
  * @param smps The samples to be written. Must be allocated from shm_int_alloc.
@@ -110,7 +170,7 @@ int shmem_int_write(struct shmem_int *shm, struct sample *smps[], unsigned cnt);
 
 /** Allocate samples to be written to the interface.
  *
- * The writing process must not free the samples; only the receiving process should free them using sample_decref after use.
+ * The writing process must not free the samples; they are released by shmem_int_write().
  * @param shm The shared memory interface.
  * @param smps Array where pointers to newly allocated samples will be returned.
  * @param cnt Number of samples to allocate.
@@ -123,4 +183,40 @@ int shmem_int_alloc(struct shmem_int *shm, struct sample *smps[], unsigned cnt);
  * per struct sample. */
 size_t shmem_total_size(int queuelen, int samplelen);
 
+/** Reserve slots of the output ring for writing.
+ *
+ * The samples are filled in place and published afterwards with shmem_int_publish().
+ * Each call which reserves at least one slot must be followed by a call to shmem_int_publish().
+ * Other threads of this process which write to the interface block until then.
+ *
+ * @param shm The shared memory interface.
+ * @param smps Array where pointers to the samples of the reserved slots will be returned.
+ * @param cnt Maximum number of slots to reserve.
+ * @retval >=0 Number of reserved slots. Can be less than cnt (including 0) in case of a full ring.
+ * @retval -1 The interface has been closed.
+ */
+int shmem_int_reserve(struct shmem_int *shm, struct sample *smps[], unsigned cnt);
+
+/** Publish the first \p cnt slots which have been reserved by shmem_int_reserve().
+ *
+ * A sleeping consumer is woken up once per batch.
+ */
+int shmem_int_publish(struct shmem_int *shm, unsigned cnt);
+
+/** Get the samples of readable slots of the input ring without copying them.
+ *
+ * Blocks until at least one sample is available. The consumer spins for an
+ * adaptive number of iterations before it sleeps on a futex, unless
+ * polling mode is used. The samples stay valid until shmem_int_consume() is called.
+ * Each call which returns at least one sample must be followed by a call to shmem_int_consume().
+ * Other threads of this process which read from the interface block until then.
+ *
+ * @retval >=0 Number of readable samples.
+ * @retval -1 The other process closed the interface; no samples can be read anymore.
+ */
+int shmem_int_peek(struct shmem_int *shm, struct sample *smps[], unsigned cnt);
+
+/** Release the first \p cnt slots which have been returned by shmem_int_peek(). */
+int shmem_int_consume(struct shmem_int *shm, unsigned cnt);
+
 /** @} */
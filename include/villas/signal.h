@@ -122,6 +122,9 @@ int signal_list_generate2(struct vlist *list, const char *dt);
 void signal_list_dump(const struct vlist *list, const union signal_data *data, unsigned len);
 int signal_list_copy(struct vlist *dst, const struct vlist *src);
 
+/** Get the common type of the first \p len signals or SignalType::INVALID if their types differ. */
+enum SignalType signal_list_type(const struct vlist *list, unsigned len);
+
 enum SignalType signal_type_from_str(const char *str);
 
 enum SignalType signal_type_from_fmtstr(char c);
@@ -133,10 +136,17 @@ enum SignalType signal_type_detect(const char *val);
 /** Convert signal data from one description/format to another. */
 void signal_data_cast(union signal_data *data, const struct signal *from, const struct signal *to);
 
-/** Print value of a signal to a character buffer. */
-int signal_data_print_str(const union signal_data *data, const struct signal *sig, char *buf, size_t len);
+/** Print value of a signal to a character buffer.
+ *
+ * Floating point values are printed in their shortest round-trip representation
+ * unless IOFlags::PRINTF_COMPAT is set in \p flags.
+ *
+ * @return The number of characters written or \p len if the value has been truncated.
+ */
+int signal_data_print_str(const union signal_data *data, const struct signal *sig, char *buf, size_t len, int flags = 0);
 
-int signal_data_parse_str(union signal_data *data, const struct signal *sig, const char *ptr, char **end);
+/** Parse the value of a signal from the first \p len characters of \p ptr. */
+int signal_data_parse_str(union signal_data *data, const struct signal *sig, const char *ptr, size_t len, char **end);
 
 int signal_data_parse_json(union signal_data *data, const struct signal *sig, json_t *cfg);
 
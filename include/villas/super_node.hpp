@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <villas/node/config.h>
 #include <villas/list.h>
 #include <villas/api.hpp>
 #include <villas/web.hpp>
@@ -32,6 +33,10 @@
 #include <villas/task.h>
 #include <villas/common.h>
 
+#ifdef HAS_EPOLL
+  #include <villas/path_scheduler.hpp>
+#endif
+
 /* Forward declarations */
 struct node;
 
@@ -60,9 +65,15 @@ protected:
 	Web web;
 #endif
 
+#ifdef HAS_EPOLL
+	PathScheduler scheduler;	/**< Runs polling paths on a pool of worker threads. */
+#endif
+
 	int priority;		/**< Process priority (lower is better) */
 	int affinity;		/**< Process affinity of the server and all created threads */
 	int hugepages;		/**< Number of hugepages to reserve. */
+	int arenaSize;		/**< Size of the hugepage arenas in MiB or 0 to map each allocation separately. */
+	int giganticPages;	/**< Back the hugepage arenas by 1 GiB pages. */
 
 	struct task task;	/**< Task for periodic stats output */
 
@@ -150,6 +161,12 @@ public:
 	}
 #endif
 
+#ifdef HAS_EPOLL
+	PathScheduler * getScheduler() {
+		return &scheduler;
+	}
+#endif
+
 	json_t * getConfig()
 	{
 		return config.root;
@@ -0,0 +1,74 @@
+/** Locale-independent conversion of numbers for text formats.
+ *
+ * @file
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/** @{
+ * The print functions return the number of characters written to \p buf.
+ * If the value does not fit into \p len characters, \p len is returned.
+ * Hence, consecutive calls can be chained with `off += f(buf + off, len - off, ...)`
+ * and a truncation is detected by checking `off >= len` at the end.
+ * No null-terminator is written.
+ */
+
+/** Print the shortest representation which parses back to the same double.
+ *
+ * If \p precision is positive, the output matches printf("%.*g", precision, v) in the "C" locale.
+ */
+size_t text_print_double(char *buf, size_t len, double v, int precision = 0);
+
+/** Print the shortest representation which parses back to the same float. */
+size_t text_print_float(char *buf, size_t len, float v);
+
+size_t text_print_int(char *buf, size_t len, int64_t v);
+
+/** Print an unsigned integer with at least \p width digits padded by zeros. */
+size_t text_print_uint(char *buf, size_t len, uint64_t v, int width = 0);
+
+size_t text_print_char(char *buf, size_t len, char c);
+
+size_t text_print_str(char *buf, size_t len, const char *str);
+
+/** @} */
+
+/** @{
+ * The parse functions behave like strtod() / strtoll() / strtoull() with base 10.
+ * Leading whitespace and a '+' sign are skipped. Parsing does not depend on the locale
+ * and never reads beyond \p last. If no number is found, \p end is set to \p ptr.
+ * Numbers which are out of range are consumed completely. Like strtod(), the
+ * result is +-HUGE_VAL on overflow and 0 or a denormal number on underflow.
+ * Integers are clamped to the limits of their type.
+ */
+
+double text_parse_double(const char *ptr, const char *last, char **end);
+
+float text_parse_float(const char *ptr, const char *last, char **end);
+
+int64_t text_parse_int(const char *ptr, const char *last, char **end);
+
+uint64_t text_parse_uint(const char *ptr, const char *last, char **end);
+
+/** @} */
@@ -25,6 +25,7 @@
 
 #include <atomic>
 #include <thread>
+#include <vector>
 
 #include <jansson.h>
 
@@ -40,6 +41,17 @@ class Api;
 
 class Web {
 
+public:
+	/** A thread which services a part of the connections of the libwebsockets context. */
+	struct Service {
+		int tsi;			/**< Index of the service thread within libwebsockets. */
+
+		std::thread thread;
+
+		std::atomic<bool> pending;	/**< The service thread has already been woken up for Service::writables. */
+		Queue<lws *> writables;		/**< Queue of WSIs for which we will call lws_callback_on_writable() */
+	};
+
 protected:
 	enum State state;
 
@@ -48,19 +60,21 @@ protected:
 	lws_context *context;		/**< The libwebsockets server context. */
 	lws_vhost *vhost;		/**< The libwebsockets vhost. */
 
-	Queue<lws *> writables;		/**< Queue of WSIs for which we will call lws_callback_on_writable() */
-
 	int port;			/**< Port of the build in HTTP / WebSocket server. */
 	std::string htdocs;		/**< The root directory for files served via HTTP. */
 	std::string ssl_cert;		/**< Path to the SSL certitifcate for HTTPS / WSS. */
 	std::string ssl_private_key;	/**< Path to the SSL private key for HTTPS / WSS. */
+	int compression;		/**< Offer the permessage-deflate extension to WebSocket clients. */
+	int threads;			/**< Number of service threads or 0 for one per core. */
 
-	std::thread thread;
+	std::vector<Service *> services;
 	std::atomic<bool> running;	/**< Atomic flag for signalizing thread termination. */
 
+	static thread_local int tsi;	/**< Index of the service thread which is executing the current callback. */
+
 	Api *api;
 
-	void worker();
+	void worker(Service *s);
 	static void lwsLogger(int level, const char *msg);
 
 public:
@@ -98,7 +112,22 @@ public:
 		return state;
 	}
 
-	void callbackOnWritable(struct lws *wsi);
+	/** Get the index of the calling service thread.
+	 *
+	 * libwebsockets services each connection from a single thread.
+	 * Callers must remember this index during the LWS_CALLBACK_ESTABLISHED
+	 * callback in order to pass it to callbackOnWritable() later.
+	 */
+	static int getServiceThread()
+	{
+		return tsi;
+	}
+
+	/** Request a writable callback for \p wsi from any thread.
+	 *
+	 * @param tsi The index of the service thread which owns \p wsi as returned by getServiceThread().
+	 */
+	void callbackOnWritable(struct lws *wsi, int tsi);
 };
 
 } // namespace node
@@ -35,7 +35,8 @@ using namespace villas::node::api;
 Api::Api(SuperNode *sn) :
 	state(State::INITIALIZED),
 	super_node(sn),
-	server(this)
+	server(this),
+	busy(nullptr)
 {
 	logger = logging.get("api");
 }
@@ -65,11 +66,26 @@ void Api::stop()
 
 	logger->info("Stopping sub-system");
 
-	for (Session *s : sessions)
-		s->shutdown();
+	{
+		std::unique_lock<std::mutex> guard(sessionsMutex);
 
-	for (int i = 0; i < 2 && sessions.size() > 0; i++) {
-		logger->info("Waiting for {} sessions to terminate", sessions.size());
+		for (Session *s : sessions)
+			s->shutdown();
+	}
+
+	for (int i = 0; i < 2; i++) {
+		size_t cnt;
+
+		{
+			std::unique_lock<std::mutex> guard(sessionsMutex);
+
+			cnt = sessions.size();
+		}
+
+		if (cnt == 0)
+			break;
+
+		logger->info("Waiting for {} sessions to terminate", cnt);
 		usleep(1 * 1e6);
 	}
 
@@ -91,16 +107,48 @@ void Api::run()
 	while (!pending.empty()) {
 		Session *s = pending.pop();
 		if (s) {
-			/* Check that the session is still alive */
-			auto it = std::find(sessions.begin(), sessions.end(), s);
-			if (it == sessions.end())
-				return;
+			{
+				std::unique_lock<std::mutex> guard(sessionsMutex);
+
+				/* Check that the session is still alive */
+				auto it = std::find(sessions.begin(), sessions.end(), s);
+				if (it == sessions.end())
+					continue;
+
+				/* Sessions are destroyed by the web service threads.
+				 * removeSession() waits until we are done with it. */
+				busy = s;
+			}
 
 			s->runPendingActions();
+
+			{
+				std::unique_lock<std::mutex> guard(sessionsMutex);
+
+				busy = nullptr;
+			}
+
+			sessionsCv.notify_all();
 		}
 	}
 }
 
+void Api::addSession(Session *s)
+{
+	std::unique_lock<std::mutex> guard(sessionsMutex);
+
+	sessions.push_back(s);
+}
+
+void Api::removeSession(Session *s)
+{
+	std::unique_lock<std::mutex> guard(sessionsMutex);
+
+	sessions.remove(s);
+
+	sessionsCv.wait(guard, [this, s]() { return busy != s; });
+}
+
 void Api::worker()
 {
 	logger->info("Started worker");
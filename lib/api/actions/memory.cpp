@@ -0,0 +1,79 @@
+/** The API ressource for getting the accounting of the hugepage arenas.
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <jansson.h>
+
+#include <villas/memory.h>
+#include <villas/api/action.hpp>
+
+namespace villas {
+namespace node {
+namespace api {
+
+class MemoryAction : public Action {
+
+public:
+	using Action::Action;
+
+	virtual int execute(json_t *args, json_t **resp)
+	{
+		int ret;
+		struct memory_arena_stats s;
+
+		json_t *json_arenas = json_array();
+
+		for (size_t i = 0; i < memory_hugepage_arena_count(); i++) {
+			ret = memory_hugepage_arena_stats(i, &s);
+			if (ret)
+				continue;
+
+			json_array_append_new(json_arenas, json_pack("{ s: I, s: I, s: i, s: I, s: I, s: I, s: I, s: I, s: I, s: I, s: f }",
+				"length", (json_int_t) s.length,
+				"pagesize", (json_int_t) s.pagesize,
+				"node", s.node,
+				"used", (json_int_t) s.managed.used,
+				"requested", (json_int_t) s.managed.requested,
+				"cached", (json_int_t) s.managed.cached,
+				"remaining", (json_int_t) s.managed.remaining,
+				"largest", (json_int_t) s.managed.largest,
+				"allocs", (json_int_t) s.managed.allocs,
+				"frees", (json_int_t) s.managed.frees,
+				"fragmentation", s.managed.fragmentation
+			));
+		}
+
+		*resp = json_pack("{ s: o }",
+			"arenas", json_arenas);
+
+		return 0;
+	}
+};
+
+/* Register action */
+static ActionPlugin<MemoryAction> p(
+	"memory",
+	"get accounting of the hugepage arenas"
+);
+
+} /* namespace api */
+} /* namespace node */
+} /* namespace villas */
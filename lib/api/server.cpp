@@ -191,7 +191,7 @@ void Server::acceptNewSession() {
 	pfds.push_back(pfd);
 	sessions[fd] = s;
 
-	api->sessions.push_back(s);
+	api->addSession(s);
 }
 
 void Server::closeSession(sessions::Socket *s)
@@ -199,7 +199,7 @@ void Server::closeSession(sessions::Socket *s)
 	int sd = s->getSd();
 
 	sessions.erase(sd);
-	api->sessions.remove(s);
+	api->removeSession(s);
 
 	pfds.erase(std::remove_if(pfds.begin(), pfds.end(),
 		[sd](const pollfd &p){ return p.fd == sd; })
@@ -160,7 +160,7 @@ int api_http_protocol_cb(struct lws *wsi, enum lws_callback_reasons reason, void
 
 			new (s) Http(a, wsi);
 
-			a->sessions.push_back(s);
+			a->addSession(s);
 
 			break;
 
@@ -168,7 +168,7 @@ int api_http_protocol_cb(struct lws *wsi, enum lws_callback_reasons reason, void
 			if (s == nullptr)
 				return -1;
 
-			a->sessions.remove(s);
+			a->removeSession(s);
 
 			s->~Http();
 
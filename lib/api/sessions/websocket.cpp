@@ -121,16 +121,15 @@ int api_ws_protocol_cb(lws *wsi, enum lws_callback_reasons reason, void *user, v
 
 			new (s) WebSocket(a, wsi);
 
-			a->sessions.push_back(s);
+			a->addSession(s);
 
 			break;
 
 		case LWS_CALLBACK_CLOSED:
+			a->removeSession(s);
 
 			s->~WebSocket();
 
-			a->sessions.remove(s);
-
 			break;
 
 		case LWS_CALLBACK_RECEIVE:
@@ -32,14 +32,14 @@ void Wsi::runPendingActions()
 
 	logger->debug("Ran pending actions. Triggering on_writeable callback: wsi={}", (void *) wsi);
 
-	web->callbackOnWritable(wsi);
+	web->callbackOnWritable(wsi, tsi);
 }
 
 void Wsi::shutdown()
 {
 	state = State::SHUTDOWN;
 
-	web->callbackOnWritable(wsi);
+	web->callbackOnWritable(wsi, tsi);
 }
 
 std::string Wsi::getName()
@@ -63,7 +63,8 @@ std::string Wsi::getName()
 
 Wsi::Wsi(Api *a, lws *w) :
 	Session(a),
-	wsi(w)
+	wsi(w),
+	tsi(Web::getServiceThread())
 {
 	state = Session::State::ESTABLISHED;
 
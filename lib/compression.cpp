@@ -0,0 +1,537 @@
+/** Streaming compression for file streams.
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <villas/node/config.h>
+#include <villas/utils.hpp>
+#include <villas/log.h>
+#include <villas/compression.h>
+
+#ifdef ZSTD_FOUND
+  #include <zstd.h>
+#endif
+
+#ifdef LZ4_FOUND
+  #include <lz4frame.h>
+#endif
+
+using namespace villas::utils;
+
+/** Size of the buffer for compressed data which is read from the underlying stream. */
+#define COMPRESSOR_INPUT_SIZE	(128 << 10)
+
+/** Maximum number of bytes which are passed to LZ4F_compressUpdate() at once. */
+#define COMPRESSOR_LZ4_CHUNK	(64 << 10)
+
+struct compressor {
+	enum CompressionType type;
+	FILE *file;		/**< The underlying stream of compressed data. */
+
+	bool writing;
+	bool started;		/**< A frame has been started by the first write. */
+	off64_t position;	/**< Number of uncompressed bytes which have been read or written. */
+
+	char *buf;		/**< Compressed data which is read or written next. */
+	size_t buflen;
+	size_t len;		/**< Valid bytes in compressor::buf (reading only). */
+	size_t pos;		/**< Bytes of compressor::buf which have been consumed (reading only). */
+
+#ifdef ZSTD_FOUND
+	ZSTD_CCtx *zcctx;
+	ZSTD_DCtx *zdctx;
+#endif
+#ifdef LZ4_FOUND
+	LZ4F_cctx *lcctx;
+	LZ4F_dctx *ldctx;
+	LZ4F_preferences_t prefs;
+#endif
+};
+
+int compression_parse(const char *name, enum CompressionType *type)
+{
+	if      (!strcmp(name, "auto"))
+		*type = CompressionType::AUTO;
+	else if (!strcmp(name, "none"))
+		*type = CompressionType::NONE;
+#ifdef ZSTD_FOUND
+	else if (!strcmp(name, "zstd"))
+		*type = CompressionType::ZSTD;
+#endif
+#ifdef LZ4_FOUND
+	else if (!strcmp(name, "lz4"))
+		*type = CompressionType::LZ4;
+#endif
+	else
+		return -1;
+
+	return 0;
+}
+
+const char * compression_name(enum CompressionType type)
+{
+	switch (type) {
+		case CompressionType::AUTO:
+			return "auto";
+
+		case CompressionType::NONE:
+			return "none";
+
+		case CompressionType::ZSTD:
+			return "zstd";
+
+		case CompressionType::LZ4:
+			return "lz4";
+	}
+
+	return nullptr;
+}
+
+static bool compression_has_suffix(const char *uri, const char *suffix)
+{
+	size_t len = strlen(uri), slen = strlen(suffix);
+
+	return len >= slen && !strcmp(uri + len - slen, suffix);
+}
+
+enum CompressionType compression_from_uri(const char *uri)
+{
+	if (compression_has_suffix(uri, ".zst") || compression_has_suffix(uri, ".zstd"))
+		return CompressionType::ZSTD;
+
+	if (compression_has_suffix(uri, ".lz4"))
+		return CompressionType::LZ4;
+
+	return CompressionType::NONE;
+}
+
+static int compressor_output(struct compressor *c, const void *buf, size_t len)
+{
+	if (len > 0 && fwrite(buf, len, 1, c->file) != 1)
+		return -1;
+
+	return 0;
+}
+
+/** Refill the buffer of compressed data from the underlying stream.
+ *
+ * @retval 0	The end of the underlying stream has been reached.
+ */
+static ssize_t compressor_input(struct compressor *c)
+{
+	/* The stream might have been appended since we have reached its end */
+	clearerr(c->file);
+
+	c->len = fread(c->buf, 1, c->buflen, c->file);
+	c->pos = 0;
+
+	if (c->len == 0 && ferror(c->file))
+		return -1;
+
+	return c->len;
+}
+
+#ifdef ZSTD_FOUND
+static ssize_t compressor_read_zstd(struct compressor *c, char *buf, size_t size)
+{
+	ZSTD_outBuffer out = { buf, size, 0 };
+
+	for (;;) {
+		ZSTD_inBuffer in = { c->buf, c->len, c->pos };
+
+		/* Also called without new input to drain data buffered by the decoder */
+		size_t ret = ZSTD_decompressStream(c->zdctx, &out, &in);
+		if (ZSTD_isError(ret)) {
+			warning("Failed to decompress stream: %s", ZSTD_getErrorName(ret));
+			errno = EIO;
+			return -1;
+		}
+
+		c->pos = in.pos;
+
+		if (out.pos > 0)
+			return out.pos;
+
+		if (c->pos == c->len) {
+			ssize_t len = compressor_input(c);
+			if (len <= 0)
+				return len;
+		}
+	}
+}
+
+static int compressor_write_zstd(struct compressor *c, const char *buf, size_t size, ZSTD_EndDirective mode)
+{
+	ZSTD_inBuffer in = { buf, size, 0 };
+	size_t remaining;
+
+	do {
+		ZSTD_outBuffer out = { c->buf, c->buflen, 0 };
+
+		remaining = ZSTD_compressStream2(c->zcctx, &out, &in, mode);
+		if (ZSTD_isError(remaining)) {
+			warning("Failed to compress stream: %s", ZSTD_getErrorName(remaining));
+			errno = EIO;
+			return -1;
+		}
+
+		if (compressor_output(c, c->buf, out.pos))
+			return -1;
+
+	/* Flushing and ending frames is complete only once nothing remains */
+	} while (mode == ZSTD_e_continue ? in.pos < in.size : remaining > 0);
+
+	return 0;
+}
+#endif /* ZSTD_FOUND */
+
+#ifdef LZ4_FOUND
+static ssize_t compressor_read_lz4(struct compressor *c, char *buf, size_t size)
+{
+	for (;;) {
+		size_t dlen = size;
+		size_t slen = c->len - c->pos;
+
+		size_t ret = LZ4F_decompress(c->ldctx, buf, &dlen, c->buf + c->pos, &slen, nullptr);
+		if (LZ4F_isError(ret)) {
+			warning("Failed to decompress stream: %s", LZ4F_getErrorName(ret));
+			errno = EIO;
+			return -1;
+		}
+
+		c->pos += slen;
+
+		if (dlen > 0)
+			return dlen;
+
+		if (c->pos == c->len) {
+			ssize_t len = compressor_input(c);
+			if (len <= 0)
+				return len;
+		}
+	}
+}
+
+static int compressor_write_lz4(struct compressor *c, const char *buf, size_t size)
+{
+	size_t ret;
+
+	if (!c->started) {
+		ret = LZ4F_compressBegin(c->lcctx, c->buf, c->buflen, &c->prefs);
+		if (LZ4F_isError(ret))
+			goto fail;
+
+		if (compressor_output(c, c->buf, ret))
+			return -1;
+	}
+
+	while (size > 0) {
+		size_t len = MIN(size, COMPRESSOR_LZ4_CHUNK);
+
+		ret = LZ4F_compressUpdate(c->lcctx, c->buf, c->buflen, buf, len, nullptr);
+		if (LZ4F_isError(ret))
+			goto fail;
+
+		if (compressor_output(c, c->buf, ret))
+			return -1;
+
+		buf += len;
+		size -= len;
+	}
+
+	return 0;
+
+fail:	warning("Failed to compress stream: %s", LZ4F_getErrorName(ret));
+	errno = EIO;
+
+	return -1;
+}
+#endif /* LZ4_FOUND */
+
+static ssize_t compressor_read(void *cookie, char *buf, size_t size)
+{
+	struct compressor *c = (struct compressor *) cookie;
+	ssize_t ret;
+
+	switch (c->type) {
+#ifdef ZSTD_FOUND
+		case CompressionType::ZSTD:
+			ret = compressor_read_zstd(c, buf, size);
+			break;
+#endif
+#ifdef LZ4_FOUND
+		case CompressionType::LZ4:
+			ret = compressor_read_lz4(c, buf, size);
+			break;
+#endif
+		default:
+			errno = EINVAL;
+			return -1;
+	}
+
+	if (ret > 0)
+		c->position += ret;
+
+	return ret;
+}
+
+static ssize_t compressor_write(void *cookie, const char *buf, size_t size)
+{
+	struct compressor *c = (struct compressor *) cookie;
+	int ret;
+
+	switch (c->type) {
+#ifdef ZSTD_FOUND
+		case CompressionType::ZSTD:
+			ret = compressor_write_zstd(c, buf, size, ZSTD_e_continue);
+			break;
+#endif
+#ifdef LZ4_FOUND
+		case CompressionType::LZ4:
+			ret = compressor_write_lz4(c, buf, size);
+			break;
+#endif
+		default:
+			errno = EINVAL;
+			return -1;
+	}
+
+	if (ret)
+		return 0; /* Signals an error to stdio */
+
+	c->started = true;
+	c->position += size;
+
+	return size;
+}
+
+/** Only rewinding input streams and querying the position are supported. */
+static int compressor_seek(void *cookie, off64_t *offset, int whence)
+{
+	struct compressor *c = (struct compressor *) cookie;
+
+	if (whence == SEEK_CUR && *offset == 0) {
+		*offset = c->position;
+		return 0;
+	}
+
+	if (c->writing || whence != SEEK_SET || *offset != 0) {
+		errno = ESPIPE;
+		return -1;
+	}
+
+	switch (c->type) {
+#ifdef ZSTD_FOUND
+		case CompressionType::ZSTD:
+			ZSTD_DCtx_reset(c->zdctx, ZSTD_reset_session_only);
+			break;
+#endif
+#ifdef LZ4_FOUND
+		case CompressionType::LZ4:
+			LZ4F_resetDecompressionContext(c->ldctx);
+			break;
+#endif
+		default: { }
+	}
+
+	rewind(c->file);
+
+	c->len = 0;
+	c->pos = 0;
+	c->position = 0;
+
+	return 0;
+}
+
+/** Complete the current block or frame. */
+static int compressor_end(struct compressor *c, bool end)
+{
+	if (!c->writing || !c->started)
+		return 0;
+
+	switch (c->type) {
+#ifdef ZSTD_FOUND
+		case CompressionType::ZSTD:
+			if (compressor_write_zstd(c, nullptr, 0, end ? ZSTD_e_end : ZSTD_e_flush))
+				return -1;
+			break;
+#endif
+#ifdef LZ4_FOUND
+		case CompressionType::LZ4: {
+			size_t ret = end
+				? LZ4F_compressEnd(c->lcctx, c->buf, c->buflen, nullptr)
+				: LZ4F_flush(c->lcctx, c->buf, c->buflen, nullptr);
+			if (LZ4F_isError(ret)) {
+				errno = EIO;
+				return -1;
+			}
+
+			if (compressor_output(c, c->buf, ret))
+				return -1;
+			break;
+		}
+#endif
+		default: { }
+	}
+
+	if (end)
+		c->started = false;
+
+	return fflush(c->file);
+}
+
+static int compressor_close(void *cookie)
+{
+	struct compressor *c = (struct compressor *) cookie;
+	int ret;
+
+	ret = compressor_end(c, true);
+
+	if (c->file && fclose(c->file))
+		ret = -1;
+
+#ifdef ZSTD_FOUND
+	ZSTD_freeCCtx(c->zcctx);
+	ZSTD_freeDCtx(c->zdctx);
+#endif
+#ifdef LZ4_FOUND
+	LZ4F_freeCompressionContext(c->lcctx);
+	LZ4F_freeDecompressionContext(c->ldctx);
+#endif
+
+	free(c->buf);
+	free(c);
+
+	return ret;
+}
+
+int compressor_flush(struct compressor *c)
+{
+	return compressor_end(c, false);
+}
+
+static int compressor_init(struct compressor *c, const struct compression *cfg)
+{
+	switch (c->type) {
+#ifdef ZSTD_FOUND
+		case CompressionType::ZSTD:
+			if (c->writing) {
+				size_t ret;
+
+				c->zcctx = ZSTD_createCCtx();
+				if (!c->zcctx)
+					return -1;
+
+				ret = ZSTD_CCtx_setParameter(c->zcctx, ZSTD_c_compressionLevel, cfg->level ? cfg->level : ZSTD_CLEVEL_DEFAULT);
+				if (ZSTD_isError(ret))
+					return -1;
+
+				if (cfg->threads > 0) {
+					ret = ZSTD_CCtx_setParameter(c->zcctx, ZSTD_c_nbWorkers, cfg->threads);
+					if (ZSTD_isError(ret))
+						warning("Multi-threaded compression is not supported by libzstd: %s", ZSTD_getErrorName(ret));
+				}
+
+				c->buflen = ZSTD_CStreamOutSize();
+			}
+			else {
+				c->zdctx = ZSTD_createDCtx();
+				if (!c->zdctx)
+					return -1;
+
+				c->buflen = ZSTD_DStreamInSize();
+			}
+			break;
+#endif
+#ifdef LZ4_FOUND
+		case CompressionType::LZ4:
+			if (c->writing) {
+				if (LZ4F_isError(LZ4F_createCompressionContext(&c->lcctx, LZ4F_VERSION)))
+					return -1;
+
+				memset(&c->prefs, 0, sizeof(c->prefs));
+				c->prefs.compressionLevel = cfg->level;
+				c->prefs.frameInfo.blockMode = LZ4F_blockLinked;
+				c->prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+
+				c->buflen = LZ4F_compressBound(COMPRESSOR_LZ4_CHUNK, &c->prefs);
+			}
+			else {
+				if (LZ4F_isError(LZ4F_createDecompressionContext(&c->ldctx, LZ4F_VERSION)))
+					return -1;
+
+				c->buflen = COMPRESSOR_INPUT_SIZE;
+			}
+			break;
+#endif
+		default:
+			errno = ENOTSUP;
+			return -1;
+	}
+
+	c->buf = (char *) alloc(c->buflen);
+	if (!c->buf)
+		return -1;
+
+	return 0;
+}
+
+FILE * compressor_open(FILE *f, const struct compression *cfg, const char *mode, struct compressor **cp)
+{
+	FILE *s;
+	int ret;
+
+	cookie_io_functions_t funcs = {
+		.read = compressor_read,
+		.write = compressor_write,
+		.seek = compressor_seek,
+		.close = compressor_close
+	};
+
+	auto *c = (struct compressor *) alloc(sizeof(struct compressor));
+	if (!c)
+		return nullptr;
+
+	c->type = cfg->type;
+	c->file = f;
+	c->writing = mode[0] != 'r';
+
+	ret = compressor_init(c, cfg);
+	if (ret)
+		goto fail;
+
+	s = fopencookie(c, c->writing ? "w" : "r", funcs);
+	if (!s)
+		goto fail;
+
+	if (cp)
+		*cp = c;
+
+	return s;
+
+fail:	c->file = nullptr;
+	compressor_close(c);
+
+	return nullptr;
+}
@@ -0,0 +1,94 @@
+/** Stub of the streaming compression for builds without zstd, lz4 or fopencookie().
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <cerrno>
+#include <cstring>
+
+#include <villas/log.h>
+#include <villas/compression.h>
+
+int compression_parse(const char *name, enum CompressionType *type)
+{
+	if      (!strcmp(name, "auto"))
+		*type = CompressionType::AUTO;
+	else if (!strcmp(name, "none"))
+		*type = CompressionType::NONE;
+	else
+		return -1;
+
+	return 0;
+}
+
+const char * compression_name(enum CompressionType type)
+{
+	switch (type) {
+		case CompressionType::AUTO:
+			return "auto";
+
+		case CompressionType::NONE:
+			return "none";
+
+		case CompressionType::ZSTD:
+			return "zstd";
+
+		case CompressionType::LZ4:
+			return "lz4";
+	}
+
+	return nullptr;
+}
+
+static bool compression_has_suffix(const char *uri, const char *suffix)
+{
+	size_t len = strlen(uri), slen = strlen(suffix);
+
+	return len >= slen && !strcmp(uri + len - slen, suffix);
+}
+
+/* Compressed files are still detected. So they are rejected by compressor_open()
+ * instead of being read or appended as plain text. */
+enum CompressionType compression_from_uri(const char *uri)
+{
+	if (compression_has_suffix(uri, ".zst") || compression_has_suffix(uri, ".zstd"))
+		return CompressionType::ZSTD;
+
+	if (compression_has_suffix(uri, ".lz4"))
+		return CompressionType::LZ4;
+
+	return CompressionType::NONE;
+}
+
+FILE * compressor_open(FILE *f, const struct compression *c, const char *mode, struct compressor **cp)
+{
+	warning("Compression '%s' is not supported by this build", compression_name(c->type));
+
+	errno = ENOTSUP;
+
+	return nullptr;
+}
+
+int compressor_flush(struct compressor *c)
+{
+	errno = ENOTSUP;
+
+	return -1;
+}
@@ -0,0 +1,493 @@
+/** Vectorized conversion kernels for binary formats.
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <cstring>
+
+#include <villas/formats/convert.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define CONVERT_X86
+  #include <immintrin.h>
+#endif
+
+struct convert_kernels {
+	const char *name;
+
+	void (*f64_to_f32)(void *dst, const double *src, size_t cnt, bool swap);
+	void (*f32_to_f64)(double *dst, const void *src, size_t cnt, bool swap);
+	void (*i64_to_i32)(void *dst, const int64_t *src, size_t cnt, bool swap);
+	void (*i32_to_i64)(int64_t *dst, const void *src, size_t cnt, bool swap, bool sign);
+	void (*copy64)(void *dst, const void *src, size_t cnt, bool swap);
+};
+
+/* Scalar kernels
+ *
+ * These are also used for the remainders of the vectorized kernels.
+ */
+
+static void f64_to_f32_scalar(void *dst, const double *src, size_t cnt, bool swap)
+{
+	uint32_t *d = (uint32_t *) dst;
+
+	for (size_t i = 0; i < cnt; i++) {
+		float f = src[i];
+		uint32_t u;
+
+		memcpy(&u, &f, sizeof(u));
+		u = swap ? __builtin_bswap32(u) : u;
+		memcpy(&d[i], &u, sizeof(u));
+	}
+}
+
+static void f32_to_f64_scalar(double *dst, const void *src, size_t cnt, bool swap)
+{
+	const uint32_t *s = (const uint32_t *) src;
+
+	for (size_t i = 0; i < cnt; i++) {
+		uint32_t u;
+		float f;
+
+		memcpy(&u, &s[i], sizeof(u));
+		u = swap ? __builtin_bswap32(u) : u;
+		memcpy(&f, &u, sizeof(f));
+
+		dst[i] = f;
+	}
+}
+
+static void i64_to_i32_scalar(void *dst, const int64_t *src, size_t cnt, bool swap)
+{
+	uint32_t *d = (uint32_t *) dst;
+
+	for (size_t i = 0; i < cnt; i++) {
+		uint32_t u = src[i];
+
+		u = swap ? __builtin_bswap32(u) : u;
+		memcpy(&d[i], &u, sizeof(u));
+	}
+}
+
+static void i32_to_i64_scalar(int64_t *dst, const void *src, size_t cnt, bool swap, bool sign)
+{
+	const uint32_t *s = (const uint32_t *) src;
+
+	for (size_t i = 0; i < cnt; i++) {
+		uint32_t u;
+
+		memcpy(&u, &s[i], sizeof(u));
+		u = swap ? __builtin_bswap32(u) : u;
+
+		dst[i] = sign ? (int64_t) (int32_t) u : (int64_t) u;
+	}
+}
+
+static void copy64_scalar(void *dst, const void *src, size_t cnt, bool swap)
+{
+	uint64_t *d = (uint64_t *) dst;
+	const uint64_t *s = (const uint64_t *) src;
+
+	if (!swap) {
+		memmove(dst, src, cnt * sizeof(uint64_t));
+		return;
+	}
+
+	for (size_t i = 0; i < cnt; i++) {
+		uint64_t u;
+
+		memcpy(&u, &s[i], sizeof(u));
+		u = __builtin_bswap64(u);
+		memcpy(&d[i], &u, sizeof(u));
+	}
+}
+
+static const struct convert_kernels kernels_scalar = {
+	.name = "scalar",
+	.f64_to_f32 = f64_to_f32_scalar,
+	.f32_to_f64 = f32_to_f64_scalar,
+	.i64_to_i32 = i64_to_i32_scalar,
+	.i32_to_i64 = i32_to_i64_scalar,
+	.copy64 = copy64_scalar
+};
+
+#ifdef CONVERT_X86
+
+/* SSE2 kernels
+ *
+ * SSE2 has no byte shuffle. So we swap the bytes of each 16-bit word
+ * with shifts and reorder the words afterwards.
+ */
+
+__attribute__((target("sse2")))
+static inline __m128i bswap32_sse2(__m128i x)
+{
+	x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+	x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+
+	return _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i bswap64_sse2(__m128i x)
+{
+	x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+	x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+
+	return _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+__attribute__((target("sse2")))
+static void f64_to_f32_sse2(void *dst, const double *src, size_t cnt, bool swap)
+{
+	char *d = (char *) dst;
+	size_t i = 0;
+
+	for (; i + 4 <= cnt; i += 4) {
+		__m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(&src[i]));
+		__m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(&src[i + 2]));
+		__m128i v = _mm_castps_si128(_mm_movelh_ps(lo, hi));
+
+		if (swap)
+			v = bswap32_sse2(v);
+
+		_mm_storeu_si128((__m128i *) (d + i * 4), v);
+	}
+
+	f64_to_f32_scalar(d + i * 4, &src[i], cnt - i, swap);
+}
+
+__attribute__((target("sse2")))
+static void f32_to_f64_sse2(double *dst, const void *src, size_t cnt, bool swap)
+{
+	const char *s = (const char *) src;
+	size_t i = 0;
+
+	for (; i + 4 <= cnt; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (s + i * 4));
+
+		if (swap)
+			v = bswap32_sse2(v);
+
+		__m128 f = _mm_castsi128_ps(v);
+
+		_mm_storeu_pd(&dst[i],     _mm_cvtps_pd(f));
+		_mm_storeu_pd(&dst[i + 2], _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+	}
+
+	f32_to_f64_scalar(&dst[i], s + i * 4, cnt - i, swap);
+}
+
+__attribute__((target("sse2")))
+static void i64_to_i32_sse2(void *dst, const int64_t *src, size_t cnt, bool swap)
+{
+	char *d = (char *) dst;
+	size_t i = 0;
+
+	for (; i + 4 <= cnt; i += 4) {
+		__m128i lo = _mm_loadu_si128((const __m128i *) &src[i]);
+		__m128i hi = _mm_loadu_si128((const __m128i *) &src[i + 2]);
+
+		/* Gather the lower double words */
+		lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+		hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+
+		__m128i v = _mm_unpacklo_epi64(lo, hi);
+
+		if (swap)
+			v = bswap32_sse2(v);
+
+		_mm_storeu_si128((__m128i *) (d + i * 4), v);
+	}
+
+	i64_to_i32_scalar(d + i * 4, &src[i], cnt - i, swap);
+}
+
+__attribute__((target("sse2")))
+static void i32_to_i64_sse2(int64_t *dst, const void *src, size_t cnt, bool swap, bool sign)
+{
+	const char *s = (const char *) src;
+	size_t i = 0;
+
+	for (; i + 4 <= cnt; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (s + i * 4));
+
+		if (swap)
+			v = bswap32_sse2(v);
+
+		__m128i ext = sign ? _mm_srai_epi32(v, 31) : _mm_setzero_si128();
+
+		_mm_storeu_si128((__m128i *) &dst[i],     _mm_unpacklo_epi32(v, ext));
+		_mm_storeu_si128((__m128i *) &dst[i + 2], _mm_unpackhi_epi32(v, ext));
+	}
+
+	i32_to_i64_scalar(&dst[i], s + i * 4, cnt - i, swap, sign);
+}
+
+__attribute__((target("sse2")))
+static void copy64_sse2(void *dst, const void *src, size_t cnt, bool swap)
+{
+	char *d = (char *) dst;
+	const char *s = (const char *) src;
+	size_t i = 0;
+
+	if (!swap) {
+		memmove(dst, src, cnt * sizeof(uint64_t));
+		return;
+	}
+
+	for (; i + 2 <= cnt; i += 2) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (s + i * 8));
+
+		_mm_storeu_si128((__m128i *) (d + i * 8), bswap64_sse2(v));
+	}
+
+	copy64_scalar(d + i * 8, s + i * 8, cnt - i, swap);
+}
+
+static const struct convert_kernels kernels_sse2 = {
+	.name = "sse2",
+	.f64_to_f32 = f64_to_f32_sse2,
+	.f32_to_f64 = f32_to_f64_sse2,
+	.i64_to_i32 = i64_to_i32_sse2,
+	.i32_to_i64 = i32_to_i64_sse2,
+	.copy64 = copy64_sse2
+};
+
+/* AVX2 kernels */
+
+__attribute__((target("avx2")))
+static inline __m256i bswap32_avx2(__m256i x)
+{
+	const __m256i mask = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	return _mm256_shuffle_epi8(x, mask);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i bswap64_avx2(__m256i x)
+{
+	const __m256i mask = _mm256_setr_epi8(
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+	return _mm256_shuffle_epi8(x, mask);
+}
+
+__attribute__((target("avx2")))
+static void f64_to_f32_avx2(void *dst, const double *src, size_t cnt, bool swap)
+{
+	char *d = (char *) dst;
+	size_t i = 0;
+
+	for (; i + 8 <= cnt; i += 8) {
+		__m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(&src[i]));
+		__m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(&src[i + 4]));
+		__m256i v = _mm256_castps_si256(_mm256_set_m128(hi, lo));
+
+		if (swap)
+			v = bswap32_avx2(v);
+
+		_mm256_storeu_si256((__m256i *) (d + i * 4), v);
+	}
+
+	f64_to_f32_sse2(d + i * 4, &src[i], cnt - i, swap);
+}
+
+__attribute__((target("avx2")))
+static void f32_to_f64_avx2(double *dst, const void *src, size_t cnt, bool swap)
+{
+	const char *s = (const char *) src;
+	size_t i = 0;
+
+	for (; i + 8 <= cnt; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (s + i * 4));
+
+		if (swap)
+			v = bswap32_avx2(v);
+
+		__m256 f = _mm256_castsi256_ps(v);
+
+		_mm256_storeu_pd(&dst[i],     _mm256_cvtps_pd(_mm256_castps256_ps128(f)));
+		_mm256_storeu_pd(&dst[i + 4], _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)));
+	}
+
+	f32_to_f64_sse2(&dst[i], s + i * 4, cnt - i, swap);
+}
+
+__attribute__((target("avx2")))
+static void i64_to_i32_avx2(void *dst, const int64_t *src, size_t cnt, bool swap)
+{
+	char *d = (char *) dst;
+	size_t i = 0;
+
+	/* Moves the lower double words into the lower lane */
+	const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+	for (; i + 8 <= cnt; i += 8) {
+		__m256i lo = _mm256_loadu_si256((const __m256i *) &src[i]);
+		__m256i hi = _mm256_loadu_si256((const __m256i *) &src[i + 4]);
+
+		lo = _mm256_permutevar8x32_epi32(lo, idx);
+		hi = _mm256_permutevar8x32_epi32(hi, idx);
+
+		__m256i v = _mm256_permute2x128_si256(lo, hi, 0x20);
+
+		if (swap)
+			v = bswap32_avx2(v);
+
+		_mm256_storeu_si256((__m256i *) (d + i * 4), v);
+	}
+
+	i64_to_i32_sse2(d + i * 4, &src[i], cnt - i, swap);
+}
+
+__attribute__((target("avx2")))
+static void i32_to_i64_avx2(int64_t *dst, const void *src, size_t cnt, bool swap, bool sign)
+{
+	const char *s = (const char *) src;
+	size_t i = 0;
+
+	for (; i + 8 <= cnt; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (s + i * 4));
+
+		if (swap)
+			v = bswap32_avx2(v);
+
+		__m128i lo = _mm256_castsi256_si128(v);
+		__m128i hi = _mm256_extracti128_si256(v, 1);
+
+		if (sign) {
+			_mm256_storeu_si256((__m256i *) &dst[i],     _mm256_cvtepi32_epi64(lo));
+			_mm256_storeu_si256((__m256i *) &dst[i + 4], _mm256_cvtepi32_epi64(hi));
+		}
+		else {
+			_mm256_storeu_si256((__m256i *) &dst[i],     _mm256_cvtepu32_epi64(lo));
+			_mm256_storeu_si256((__m256i *) &dst[i + 4], _mm256_cvtepu32_epi64(hi));
+		}
+	}
+
+	i32_to_i64_sse2(&dst[i], s + i * 4, cnt - i, swap, sign);
+}
+
+__attribute__((target("avx2")))
+static void copy64_avx2(void *dst, const void *src, size_t cnt, bool swap)
+{
+	char *d = (char *) dst;
+	const char *s = (const char *) src;
+	size_t i = 0;
+
+	if (!swap) {
+		memmove(dst, src, cnt * sizeof(uint64_t));
+		return;
+	}
+
+	for (; i + 4 <= cnt; i += 4) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (s + i * 8));
+
+		_mm256_storeu_si256((__m256i *) (d + i * 8), bswap64_avx2(v));
+	}
+
+	copy64_sse2(d + i * 8, s + i * 8, cnt - i, swap);
+}
+
+static const struct convert_kernels kernels_avx2 = {
+	.name = "avx2",
+	.f64_to_f32 = f64_to_f32_avx2,
+	.f32_to_f64 = f32_to_f64_avx2,
+	.i64_to_i32 = i64_to_i32_avx2,
+	.i32_to_i64 = i32_to_i64_avx2,
+	.copy64 = copy64_avx2
+};
+
+#endif /* CONVERT_X86 */
+
+static const struct convert_kernels *kernels = &kernels_scalar;
+
+__attribute__((constructor)) static void convert_init()
+{
+	convert_select(nullptr);
+}
+
+int convert_select(const char *name)
+{
+	const struct convert_kernels *candidates[] = {
+#ifdef CONVERT_X86
+		&kernels_avx2,
+		&kernels_sse2,
+#endif /* CONVERT_X86 */
+		&kernels_scalar
+	};
+
+#ifdef CONVERT_X86
+	__builtin_cpu_init();
+#endif /* CONVERT_X86 */
+
+	for (const struct convert_kernels *k : candidates) {
+		if (name && strcmp(name, k->name))
+			continue;
+
+#ifdef CONVERT_X86
+		if (k == &kernels_avx2 && !__builtin_cpu_supports("avx2"))
+			continue;
+
+		if (k == &kernels_sse2 && !__builtin_cpu_supports("sse2"))
+			continue;
+#endif /* CONVERT_X86 */
+
+		kernels = k;
+
+		return 0;
+	}
+
+	return -1;
+}
+
+void convert_f64_to_f32(void *dst, const double *src, size_t cnt, bool swap)
+{
+	kernels->f64_to_f32(dst, src, cnt, swap);
+}
+
+void convert_f32_to_f64(double *dst, const void *src, size_t cnt, bool swap)
+{
+	kernels->f32_to_f64(dst, src, cnt, swap);
+}
+
+void convert_i64_to_i32(void *dst, const int64_t *src, size_t cnt, bool swap)
+{
+	kernels->i64_to_i32(dst, src, cnt, swap);
+}
+
+void convert_i32_to_i64(int64_t *dst, const void *src, size_t cnt, bool swap, bool sign)
+{
+	kernels->i32_to_i64(dst, src, cnt, swap, sign);
+}
+
+void convert_copy64(void *dst, const void *src, size_t cnt, bool swap)
+{
+	kernels->copy64(dst, src, cnt, swap);
+}
+
+const char * convert_implementation()
+{
+	return kernels->name;
+}
@@ -30,6 +30,7 @@
 #include <villas/sample.h>
 #include <villas/signal.h>
 #include <villas/timing.h>
+#include <villas/text_codec.h>
 
 using namespace villas::utils;
 
@@ -39,24 +40,43 @@ static size_t csv_sprint_single(struct io *io, char *buf, size_t len, const stru
 	struct signal *sig;
 
 	if (io->flags & (int) SampleFlags::HAS_TS_ORIGIN) {
-		if (io->flags & (int) SampleFlags::HAS_TS_ORIGIN)
-			off += snprintf(buf + off, len - off, "%ld%c%09ld", smp->ts.origin.tv_sec, io->separator, smp->ts.origin.tv_nsec);
-		else
-			off += snprintf(buf + off, len - off, "nan%cnan", io->separator);
+		if (io->flags & (int) SampleFlags::HAS_TS_ORIGIN) {
+			off += text_print_int(buf + off, len - off, smp->ts.origin.tv_sec);
+			off += text_print_char(buf + off, len - off, io->separator);
+			off += text_print_uint(buf + off, len - off, smp->ts.origin.tv_nsec, 9);
+		}
+		else {
+			off += text_print_str(buf + off, len - off, "nan");
+			off += text_print_char(buf + off, len - off, io->separator);
+			off += text_print_str(buf + off, len - off, "nan");
+		}
 	}
 
 	if (io->flags & (int) SampleFlags::HAS_OFFSET) {
-		if ((smp->flags & (int) SampleFlags::HAS_TS_RECEIVED) && (smp->flags & (int) SampleFlags::HAS_TS_RECEIVED))
-			off += snprintf(buf + off, len - off, "%c%.09f", io->separator, time_delta(&smp->ts.origin, &smp->ts.received));
+		off += text_print_char(buf + off, len - off, io->separator);
+
+		if ((smp->flags & (int) SampleFlags::HAS_TS_RECEIVED) && (smp->flags & (int) SampleFlags::HAS_TS_RECEIVED)) {
+			double offset = time_delta(&smp->ts.origin, &smp->ts.received);
+
+			if (io->flags & (int) IOFlags::PRINTF_COMPAT) {
+				int ret = snprintf(buf + off, len - off, "%.09f", offset);
+
+				off += ret < 0 ? 0 : MIN((size_t) ret, len - off);
+			}
+			else
+				off += text_print_double(buf + off, len - off, offset);
+		}
 		else
-			off += snprintf(buf + off, len - off, "%cnan", io->separator);
+			off += text_print_str(buf + off, len - off, "nan");
 	}
 
 	if (io->flags & (int) SampleFlags::HAS_SEQUENCE) {
+		off += text_print_char(buf + off, len - off, io->separator);
+
 		if (smp->flags & (int) SampleFlags::HAS_SEQUENCE)
-			off += snprintf(buf + off, len - off, "%c%" PRIu64, io->separator, smp->sequence);
+			off += text_print_uint(buf + off, len - off, smp->sequence);
 		else
-			off += snprintf(buf + off, len - off, "%cnan", io->separator);
+			off += text_print_str(buf + off, len - off, "nan");
 	}
 
 	if (io->flags & (int) SampleFlags::HAS_DATA) {
@@ -65,12 +85,18 @@ static size_t csv_sprint_single(struct io *io, char *buf, size_t len, const stru
 			if (!sig)
 				break;
 
-			off += snprintf(buf + off, len - off, "%c", io->separator);
-			off += signal_data_print_str(&smp->data[i], sig, buf + off, len - off);
+			off += text_print_char(buf + off, len - off, io->separator);
+			off += signal_data_print_str(&smp->data[i], sig, buf + off, len - off, io->flags);
 		}
 	}
 
-	off += snprintf(buf + off, len - off, "%c", io->delimiter);
+	off += text_print_char(buf + off, len - off, io->delimiter);
+
+	/* The sample has been truncated. We leave room for a null-terminator */
+	if (off >= len)
+		return 0;
+
+	buf[off] = '\0';
 
 	return off;
 }
@@ -80,6 +106,7 @@ static size_t csv_sscan_single(struct io *io, const char *buf, size_t len, struc
 	int ret;
 	unsigned i = 0;
 	const char *ptr = buf;
+	const char *last = buf + len;
 	char *end;
 
 	double offset __attribute__((unused));
@@ -87,47 +114,47 @@ static size_t csv_sscan_single(struct io *io, const char *buf, size_t len, struc
 	smp->flags = 0;
 	smp->signals = io->signals;
 
-	smp->ts.origin.tv_sec = strtoul(ptr, &end, 10);
-	if (end == ptr || *end == io->delimiter)
+	smp->ts.origin.tv_sec = text_parse_uint(ptr, last, &end);
+	if (end == ptr || end == last || *end == io->delimiter)
 		goto out;
 
 	ptr = end + 1;
 
-	smp->ts.origin.tv_nsec = strtoul(ptr, &end, 10);
-	if (end == ptr || *end == io->delimiter)
+	smp->ts.origin.tv_nsec = text_parse_uint(ptr, last, &end);
+	if (end == ptr || end == last || *end == io->delimiter)
 		goto out;
 
 	ptr = end + 1;
 
 	smp->flags |= (int) SampleFlags::HAS_TS_ORIGIN;
 
-	offset = strtof(ptr, &end);
-	if (end == ptr || *end == io->delimiter)
+	offset = text_parse_double(ptr, last, &end);
+	if (end == ptr || end == last || *end == io->delimiter)
 		goto out;
 
 	ptr = end + 1;
 
-	smp->sequence = strtoul(ptr, &end, 10);
-	if (end == ptr || *end == io->delimiter)
+	smp->sequence = text_parse_uint(ptr, last, &end);
+	if (end == ptr || end == last || *end == io->delimiter)
 		goto out;
 
 	smp->flags |= (int) SampleFlags::HAS_SEQUENCE;
 
 	for (ptr = end + 1, i = 0; i < smp->capacity; ptr = end + 1, i++) {
 
-		if (*end == io->delimiter)
+		if (end >= last || *end == io->delimiter)
 			goto out;
 
 		struct signal *sig = (struct signal *) vlist_at_safe(smp->signals, i);
 		if (!sig)
 			goto out;
 
-		ret = signal_data_parse_str(&smp->data[i], sig, ptr, &end);
+		ret = signal_data_parse_str(&smp->data[i], sig, ptr, last - ptr, &end);
 		if (ret || end == ptr) /* There are no valid values anymore. */
 			goto out;
 	}
 
-out:	if (*end == io->delimiter)
+out:	if (end < last && *end == io->delimiter)
 		end++;
 
 	smp->length = i;
@@ -142,8 +169,13 @@ int csv_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct samp
 	unsigned i;
 	size_t off = 0;
 
-	for (i = 0; i < cnt && off < len; i++)
-		off += csv_sprint_single(io, buf + off, len - off, smps[i]);
+	for (i = 0; i < cnt && off < len; i++) {
+		size_t wlen = csv_sprint_single(io, buf + off, len - off, smps[i]);
+		if (!wlen)
+			break;
+
+		off += wlen;
+	}
 
 	if (wbytes)
 		*wbytes = off;
@@ -246,3 +278,51 @@ __attribute__((destructor(110))) static void UNIQUE(__dtor)() {
 	if (plugins.state != State::DESTROYED)
 		vlist_remove_all(&plugins, &p2);
 }
+
+static struct plugin p3;
+__attribute__((constructor(110))) static void UNIQUE(__ctor)() {
+	if (plugins.state == State::DESTROYED)
+		vlist_init(&plugins);
+
+	p3.name = "tsv.compat";
+	p3.description = "Tabulator-separated values (printf-compatible numbers)";
+	p3.type = PluginType::FORMAT;
+	p3.format.header = csv_header;
+	p3.format.sprint = csv_sprint;
+	p3.format.sscan	= csv_sscan;
+	p3.format.size 	= 0;
+	p3.format.flags	= (int) IOFlags::NEWLINES | (int) IOFlags::PRINTF_COMPAT |
+			  (int) SampleFlags::HAS_TS_ORIGIN | (int) SampleFlags::HAS_SEQUENCE | (int) SampleFlags::HAS_DATA;
+	p3.format.separator = '\t';
+
+	vlist_push(&plugins, &p3);
+}
+
+__attribute__((destructor(110))) static void UNIQUE(__dtor)() {
+	if (plugins.state != State::DESTROYED)
+		vlist_remove_all(&plugins, &p3);
+}
+
+static struct plugin p4;
+__attribute__((constructor(110))) static void UNIQUE(__ctor)() {
+	if (plugins.state == State::DESTROYED)
+		vlist_init(&plugins);
+
+	p4.name = "csv.compat";
+	p4.description = "Comma-separated values (printf-compatible numbers)";
+	p4.type = PluginType::FORMAT;
+	p4.format.header = csv_header;
+	p4.format.sprint = csv_sprint;
+	p4.format.sscan	= csv_sscan;
+	p4.format.size 	= 0;
+	p4.format.flags	= (int) IOFlags::NEWLINES | (int) IOFlags::PRINTF_COMPAT |
+			  (int) SampleFlags::HAS_TS_ORIGIN | (int) SampleFlags::HAS_SEQUENCE | (int) SampleFlags::HAS_DATA;
+	p4.format.separator = ',';
+
+	vlist_push(&plugins, &p4);
+}
+
+__attribute__((destructor(110))) static void UNIQUE(__dtor)() {
+	if (plugins.state != State::DESTROYED)
+		vlist_remove_all(&plugins, &p4);
+}
@@ -20,11 +20,17 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *********************************************************************************/
 
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <charconv>
+
 #include <villas/plugin.h>
 #include <villas/sample.h>
 #include <villas/compat.h>
 #include <villas/signal.h>
 #include <villas/io.h>
+#include <villas/text_codec.h>
 #include <villas/formats/json.h>
 
 static enum SignalType json_detect_format(json_t *val)
@@ -164,9 +170,10 @@ static int json_pack_sample(struct io *io, json_t **j, struct sample *smp)
 static int json_pack_samples(struct io *io, json_t **j, struct sample *smps[], unsigned cnt)
 {
 	int ret;
+	unsigned i;
 	json_t *json_smps = json_array();
 
-	for (unsigned i = 0; i < cnt; i++) {
+	for (i = 0; i < cnt; i++) {
 		json_t *json_smp;
 
 		ret = json_pack_sample(io, &json_smp, smps[i]);
@@ -178,7 +185,7 @@ static int json_pack_samples(struct io *io, json_t **j, struct sample *smps[], u
 
 	*j = json_smps;
 
-	return cnt;
+	return i;
 }
 
 static int json_unpack_sample(struct io *io, json_t *json_smp, struct sample *smp)
@@ -264,7 +271,7 @@ static int json_unpack_samples(struct io *io, json_t *json_smps, struct sample *
 	return i;
 }
 
-int json_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt)
+int json_sprint_jansson(struct io *io, char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt)
 {
 	int ret;
 	json_t *json;
@@ -284,7 +291,7 @@ int json_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct sam
 	return ret;
 }
 
-int json_sscan(struct io *io, const char *buf, size_t len, size_t *rbytes, struct sample *smps[], unsigned cnt)
+int json_sscan_jansson(struct io *io, const char *buf, size_t len, size_t *rbytes, struct sample *smps[], unsigned cnt)
 {
 	int ret;
 	json_t *json;
@@ -307,6 +314,758 @@ int json_sscan(struct io *io, const char *buf, size_t len, size_t *rbytes, struc
 	return ret;
 }
 
+/* Streaming encoder
+ *
+ * Writes the samples directly into the output buffer. The output is identical
+ * to the one of json_dumpb() for the object tree built by json_pack_samples().
+ */
+
+struct json_writer {
+	char *buf;
+	size_t len;
+	size_t pos;		/**< Number of bytes which have been written or would have been written. */
+};
+
+static void json_write(struct json_writer *w, const char *str, size_t n)
+{
+	if (w->pos + n <= w->len)
+		memcpy(w->buf + w->pos, str, n);
+
+	w->pos += n;
+}
+
+#define json_write_literal(w, str) json_write(w, str, sizeof(str) - 1)
+
+static void json_write_integer(struct json_writer *w, json_int_t i)
+{
+	char tmp[32];
+
+	auto res = std::to_chars(tmp, tmp + sizeof(tmp), i);
+
+	json_write(w, tmp, res.ptr - tmp);
+}
+
+/** Format a real number in the same way as jansson's jsonp_dtostr() does. */
+static int json_write_real(struct json_writer *w, double d)
+{
+	char tmp[64], *start, *end;
+	int len;
+
+	/* jansson refuses to create reals for NaN and infinity */
+	if (!std::isfinite(d))
+		return -1;
+
+	/* Same digits as "%.17g" but independent of the locale */
+	len = text_print_double(tmp, sizeof(tmp) - 3, d, 17);
+	if (len >= (int) sizeof(tmp) - 3)
+		return -1;
+
+	tmp[len] = '\0';
+
+	/* Make sure there's a dot or 'e' in the output */
+	if (!memchr(tmp, '.', len) && !memchr(tmp, 'e', len)) {
+		tmp[len++] = '.';
+		tmp[len++] = '0';
+		tmp[len] = '\0';
+	}
+
+	/* Remove leading '+' and zeros from the exponent */
+	start = (char *) memchr(tmp, 'e', len);
+	if (start) {
+		start++;
+		end = start + 1;
+
+		if (*start == '-')
+			start++;
+
+		while (*end == '0')
+			end++;
+
+		if (end != start) {
+			memmove(start, end, len - (end - tmp) + 1);
+			len -= end - start;
+		}
+	}
+
+	json_write(w, tmp, len);
+
+	return 0;
+}
+
+static void json_write_timestamp(struct json_writer *w, const struct timespec *ts)
+{
+	json_write_literal(w, "[");
+	json_write_integer(w, ts->tv_sec);
+	json_write_literal(w, ", ");
+	json_write_integer(w, ts->tv_nsec);
+	json_write_literal(w, "]");
+}
+
+static void json_write_timestamps(struct io *io, struct json_writer *w, struct sample *smp)
+{
+	bool first = true;
+
+	json_write_literal(w, "{");
+
+	if (io->flags & (int) SampleFlags::HAS_TS_ORIGIN) {
+		if (smp->flags & (int) SampleFlags::HAS_TS_ORIGIN) {
+			json_write_literal(w, "\"origin\": ");
+			json_write_timestamp(w, &smp->ts.origin);
+
+			first = false;
+		}
+	}
+
+	if (io->flags & (int) SampleFlags::HAS_TS_RECEIVED) {
+		if (smp->flags & (int) SampleFlags::HAS_TS_RECEIVED) {
+			if (!first)
+				json_write_literal(w, ", ");
+
+			json_write_literal(w, "\"received\": ");
+			json_write_timestamp(w, &smp->ts.received);
+		}
+	}
+
+	json_write_literal(w, "}");
+}
+
+static int json_write_sample(struct io *io, struct json_writer *w, struct sample *smp)
+{
+	json_write_literal(w, "{\"ts\": ");
+	json_write_timestamps(io, w, smp);
+
+	if (io->flags & (int) SampleFlags::HAS_SEQUENCE) {
+		if (smp->flags & (int) SampleFlags::HAS_SEQUENCE) {
+			json_write_literal(w, ", \"sequence\": ");
+			json_write_integer(w, smp->sequence);
+		}
+	}
+
+	if (io->flags & (int) SampleFlags::HAS_DATA) {
+		bool first = true;
+
+		json_write_literal(w, ", \"data\": [");
+
+		for (unsigned i = 0; i < smp->length; i++) {
+			enum SignalType fmt = sample_format(smp, i);
+			size_t pos = w->pos;
+			int ret = 0;
+
+			if (!first)
+				json_write_literal(w, ", ");
+
+			switch (fmt) {
+				case SignalType::INTEGER:
+					json_write_integer(w, smp->data[i].i);
+					break;
+
+				case SignalType::FLOAT:
+					ret = json_write_real(w, smp->data[i].f);
+					break;
+
+				case SignalType::BOOLEAN:
+					if (smp->data[i].b)
+						json_write_literal(w, "true");
+					else
+						json_write_literal(w, "false");
+					break;
+
+				case SignalType::COMPLEX:
+					json_write_literal(w, "{\"real\": ");
+					ret = json_write_real(w, std::real(smp->data[i].z));
+					if (ret)
+						break;
+
+					json_write_literal(w, ", \"imag\": ");
+					ret = json_write_real(w, std::imag(smp->data[i].z));
+					if (ret)
+						break;
+
+					json_write_literal(w, "}");
+					break;
+
+				case SignalType::INVALID:
+					return -1;
+			}
+
+			/* Values which can not be represented are omitted */
+			if (ret)
+				w->pos = pos;
+			else
+				first = false;
+		}
+
+		json_write_literal(w, "]");
+	}
+
+	json_write_literal(w, "}");
+
+	return 0;
+}
+
+int json_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt)
+{
+	int ret;
+	unsigned i;
+	struct json_writer w = { buf, len, 0 };
+
+	json_write_literal(&w, "[");
+
+	for (i = 0; i < cnt; i++) {
+		size_t pos = w.pos;
+
+		if (i > 0)
+			json_write_literal(&w, ", ");
+
+		ret = json_write_sample(io, &w, smps[i]);
+		if (ret) {
+			w.pos = pos;
+			break;
+		}
+	}
+
+	json_write_literal(&w, "]");
+
+	if (wbytes)
+		*wbytes = w.pos;
+
+	return i;
+}
+
+/* Streaming decoder
+ *
+ * Parses the samples in-situ without building a jansson object tree.
+ * Each sample object is validated and its members are located before they are decoded.
+ * Valid documents which use features we do not support here (e.g. escaped strings)
+ * are passed on to json_sscan_jansson(). So are invalid documents for which jansson
+ * produces the authoritative error.
+ */
+
+/** Maximum nesting depth of the jansson parser. */
+#define JSON_MAX_DEPTH 2048
+
+struct json_reader {
+	const char *pos;
+	const char *end;
+};
+
+static bool json_isdigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static char json_peek(struct json_reader *r)
+{
+	while (r->pos < r->end && (*r->pos == ' ' || *r->pos == '\t' || *r->pos == '\n' || *r->pos == '\r'))
+		r->pos++;
+
+	return r->pos < r->end ? *r->pos : '\0';
+}
+
+static bool json_consume(struct json_reader *r, char c)
+{
+	if (json_peek(r) != c)
+		return false;
+
+	r->pos++;
+
+	return true;
+}
+
+static bool json_read_literal(struct json_reader *r, const char *lit, size_t len)
+{
+	if ((size_t) (r->end - r->pos) < len || memcmp(r->pos, lit, len))
+		return false;
+
+	r->pos += len;
+
+	return true;
+}
+
+/** Read a string which does not contain escape sequences, control or non-ASCII characters. */
+static bool json_read_string(struct json_reader *r, const char **str, size_t *len)
+{
+	if (!json_consume(r, '"'))
+		return false;
+
+	const char *start = r->pos;
+
+	for (; r->pos < r->end; r->pos++) {
+		unsigned char c = *r->pos;
+
+		if (c == '"') {
+			*str = start;
+			*len = r->pos++ - start;
+
+			return true;
+		}
+		else if (c == '\\' || c < 0x20 || c >= 0x80)
+			return false;
+	}
+
+	return false;
+}
+
+static bool json_read_number(struct json_reader *r, bool *real, json_int_t *i, double *d)
+{
+	char tmp[64], *end;
+	const char *p, *start;
+
+	json_peek(r);
+
+	p = start = r->pos;
+	*real = false;
+
+	/* Check the syntax according to RFC 8259 */
+	if (p < r->end && *p == '-')
+		p++;
+
+	if (p < r->end && *p == '0')
+		p++;
+	else if (p < r->end && json_isdigit(*p)) {
+		while (p < r->end && json_isdigit(*p))
+			p++;
+	}
+	else
+		return false;
+
+	if (p < r->end && *p == '.') {
+		*real = true;
+		p++;
+
+		if (p >= r->end || !json_isdigit(*p))
+			return false;
+
+		while (p < r->end && json_isdigit(*p))
+			p++;
+	}
+
+	if (p < r->end && (*p == 'e' || *p == 'E')) {
+		*real = true;
+		p++;
+
+		if (p < r->end && (*p == '+' || *p == '-'))
+			p++;
+
+		if (p >= r->end || !json_isdigit(*p))
+			return false;
+
+		while (p < r->end && json_isdigit(*p))
+			p++;
+	}
+
+	if ((size_t) (p - start) >= sizeof(tmp))
+		return false;
+
+	memcpy(tmp, start, p - start);
+	tmp[p - start] = '\0';
+
+	errno = 0;
+
+	if (*real) {
+		*d = strtod(tmp, &end);
+		if ((*d == HUGE_VAL || *d == -HUGE_VAL) && errno == ERANGE)
+			return false;
+	}
+	else {
+		*i = strtoll(tmp, &end, 10);
+		if (errno == ERANGE)
+			return false;
+	}
+
+	r->pos = p;
+
+	return true;
+}
+
+static bool json_skip_value(struct json_reader *r, int depth)
+{
+	const char *str;
+	size_t len;
+	bool real;
+	json_int_t i;
+	double d;
+
+	if (depth > JSON_MAX_DEPTH)
+		return false;
+
+	switch (json_peek(r)) {
+		case '{':
+			r->pos++;
+
+			if (json_consume(r, '}'))
+				return true;
+
+			do {
+				if (!json_read_string(r, &str, &len))
+					return false;
+
+				if (!json_consume(r, ':'))
+					return false;
+
+				if (!json_skip_value(r, depth + 1))
+					return false;
+			} while (json_consume(r, ','));
+
+			return json_consume(r, '}');
+
+		case '[':
+			r->pos++;
+
+			if (json_consume(r, ']'))
+				return true;
+
+			do {
+				if (!json_skip_value(r, depth + 1))
+					return false;
+			} while (json_consume(r, ','));
+
+			return json_consume(r, ']');
+
+		case '"':
+			return json_read_string(r, &str, &len);
+
+		case 't':
+			return json_read_literal(r, "true", 4);
+
+		case 'f':
+			return json_read_literal(r, "false", 5);
+
+		case 'n':
+			return json_read_literal(r, "null", 4);
+
+		default:
+			return json_read_number(r, &real, &i, &d);
+	}
+}
+
+/** The members of a sample object. */
+struct json_sample_members {
+	const char *ts;
+	const char *sequence;
+	const char *data;
+};
+
+#define json_key_equals(str, len, key) ((len) == sizeof(key) - 1 && !memcmp(str, key, len))
+
+/** Validate a sample object and locate its members. */
+static bool json_locate_sample(struct json_reader *r, struct json_sample_members *m)
+{
+	const char *str, **member;
+	size_t len;
+
+	m->ts = m->sequence = m->data = nullptr;
+
+	if (!json_consume(r, '{'))
+		return false;
+
+	if (json_consume(r, '}'))
+		return true;
+
+	do {
+		if (!json_read_string(r, &str, &len))
+			return false;
+
+		if (!json_consume(r, ':'))
+			return false;
+
+		if (json_key_equals(str, len, "ts"))
+			member = &m->ts;
+		else if (json_key_equals(str, len, "sequence"))
+			member = &m->sequence;
+		else if (json_key_equals(str, len, "data"))
+			member = &m->data;
+		else
+			member = nullptr;
+
+		if (member) {
+			/* Duplicate keys are left to jansson */
+			if (*member)
+				return false;
+
+			json_peek(r);
+			*member = r->pos;
+		}
+
+		if (!json_skip_value(r, 2))
+			return false;
+	} while (json_consume(r, ','));
+
+	return json_consume(r, '}');
+}
+
+static int json_scan_timestamp(struct json_reader *r, struct timespec *ts)
+{
+	bool real;
+	double d;
+	json_int_t sec, nsec;
+
+	if (!json_consume(r, '['))
+		return -1;
+
+	if (!json_read_number(r, &real, &sec, &d) || real)
+		return -1;
+
+	if (!json_consume(r, ','))
+		return -1;
+
+	if (!json_read_number(r, &real, &nsec, &d) || real)
+		return -1;
+
+	ts->tv_sec = sec;
+	ts->tv_nsec = nsec;
+
+	return 0;
+}
+
+static int json_scan_timestamps(struct json_reader *r, struct sample *smp)
+{
+	int ret;
+	const char *str, *origin = nullptr, *received = nullptr;
+	size_t len;
+
+	/* Anything else than an object is ignored */
+	if (!json_consume(r, '{') || json_consume(r, '}'))
+		return 0;
+
+	do {
+		json_read_string(r, &str, &len);
+		json_consume(r, ':');
+		json_peek(r);
+
+		if (json_key_equals(str, len, "origin"))
+			origin = r->pos;
+		else if (json_key_equals(str, len, "received"))
+			received = r->pos;
+
+		json_skip_value(r, 3);
+	} while (json_consume(r, ','));
+
+	if (origin) {
+		r->pos = origin;
+
+		ret = json_scan_timestamp(r, &smp->ts.origin);
+		if (ret)
+			return ret;
+
+		smp->flags |= (int) SampleFlags::HAS_TS_ORIGIN;
+	}
+
+	if (received) {
+		r->pos = received;
+
+		ret = json_scan_timestamp(r, &smp->ts.received);
+		if (ret)
+			return ret;
+
+		smp->flags |= (int) SampleFlags::HAS_TS_RECEIVED;
+	}
+
+	return 0;
+}
+
+static int json_scan_complex(struct json_reader *r, std::complex<float> *z)
+{
+	const char *str;
+	size_t len;
+	bool real, has_real = false, has_imag = false;
+	json_int_t i;
+	double d, re = 0, im = 0;
+
+	json_consume(r, '{');
+
+	if (json_consume(r, '}'))
+		return -1;
+
+	do {
+		json_read_string(r, &str, &len);
+		json_consume(r, ':');
+
+		double *v = json_key_equals(str, len, "real") ? &re : json_key_equals(str, len, "imag") ? &im : nullptr;
+		bool *has = v == &re ? &has_real : &has_imag;
+
+		if (v) {
+			if (json_peek(r) == '-' || json_isdigit(json_peek(r))) {
+				json_read_number(r, &real, &i, &d);
+
+				*v = real ? d : (double) i;
+				*has = true;
+			}
+			else {
+				json_skip_value(r, 4);
+				*has = false;
+			}
+		}
+		else
+			json_skip_value(r, 4);
+	} while (json_consume(r, ','));
+
+	json_consume(r, '}');
+
+	if (!has_real || !has_imag)
+		return -1;
+
+	*z = std::complex<float>(re, im);
+
+	return 0;
+}
+
+/** Decode a validated sample object with the same semantics as json_unpack_sample(). */
+static int json_scan_sample(struct io *io, const char *end, struct json_sample_members *m, struct sample *smp)
+{
+	int ret;
+	bool real;
+	double d;
+	json_int_t i, sequence = -1;
+	struct json_reader r = { nullptr, end };
+
+	smp->signals = io->signals;
+
+	if (!m->data)
+		return -1;
+
+	if (m->sequence) {
+		r.pos = m->sequence;
+
+		if (!json_read_number(&r, &real, &sequence, &d) || real)
+			return -1;
+	}
+
+	smp->flags = 0;
+	smp->length = 0;
+
+	if (m->ts) {
+		r.pos = m->ts;
+
+		ret = json_scan_timestamps(&r, smp);
+		if (ret)
+			return ret;
+	}
+
+	r.pos = m->data;
+	if (!json_consume(&r, '['))
+		return -1;
+
+	if (sequence >= 0) {
+		smp->sequence = sequence;
+		smp->flags |= (int) SampleFlags::HAS_SEQUENCE;
+	}
+
+	if (!json_consume(&r, ']')) {
+		size_t j = 0;
+
+		do {
+			if (j >= smp->capacity)
+				break;
+
+			struct signal *sig = (struct signal *) vlist_at_safe(smp->signals, j);
+			if (!sig)
+				return -1;
+
+			enum SignalType fmt;
+			char c = json_peek(&r);
+
+			if (c == '-' || json_isdigit(c)) {
+				json_read_number(&r, &real, &i, &d);
+
+				fmt = real ? SignalType::FLOAT : SignalType::INTEGER;
+			}
+			else if (c == 't' || c == 'f')
+				fmt = SignalType::BOOLEAN;
+			else if (c == '{')
+				fmt = SignalType::COMPLEX;
+			else
+				fmt = SignalType::INVALID;
+
+			if (sig->type != fmt) {
+				error("Received invalid data type in JSON payload: Received %s, expected %s for signal %s (index %zu).",
+					signal_type_to_str(fmt), signal_type_to_str(sig->type), sig->name, j);
+				return -2;
+			}
+
+			switch (fmt) {
+				case SignalType::FLOAT:
+					smp->data[j].f = d;
+					break;
+
+				case SignalType::INTEGER:
+					smp->data[j].i = i;
+					break;
+
+				case SignalType::BOOLEAN:
+					smp->data[j].b = c == 't';
+					json_skip_value(&r, 3);
+					break;
+
+				case SignalType::COMPLEX:
+					ret = json_scan_complex(&r, &smp->data[j].z);
+					if (ret)
+						return -3;
+					break;
+
+				case SignalType::INVALID:
+					return -3;
+			}
+
+			smp->length++;
+			j++;
+		} while (json_consume(&r, ','));
+	}
+
+	if (smp->length > 0)
+		smp->flags |= (int) SampleFlags::HAS_DATA;
+
+	return 0;
+}
+
+int json_sscan(struct io *io, const char *buf, size_t len, size_t *rbytes, struct sample *smps[], unsigned cnt)
+{
+	int ret;
+	unsigned i = 0;
+	bool stop = false;
+	struct json_reader r = { buf, buf + len };
+	struct json_sample_members m;
+
+	if (!json_consume(&r, '['))
+		goto fallback;
+
+	if (!json_consume(&r, ']')) {
+		do {
+			if (i >= cnt || stop || json_peek(&r) != '{') {
+				/* Samples which are not decoded must still be valid JSON */
+				if (!json_skip_value(&r, 1))
+					goto fallback;
+
+				stop = true;
+				continue;
+			}
+
+			if (!json_locate_sample(&r, &m))
+				goto fallback;
+
+			ret = json_scan_sample(io, r.end, &m, smps[i]);
+			if (ret < 0)
+				stop = true;
+			else
+				i++;
+		} while (json_consume(&r, ','));
+
+		if (!json_consume(&r, ']'))
+			goto fallback;
+	}
+
+	if (json_peek(&r) != '\0' || r.pos != r.end)
+		goto fallback;
+
+	if (rbytes)
+		*rbytes = len;
+
+	return i;
+
+fallback:
+	return json_sscan_jansson(io, buf, len, rbytes, smps, cnt);
+}
+
 int json_print(struct io *io, struct sample *smps[], unsigned cnt)
 {
 	int ret;
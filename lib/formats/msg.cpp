@@ -20,10 +20,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *********************************************************************************/
 
+#include <cstring>
+
 #include <arpa/inet.h>
 
 #include <villas/formats/msg.h>
 #include <villas/formats/msg_format.h>
+#include <villas/formats/convert.h>
 #include <villas/sample.h>
 #include <villas/signal.h>
 #include <villas/utils.hpp>
@@ -73,29 +76,58 @@ int msg_verify(struct msg *m)
 		return 0;
 }
 
-int msg_to_sample(struct msg *msg, struct sample *smp, struct vlist *signals)
+int msg_to_sample(struct msg *msg, struct sample *smp, struct vlist *signals, bool ntoh)
 {
 	int ret;
+	unsigned len;
+	bool swap = ntoh && BYTE_ORDER == LITTLE_ENDIAN;
 
 	ret = msg_verify(msg);
 	if (ret)
 		return -1;
 
+	/* The header is decoded without modifying the receive buffer */
+	uint16_t length   = ntoh ? ntohs(msg->length)   : msg->length;
+	uint32_t sequence = ntoh ? ntohl(msg->sequence) : msg->sequence;
+	uint32_t sec      = ntoh ? ntohl(msg->ts.sec)   : msg->ts.sec;
+	uint32_t nsec     = ntoh ? ntohl(msg->ts.nsec)  : msg->ts.nsec;
+
 	smp->flags = (int) SampleFlags::HAS_TS_ORIGIN | (int) SampleFlags::HAS_SEQUENCE | (int) SampleFlags::HAS_DATA;
-	smp->length = MIN(msg->length, smp->capacity);
-	smp->sequence = msg->sequence;
-	MSG_TS(msg, smp->ts.origin);
+	smp->length = MIN(length, smp->capacity);
+	smp->sequence = sequence;
+	smp->ts.origin.tv_sec = sec;
+	smp->ts.origin.tv_nsec = nsec;
+
+	len = MIN(smp->length, vlist_length(signals));
+
+	/* Fast path: all values share the same type */
+	switch (signal_list_type(signals, len)) {
+		case SignalType::FLOAT:
+			convert_f32_to_f64(&smp->data[0].f, MSG_DATA_OFFSET(msg), len, swap);
+			return 0;
 
-	for (unsigned i = 0; i < MIN(smp->length, vlist_length(signals)); i++) {
+		case SignalType::INTEGER:
+			convert_i32_to_i64(&smp->data[0].i, MSG_DATA_OFFSET(msg), len, swap, false);
+			return 0;
+
+		default: { }
+	}
+
+	for (unsigned i = 0; i < len; i++) {
 		struct signal *sig = (struct signal *) vlist_at(signals, i);
+		uint32_t value = swap ? ntohl(msg->data[i].i) : msg->data[i].i;
 
 		switch (sig->type) {
-			case SignalType::FLOAT:
-				smp->data[i].f = msg->data[i].f;
+			case SignalType::FLOAT: {
+				float f;
+
+				memcpy(&f, &value, sizeof(f));
+				smp->data[i].f = f;
 				break;
+			}
 
 			case SignalType::INTEGER:
-				smp->data[i].i = msg->data[i].i;
+				smp->data[i].i = value;
 				break;
 
 			default:
@@ -106,15 +138,31 @@ int msg_to_sample(struct msg *msg, struct sample *smp, struct vlist *signals)
 	return 0;
 }
 
-int msg_from_sample(struct msg *msg_in, struct sample *smp, struct vlist *signals)
+int msg_from_sample(struct msg *msg_in, struct sample *smp, struct vlist *signals, bool hton)
 {
+	bool swap = hton && BYTE_ORDER == LITTLE_ENDIAN;
+
 	msg_in->type     = MSG_TYPE_DATA;
 	msg_in->version  = MSG_VERSION;
+	msg_in->reserved1 = 0;
 	msg_in->length   = (uint16_t) smp->length;
 	msg_in->sequence = (uint32_t) smp->sequence;
 	msg_in->ts.sec  = smp->ts.origin.tv_sec;
 	msg_in->ts.nsec = smp->ts.origin.tv_nsec;
 
+	/* Fast path: all values share the same type */
+	switch (signal_list_type(signals, smp->length)) {
+		case SignalType::FLOAT:
+			convert_f64_to_f32(MSG_DATA_OFFSET(msg_in), &smp->data[0].f, smp->length, swap);
+			goto out;
+
+		case SignalType::INTEGER:
+			convert_i64_to_i32(MSG_DATA_OFFSET(msg_in), &smp->data[0].i, smp->length, swap);
+			goto out;
+
+		default: { }
+	}
+
 	for (unsigned i = 0; i < smp->length; i++) {
 		struct signal *sig = (struct signal *) vlist_at(signals, i);
 
@@ -130,7 +178,13 @@ int msg_from_sample(struct msg *msg_in, struct sample *smp, struct vlist *signal
 			default:
 				return -1;
 		}
+
+		if (swap)
+			msg_in->data[i].i = htonl(msg_in->data[i].i);
 	}
 
+out:	if (hton)
+		msg_hdr_hton(msg_in);
+
 	return 0;
 }
@@ -31,6 +31,89 @@
 
 using namespace villas::utils;
 
+#define PROTOBUF_ARENA_SIZE 4096
+
+static void * protobuf_arena_alloc(void *ctx, size_t len)
+{
+	struct protobuf_arena *a = (struct protobuf_arena *) ctx;
+
+	len = ALIGN(len, alignof(max_align_t));
+
+	if (a->used + len <= a->size) {
+		void *ptr = a->buffer + a->used;
+
+		a->used += len;
+
+		return ptr;
+	}
+
+	auto *c = (struct protobuf_chunk *) malloc(sizeof(struct protobuf_chunk) + len);
+	if (!c)
+		return nullptr;
+
+	c->next = a->chunks;
+
+	a->chunks = c;
+	a->overflow += len;
+
+	return c->data;
+}
+
+static void protobuf_arena_free(void *ctx, void *ptr)
+{
+	/* Everything is released at once by protobuf_arena_reset() */
+}
+
+int protobuf_arena_init(struct protobuf_arena *a, size_t size)
+{
+	a->buffer = (char *) malloc(size);
+	if (!a->buffer)
+		return -1;
+
+	a->size = size;
+	a->used = 0;
+	a->chunks = nullptr;
+	a->overflow = 0;
+
+	a->allocator.alloc = protobuf_arena_alloc;
+	a->allocator.free = protobuf_arena_free;
+	a->allocator.allocator_data = a;
+
+	return 0;
+}
+
+int protobuf_arena_destroy(struct protobuf_arena *a)
+{
+	protobuf_arena_reset(a);
+
+	free(a->buffer);
+
+	return 0;
+}
+
+void protobuf_arena_reset(struct protobuf_arena *a)
+{
+	struct protobuf_chunk *c, *n;
+
+	for (c = a->chunks; c; c = n) {
+		n = c->next;
+		free(c);
+	}
+
+	/* Make room for the largest message seen so far */
+	if (a->overflow > 0) {
+		char *buffer = (char *) realloc(a->buffer, a->size + a->overflow);
+		if (buffer) {
+			a->buffer = buffer;
+			a->size += a->overflow;
+		}
+	}
+
+	a->chunks = nullptr;
+	a->overflow = 0;
+	a->used = 0;
+}
+
 static enum SignalType protobuf_detect_format(Villas__Node__Value *val)
 {
 	switch (val->value_case) {
@@ -52,18 +135,175 @@ static enum SignalType protobuf_detect_format(Villas__Node__Value *val)
 	}
 }
 
+static int protobuf_init(struct io *io)
+{
+	int ret;
+	struct protobuf *pb = (struct protobuf *) io->_vd;
+
+	pb->packed = false;
+
+	ret = protobuf_arena_init(&pb->out, PROTOBUF_ARENA_SIZE);
+	if (ret)
+		return ret;
+
+	ret = protobuf_arena_init(&pb->in, PROTOBUF_ARENA_SIZE);
+	if (ret) {
+		protobuf_arena_destroy(&pb->out);
+		return ret;
+	}
+
+	return 0;
+}
+
+static int protobuf_packed_init(struct io *io)
+{
+	int ret;
+	struct protobuf *pb = (struct protobuf *) io->_vd;
+
+	ret = protobuf_init(io);
+	if (ret)
+		return ret;
+
+	pb->packed = true;
+
+	return 0;
+}
+
+static int protobuf_destroy(struct io *io)
+{
+	int ret;
+	struct protobuf *pb = (struct protobuf *) io->_vd;
+
+	ret = protobuf_arena_destroy(&pb->out);
+	if (ret)
+		return ret;
+
+	ret = protobuf_arena_destroy(&pb->in);
+	if (ret)
+		return ret;
+
+	return 0;
+}
+
+static int protobuf_sprint_values(struct protobuf_arena *a, Villas__Node__Sample *pb_smp, struct sample *smp)
+{
+	pb_smp->n_values = smp->length;
+	pb_smp->values = (Villas__Node__Value **) protobuf_arena_alloc(a, pb_smp->n_values * sizeof(Villas__Node__Value *));
+
+	/* All values of a sample are allocated at once */
+	Villas__Node__Value *pb_vals = (Villas__Node__Value *) protobuf_arena_alloc(a, pb_smp->n_values * sizeof(Villas__Node__Value));
+
+	if (!pb_smp->values || !pb_vals)
+		return -1;
+
+	for (unsigned j = 0; j < pb_smp->n_values; j++) {
+		Villas__Node__Value *pb_val = pb_smp->values[j] = &pb_vals[j];
+		villas__node__value__init(pb_val);
+
+		enum SignalType fmt = sample_format(smp, j);
+		switch (fmt) {
+			case SignalType::FLOAT:
+				pb_val->value_case = VILLAS__NODE__VALUE__VALUE_F;
+				pb_val->f = smp->data[j].f;
+				break;
+
+			case SignalType::INTEGER:
+				pb_val->value_case = VILLAS__NODE__VALUE__VALUE_I;
+				pb_val->i = smp->data[j].i;
+				break;
+
+			case SignalType::BOOLEAN:
+				pb_val->value_case = VILLAS__NODE__VALUE__VALUE_B;
+				pb_val->b = smp->data[j].b;
+				break;
+
+			case SignalType::COMPLEX:
+				pb_val->value_case = VILLAS__NODE__VALUE__VALUE_Z;
+				pb_val->z = (Villas__Node__Complex *) protobuf_arena_alloc(a, sizeof(Villas__Node__Complex));
+				if (!pb_val->z)
+					return -1;
+
+				villas__node__complex__init(pb_val->z);
+
+				pb_val->z->real = std::real(smp->data[j].z);
+				pb_val->z->imag = std::imag(smp->data[j].z);
+				break;
+
+			case SignalType::INVALID:
+				pb_val->value_case = VILLAS__NODE__VALUE__VALUE__NOT_SET;
+				break;
+		}
+	}
+
+	return 0;
+}
+
+static int protobuf_sprint_packed(struct protobuf_arena *a, Villas__Node__Sample *pb_smp, struct sample *smp)
+{
+	/* Worst case: all values are complex */
+	pb_smp->values_f = (double *) protobuf_arena_alloc(a, 2 * smp->length * sizeof(double));
+	pb_smp->values_i = (int64_t *) protobuf_arena_alloc(a, smp->length * sizeof(int64_t));
+
+	if (!pb_smp->values_f || !pb_smp->values_i)
+		return -1;
+
+	pb_smp->n_values_f = 0;
+	pb_smp->n_values_i = 0;
+
+	for (unsigned j = 0; j < smp->length; j++) {
+		enum SignalType fmt = sample_format(smp, j);
+		switch (fmt) {
+			case SignalType::FLOAT:
+				pb_smp->values_f[pb_smp->n_values_f++] = smp->data[j].f;
+				break;
+
+			case SignalType::INTEGER:
+				pb_smp->values_i[pb_smp->n_values_i++] = smp->data[j].i;
+				break;
+
+			case SignalType::BOOLEAN:
+				pb_smp->values_i[pb_smp->n_values_i++] = smp->data[j].b;
+				break;
+
+			case SignalType::COMPLEX:
+				pb_smp->values_f[pb_smp->n_values_f++] = std::real(smp->data[j].z);
+				pb_smp->values_f[pb_smp->n_values_f++] = std::imag(smp->data[j].z);
+				break;
+
+			case SignalType::INVALID:
+				break;
+		}
+	}
+
+	return 0;
+}
+
 int protobuf_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt)
 {
+	int ret = -1;
 	unsigned psz;
+	struct protobuf *pb = (struct protobuf *) io->_vd;
+	struct protobuf_arena *a = &pb->out;
+	Villas__Node__Sample *pb_smps;
+	Villas__Node__Timestamp *pb_tss;
+
+	Villas__Node__Message *pb_msg = (Villas__Node__Message *) protobuf_arena_alloc(a, sizeof(Villas__Node__Message));
+	if (!pb_msg)
+		goto out;
 
-	Villas__Node__Message *pb_msg = (Villas__Node__Message *) alloc(sizeof(Villas__Node__Message));
 	villas__node__message__init(pb_msg);
 
 	pb_msg->n_samples = cnt;
-	pb_msg->samples = (Villas__Node__Sample **) alloc(pb_msg->n_samples * sizeof(Villas__Node__Sample *));
+	pb_msg->samples = (Villas__Node__Sample **) protobuf_arena_alloc(a, pb_msg->n_samples * sizeof(Villas__Node__Sample *));
+
+	pb_smps = (Villas__Node__Sample *) protobuf_arena_alloc(a, pb_msg->n_samples * sizeof(Villas__Node__Sample));
+	pb_tss = (Villas__Node__Timestamp *) protobuf_arena_alloc(a, pb_msg->n_samples * sizeof(Villas__Node__Timestamp));
+
+	if (!pb_msg->samples || !pb_smps || !pb_tss)
+		goto out;
 
 	for (unsigned i = 0; i < pb_msg->n_samples; i++) {
-		Villas__Node__Sample *pb_smp = pb_msg->samples[i] = (Villas__Node__Sample *) alloc(sizeof(Villas__Node__Sample));
+		Villas__Node__Sample *pb_smp = pb_msg->samples[i] = &pb_smps[i];
 		villas__node__sample__init(pb_smp);
 
 		struct sample *smp = smps[i];
@@ -76,80 +316,159 @@ int protobuf_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct
 		}
 
 		if (io->flags & smp->flags & (int) SampleFlags::HAS_TS_ORIGIN) {
-			pb_smp->timestamp = (Villas__Node__Timestamp *) alloc(sizeof(Villas__Node__Timestamp));
+			pb_smp->timestamp = &pb_tss[i];
 			villas__node__timestamp__init(pb_smp->timestamp);
 
 			pb_smp->timestamp->sec = smp->ts.origin.tv_sec;
 			pb_smp->timestamp->nsec = smp->ts.origin.tv_nsec;
 		}
 
-		pb_smp->n_values = smp->length;
-		pb_smp->values = (Villas__Node__Value **) alloc(pb_smp->n_values * sizeof(Villas__Node__Value *));
+		if (pb->packed)
+			ret = protobuf_sprint_packed(a, pb_smp, smp);
+		else
+			ret = protobuf_sprint_values(a, pb_smp, smp);
+
+		if (ret)
+			goto out;
+	}
+
+	psz = villas__node__message__get_packed_size(pb_msg);
+
+	if (psz > len) {
+		ret = -1;
+		goto out;
+	}
+
+	villas__node__message__pack(pb_msg, (uint8_t *) buf);
 
-		for (unsigned j = 0; j < pb_smp->n_values; j++) {
-			Villas__Node__Value *pb_val = pb_smp->values[j] = (Villas__Node__Value *) alloc(sizeof(Villas__Node__Value));
-			villas__node__value__init(pb_val);
+	*wbytes = psz;
 
-			enum SignalType fmt = sample_format(smp, j);
-			switch (fmt) {
-				case SignalType::FLOAT:
-					pb_val->value_case = VILLAS__NODE__VALUE__VALUE_F;
-					pb_val->f = smp->data[j].f;
-					break;
+	ret = cnt;
+
+out:
+	protobuf_arena_reset(a);
 
-				case SignalType::INTEGER:
-					pb_val->value_case = VILLAS__NODE__VALUE__VALUE_I;
-					pb_val->i = smp->data[j].i;
-					break;
+	return ret;
+}
 
-				case SignalType::BOOLEAN:
-					pb_val->value_case = VILLAS__NODE__VALUE__VALUE_B;
-					pb_val->b = smp->data[j].b;
-					break;
+static int protobuf_sscan_values(Villas__Node__Sample *pb_smp, struct sample *smp)
+{
+	unsigned j;
 
-				case SignalType::COMPLEX:
-					pb_val->value_case = VILLAS__NODE__VALUE__VALUE_Z;
-					pb_val->z = (Villas__Node__Complex *) alloc(sizeof(Villas__Node__Complex));
+	for (j = 0; j < MIN(pb_smp->n_values, smp->capacity); j++) {
+		Villas__Node__Value *pb_val = pb_smp->values[j];
 
-					villas__node__complex__init(pb_val->z);
+		enum SignalType fmt = protobuf_detect_format(pb_val);
 
-					pb_val->z->real = std::real(smp->data[j].z);
-					pb_val->z->imag = std::imag(smp->data[j].z);
-					break;
+		struct signal *sig = (struct signal *) vlist_at_safe(smp->signals, j);
+		if (!sig)
+			return -1;
 
-				case SignalType::INVALID:
-					pb_val->value_case = VILLAS__NODE__VALUE__VALUE__NOT_SET;
-					break;
-			}
+		if (sig->type != fmt) {
+			error("Received invalid data type in Protobuf payload: Received %s, expected %s for signal %s (index %u).",
+				signal_type_to_str(fmt), signal_type_to_str(sig->type), sig->name, j);
+			return -2;
+		}
+
+		switch (sig->type) {
+			case SignalType::FLOAT:
+				smp->data[j].f = pb_val->f;
+				break;
+
+			case SignalType::INTEGER:
+				smp->data[j].i = pb_val->i;
+				break;
+
+			case SignalType::BOOLEAN:
+				smp->data[j].b = pb_val->b;
+				break;
+
+			case SignalType::COMPLEX:
+				smp->data[j].z = std::complex<float>(pb_val->z->real, pb_val->z->imag);
+				break;
+
+			default: { }
 		}
 	}
 
-	psz = villas__node__message__get_packed_size(pb_msg);
+	return j;
+}
 
-	if (psz > len)
-		goto out;
+static int protobuf_sscan_packed(Villas__Node__Sample *pb_smp, struct sample *smp)
+{
+	unsigned j, f = 0, i = 0, nf = 0, ni = 0;
 
-	villas__node__message__pack(pb_msg, (uint8_t *) buf);
-	villas__node__message__free_unpacked(pb_msg, nullptr);
+	/* The types of the values are given by the signals of the receiver.
+	 * The values can only be assigned to the signals if their numbers match exactly. */
+	for (size_t k = 0; k < vlist_length(smp->signals); k++) {
+		struct signal *sig = (struct signal *) vlist_at(smp->signals, k);
 
-	*wbytes = psz;
+		switch (sig->type) {
+			case SignalType::FLOAT:
+				nf++;
+				break;
 
-	return cnt;
+			case SignalType::INTEGER:
+			case SignalType::BOOLEAN:
+				ni++;
+				break;
 
-out:
-	villas__node__message__free_unpacked(pb_msg, nullptr);
+			case SignalType::COMPLEX:
+				nf += 2;
+				break;
+
+			default:
+				return -1;
+		}
+	}
+
+	if (pb_smp->n_values_f != nf || pb_smp->n_values_i != ni) {
+		warning("Received invalid number of values in packed Protobuf payload: Received %zu floating point and %zu integer values, expected %u and %u.",
+			pb_smp->n_values_f, pb_smp->n_values_i, nf, ni);
+		return -2;
+	}
+
+	for (j = 0; j < MIN(vlist_length(smp->signals), smp->capacity); j++) {
+		struct signal *sig = (struct signal *) vlist_at(smp->signals, j);
+
+		switch (sig->type) {
+			case SignalType::FLOAT:
+				smp->data[j].f = pb_smp->values_f[f++];
+				break;
+
+			case SignalType::INTEGER:
+				smp->data[j].i = pb_smp->values_i[i++];
+				break;
 
-	return -1;
+			case SignalType::BOOLEAN:
+				smp->data[j].b = pb_smp->values_i[i++];
+				break;
+
+			case SignalType::COMPLEX:
+				smp->data[j].z = std::complex<float>(pb_smp->values_f[f], pb_smp->values_f[f + 1]);
+				f += 2;
+				break;
+
+			default: { }
+		}
+	}
+
+	return j;
 }
 
 int protobuf_sscan(struct io *io, const char *buf, size_t len, size_t *rbytes, struct sample *smps[], unsigned cnt)
 {
-	unsigned i, j;
+	int ret;
+	unsigned i;
 	Villas__Node__Message *pb_msg;
+	struct protobuf *pb = (struct protobuf *) io->_vd;
+	struct protobuf_arena *a = &pb->in;
 
-	pb_msg = villas__node__message__unpack(nullptr, len, (uint8_t *) buf);
-	if (!pb_msg)
+	pb_msg = villas__node__message__unpack(&a->allocator, len, (uint8_t *) buf);
+	if (!pb_msg) {
+		protobuf_arena_reset(a);
 		return -1;
+	}
 
 	for (i = 0; i < MIN(pb_msg->n_samples, cnt); i++) {
 		struct sample *smp = smps[i];
@@ -173,75 +492,75 @@ int protobuf_sscan(struct io *io, const char *buf, size_t len, size_t *rbytes, s
 			smp->ts.origin.tv_nsec = pb_smp->timestamp->nsec;
 		}
 
-		for (j = 0; j < MIN(pb_smp->n_values, smp->capacity); j++) {
-			Villas__Node__Value *pb_val = pb_smp->values[j];
+		/* Both layouts are accepted regardless of the configured format */
+		if (pb_smp->n_values_f > 0 || pb_smp->n_values_i > 0)
+			ret = protobuf_sscan_packed(pb_smp, smp);
+		else
+			ret = protobuf_sscan_values(pb_smp, smp);
 
-			enum SignalType fmt = protobuf_detect_format(pb_val);
-
-			struct signal *sig = (struct signal *) vlist_at_safe(smp->signals, j);
-			if (!sig)
-				return -1;
-
-			if (sig->type != fmt) {
-				error("Received invalid data type in Protobuf payload: Received %s, expected %s for signal %s (index %u).",
-					signal_type_to_str(fmt), signal_type_to_str(sig->type), sig->name, i);
-				return -2;
-			}
-
-			switch (sig->type) {
-				case SignalType::FLOAT:
-					smp->data[j].f = pb_val->f;
-					break;
-
-				case SignalType::INTEGER:
-					smp->data[j].i = pb_val->i;
-					break;
-
-				case SignalType::BOOLEAN:
-					smp->data[j].b = pb_val->b;
-					break;
-
-				case SignalType::COMPLEX:
-					smp->data[j].z = std::complex<float>(pb_val->z->real, pb_val->z->imag);
-					break;
-
-				default: { }
-			}
+		if (ret < 0) {
+			protobuf_arena_reset(a);
+			return ret;
 		}
 
-		if (pb_smp->n_values > 0)
+		if (ret > 0)
 			smp->flags |= (int) SampleFlags::HAS_DATA;
 
-		smp->length = j;
+		smp->length = ret;
 	}
 
 	if (rbytes)
 		*rbytes = villas__node__message__get_packed_size(pb_msg);
 
-	villas__node__message__free_unpacked(pb_msg, nullptr);
+	protobuf_arena_reset(a);
 
 	return i;
 }
 
-static struct plugin p;
-
+static struct plugin p1;
 __attribute__((constructor(110))) static void UNIQUE(__ctor)() {
 	if (plugins.state == State::DESTROYED)
 		vlist_init(&plugins);
 
-	p.name = "protobuf";
-	p.description = "Google Protobuf";
-	p.type = PluginType::FORMAT;
-	p.format.sprint	= protobuf_sprint;
-	p.format.sscan = protobuf_sscan;
-	p.format.flags = (int) IOFlags::HAS_BINARY_PAYLOAD |
+	p1.name = "protobuf";
+	p1.description = "Google Protobuf";
+	p1.type = PluginType::FORMAT;
+	p1.format.init = protobuf_init;
+	p1.format.destroy = protobuf_destroy;
+	p1.format.sprint = protobuf_sprint;
+	p1.format.sscan = protobuf_sscan;
+	p1.format.size = sizeof(struct protobuf);
+	p1.format.flags = (int) IOFlags::HAS_BINARY_PAYLOAD |
 		          (int) SampleFlags::HAS_TS_ORIGIN | (int) SampleFlags::HAS_SEQUENCE | (int) SampleFlags::HAS_DATA;
 
-	vlist_push(&plugins, &p);
+	vlist_push(&plugins, &p1);
 }
 
 __attribute__((destructor(110))) static void UNIQUE(__dtor)() {
 	if (plugins.state != State::DESTROYED)
-		vlist_remove_all(&plugins, &p);
+		vlist_remove_all(&plugins, &p1);
+}
+
+static struct plugin p2;
+__attribute__((constructor(110))) static void UNIQUE(__ctor)() {
+	if (plugins.state == State::DESTROYED)
+		vlist_init(&plugins);
+
+	p2.name = "protobuf.packed";
+	p2.description = "Google Protobuf with packed values";
+	p2.type = PluginType::FORMAT;
+	p2.format.init = protobuf_packed_init;
+	p2.format.destroy = protobuf_destroy;
+	p2.format.sprint = protobuf_sprint;
+	p2.format.sscan = protobuf_sscan;
+	p2.format.size = sizeof(struct protobuf);
+	p2.format.flags = (int) IOFlags::HAS_BINARY_PAYLOAD |
+		          (int) SampleFlags::HAS_TS_ORIGIN | (int) SampleFlags::HAS_SEQUENCE | (int) SampleFlags::HAS_DATA;
+
+	vlist_push(&plugins, &p2);
 }
 
+__attribute__((destructor(110))) static void UNIQUE(__dtor)() {
+	if (plugins.state != State::DESTROYED)
+		vlist_remove_all(&plugins, &p2);
+}
@@ -25,6 +25,7 @@
 #include <villas/utils.hpp>
 #include <villas/io.h>
 #include <villas/formats/raw.h>
+#include <villas/formats/convert.h>
 #include <villas/compat.h>
 
 typedef float flt32_t;
@@ -51,6 +52,71 @@ typedef long double flt128_t; /** @todo: check */
 /** Convert integer of varying width to big/little endian byte order */
 #define SWAP_INT_HTOX(o, b, n) (o ? htobe ## b (n) : htole ## b (n))
 
+/** Do we need to swap the byte order of the values? */
+#define RAW_SWAP(flags) (!!((flags) & RAW_BIG_ENDIAN) != (BYTE_ORDER == BIG_ENDIAN))
+
+/** Convert all values of a sample at once if they share the same type.
+ *
+ * @retval true The values have been written to \p dst.
+ * @retval false There is no fast path for this sample.
+ */
+static bool raw_convert_to(int flags, int bits, void *dst, struct sample *smp)
+{
+	switch (signal_list_type(smp->signals, smp->length)) {
+		case SignalType::FLOAT:
+			if (bits == 32)
+				convert_f64_to_f32(dst, &smp->data[0].f, smp->length, RAW_SWAP(flags));
+			else if (bits == 64)
+				convert_copy64(dst, &smp->data[0].f, smp->length, RAW_SWAP(flags));
+			else
+				return false;
+
+			return true;
+
+		case SignalType::INTEGER:
+			if (bits == 32)
+				convert_i64_to_i32(dst, &smp->data[0].i, smp->length, RAW_SWAP(flags));
+			else if (bits == 64)
+				convert_copy64(dst, &smp->data[0].i, smp->length, RAW_SWAP(flags));
+			else
+				return false;
+
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+/** Convert \p cnt values into a sample at once if they share the same type. */
+static bool raw_convert_from(int flags, int bits, struct sample *smp, const void *src, unsigned cnt)
+{
+	switch (signal_list_type(smp->signals, cnt)) {
+		case SignalType::FLOAT:
+			if (bits == 32)
+				convert_f32_to_f64(&smp->data[0].f, src, cnt, RAW_SWAP(flags));
+			else if (bits == 64)
+				convert_copy64(&smp->data[0].f, src, cnt, RAW_SWAP(flags));
+			else
+				return false;
+
+			return true;
+
+		case SignalType::INTEGER:
+			if (bits == 32)
+				convert_i32_to_i64(&smp->data[0].i, src, cnt, RAW_SWAP(flags), true);
+			else if (bits == 64)
+				convert_copy64(&smp->data[0].i, src, cnt, RAW_SWAP(flags));
+			else
+				return false;
+
+			return true;
+
+		default:
+			return false;
+	}
+}
+
 int raw_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct sample *smps[], unsigned cnt)
 {
 	int o = 0;
@@ -117,6 +183,13 @@ int raw_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, struct samp
 			}
 		}
 
+		/* Fast path: all values share the same type */
+		nlen = (o + smp->length) * (bits / 8);
+		if (nlen < len && raw_convert_to(io->flags, bits, buf + o * (bits / 8), smp)) {
+			o += smp->length;
+			continue;
+		}
+
 		for (unsigned j = 0; j < smp->length; j++) {
 			enum SignalType fmt = sample_format(smp, j);
 			union signal_data *data = &smp->data[j];
@@ -324,8 +397,16 @@ int raw_sscan(struct io *io, const char *buf, size_t len, size_t *rbytes, struct
 
 	smp->signals = io->signals;
 
-	unsigned i;
-	for (i = 0; i < smp->capacity && o < nlen; i++) {
+	unsigned i = 0;
+
+	/* Fast path: all values share the same type */
+	unsigned values = MIN(smp->capacity, (unsigned) (nlen - o));
+	if (raw_convert_from(io->flags, bits, smp, buf + o * (bits / 8), values)) {
+		i = values;
+		o += values;
+	}
+
+	for (; i < smp->capacity && o < nlen; i++) {
 		enum SignalType fmt = sample_format(smp, i);
 		union signal_data *data = &smp->data[i];
 
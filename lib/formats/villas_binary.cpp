@@ -43,16 +43,11 @@ int villas_binary_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, s
 		if (ptr + MSG_LEN(smp->length) > buf + len)
 			break;
 
-		ret = msg_from_sample(msg, smp, smp->signals);
+		/** @todo convert to little endian for VILLAS_BINARY_WEB */
+		ret = msg_from_sample(msg, smp, smp->signals, !(io->flags & VILLAS_BINARY_WEB));
 		if (ret)
 			return ret;
 
-		if (io->flags & VILLAS_BINARY_WEB) {
-			/** @todo convert to little endian */
-		}
-		else
-			msg_hton(msg);
-
 		ptr += MSG_LEN(smp->length);
 	}
 
@@ -97,13 +92,8 @@ int villas_binary_sscan(struct io *io, const char *buf, size_t len, size_t *rbyt
 			break;
 		}
 
-		if (io->flags & VILLAS_BINARY_WEB) {
-			/** @todo convert from little endian */
-		}
-		else
-			msg_ntoh(msg);
-
-		ret = msg_to_sample(msg, smp, io->signals);
+		/** @todo convert from little endian for VILLAS_BINARY_WEB */
+		ret = msg_to_sample(msg, smp, io->signals, !(io->flags & VILLAS_BINARY_WEB));
 		if (ret) {
 			warning("Invalid msg received: reason=3, ret=%d", ret);
 			break;
@@ -20,6 +20,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *********************************************************************************/
 
+#include <cmath>
 #include <cinttypes>
 #include <cstring>
 
@@ -29,6 +30,7 @@
 #include <villas/timing.h>
 #include <villas/sample.h>
 #include <villas/signal.h>
+#include <villas/text_codec.h>
 #include <villas/formats/villas_human.h>
 
 static size_t villas_human_sprint_single(struct io *io, char *buf, size_t len, const struct sample *smp)
@@ -38,21 +40,39 @@ static size_t villas_human_sprint_single(struct io *io, char *buf, size_t len, c
 
 	if (io->flags & (int) SampleFlags::HAS_TS_ORIGIN) {
 		if (smp->flags & (int) SampleFlags::HAS_TS_ORIGIN) {
-			off += snprintf(buf + off, len - off, "%llu", (unsigned long long) smp->ts.origin.tv_sec);
-			off += snprintf(buf + off, len - off, ".%09llu", (unsigned long long) smp->ts.origin.tv_nsec);
+			off += text_print_uint(buf + off, len - off, smp->ts.origin.tv_sec);
+			off += text_print_char(buf + off, len - off, '.');
+			off += text_print_uint(buf + off, len - off, smp->ts.origin.tv_nsec, 9);
 		}
 		else
-			off += snprintf(buf + off, len - off, "nan.nan");
+			off += text_print_str(buf + off, len - off, "nan.nan");
 	}
 
 	if (io->flags & (int) SampleFlags::HAS_OFFSET) {
-		if (smp->flags & (int) SampleFlags::HAS_TS_RECEIVED)
-			off += snprintf(buf + off, len - off, "%+e", time_delta(&smp->ts.origin, &smp->ts.received));
+		if (smp->flags & (int) SampleFlags::HAS_TS_RECEIVED) {
+			double offset = time_delta(&smp->ts.origin, &smp->ts.received);
+
+			if (io->flags & (int) IOFlags::PRINTF_COMPAT) {
+				int ret = snprintf(buf + off, len - off, "%+e", offset);
+
+				off += ret < 0 ? 0 : MIN((size_t) ret, len - off);
+			}
+			else {
+				/* The parser expects a sign in front of the offset */
+				if (!std::signbit(offset))
+					off += text_print_char(buf + off, len - off, '+');
+
+				off += text_print_double(buf + off, len - off, offset);
+			}
+		}
 	}
 
 	if (io->flags & (int) SampleFlags::HAS_SEQUENCE) {
-		if (io->flags & (int) SampleFlags::HAS_SEQUENCE)
-			off += snprintf(buf + off, len - off, "(%" PRIu64 ")", smp->sequence);
+		if (io->flags & (int) SampleFlags::HAS_SEQUENCE) {
+			off += text_print_char(buf + off, len - off, '(');
+			off += text_print_uint(buf + off, len - off, smp->sequence);
+			off += text_print_char(buf + off, len - off, ')');
+		}
 	}
 
 	if (io->flags & (int) SampleFlags::HAS_DATA) {
@@ -61,12 +81,18 @@ static size_t villas_human_sprint_single(struct io *io, char *buf, size_t len, c
 			if (!sig)
 				break;
 
-			off += snprintf(buf + off, len - off, "%c", io->separator);
-			off += signal_data_print_str(&smp->data[i], sig, buf + off, len - off);
+			off += text_print_char(buf + off, len - off, io->separator);
+			off += signal_data_print_str(&smp->data[i], sig, buf + off, len - off, io->flags);
 		}
 	}
 
-	off += snprintf(buf + off, len - off, "%c", io->delimiter);
+	off += text_print_char(buf + off, len - off, io->delimiter);
+
+	/* The sample has been truncated. We leave room for a null-terminator */
+	if (off >= len)
+		return 0;
+
+	buf[off] = '\0';
 
 	return off;
 }
@@ -76,6 +102,7 @@ static size_t villas_human_sscan_single(struct io *io, const char *buf, size_t l
 	int ret;
 	char *end;
 	const char *ptr = buf;
+	const char *last = buf + len;
 
 	double offset = 0;
 
@@ -89,8 +116,8 @@ static size_t villas_human_sscan_single(struct io *io, const char *buf, size_t l
 	 */
 
 	/* Mandatory: seconds */
-	smp->ts.origin.tv_sec = (uint32_t) strtoul(ptr, &end, 10);
-	if (ptr == end || *end == io->delimiter)
+	smp->ts.origin.tv_sec = (uint32_t) text_parse_uint(ptr, last, &end);
+	if (ptr == end || end == last || *end == io->delimiter)
 		return -1;
 
 	smp->flags |= (int) SampleFlags::HAS_TS_ORIGIN;
@@ -99,7 +126,7 @@ static size_t villas_human_sscan_single(struct io *io, const char *buf, size_t l
 	if (*end == '.') {
 		ptr = end + 1;
 
-		smp->ts.origin.tv_nsec = (uint32_t) strtoul(ptr, &end, 10);
+		smp->ts.origin.tv_nsec = (uint32_t) text_parse_uint(ptr, last, &end);
 		if (ptr == end)
 			return -3;
 	}
@@ -107,10 +134,10 @@ static size_t villas_human_sscan_single(struct io *io, const char *buf, size_t l
 		smp->ts.origin.tv_nsec = 0;
 
 	/* Optional: offset / delay */
-	if (*end == '+' || *end == '-') {
+	if (end < last && (*end == '+' || *end == '-')) {
 		ptr = end;
 
-		offset = strtof(ptr, &end); /* offset is ignored for now */
+		offset = text_parse_double(ptr, last, &end); /* offset is ignored for now */
 		if (ptr != end)
 			smp->flags |= (int) SampleFlags::HAS_OFFSET;
 		else
@@ -118,35 +145,35 @@ static size_t villas_human_sscan_single(struct io *io, const char *buf, size_t l
 	}
 
 	/* Optional: sequence */
-	if (*end == '(') {
+	if (end < last && *end == '(') {
 		ptr = end + 1;
 
-		smp->sequence = strtoul(ptr, &end, 10);
+		smp->sequence = text_parse_uint(ptr, last, &end);
 		if (ptr != end)
 			smp->flags |= (int) SampleFlags::HAS_SEQUENCE;
 		else
 			return -5;
 
-		if (*end == ')')
+		if (end < last && *end == ')')
 			end++;
 	}
 
 	unsigned i;
 	for (ptr = end + 1, i = 0; i < smp->capacity; ptr = end + 1, i++) {
 
-		if (*end == io->delimiter)
+		if (end >= last || *end == io->delimiter)
 			goto out;
 
 		struct signal *sig = (struct signal *) vlist_at_safe(io->signals, i);
 		if (!sig)
 			goto out;
 
-		ret = signal_data_parse_str(&smp->data[i], sig, ptr, &end);
+		ret = signal_data_parse_str(&smp->data[i], sig, ptr, last - ptr, &end);
 		if (ret || end == ptr) /* There are no valid values anymore. */
 			goto out;
 	}
 
-out:	if (*end == io->delimiter)
+out:	if (end < last && *end == io->delimiter)
 		end++;
 
 	smp->length = i;
@@ -168,8 +195,13 @@ int villas_human_sprint(struct io *io, char *buf, size_t len, size_t *wbytes, st
 	unsigned i;
 	size_t off = 0;
 
-	for (i = 0; i < cnt && off < len; i++)
-		off += villas_human_sprint_single(io, buf + off, len - off, smps[i]);
+	for (i = 0; i < cnt && off < len; i++) {
+		size_t wlen = villas_human_sprint_single(io, buf + off, len - off, smps[i]);
+		if (!wlen)
+			break;
+
+		off += wlen;
+	}
 
 	if (wbytes)
 		*wbytes = off;
@@ -246,3 +278,27 @@ __attribute__((destructor(110))) static void UNIQUE(__dtor)() {
         if (plugins.state != State::DESTROYED)
                 vlist_remove_all(&plugins, &p);
 }
+
+static struct plugin p2;
+__attribute__((constructor(110))) static void UNIQUE(__ctor)() {
+	if (plugins.state == State::DESTROYED)
+		vlist_init(&plugins);
+
+	p2.name = "villas.human.compat";
+	p2.description = "VILLAS human readable format (printf-compatible numbers)";
+	p2.type = PluginType::FORMAT;
+	p2.format.header = villas_human_header;
+	p2.format.sprint = villas_human_sprint;
+	p2.format.sscan	= villas_human_sscan;
+	p2.format.size	= 0;
+	p2.format.flags	= (int) IOFlags::NEWLINES | (int) IOFlags::PRINTF_COMPAT | (int) SampleFlags::HAS_TS_ORIGIN | (int) SampleFlags::HAS_SEQUENCE | (int) SampleFlags::HAS_DATA;
+	p2.format.delimiter = '\n';
+	p2.format.separator = '\t';
+
+	vlist_push(&plugins, &p2);
+}
+
+__attribute__((destructor(110))) static void UNIQUE(__dtor)() {
+	if (plugins.state != State::DESTROYED)
+		vlist_remove_all(&plugins, &p2);
+}
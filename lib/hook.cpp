@@ -22,6 +22,7 @@
 
 #include <cstring>
 #include <cmath>
+#include <utility>
 
 #include <villas/timing.h>
 #include <villas/node/config.h>
@@ -90,3 +91,37 @@ void Hook::parse(json_t *c)
 
 	state = State::PARSED;
 }
+
+int Hook::process(sample *smps[], unsigned cnt)
+{
+	unsigned processed = 0;
+
+	for (unsigned i = 0; i < cnt; i++) {
+		auto ret = process(smps[i]);
+		switch (ret) {
+			case Reason::ERROR:
+				return -1;
+
+			case Reason::OK:
+				std::swap(smps[processed++], smps[i]);
+				break;
+
+			case Reason::SKIP_SAMPLE:
+				break;
+
+			case Reason::STOP_PROCESSING:
+				return processed;
+		}
+	}
+
+	return processed;
+}
+
+Hook::Reason Hook::processOne(sample *smp)
+{
+	int ret = process(&smp, 1);
+	if (ret < 0)
+		return Reason::ERROR;
+
+	return ret > 0 ? Reason::OK : Reason::SKIP_SAMPLE;
+}
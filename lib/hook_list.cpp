@@ -134,38 +134,30 @@ skip_add:
 
 int hook_list_process(vlist *hs, sample *smps[], unsigned cnt)
 {
-	unsigned current, processed = 0;
+	int processed = cnt;
 
-	if (vlist_length(hs) == 0)
-		return cnt;
-
-	for (current = 0; current < cnt; current++) {
-		sample *smp = smps[current];
-
-		for (size_t i = 0; i < vlist_length(hs); i++) {
-			Hook *h = (Hook *) vlist_at(hs, i);
-
-			auto ret = h->process(smp);
-			switch (ret) {
-				case Hook::Reason::ERROR:
-					return -1;
+	/* Each hook processes the whole batch before it is handed to the next one */
+	for (size_t i = 0; i < vlist_length(hs) && processed > 0; i++) {
+		Hook *h = (Hook *) vlist_at(hs, i);
 
-				case Hook::Reason::OK:
-					continue;
+		processed = h->process(smps, processed);
+		if (processed < 0)
+			return -1;
+	}
 
-				case Hook::Reason::SKIP_SAMPLE:
-					goto skip;
+	return processed;
+}
 
-				case Hook::Reason::STOP_PROCESSING:
-					goto stop;
-			}
-		}
+bool hook_list_is_read_only(vlist *hs)
+{
+	for (size_t i = 0; i < vlist_length(hs); i++) {
+		Hook *h = (Hook *) vlist_at(hs, i);
 
-		smps[processed++] = smp;
-skip: {}
+		if (!h->isReadOnly())
+			return false;
 	}
 
-stop:	return processed;
+	return true;
 }
 
 void hook_list_periodic(vlist *hs)
@@ -32,6 +32,7 @@
 #include <villas/node/exceptions.hpp>
 #include <villas/signal.h>
 #include <villas/sample.h>
+#include <villas/utils.hpp>
 
 namespace villas {
 namespace node {
@@ -136,38 +137,62 @@ public:
 
 	virtual Hook::Reason process(sample *smp)
 	{
-		double avg, sum = 0;
-		int n = 0;
+		return processOne(smp);
+	}
 
+	virtual int process(sample *smps[], unsigned cnt)
+	{
 		assert(state == State::STARTED);
 
-		for (unsigned k = 0; k < smp->length; k++) {
-			if (!mask.test(k))
-				continue;
-
-			switch (sample_format(smp, k)) {
-				case SignalType::INTEGER:
-					sum += smp->data[k].i;
-					break;
+		/* The types of the averaged signals are looked up once for each
+		 * run of samples which share the same signal list and length. */
+		const struct vlist *fmt = nullptr;
+		unsigned fmtlen = 0, len = 0;
+		unsigned indices[MAX_SAMPLE_LENGTH];
+		bool integer[MAX_SAMPLE_LENGTH];
+
+		for (unsigned i = 0; i < cnt; i++) {
+			sample *smp = smps[i];
+
+			if (i == 0 || smp->signals != fmt || smp->length != fmtlen) {
+				fmt = smp->signals;
+				fmtlen = smp->length;
+				len = 0;
+
+				for (unsigned k = 0; k < MIN(smp->length, MAX_SAMPLE_LENGTH); k++) {
+					if (!mask.test(k))
+						continue;
+
+					switch (sample_format(smp, k)) {
+						case SignalType::INTEGER:
+							integer[len] = true;
+							break;
+
+						case SignalType::FLOAT:
+							integer[len] = false;
+							break;
+
+						case SignalType::INVALID:
+						case SignalType::COMPLEX:
+						case SignalType::BOOLEAN:
+							return -1; /* not supported */
+					}
+
+					indices[len++] = k;
+				}
+			}
 
-				case SignalType::FLOAT:
-					sum += smp->data[k].f;
-					break;
+			double avg, sum = 0;
 
-				case SignalType::INVALID:
-				case SignalType::COMPLEX:
-				case SignalType::BOOLEAN:
-					return Hook::Reason::ERROR; /* not supported */
-			}
+			for (unsigned j = 0; j < len; j++)
+				sum += integer[j] ? smp->data[indices[j]].i : smp->data[indices[j]].f;
 
-			n++;
+			avg = sum / len;
+			sample_data_insert(smp, (union signal_data *) &avg, offset, 1);
+			smp->signals = &signals;
 		}
 
-		avg = sum / n;
-		sample_data_insert(smp, (union signal_data *) &avg, offset, 1);
-		smp->signals = &signals;
-
-		return Reason::OK;
+		return cnt;
 	}
 };
 
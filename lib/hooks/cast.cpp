@@ -151,18 +151,29 @@ public:
 	}
 
 	virtual Hook::Reason process(sample *smp)
+	{
+		return processOne(smp);
+	}
+
+	virtual int process(sample *smps[], unsigned cnt)
 	{
 		assert(state == State::STARTED);
 
-		struct signal *orig_sig = (struct signal *) vlist_at(smp->signals, signal_index);
+		if (cnt == 0)
+			return 0;
+
+		/* All samples of a batch share the same signal descriptors */
+		struct signal *orig_sig = (struct signal *) vlist_at(smps[0]->signals, signal_index);
 		struct signal *new_sig  = (struct signal *) vlist_at(&signals,  signal_index);
 
-		signal_data_cast(&smp->data[signal_index], orig_sig, new_sig);
+		for (unsigned i = 0; i < cnt; i++) {
+			signal_data_cast(&smps[i]->data[signal_index], orig_sig, new_sig);
 
-		/* Replace signal descriptors of sample */
-		smp->signals = &signals;
+			/* Replace signal descriptors of sample */
+			smps[i]->signals = &signals;
+		}
 
-		return Reason::OK;
+		return cnt;
 	}
 };
 
@@ -24,6 +24,8 @@
  * @{
  */
 
+#include <utility>
+
 #include <villas/hooks/decimate.hpp>
 
 namespace villas {
@@ -54,14 +56,23 @@ void DecimateHook::parse(json_t *cfg)
 	state = State::PARSED;
 }
 
-Hook::Reason DecimateHook::process(sample *smp)
+int DecimateHook::process(sample *smps[], unsigned cnt)
 {
+	unsigned processed = 0;
+
 	assert(state == State::STARTED);
 
-	if (ratio && counter++ % ratio != 0)
-		return Hook::Reason::SKIP_SAMPLE;
+	if (!ratio)
+		return cnt;
+
+	for (unsigned i = 0; i < cnt; i++) {
+		if (counter++ % ratio != 0)
+			continue;
+
+		std::swap(smps[processed++], smps[i]);
+	}
 
-	return Reason::OK;
+	return processed;
 }
 
 /* Register hook */
@@ -43,58 +43,78 @@ namespace node {
 class DPHook : public Hook {
 
 protected:
+	enum class Method {
+		DFT,		/**< Evaluate the full DFT over the window for every sample. */
+		SDFT		/**< Update the DFT recursively by the difference of newest and oldest sample. */
+	} method;
+
 	char *signal_name;
 	unsigned signal_index;
 
 	int offset;
 	int inverse;
+	int resync;		/**< Number of samples after which the recursive DFT is re-anchored (SDFT only). */
 
 	double f0;
 	double timestep;
 	double time;
 	double steps;
 
-	std::complex<double> *coeffs;
+	std::complex<double> *coeffs;	/**< Running sums of the sliding DFT (one per harmonic). */
 	int *fharmonics;
 	int  fharmonics_len;
 
+	std::complex<double> *twiddles;	/**< twiddles[i] = exp(2j * pi * i / N) */
+	unsigned phase;			/**< Index of the newest sample in the window modulo N. */
+	int anchor;			/**< Samples since the last re-anchoring of the sliding DFT. */
+
 	dsp::Window<double> window;
 
-	void step(double *in, std::complex<float> *out)
+	/** Returns the twiddle factor index for harmonic \p k at sample \p m modulo N. */
+	unsigned twiddleIndex(int k, unsigned m, unsigned N)
 	{
-		int N = window.getLength();
-		__attribute__((unused)) std::complex<double> om_k, corr;
-		double newest = *in;
-		__attribute__((unused)) double oldest = window.update(newest);
+		unsigned km = ((k % (int) N) + N) % N;
 
-		for (int k = 0; k < fharmonics_len; k++) {
-			om_k = 2.0i * M_PI * (double) fharmonics[k] / (double) N;
+		return ((uint64_t) km * (m % N)) % N;
+	}
 
-			/* Correction for stationary phasor */
-			corr = std::exp(-om_k * (steps - (N + 1)));
-			//corr = 1;
+	/** Calculate the DFT sum of harmonic \p k over the complete window. */
+	std::complex<double> sum(int k)
+	{
+		unsigned N = window.getLength();
+		std::complex<double> S_k = 0;
 
-#if 0
-			/* Recursive update */
-			coeffs[k] = std::exp(om) * (coeffs[k] + (newest - oldest));
+		/* window[0] is the oldest sample which is N - 1 samples before the newest one */
+		for (unsigned n = 0; n < N; n++)
+			S_k += window[n] * twiddles[twiddleIndex(k, phase + 1 + n, N)];
 
-			out[k] = (2.0 / N) * (coeffs[i] * corr);
+		return S_k;
+	}
 
-			/* DC component */
-			if (fharmonics[k] == 0)
-				out[k] /= 2.0;
-#else
-			/* Full DFT */
-			std::complex<double> X_k = 0;
+	void step(double *in, std::complex<float> *out)
+	{
+		unsigned N = window.getLength();
+		double newest = *in;
+		double oldest = window.update(newest);
 
-			for (int n = 0; n < N; n++) {
-				double x_n = window[n];
+		phase = (phase + 1) % N;
 
-				X_k += x_n * std::exp(om_k * (double) n);
-			}
+		bool full = method == Method::DFT;
+		if (method == Method::SDFT && resync > 0 && ++anchor >= resync) {
+			anchor = 0;
+			full = true;
+		}
+
+		for (int k = 0; k < fharmonics_len; k++) {
+			if (full)
+				coeffs[k] = sum(fharmonics[k]);
+			else
+				coeffs[k] += (newest - oldest) * twiddles[twiddleIndex(fharmonics[k], phase, N)];
 
-			out[k] = X_k / (corr * (double) N);
-#endif
+			/* Correction for stationary phasor */
+			std::complex<double> corr = twiddles[twiddleIndex(-2 * fharmonics[k], 1, N)];
+
+			out[k] = coeffs[k] * corr / (double) N;
 		}
 	}
 
@@ -118,17 +138,26 @@ public:
 
 	DPHook(struct path *p, struct node *n, int fl, int prio, bool en = true) :
 		Hook(p, n, fl, prio, en),
-		inverse(0)
+		method(Method::DFT),
+		signal_name(nullptr),
+		inverse(0),
+		resync(-1),
+		coeffs(nullptr),
+		fharmonics(nullptr),
+		twiddles(nullptr)
 	{ }
 
 	virtual ~DPHook()
 	{
 		/* Release memory */
 		if (fharmonics)
-			delete fharmonics;
+			delete[] fharmonics;
 
 		if (coeffs)
-			delete coeffs;
+			delete[] coeffs;
+
+		if (twiddles)
+			delete[] twiddles;
 
 		if (signal_name)
 			free(signal_name);
@@ -140,11 +169,31 @@ public:
 
 		time = 0;
 		steps = 0;
+		anchor = 0;
 
 		for (int i = 0; i < fharmonics_len; i++)
 			coeffs[i] = 0;
 
-		window = dsp::Window<double>((1.0 / f0) / timestep, 0.0);
+		window = dsp::Window<double>(std::round((1.0 / f0) / timestep), 0.0);
+
+		unsigned N = window.getLength();
+		if (N == 0)
+			throw RuntimeError("Window length of dp hook is zero. Check settings 'f0' and 'rate'");
+
+		/* Precompute the twiddle factors for all harmonics */
+		if (twiddles)
+			delete[] twiddles;
+
+		twiddles = new std::complex<double>[N];
+		for (unsigned i = 0; i < N; i++)
+			twiddles[i] = std::exp(2.0i * M_PI * (double) i / (double) N);
+
+		/* By default we re-anchor the sliding DFT every 100 periods */
+		if (resync < 0)
+			resync = 100 * N;
+
+		/* The window is filled with zeros: start with the sample before the first one */
+		phase = N - 1;
 
 		state = State::STARTED;
 	}
@@ -157,18 +206,30 @@ public:
 		size_t i;
 
 		double rate = -1, dt = -1;
+		const char *method_str = nullptr;
 
-		ret = json_unpack_ex(cfg, &err, 0, "{ s: o, s: F, s?: F, s?: F, s: o, s?: b }",
+		ret = json_unpack_ex(cfg, &err, 0, "{ s: o, s: F, s?: F, s?: F, s: o, s?: b, s?: s, s?: i }",
 			"signal", &json_signal,
 			"f0", &f0,
 			"dt", &dt,
 			"rate", &rate,
 			"harmonics", &json_harmonics,
-			"inverse", &inverse
+			"inverse", &inverse,
+			"method", &method_str,
+			"resync", &resync
 		);
 		if (ret)
 			throw ConfigError(cfg, err, "node-config-hook-dp");
 
+		if (method_str) {
+			if (!strcmp(method_str, "dft"))
+				method = Method::DFT;
+			else if (!strcmp(method_str, "sdft"))
+				method = Method::SDFT;
+			else
+				throw ConfigError(cfg, "node-config-hook-dp-method", "Invalid value for setting 'method': {}", method_str);
+		}
+
 		if (rate > 0)
 			timestep = 1. / rate;
 		else if (dt > 0)
@@ -25,6 +25,7 @@
  */
 
 #include <cinttypes>
+#include <utility>
 
 #include <villas/hook.hpp>
 #include <villas/node.h>
@@ -61,27 +62,45 @@ public:
 	}
 
 	virtual Hook::Reason process(sample *smp)
+	{
+		return processOne(smp);
+	}
+
+	virtual int process(sample *smps[], unsigned cnt)
 	{
 		int dist;
+		unsigned processed = 0;
+		sample *last = prev;
 
 		assert(state == State::STARTED);
 
-		if (prev) {
-			dist = smp->sequence - (int64_t) prev->sequence;
-			if (dist <= 0) {
-				logger->debug("Dropping reordered sample: sequence={}, distance={}", smp->sequence, dist);
+		for (unsigned i = 0; i < cnt; i++) {
+			sample *smp = smps[i];
+
+			if (last) {
+				dist = smp->sequence - (int64_t) last->sequence;
+				if (dist <= 0) {
+					logger->debug("Dropping reordered sample: sequence={}, distance={}", smp->sequence, dist);
 
-				return Hook::Reason::SKIP_SAMPLE;
+					continue;
+				}
 			}
+
+			std::swap(smps[processed++], smps[i]);
+
+			last = smp;
 		}
 
-		sample_incref(smp);
-		if (prev)
-			sample_decref(prev);
+		/* We only need to hold a reference to the last sample of the batch */
+		if (last != prev) {
+			sample_incref(last);
+			if (prev)
+				sample_decref(prev);
 
-		prev = smp;
+			prev = last;
+		}
 
-		return Reason::OK;
+		return processed;
 	}
 
 	virtual void restart()
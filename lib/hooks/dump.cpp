@@ -37,6 +37,11 @@ class DumpHook : public Hook {
 public:
 	using Hook::Hook;
 
+	virtual bool isReadOnly() const
+	{
+		return true;
+	}
+
 	virtual Hook::Reason process(sample *smp)
 	{
 		assert(state == State::STARTED);
@@ -95,6 +95,11 @@ public:
 		info("Energy: %f", energy);
 	}
 
+	virtual bool isReadOnly() const
+	{
+		return true;
+	}
+
 	virtual Hook::Reason process(sample *smp)
 	{
 		double P, P_last, dt;
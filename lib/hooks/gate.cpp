@@ -27,6 +27,7 @@
 #include <cmath>
 #include <string>
 #include <limits>
+#include <utility>
 
 #include <villas/hook.hpp>
 #include <villas/node.h>
@@ -141,54 +142,66 @@ public:
 
 	virtual Hook::Reason process(sample *smp)
 	{
-		assert(state == State::STARTED);
-
-		Hook::Reason reason;
-		double value = smp->data[signalIndex].f;
-
-		if (active) {
-			if (duration > 0 && time_delta(&smp->ts.origin, &startTime) < duration)
-				reason = Reason::OK;
-			else if (samples > 0 && smp->sequence - startSequence < (uint64_t) samples)
-				reason = Reason::OK;
-			else {
-				reason = Reason::SKIP_SAMPLE;
-				active = false;
-			}
-		}
+		return processOne(smp);
+	}
 
-		if (!active) {
-			switch (mode) {
-				case Mode::ABOVE:
-					reason = value > threshold ? Reason::OK : Reason::SKIP_SAMPLE;
-					break;
+	virtual int process(sample *smps[], unsigned cnt)
+	{
+		unsigned processed = 0;
 
-				case Mode::BELOW:
-					reason = value < threshold ? Reason::OK : Reason::SKIP_SAMPLE;
-					break;
+		assert(state == State::STARTED);
 
-				case Mode::RISING_EDGE:
-					reason = (!std::isnan(previousValue) && value > previousValue) ? Reason::OK : Reason::SKIP_SAMPLE;
-					break;
+		for (unsigned i = 0; i < cnt; i++) {
+			sample *smp = smps[i];
 
-				case Mode::FALLING_EDGE:
-					reason = (!std::isnan(previousValue) && value < previousValue) ? Reason::OK : Reason::SKIP_SAMPLE;
-					break;
+			bool pass = false;
+			double value = smp->data[signalIndex].f;
 
-				default:
-					reason = Reason::ERROR;
+			if (active) {
+				if (duration > 0 && time_delta(&smp->ts.origin, &startTime) < duration)
+					pass = true;
+				else if (samples > 0 && smp->sequence - startSequence < (uint64_t) samples)
+					pass = true;
+				else
+					active = false;
 			}
 
-			if (reason == Reason::OK) {
-				startTime = smp->ts.origin;
-				startSequence = smp->sequence;
-				active = true;
+			if (!active) {
+				switch (mode) {
+					case Mode::ABOVE:
+						pass = value > threshold;
+						break;
+
+					case Mode::BELOW:
+						pass = value < threshold;
+						break;
+
+					case Mode::RISING_EDGE:
+						pass = !std::isnan(previousValue) && value > previousValue;
+						break;
+
+					case Mode::FALLING_EDGE:
+						pass = !std::isnan(previousValue) && value < previousValue;
+						break;
+
+					default:
+						return -1;
+				}
+
+				if (pass) {
+					startTime = smp->ts.origin;
+					startSequence = smp->sequence;
+					active = true;
+				}
 			}
-		}
 
-		previousValue = value;
+			previousValue = value;
+
+			if (pass)
+				std::swap(smps[processed++], smps[i]);
+		}
 
-		return reason;
+		return processed;
 	}
 };
 
@@ -78,6 +78,11 @@ public:
 		delete moving_var;
 	}
 
+	virtual bool isReadOnly() const
+	{
+		return true;
+	}
+
 	/**
 	 * Hook to calculate jitter between GTNET-SKT GPS timestamp and Villas node NTP timestamp.
 	 *
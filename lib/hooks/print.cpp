@@ -124,6 +124,11 @@ public:
 		state = State::PARSED;
 	}
 
+	virtual bool isReadOnly() const
+	{
+		return true;
+	}
+
 	virtual Hook::Reason process(sample *smp)
 	{
 		assert(state == State::STARTED);
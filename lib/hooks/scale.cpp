@@ -101,32 +101,45 @@ public:
 	}
 
 	virtual Hook::Reason process(sample *smp)
+	{
+		return processOne(smp);
+	}
+
+	virtual int process(sample *smps[], unsigned cnt)
 	{
 		int k = signal_index;
 
 		assert(state == State::STARTED);
 
-		switch (sample_format(smp, k)) {
+		if (cnt == 0)
+			return 0;
+
+		/* All samples of a batch share the same signal descriptors */
+		switch (sample_format(smps[0], k)) {
 			case SignalType::INTEGER:
-				smp->data[k].i = smp->data[k].i * scale + offset;
+				for (unsigned i = 0; i < cnt; i++)
+					smps[i]->data[k].i = smps[i]->data[k].i * scale + offset;
 				break;
 
 			case SignalType::FLOAT:
-				smp->data[k].f = smp->data[k].f * scale + offset;
+				for (unsigned i = 0; i < cnt; i++)
+					smps[i]->data[k].f = smps[i]->data[k].f * scale + offset;
 				break;
 
 			case SignalType::COMPLEX:
-				smp->data[k].z = smp->data[k].z * (float) scale + (float) offset;
+				for (unsigned i = 0; i < cnt; i++)
+					smps[i]->data[k].z = smps[i]->data[k].z * (float) scale + (float) offset;
 				break;
 
 			case SignalType::BOOLEAN:
-				smp->data[k].b = smp->data[k].b * (float) scale + (float) offset;
+				for (unsigned i = 0; i < cnt; i++)
+					smps[i]->data[k].b = smps[i]->data[k].b * (float) scale + (float) offset;
 				break;
 
 			default: { }
 		}
 
-		return Reason::OK;
+		return cnt;
 	}
 };
 
@@ -80,26 +80,29 @@ public:
 
 	virtual Hook::Reason process(sample *smp)
 	{
-		timespec *ts;
+		return processOne(smp);
+	}
 
+	virtual int process(sample *smps[], unsigned cnt)
+	{
 		assert(state == State::STARTED);
 
 		switch (mode) {
 			case SHIFT_ORIGIN:
-				ts = &smp->ts.origin;
+				for (unsigned i = 0; i < cnt; i++)
+					smps[i]->ts.origin = time_add(&smps[i]->ts.origin, &offset);
 				break;
 
 			case SHIFT_RECEIVED:
-				ts = &smp->ts.received;
+				for (unsigned i = 0; i < cnt; i++)
+					smps[i]->ts.received = time_add(&smps[i]->ts.received, &offset);
 				break;
 
 			default:
-				return Hook::Reason::ERROR;
+				return -1;
 		}
 
-		*ts = time_add(ts, &offset);;
-
-		return Reason::OK;
+		return cnt;
 	}
 };
 
@@ -94,6 +94,11 @@ public:
 		skip_state = SkipState::STARTED;
 	}
 
+	virtual bool isReadOnly() const
+	{
+		return true;
+	}
+
 	virtual Hook::Reason process(sample *smp)
 	{
 		assert(state == State::STARTED);
@@ -51,6 +51,11 @@ public:
 		state = State::CHECKED;
 	}
 
+	virtual bool isReadOnly() const
+	{
+		return true;
+	}
+
 	virtual Hook::Reason process(sample *smp)
 	{
 		timespec now = time_now();
@@ -92,6 +97,11 @@ public:
 		state = State::STOPPED;
 	}
 
+	virtual bool isReadOnly() const
+	{
+		return true;
+	}
+
 	virtual Hook::Reason process(sample *smp)
 	{
 		if (last) {
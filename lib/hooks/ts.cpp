@@ -37,12 +37,18 @@ public:
 	using Hook::Hook;
 
 	virtual Hook::Reason process(sample *smp)
+	{
+		return processOne(smp);
+	}
+
+	virtual int process(sample *smps[], unsigned cnt)
 	{
 		assert(state == State::STARTED);
 
-		smp->ts.origin = smp->ts.received;
+		for (unsigned i = 0; i < cnt; i++)
+			smps[i]->ts.origin = smps[i]->ts.received;
 
-		return Reason::OK;
+		return cnt;
 	}
 };
 
@@ -30,9 +30,13 @@
 #include <villas/format_type.h>
 #include <villas/utils.hpp>
 #include <villas/sample.h>
+#include <villas/log.h>
 
 using namespace villas::utils;
 
+/** Size of the stdio buffer of compressed output streams. */
+#define IO_COMPRESSION_BUFSIZ	(64 << 10)
+
 static int io_print_lines(struct io *io, struct sample *smps[], unsigned cnt)
 {
 	int ret;
@@ -104,6 +108,13 @@ int io_init(struct io *io, const struct format_type *fmt, struct vlist *signals,
 
 	io->signals = signals;
 
+	io->in.compressor =
+	io->out.compressor = nullptr;
+
+	io->compression.type = CompressionType::AUTO;
+	io->compression.level = 0;
+	io->compression.threads = 0;
+
 	ret = io_type(io)->init ? io_type(io)->init(io) : 0;
 	if (ret)
 		return ret;
@@ -168,6 +179,37 @@ int io_check(struct io *io)
 	return 0;
 }
 
+/** Replace the streams of a local file by (de-)compressing ones. */
+static int io_stream_compress(struct io *io, const char *uri)
+{
+	FILE *f;
+
+	if (io->compression.type == CompressionType::AUTO)
+		io->compression.type = compression_from_uri(uri);
+
+	if (io->compression.type == CompressionType::NONE)
+		return 0;
+
+	if (io->flags & (int) IOFlags::NONBLOCK) {
+		warning("Compressed streams can not be non-blocking");
+		return -1;
+	}
+
+	f = compressor_open(io->out.stream.std, &io->compression, "w", &io->out.compressor);
+	if (!f)
+		return -1;
+
+	io->out.stream.std = f;
+
+	f = compressor_open(io->in.stream.std, &io->compression, "r", &io->in.compressor);
+	if (!f)
+		return -1;
+
+	io->in.stream.std = f;
+
+	return 0;
+}
+
 int io_stream_open(struct io *io, const char *uri)
 {
 	int ret;
@@ -186,10 +228,20 @@ int io_stream_open(struct io *io, const char *uri)
 			io->in.stream.std  = fopen(uri, "r");
 			if (io->in.stream.std == nullptr)
 				return -1;
+
+			ret = io_stream_compress(io, uri);
+			if (ret)
+				return ret;
 		}
 		else {
 			io->mode = IOMode::ADVIO;
 
+			if (io->compression.type != CompressionType::AUTO &&
+			    io->compression.type != CompressionType::NONE) {
+				warning("Compression is only supported for local files");
+				return -1;
+			}
+
 			io->out.stream.adv = afopen(uri, "a+");
 			if (io->out.stream.adv == nullptr)
 				return -1;
@@ -232,7 +284,10 @@ stdio:		io->mode = IOMode::STDIO;
 		if (ret)
 			return -1;
 
-		ret = setvbuf(io->out.stream.std, nullptr, _IOLBF, BUFSIZ);
+		/* Compressed streams are fully buffered to get reasonable block sizes */
+		ret = io->out.compressor
+			? setvbuf(io->out.stream.std, nullptr, _IOFBF, IO_COMPRESSION_BUFSIZ)
+			: setvbuf(io->out.stream.std, nullptr, _IOLBF, BUFSIZ);
 		if (ret)
 			return -1;
 	}
@@ -268,6 +323,9 @@ int io_stream_close(struct io *io)
 			if (ret)
 				return ret;
 
+			io->in.compressor = nullptr;
+			io->out.compressor = nullptr;
+
 			return 0;
 
 		case IOMode::CUSTOM:
@@ -282,8 +340,15 @@ int io_stream_flush(struct io *io)
 	switch (io->mode) {
 		case IOMode::ADVIO:
 			return afflush(io->out.stream.adv);
-		case IOMode::STDIO:
-			return fflush(io->out.stream.std);
+		case IOMode::STDIO: {
+			int ret = fflush(io->out.stream.std);
+			if (ret)
+				return ret;
+
+			return io->out.compressor
+				? compressor_flush(io->out.compressor)
+				: 0;
+		}
 		case IOMode::CUSTOM:
 			return 0;
 	}
@@ -334,6 +334,108 @@ int mapping_list_prepare(struct vlist *ml)
 	return 0;
 }
 
+int mapping_plan_init(struct mapping_plan *mp, const struct vlist *ml)
+{
+	size_t len = vlist_length(ml);
+
+	mp->entries = (const struct mapping_entry **) alloc(len * sizeof(struct mapping_entry *));
+	mp->fixups = (const struct mapping_entry **) alloc(len * sizeof(struct mapping_entry *));
+	mp->ranges = (struct mapping_range *) alloc(len * sizeof(struct mapping_range));
+
+	mp->nranges = 0;
+	mp->nfixups = 0;
+	mp->length = 0;
+
+	for (size_t i = 0, j = 0; i < len; i++) {
+		const struct mapping_entry *me = (const struct mapping_entry *) vlist_at(ml, i);
+
+		if (me->length < 0)
+			return -1; /* mapping_list_prepare() has not been called yet */
+
+		if (me->offset + me->length > mp->length)
+			mp->length = me->offset + me->length;
+
+		if (me->type != MappingType::DATA) {
+			mp->fixups[mp->nfixups++] = me;
+			continue;
+		}
+
+		if (me->length == 0)
+			continue;
+
+		mp->entries[j] = me;
+
+		/* Extend the previous range if this entry directly follows it */
+		struct mapping_range *mr = mp->nranges > 0 ? &mp->ranges[mp->nranges - 1] : nullptr;
+		if (mr && mr->offset + mr->length == me->offset &&
+		          mr->source + mr->length == (unsigned) me->data.offset) {
+			mr->length += me->length;
+			mr->count++;
+		}
+		else {
+			mr = &mp->ranges[mp->nranges++];
+
+			mr->offset = me->offset;
+			mr->source = me->data.offset;
+			mr->length = me->length;
+			mr->first = j;
+			mr->count = 1;
+		}
+
+		j++;
+	}
+
+	return 0;
+}
+
+int mapping_plan_destroy(struct mapping_plan *mp)
+{
+	free(mp->entries);
+	free(mp->fixups);
+	free(mp->ranges);
+
+	mp->nranges = 0;
+	mp->nfixups = 0;
+
+	return 0;
+}
+
+int mapping_plan_remap(const struct mapping_plan *mp, struct sample *remapped, const struct sample *original)
+{
+	int ret;
+
+	if (mp->length > remapped->capacity)
+		return -1;
+
+	for (unsigned i = 0; i < mp->nranges; i++) {
+		const struct mapping_range *mr = &mp->ranges[i];
+
+		/* The original sample is too short: fall back to the individual entries */
+		if (mr->source + mr->length > original->length) {
+			for (unsigned j = 0; j < mr->count; j++) {
+				ret = mapping_update(mp->entries[mr->first + j], remapped, original);
+				if (ret)
+					return ret;
+			}
+
+			continue;
+		}
+
+		memcpy(&remapped->data[mr->offset], &original->data[mr->source], mr->length * sizeof(original->data[0]));
+
+		if (mr->offset + mr->length > remapped->length)
+			remapped->length = mr->offset + mr->length;
+	}
+
+	for (unsigned i = 0; i < mp->nfixups; i++) {
+		ret = mapping_update(mp->fixups[i], remapped, original);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 int mapping_to_str(const struct mapping_entry *me, unsigned index, char **str)
 {
 	const char *type;
@@ -22,6 +22,11 @@
 
 #include <cstdlib>
 #include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 #include <unistd.h>
 
 #include <sys/mman.h>
@@ -29,6 +34,12 @@
 #include <sys/resource.h>
 #include <sys/types.h>
 
+#ifdef __linux__
+  #include <sys/syscall.h>
+  #include <linux/mman.h>
+  #include <linux/mempolicy.h>
+#endif
+
 /* Required to allocate hugepages on Apple OS X */
 #ifdef __MACH__
   #include <mach/vm_statistics.h>
@@ -42,9 +53,30 @@
 
 using namespace villas::utils;
 
+/* Allocations which consume more than this share of an arena get their own mapping */
+#define MEMORY_HUGEPAGE_ARENA_FRACTION	4
+
+#define MEMORY_HUGEPAGE_GIGANTIC_SIZE	(1UL << 30)
+
+/** A large region backed by hugepages from which small allocations are carved. */
+struct memory_arena {
+	void *address;
+	size_t length;
+	size_t pagesz;			/**< Size of the pages which back the arena. */
+	int node;			/**< NUMA node to which the arena is bound or -1. */
+
+	struct memory_type *manager;	/**< Allocator of the arena, see memory_managed(). */
+};
+
 static size_t pgsz = -1;
 static size_t hugepgsz = -1;
 
+static std::mutex arenas_mtx;
+static std::vector<struct memory_arena> arenas;
+
+static size_t arena_size = DEFAULT_HUGEPAGE_ARENA_SIZE;
+static bool arena_gigantic = false;
+
 int memory_hugepage_init(int hugepages)
 {
 	pgsz = kernel_get_page_size();
@@ -74,19 +106,62 @@ int memory_hugepage_init(int hugepages)
 	return 0;
 }
 
-/** Allocate memory backed by hugepages with malloc() like interface */
-static struct memory_allocation * memory_hugepage_alloc(struct memory_type *m, size_t len, size_t alignment)
+void memory_hugepage_arenas(size_t size, bool gigantic)
 {
-	static bool use_huge = true;
+	std::lock_guard<std::mutex> guard(arenas_mtx);
 
+	arena_size = size;
+	arena_gigantic = gigantic;
+}
+
+/** Hugepages of the given kind can not be used at all if mmap() fails with one of these errors.
+ *
+ * Other errors like ENOMEM only mean that not enough hugepages are free at the moment.
+ */
+static bool memory_hugepage_unsupported(int err)
+{
+	return err == ENOSYS || err == EINVAL;
+}
+
+/** Map a region which is backed by hugepages or by normal pages if no hugepages are available.
+ *
+ * @param[inout] len The requested length. Rounded up to a multiple of the page size.
+ * @param[out] pagesz The size of the pages which back the region.
+ * @param gigantic Try to use 1 GiB pages first.
+ */
+static void * memory_hugepage_map(size_t *len, size_t *pagesz, bool gigantic)
+{
+	static std::atomic<bool> use_huge(true);
+
+	void *addr;
 	int flags, fd;
 	size_t sz;
 
-	struct memory_allocation *ma = (struct memory_allocation *) alloc(sizeof(struct memory_allocation));
-	if (!ma)
-		return nullptr;
+#if defined(__linux__) && defined(MAP_HUGE_1GB)
+	static std::atomic<bool> use_gigantic(true);
+
+	if (gigantic && use_gigantic && use_huge) {
+		sz = MEMORY_HUGEPAGE_GIGANTIC_SIZE;
+		flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_1GB;
+
+		addr = mmap(nullptr, ALIGN(*len, sz), PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (addr != MAP_FAILED) {
+			*len = ALIGN(*len, sz);
+			*pagesz = sz;
 
-retry:	if (use_huge) {
+			return addr;
+		}
+
+		if (memory_hugepage_unsupported(errno)) {
+			warning("1 GiB hugepages are not supported, using %zu KiB hugepages from now on: %s", hugepgsz >> 10, strerror(errno));
+			use_gigantic = false;
+		}
+		else
+			debug(LOG_MEM | 2, "Failed to map 1 GiB hugepages, try with %zu KiB hugepages instead: %s", hugepgsz >> 10, strerror(errno));
+	}
+#endif
+
+	if (use_huge) {
 #ifdef __linux__
 		flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
 #else
@@ -99,42 +174,156 @@ retry:	if (use_huge) {
 		fd = -1;
 #endif
 		sz = hugepgsz;
-	}
-	else {
-		flags = MAP_PRIVATE | MAP_ANONYMOUS;
-		fd = -1;
 
-		sz = pgsz;
-	}
+		/** We must make sure that len is a multiple of the (huge)page size
+		 *
+		 * See: https://lkml.org/lkml/2014/10/22/925
+		 */
+		addr = mmap(nullptr, ALIGN(*len, sz), PROT_READ | PROT_WRITE, flags, fd, 0);
+		if (addr != MAP_FAILED) {
+			*len = ALIGN(*len, sz);
+			*pagesz = sz;
 
-	/** We must make sure that len is a multiple of the (huge)page size
-	 *
-	 * See: https://lkml.org/lkml/2014/10/22/925
-	 */
-	ma->length = ALIGN(len, sz);
-	ma->alignment = ALIGN(alignment, sz);
-	ma->type = m;
+			return addr;
+		}
 
-	ma->address = mmap(nullptr, ma->length, PROT_READ | PROT_WRITE, flags, fd, 0);
-	if (ma->address == MAP_FAILED) {
-		if (use_huge) {
-			warning("Failed to map hugepages, try with normal pages instead!");
+		/* Only this allocation falls back to normal pages if the hugepages are just exhausted */
+		if (memory_hugepage_unsupported(errno)) {
+			warning("Hugepages are not supported, using normal pages from now on: %s", strerror(errno));
 			use_huge = false;
-			goto retry;
 		}
-		else {
-			free(ma);
-			return nullptr;
+		else
+			warning("Failed to map hugepages, try with normal pages instead: %s", strerror(errno));
+	}
+
+	flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	sz = pgsz;
+
+	addr = mmap(nullptr, ALIGN(*len, sz), PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (addr == MAP_FAILED)
+		return nullptr;
+
+	*len = ALIGN(*len, sz);
+	*pagesz = sz;
+
+	return addr;
+}
+
+static void memory_hugepage_bind(void *addr, size_t len, int node)
+{
+#ifdef __linux__
+	unsigned long mask = 1UL << node;
+
+	/* The pages might have already been faulted in by mlockall(MCL_FUTURE).
+	 * So we ask the kernel to migrate them if necessary. */
+	long ret = syscall(SYS_mbind, addr, len, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, MPOL_MF_MOVE);
+	if (ret)
+		warning("Failed to bind memory to NUMA node %d: %s", node, strerror(errno));
+#endif /* __linux__ */
+}
+
+/** Carve an allocation from one of the arenas of NUMA node \p node.
+ *
+ * A new arena is mapped if all existing ones are exhausted.
+ */
+static struct memory_allocation * memory_hugepage_arena_alloc(size_t len, size_t alignment, int node)
+{
+	struct memory_allocation *ma;
+	struct memory_arena a;
+
+	std::lock_guard<std::mutex> guard(arenas_mtx);
+
+	for (auto &b : arenas) {
+		if (b.node != node)
+			continue;
+
+		ma = b.manager->alloc(b.manager, len, alignment);
+		if (ma)
+			return ma;
+	}
+
+	a.node = node;
+	a.length = arena_size;
+	a.address = memory_hugepage_map(&a.length, &a.pagesz, arena_gigantic);
+	if (!a.address)
+		return nullptr;
+
+	if (node >= 0)
+		memory_hugepage_bind(a.address, a.length, node);
+
+	a.manager = memory_managed(a.address, a.length);
+	if (!a.manager) {
+		munmap(a.address, a.length);
+		return nullptr;
+	}
+
+	arenas.push_back(a);
+
+	debug(LOG_MEM | 2, "Mapped hugepage arena #%zu: length=%#zx, pagesize=%#zx, node=%d", arenas.size() - 1, a.length, a.pagesz, node);
+
+	return a.manager->alloc(a.manager, len, alignment);
+}
+
+struct memory_allocation * memory_hugepage_alloc_node(size_t len, size_t alignment, int node)
+{
+	struct memory_allocation *ma = (struct memory_allocation *) alloc(sizeof(struct memory_allocation));
+	if (!ma)
+		return nullptr;
+
+	ma->type = &memory_hugepage;
+
+	/* Small allocations share the pages of an arena instead of wasting a whole hugepage each */
+	if (arena_size > 0 && alignment <= hugepgsz &&
+	    memory_managed_size(len, alignment) <= arena_size / MEMORY_HUGEPAGE_ARENA_FRACTION) {
+		ma->parent = memory_hugepage_arena_alloc(len, alignment, node);
+		if (ma->parent) {
+			ma->address = ma->parent->address;
+			ma->length = len;
+			ma->alignment = alignment;
+
+			return ma;
 		}
 	}
 
+	size_t sz;
+
+	ma->length = len;
+	ma->address = memory_hugepage_map(&ma->length, &sz, false);
+	if (!ma->address) {
+		free(ma);
+		return nullptr;
+	}
+
+	ma->alignment = ALIGN(alignment, sz);
+
+	if (node >= 0)
+		memory_hugepage_bind(ma->address, ma->length, node);
+
 	return ma;
 }
 
+/** Allocate memory backed by hugepages with malloc() like interface */
+static struct memory_allocation * memory_hugepage_alloc(struct memory_type *m, size_t len, size_t alignment)
+{
+	return memory_hugepage_alloc_node(len, alignment, -1);
+}
+
 static int memory_hugepage_free(struct memory_type *m, struct memory_allocation *ma)
 {
 	int ret;
 
+	if (ma->parent) {
+		struct memory_type *mt = ma->parent->type;
+
+		ret = mt->free(mt, ma->parent);
+		if (ret)
+			return ret;
+
+		free(ma->parent);
+
+		return 0;
+	}
+
 	ret = munmap(ma->address, ma->length);
 	if (ret)
 		return ret;
@@ -142,6 +331,30 @@ static int memory_hugepage_free(struct memory_type *m, struct memory_allocation
 	return 0;
 }
 
+size_t memory_hugepage_arena_count()
+{
+	std::lock_guard<std::mutex> guard(arenas_mtx);
+
+	return arenas.size();
+}
+
+int memory_hugepage_arena_stats(size_t idx, struct memory_arena_stats *s)
+{
+	std::lock_guard<std::mutex> guard(arenas_mtx);
+
+	if (idx >= arenas.size())
+		return -1;
+
+	struct memory_arena *a = &arenas[idx];
+
+	s->address = a->address;
+	s->length = a->length;
+	s->pagesize = a->pagesz;
+	s->node = a->node;
+
+	return memory_managed_stats(a->manager, &s->managed);
+}
+
 struct memory_type memory_hugepage = {
 	.name = "mmap_hugepages",
 	.flags = (int) MemoryFlags::MMAP | (int) MemoryFlags::HUGEPAGE,
@@ -21,6 +21,7 @@
  *********************************************************************************/
 
 #include <cstdlib>
+#include <cstdint>
 #include <unistd.h>
 #include <cerrno>
 #include <strings.h>
@@ -30,140 +31,238 @@
 #include <sys/resource.h>
 #include <sys/types.h>
 
+#include <villas/config.h>
 #include <villas/log.h>
 #include <villas/memory.h>
 #include <villas/utils.hpp>
 
 using namespace villas::utils;
 
-static struct memory_allocation * memory_managed_alloc(struct memory_type *m, size_t len, size_t alignment)
+#define MEMORY_MANAGED_ALIGNMENT	16	/**< Alignment of all block descriptors and blocks */
+#define MEMORY_MANAGED_MAX_SHIFT	40	/**< Blocks must be smaller than 1 TiB */
+
+/* Each power of two is divided into four size classes.
+ * The first classes are 16, 32, 48, 64, 80, 96, 112, 128, 160, 192, ... bytes. */
+#define MEMORY_MANAGED_CLASSES		(3 + (MEMORY_MANAGED_MAX_SHIFT - 6) * 4)
+
+/* The heads of the free lists combine the offset of the first block with a tag to avoid the ABA problem */
+#define MEMORY_MANAGED_OFFSET_BITS	40
+#define MEMORY_MANAGED_OFFSET_MASK	((UINT64_C(1) << MEMORY_MANAGED_OFFSET_BITS) - 1)
+
+#define MEMORY_MANAGED_BLOCK_SIZE	ALIGN(sizeof(struct memory_block), MEMORY_MANAGED_ALIGNMENT)
+
+/** State of the allocator which is placed at the beginning of the managed region. */
+struct memory_managed {
+	std::atomic<uint64_t> free[MEMORY_MANAGED_CLASSES];	/**< Free lists of blocks per size class. */
+
+	std::atomic<size_t> top;	/**< Offset of the unused remainder of the region. */
+	size_t length;			/**< Length of the region starting at this struct. */
+
+	/* Statistics */
+	std::atomic<size_t> used;
+	std::atomic<size_t> requested;
+	std::atomic<size_t> cached;
+	std::atomic<size_t> allocs;
+	std::atomic<size_t> frees;
+};
+
+static struct memory_managed * memory_managed_header(void *ptr)
 {
-	/* Simple first-fit allocation */
-	struct memory_block *first = (struct memory_block *) m->_vd;
-	struct memory_block *block;
-
-	for (block = first; block != nullptr; block = block->next) {
-		if (block->used)
-			continue;
-
-		char* cptr = (char *) block + sizeof(struct memory_block);
-		size_t avail = block->length;
-		uintptr_t uptr = (uintptr_t) cptr;
-
-		/* Check alignment first; leave a gap at start of block to assure
-		 * alignment if necessary */
-		uintptr_t rem = uptr % alignment;
-		uintptr_t gap = 0;
-		if (rem != 0) {
-			gap = alignment - rem;
-			if (gap > avail)
-				continue; /* Next aligned address isn't in this block anymore */
-
-			cptr += gap;
-			avail -= gap;
-		}
+	return (struct memory_managed *) ALIGN((char *) ptr + sizeof(struct memory_type), CACHELINE_SIZE);
+}
 
-		if (avail >= len) {
-			if (gap > sizeof(struct memory_block)) {
-				/* The alignment gap is big enough to fit another block.
-				 * The original block descriptor is already at the correct
-				 * position, so we just change its len and create a new block
-				 * descriptor for the actual block we're handling. */
-				block->length = gap - sizeof(struct memory_block);
-				struct memory_block *newblock = (struct memory_block *) (cptr - sizeof(struct memory_block));
-				newblock->prev = block;
-				newblock->next = block->next;
-				block->next = newblock;
-				newblock->used = false;
-				newblock->length = len;
-				block = newblock;
-			}
-			else {
-				/* The gap is too small to fit another block descriptor, so we
-				 * must account for the gap length in the block length. */
-				block->length = len + gap;
-			}
-
-			if (avail > len + sizeof(struct memory_block)) {
-				/* Imperfect fit, so create another block for the remaining part */
-				struct memory_block *newblock = (struct memory_block *) (cptr + len);
-				newblock->prev = block;
-				newblock->next = block->next;
-				block->next = newblock;
-
-				if (newblock->next)
-					newblock->next->prev = newblock;
-
-				newblock->used = false;
-				newblock->length = avail - len - sizeof(struct memory_block);
-			}
-			else {
-				/* If this block was larger than the requested length, but only
-				 * by less than sizeof(struct memory_block), we may have wasted
-				 * memory by previous assignments to block->length. */
-				block->length = avail;
-			}
-
-			block->used = true;
-
-			struct memory_allocation *ma = (struct memory_allocation *) alloc(sizeof(struct memory_allocation));
-			if (!ma)
-				return nullptr;
-
-			ma->address = cptr;
-			ma->type = m;
-			ma->alignment = alignment;
-			ma->length = len;
-			ma->managed.block = block;
-
-			return ma;
-		}
+static struct memory_block * memory_managed_block(struct memory_managed *mm, size_t off)
+{
+	return (struct memory_block *) ((char *) mm + off);
+}
+
+/** Length of the blocks in size class \p cls. */
+static size_t memory_managed_class_size(unsigned cls)
+{
+	if (cls < 3)
+		return (cls + 1) * MEMORY_MANAGED_ALIGNMENT;
+
+	unsigned shift = 6 + (cls - 3) / 4;
+	unsigned sub = (cls - 3) % 4;
+
+	return ((size_t) 1 << shift) + sub * ((size_t) 1 << (shift - 2));
+}
+
+/** Size class to which a free block of \p len bytes belongs. */
+static unsigned memory_managed_class_floor(size_t len)
+{
+	if (len < 64)
+		return len / MEMORY_MANAGED_ALIGNMENT - 1;
+
+	unsigned shift = 63 - __builtin_clzll(len);
+	unsigned sub = (len - ((size_t) 1 << shift)) >> (shift - 2);
+
+	return 3 + (shift - 6) * 4 + sub;
+}
+
+/** Smallest size class whose blocks can hold \p len bytes. */
+static unsigned memory_managed_class_ceil(size_t len)
+{
+	unsigned cls = memory_managed_class_floor(len);
+
+	return memory_managed_class_size(cls) < len ? cls + 1 : cls;
+}
+
+/** Length of the block which is used for an allocation of \p len bytes.
+ *
+ * Requests are rounded up to the size of their class. So every block can be
+ * reused for all requests of the same class. This wastes at most 25%.
+ */
+static size_t memory_managed_block_length(size_t len, size_t alignment)
+{
+	/* Reserve space to align the start of the allocation */
+	if (alignment > MEMORY_MANAGED_ALIGNMENT)
+		len += alignment - MEMORY_MANAGED_ALIGNMENT;
+
+	len = ALIGN(MAX(len, 1), MEMORY_MANAGED_ALIGNMENT);
+
+	return memory_managed_class_size(memory_managed_class_ceil(len));
+}
+
+static struct memory_block * memory_managed_pop(struct memory_managed *mm, unsigned cls)
+{
+	uint64_t head = mm->free[cls].load(std::memory_order_acquire);
+
+	while (head & MEMORY_MANAGED_OFFSET_MASK) {
+		struct memory_block *b = memory_managed_block(mm, head & MEMORY_MANAGED_OFFSET_MASK);
+		uint64_t tag = (head >> MEMORY_MANAGED_OFFSET_BITS) + 1;
+		uint64_t next = b->next.load(std::memory_order_relaxed) | (tag << MEMORY_MANAGED_OFFSET_BITS);
+
+		if (mm->free[cls].compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+			return b;
 	}
 
-	/* No suitable block found */
 	return nullptr;
 }
 
-static int memory_managed_free(struct memory_type *m, struct memory_allocation *ma)
+static void memory_managed_push(struct memory_managed *mm, unsigned cls, struct memory_block *b)
 {
-	struct memory_block *block = ma->managed.block;
+	uint64_t off = (char *) b - (char *) mm;
+	uint64_t head = mm->free[cls].load(std::memory_order_relaxed);
+	uint64_t next;
 
-	/* Try to merge it with neighbouring free blocks */
-	if (block->prev && !block->prev->used &&
-	    block->next && !block->next->used) {
-		/* Special case first: both previous and next block are unused */
-		block->prev->length += block->length + block->next->length + 2 * sizeof(struct memory_block);
-		block->prev->next = block->next->next;
-		if (block->next->next)
-			block->next->next->prev = block->prev;
-	}
-	else if (block->prev && !block->prev->used) {
-		block->prev->length += block->length + sizeof(struct memory_block);
-		block->prev->next = block->next;
-		if (block->next)
-			block->next->prev = block->prev;
-	}
-	else if (block->next && !block->next->used) {
-		block->length += block->next->length + sizeof(struct memory_block);
-		block->next = block->next->next;
-		if (block->next)
-			block->next->prev = block;
-	}
+	do {
+		b->next.store(head & MEMORY_MANAGED_OFFSET_MASK, std::memory_order_relaxed);
+
+		next = off | (((head >> MEMORY_MANAGED_OFFSET_BITS) + 1) << MEMORY_MANAGED_OFFSET_BITS);
+	} while (!mm->free[cls].compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+/** Take a new block from the unused remainder of the region. */
+static struct memory_block * memory_managed_carve(struct memory_managed *mm, size_t len)
+{
+	size_t top = mm->top.load(std::memory_order_relaxed);
+	size_t end;
+
+	do {
+		end = top + MEMORY_MANAGED_BLOCK_SIZE + len;
+		if (end > mm->length)
+			return nullptr;
+	} while (!mm->top.compare_exchange_weak(top, end, std::memory_order_relaxed));
+
+	struct memory_block *b = memory_managed_block(mm, top);
+
+	b->next = 0;
+	b->length = len;
+
+	return b;
+}
+
+static struct memory_allocation * memory_managed_alloc(struct memory_type *m, size_t len, size_t alignment)
+{
+	struct memory_managed *mm = (struct memory_managed *) m->_vd;
+	struct memory_block *b;
+
+	size_t exact = len + (alignment > MEMORY_MANAGED_ALIGNMENT ? alignment - MEMORY_MANAGED_ALIGNMENT : 0);
+	size_t need = memory_managed_block_length(len, alignment);
+
+	exact = ALIGN(MAX(exact, 1), MEMORY_MANAGED_ALIGNMENT);
+
+	if (need >= ((size_t) 1 << MEMORY_MANAGED_MAX_SHIFT))
+		return nullptr;
+
+	/* All blocks in this class are large enough */
+	unsigned cls = memory_managed_class_ceil(need);
+
+	b = memory_managed_pop(mm, cls);
+	if (b)
+		mm->cached -= MEMORY_MANAGED_BLOCK_SIZE + b->length;
 	else {
-		/* no neighbouring free block, so just mark it as free */
-		block->used = false;
+		b = memory_managed_carve(mm, need);
+
+		/* The rounded block does not fit anymore */
+		if (!b && exact < need)
+			b = memory_managed_carve(mm, exact);
+
+		/* Use a block of a larger class as a last resort */
+		for (unsigned i = cls + 1; !b && i < MEMORY_MANAGED_CLASSES; i++) {
+			b = memory_managed_pop(mm, i);
+			if (b)
+				mm->cached -= MEMORY_MANAGED_BLOCK_SIZE + b->length;
+		}
+
+		if (!b)
+			return nullptr;
+	}
+
+	struct memory_allocation *ma = (struct memory_allocation *) alloc(sizeof(struct memory_allocation));
+	if (!ma) {
+		/* Keep the block for later allocations */
+		mm->cached += MEMORY_MANAGED_BLOCK_SIZE + b->length;
+		memory_managed_push(mm, memory_managed_class_floor(b->length), b);
+
+		return nullptr;
 	}
 
+	b->used = true;
+
+	ma->address = (void *) ALIGN((char *) b + MEMORY_MANAGED_BLOCK_SIZE, alignment);
+	ma->type = m;
+	ma->alignment = alignment;
+	ma->length = len;
+	ma->managed.block = b;
+
+	mm->used += MEMORY_MANAGED_BLOCK_SIZE + b->length;
+	mm->requested += len;
+	mm->allocs++;
+
+	return ma;
+}
+
+static int memory_managed_free(struct memory_type *m, struct memory_allocation *ma)
+{
+	struct memory_managed *mm = (struct memory_managed *) m->_vd;
+	struct memory_block *b = ma->managed.block;
+
+	if (!b->used)
+		return -1;
+
+	b->used = false;
+
+	mm->used -= MEMORY_MANAGED_BLOCK_SIZE + b->length;
+	mm->requested -= ma->length;
+	mm->cached += MEMORY_MANAGED_BLOCK_SIZE + b->length;
+	mm->frees++;
+
+	memory_managed_push(mm, memory_managed_class_floor(b->length), b);
+
 	return 0;
 }
 
 struct memory_type * memory_managed(void *ptr, size_t len)
 {
 	struct memory_type *mt = (struct memory_type *) ptr;
-	struct memory_block *mb;
-	char *cptr = (char *) ptr;
+	struct memory_managed *mm = memory_managed_header(ptr);
+
+	size_t off = (char *) mm - (char *) ptr;
+	size_t first = ALIGN(sizeof(struct memory_managed), MEMORY_MANAGED_ALIGNMENT);
 
-	if (len < sizeof(struct memory_type) + sizeof(struct memory_block)) {
+	if (len < off + first + MEMORY_MANAGED_BLOCK_SIZE) {
 		info("memory_managed: passed region too small");
 		return nullptr;
 	}
@@ -174,20 +273,74 @@ struct memory_type * memory_managed(void *ptr, size_t len)
 	mt->alloc = memory_managed_alloc;
 	mt->free  = memory_managed_free;
 	mt->alignment = 1;
+	mt->_vd = (void *) mm;
 
-	cptr += ALIGN(sizeof(struct memory_type), sizeof(void *));
+	/* Initialize allocator */
+	for (unsigned i = 0; i < MEMORY_MANAGED_CLASSES; i++)
+		mm->free[i] = 0;
 
-	/* Initialize first free memory block */
-	mb = (struct memory_block *) cptr;
-	mb->prev = nullptr;
-	mb->next = nullptr;
-	mb->used = false;
+	mm->top = first;
+	mm->length = len - off;
 
-	cptr += ALIGN(sizeof(struct memory_block), sizeof(void *));
+	mm->used = 0;
+	mm->requested = 0;
+	mm->cached = 0;
+	mm->allocs = 0;
+	mm->frees = 0;
 
-	mb->length = len - (cptr - (char *) ptr);
+	return mt;
+}
 
-	mt->_vd = (void *) mb;
+int memory_managed_stats(struct memory_type *m, struct memory_managed_stats *s)
+{
+	if (m->alloc != memory_managed_alloc)
+		return -1;
 
-	return mt;
+	struct memory_managed *mm = (struct memory_managed *) m->_vd;
+	size_t top = mm->top;
+
+	s->total = mm->length - ALIGN(sizeof(struct memory_managed), MEMORY_MANAGED_ALIGNMENT);
+	s->used = mm->used;
+	s->requested = mm->requested;
+	s->cached = mm->cached;
+	s->remaining = mm->length - top;
+	s->allocs = mm->allocs;
+	s->frees = mm->frees;
+
+	s->largest = s->remaining > MEMORY_MANAGED_BLOCK_SIZE
+		? (s->remaining - MEMORY_MANAGED_BLOCK_SIZE) & ~(MEMORY_MANAGED_ALIGNMENT - 1)
+		: 0;
+
+	/* The first block of each free list is a lower bound for the length of its class */
+	for (unsigned i = 0; i < MEMORY_MANAGED_CLASSES; i++) {
+		uint64_t head = mm->free[i].load(std::memory_order_acquire);
+
+		if (head & MEMORY_MANAGED_OFFSET_MASK && memory_managed_class_size(i) > s->largest)
+			s->largest = memory_managed_class_size(i);
+	}
+
+	size_t consumed = s->used + s->cached;
+
+	s->fragmentation = consumed > 0
+		? 1.0 - (double) s->requested / consumed
+		: 0;
+
+	return 0;
+}
+
+size_t memory_managed_overhead()
+{
+	return sizeof(struct memory_type) + CACHELINE_SIZE + ALIGN(sizeof(struct memory_managed), MEMORY_MANAGED_ALIGNMENT);
+}
+
+size_t memory_managed_size(size_t len, size_t alignment)
+{
+	return MEMORY_MANAGED_BLOCK_SIZE + memory_managed_block_length(len, alignment);
+}
+
+void * memory_managed_first(void *ptr)
+{
+	struct memory_managed *mm = memory_managed_header(ptr);
+
+	return (char *) mm + ALIGN(sizeof(struct memory_managed), MEMORY_MANAGED_ALIGNMENT) + MEMORY_MANAGED_BLOCK_SIZE;
 }
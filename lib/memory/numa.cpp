@@ -0,0 +1,113 @@
+/** NUMA-local memory allocator.
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#include <villas/log.h>
+#include <villas/utils.hpp>
+#include <villas/memory.h>
+
+using namespace villas::utils;
+
+#define MEMORY_NUMA_MAX_NODES	64
+
+struct memory_numa {
+	int node;
+	struct memory_type *parent;
+};
+
+static struct memory_allocation * memory_numa_alloc(struct memory_type *m, size_t len, size_t alignment)
+{
+	struct memory_numa *mn = (struct memory_numa *) m->_vd;
+
+	struct memory_allocation *ma = (struct memory_allocation *) alloc(sizeof(struct memory_allocation));
+	if (!ma)
+		return nullptr;
+
+	/* Arenas are bound as a whole. So small allocations only share pages with allocations of the same node */
+	ma->parent = memory_hugepage_alloc_node(len, alignment, mn->node);
+	if (!ma->parent) {
+		free(ma);
+		return nullptr;
+	}
+
+	ma->type = m;
+	ma->address = ma->parent->address;
+	ma->length = ma->parent->length;
+	ma->alignment = ma->parent->alignment;
+
+	return ma;
+}
+
+static int memory_numa_free(struct memory_type *m, struct memory_allocation *ma)
+{
+	int ret;
+	struct memory_numa *mn = (struct memory_numa *) m->_vd;
+
+	ret = mn->parent->free(mn->parent, ma->parent);
+	if (ret)
+		return ret;
+
+	free(ma->parent);
+
+	return 0;
+}
+
+struct memory_type * memory_numa(int node)
+{
+	static struct memory_type types[MEMORY_NUMA_MAX_NODES];
+	static struct memory_numa vds[MEMORY_NUMA_MAX_NODES];
+
+	if (node < 0 || node >= MEMORY_NUMA_MAX_NODES)
+		return nullptr;
+
+#ifdef __linux__
+	char path[128];
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", node);
+
+	if (access(path, F_OK))
+		return nullptr;
+#else
+	return nullptr;
+#endif /* __linux__ */
+
+	struct memory_type *mt = &types[node];
+	struct memory_numa *mn = &vds[node];
+
+	if (!mt->name) {
+		mn->node = node;
+		mn->parent = &memory_hugepage;
+
+		mt->name = "numa";
+		mt->flags = memory_hugepage.flags;
+		mt->alignment = memory_hugepage.alignment;
+		mt->alloc = memory_numa_alloc;
+		mt->free = memory_numa_free;
+		mt->_vd = mn;
+	}
+
+	return mt;
+}
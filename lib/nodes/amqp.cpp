@@ -21,6 +21,7 @@
  *********************************************************************************/
 
 #include <cstring>
+#include <cinttypes>
 
 #include <amqp_ssl_socket.h>
 #include <amqp_tcp_socket.h>
@@ -113,6 +114,77 @@ static int amqp_close(amqp_connection_state_t conn)
 	return 0;
 }
 
+/** Mark a delivery tag, or all tags up to it, as confirmed by the broker. */
+static void amqp_confirm(struct amqp *a, uint64_t tag, bool multiple, bool ack)
+{
+	uint64_t first = multiple ? a->confirm.lowest : MAX(tag, a->confirm.lowest);
+
+	for (uint64_t t = first; t <= tag && t < a->confirm.next; t++) {
+		char *pending = &a->confirm.pending[t % a->confirm.window];
+		if (!*pending)
+			continue;
+
+		*pending = 0;
+
+		if (ack)
+			a->acked++;
+		else
+			a->nacked++;
+	}
+
+	/* Advance the window */
+	while (a->confirm.lowest < a->confirm.next && !a->confirm.pending[a->confirm.lowest % a->confirm.window])
+		a->confirm.lowest++;
+}
+
+/** Process publisher confirms until at most \p outstanding messages are unconfirmed.
+ *
+ * @param timeout The maximum time to wait for a single frame or nullptr to block.
+ */
+static int amqp_process_confirms(struct node *n, uint64_t outstanding, struct timeval *timeout)
+{
+	int ret;
+	struct amqp *a = (struct amqp *) n->_vd;
+	amqp_frame_t frame;
+
+	uint64_t nacked = a->nacked;
+
+	while (a->confirm.next - a->confirm.lowest > outstanding) {
+		ret = amqp_simple_wait_frame_noblock(a->producer, &frame, timeout);
+		if (ret != AMQP_STATUS_OK)
+			return -1;
+
+		if (frame.frame_type != AMQP_FRAME_METHOD)
+			continue;
+
+		switch (frame.payload.method.id) {
+			case AMQP_BASIC_ACK_METHOD: {
+				auto *ack = (amqp_basic_ack_t *) frame.payload.method.decoded;
+				amqp_confirm(a, ack->delivery_tag, ack->multiple, true);
+				break;
+			}
+
+			case AMQP_BASIC_NACK_METHOD: {
+				auto *nack = (amqp_basic_nack_t *) frame.payload.method.decoded;
+				amqp_confirm(a, nack->delivery_tag, nack->multiple, false);
+				break;
+			}
+
+			case AMQP_CHANNEL_CLOSE_METHOD:
+			case AMQP_CONNECTION_CLOSE_METHOD:
+				warning("Broker closed the channel of node %s", node_name(n));
+				return -1;
+		}
+	}
+
+	if (a->nacked != nacked)
+		warning("Broker rejected %ju messages of node %s", (uintmax_t) (a->nacked - nacked), node_name(n));
+
+	amqp_maybe_release_buffers(a->producer);
+
+	return 0;
+}
+
 int amqp_parse(struct node *n, json_t *json)
 {
 	int ret;
@@ -129,13 +201,16 @@ int amqp_parse(struct node *n, json_t *json)
 
 	json_error_t err;
 
+	a->prefetch = 0;
+	a->confirm.window = 0;
+
 	json_t *json_ssl = nullptr;
 
 	/* Default values */
 	amqp_default_ssl_info(&a->ssl_info);
 	amqp_default_connection_info(&a->connection_info);
 
-	ret = json_unpack_ex(json, &err, 0, "{ s?: s, s?: s, s?: s, s?: s, s?: s, s?: i, s: s, s: s, s?: s, s?: o }",
+	ret = json_unpack_ex(json, &err, 0, "{ s?: s, s?: s, s?: s, s?: s, s?: s, s?: i, s: s, s: s, s?: s, s?: o, s?: i, s?: i }",
 		"uri", &uri,
 		"host", &host,
 		"vhost", &vhost,
@@ -145,11 +220,19 @@ int amqp_parse(struct node *n, json_t *json)
 		"exchange", &exchange,
 		"routing_key", &routing_key,
 		"format", &format,
-		"ssl", &json_ssl
+		"ssl", &json_ssl,
+		"prefetch", &a->prefetch,
+		"confirm_window", &a->confirm.window
 	);
 	if (ret)
 		jerror(&err, "Failed to parse configuration of node %s", node_name(n));
 
+	if (a->prefetch < 0 || a->prefetch > UINT16_MAX)
+		error("Setting 'prefetch' of node %s must be in the range [0, %d]", node_name(n), UINT16_MAX);
+
+	if (a->confirm.window < 0)
+		error("Setting 'confirm_window' of node %s must be a positive number", node_name(n));
+
 	a->exchange = amqp_bytes_strdup(exchange);
 	a->routing_key = amqp_bytes_strdup(routing_key);
 
@@ -213,6 +296,12 @@ char * amqp_print(struct node *n)
 		(char *) a->routing_key.bytes
 	);
 
+	if (a->prefetch > 0)
+		strcatf(&buf, ", prefetch=%d", a->prefetch);
+
+	if (a->confirm.window > 0)
+		strcatf(&buf, ", confirm_window=%d", a->confirm.window);
+
 	if (a->connection_info.ssl) {
 		strcatf(&buf, ", ssl_info.verify_peer=%s, ssl_info.verify_hostname=%s",
 			a->ssl_info.verify_peer ? "true" : "false",
@@ -261,10 +350,28 @@ int amqp_start(struct node *n)
 
 	/* Declare exchange */
 	amqp_exchange_declare(a->producer, 1, a->exchange, amqp_cstring_bytes("direct"), 0, 0, 0, 0, amqp_empty_table);
-	rep = amqp_get_rpc_reply(a->consumer);
+	rep = amqp_get_rpc_reply(a->producer);
 	if (rep.reply_type != AMQP_RESPONSE_NORMAL)
 		return -1;
 
+	/* Enable publisher confirms */
+	if (a->confirm.window > 0) {
+		amqp_confirm_select(a->producer, 1);
+		rep = amqp_get_rpc_reply(a->producer);
+		if (rep.reply_type != AMQP_RESPONSE_NORMAL)
+			return -1;
+
+		a->confirm.pending = (char *) alloc(a->confirm.window);
+		a->confirm.next = 1;
+		a->confirm.lowest = 1;
+	}
+
+	a->published = 0;
+	a->acked = 0;
+	a->nacked = 0;
+	a->received = 0;
+	a->msg_samples = 1;
+
 	/* Declare private queue */
 	r = amqp_queue_declare(a->consumer, 1, amqp_empty_bytes, 0, 0, 0, 1, amqp_empty_table);
 	rep = amqp_get_rpc_reply(a->consumer);
@@ -281,8 +388,16 @@ int amqp_start(struct node *n)
 	if (rep.reply_type != AMQP_RESPONSE_NORMAL)
 		return -1;
 
-	/* Start consumer */
-	amqp_basic_consume(a->consumer, 1, queue, amqp_empty_bytes, 0, 1, 0, amqp_empty_table);
+	/* Limit the number of unacknowledged deliveries */
+	if (a->prefetch > 0) {
+		amqp_basic_qos(a->consumer, 1, 0, a->prefetch, 0);
+		rep = amqp_get_rpc_reply(a->consumer);
+		if (rep.reply_type != AMQP_RESPONSE_NORMAL)
+			return -1;
+	}
+
+	/* Start consumer: deliveries are only acknowledged if a prefetch count is set */
+	amqp_basic_consume(a->consumer, 1, queue, amqp_empty_bytes, 0, a->prefetch == 0, 0, amqp_empty_table);
 	rep = amqp_get_rpc_reply(a->consumer);
 	if (rep.reply_type != AMQP_RESPONSE_NORMAL)
 		return -1;
@@ -297,6 +412,20 @@ int amqp_stop(struct node *n)
 	int ret;
 	struct amqp *a = (struct amqp *) n->_vd;
 
+	if (a->confirm.window > 0) {
+		struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+
+		/* Wait for the outstanding confirms */
+		ret = amqp_process_confirms(n, 0, &timeout);
+		if (ret)
+			warning("Missing confirms for %ju messages of node %s", (uintmax_t) (a->confirm.next - a->confirm.lowest), node_name(n));
+
+		free(a->confirm.pending);
+	}
+
+	info("AMQP node %s published %ju messages (acked=%ju, nacked=%ju) and received %ju messages", node_name(n),
+		(uintmax_t) a->published, (uintmax_t) a->acked, (uintmax_t) a->nacked, (uintmax_t) a->received);
+
 	ret = amqp_close(a->consumer);
 	if (ret)
 		return ret;
@@ -319,15 +448,49 @@ int amqp_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *rel
 	amqp_envelope_t env;
 	amqp_rpc_reply_t rep;
 
-	rep = amqp_consume_message(a->consumer, &env, nullptr, 0);
-	if (rep.reply_type != AMQP_RESPONSE_NORMAL)
-		return -1;
+	unsigned msgs = 0, received = 0;
+	uint64_t tag = 0;
+	struct timeval zero = { .tv_sec = 0, .tv_usec = 0 };
+
+	/* Wait for the first message and drain all which are available without blocking.
+	 * We stop before a message might not fit into the remaining samples, as its
+	 * excess samples would be lost although the message gets acknowledged. */
+	while (received < cnt) {
+		if (msgs > 0 && cnt - received < a->msg_samples)
+			break;
 
-	ret = io_sscan(&a->io, static_cast<char *>(env.message.body.bytes), env.message.body.len, nullptr, smps, cnt);
+		rep = amqp_consume_message(a->consumer, &env, msgs > 0 ? &zero : nullptr, 0);
+		if (rep.reply_type != AMQP_RESPONSE_NORMAL) {
+			if (msgs > 0)
+				break;
 
-	amqp_destroy_envelope(&env);
+			return -1;
+		}
 
-	return ret;
+		ret = io_sscan(&a->io, static_cast<char *>(env.message.body.bytes), env.message.body.len, nullptr, smps + received, cnt - received);
+		if (ret > 0) {
+			received += ret;
+
+			if ((unsigned) ret > a->msg_samples)
+				a->msg_samples = ret;
+		}
+
+		tag = env.delivery_tag;
+		msgs++;
+
+		amqp_destroy_envelope(&env);
+	}
+
+	a->received += msgs;
+
+	/* Acknowledge all messages of this batch at once */
+	if (a->prefetch > 0 && msgs > 0) {
+		ret = amqp_basic_ack(a->consumer, 1, tag, 1);
+		if (ret != AMQP_STATUS_OK)
+			warning("Failed to acknowledge messages of node %s: %s", node_name(n), amqp_error_string2(ret));
+	}
+
+	return received;
 }
 
 int amqp_write(struct node *n, struct sample *smps[], unsigned cnt, unsigned *release)
@@ -346,6 +509,13 @@ int amqp_write(struct node *n, struct sample *smps[], unsigned cnt, unsigned *re
 		.bytes = data
 	};
 
+	/* Block until there is room in the confirm window */
+	if (a->confirm.window > 0) {
+		ret = amqp_process_confirms(n, a->confirm.window - 1, nullptr);
+		if (ret)
+			return -1;
+	}
+
 	/* Send message */
 	ret = amqp_basic_publish(a->producer, 1,
 		a->exchange,
@@ -355,6 +525,11 @@ int amqp_write(struct node *n, struct sample *smps[], unsigned cnt, unsigned *re
 	if (ret != AMQP_STATUS_OK)
 		return -1;
 
+	a->published++;
+
+	if (a->confirm.window > 0)
+		a->confirm.pending[a->confirm.next++ % a->confirm.window] = 1;
+
 	return cnt;
 }
 
@@ -33,6 +33,7 @@
 #include <villas/queue.h>
 #include <villas/plugin.h>
 #include <villas/io.h>
+#include <villas/memory.h>
 
 using namespace villas::utils;
 
@@ -49,6 +50,61 @@ static char * file_format_name(const char *format, struct timespec *ts)
 	return buf;
 }
 
+static int file_open_reader(struct node *n)
+{
+	int ret;
+	struct file *f = (struct file *) n->_vd;
+	struct stat sb;
+
+	/* The recording might be created later by a writer */
+	ret = stat(f->uri, &sb);
+	if (ret || sb.st_size == 0)
+		return 0;
+
+	ret = recording_open(&f->reader, f->uri, RecordingMode::READ);
+	if (ret)
+		serror("Failed to open recording '%s' of node %s", f->uri, node_name(n));
+
+	return 0;
+}
+
+static int file_scan(struct node *n, struct sample *smps[], unsigned cnt)
+{
+	struct file *f = (struct file *) n->_vd;
+	int ret;
+
+	if (!f->recording)
+		return io_scan(&f->io, smps, cnt);
+
+	ret = recording_read(&f->reader, smps, cnt);
+
+	for (int i = 0; i < ret; i++)
+		smps[i]->signals = &n->in.signals;
+
+	return ret;
+}
+
+static int file_eof(struct node *n)
+{
+	struct file *f = (struct file *) n->_vd;
+
+	return f->recording
+		? recording_eof(&f->reader)
+		: io_eof(&f->io);
+}
+
+static void file_rewind(struct node *n)
+{
+	struct file *f = (struct file *) n->_vd;
+
+	if (!f->recording)
+		io_rewind(&f->io);
+	else if (f->start.tv_sec || f->start.tv_nsec)
+		recording_seek(&f->reader, &f->start);
+	else
+		recording_rewind(&f->reader);
+}
+
 static struct timespec file_calc_offset(const struct timespec *first, const struct timespec *epoch, enum file::EpochMode mode)
 {
 	/* Get current time */
@@ -88,6 +144,10 @@ int file_parse(struct node *n, json_t *cfg)
 	const char *eof = nullptr;
 	const char *epoch = nullptr;
 	double epoch_flt = 0;
+	double start_flt = 0;
+	int chunk_samples = DEFAULT_RECORDING_CHUNK_SAMPLES;
+	const char *overflow = nullptr;
+	const char *compression = nullptr;
 
 	/* Default values */
 	f->rate = 0;
@@ -96,29 +156,63 @@ int file_parse(struct node *n, json_t *cfg)
 	f->flush = 0;
 	f->buffer_size_in = 0;
 	f->buffer_size_out = 0;
-
-	ret = json_unpack_ex(cfg, &err, 0, "{ s: s, s?: s, s?: { s?: s, s?: F, s?: s, s?: F, s?: i }, s?: { s?: b, s?: i } }",
+	f->async.enabled = 0;
+	f->async.queuelen = DEFAULT_QUEUE_LENGTH;
+	f->async.overflow = file::OverflowPolicy::DROP;
+	f->async.queue.queue.state = State::DESTROYED;
+	f->async.pool.state = State::DESTROYED;
+	f->async.pool.queue.state = State::DESTROYED;
+	f->compression.type = CompressionType::AUTO;
+	f->compression.level = 0;
+	f->compression.threads = 0;
+
+	ret = json_unpack_ex(cfg, &err, 0, "{ s: s, s?: s, s?: s, s?: { s?: s, s?: F, s?: s, s?: F, s?: F, s?: i }, s?: { s?: b, s?: i, s?: i, s?: b, s?: i, s?: s, s?: i, s?: i } }",
 		"uri", &uri_tmpl,
 		"format", &format,
+		"compression", &compression,
 		"in",
 			"eof", &eof,
 			"rate", &f->rate,
 			"epoch_mode", &epoch,
 			"epoch", &epoch_flt,
+			"start", &start_flt,
 			"buffer_size", &f->buffer_size_in,
 		"out",
 			"flush", &f->flush,
-			"buffer_size", &f->buffer_size_out
+			"buffer_size", &f->buffer_size_out,
+			"chunk_samples", &chunk_samples,
+			"async", &f->async.enabled,
+			"queuelen", &f->async.queuelen,
+			"overflow", &overflow,
+			"compression_level", &f->compression.level,
+			"compression_threads", &f->compression.threads
 	);
 	if (ret)
 		jerror(&err, "Failed to parse configuration of node %s", node_name(n));
 
 	f->epoch = time_from_double(epoch_flt);
+	f->start = time_from_double(start_flt);
 	f->uri_tmpl = uri_tmpl ? strdup(uri_tmpl) : nullptr;
 
-	f->format = format_type_lookup(format);
-	if (!f->format)
-		error("Invalid format '%s' for node %s", format, node_name(n));
+	/* Recordings are mapped directly and therefore not handled by a format_type */
+	if (!strcmp(format, "villas.recording")) {
+		f->recording = 1;
+		f->format = nullptr;
+
+		if (chunk_samples <= 0)
+			error("Setting 'chunk_samples' of node %s must be positive", node_name(n));
+
+		f->chunk_samples = chunk_samples;
+	}
+	else {
+		f->recording = 0;
+		f->format = format_type_lookup(format);
+		if (!f->format)
+			error("Invalid format '%s' for node %s", format, node_name(n));
+
+		if (start_flt)
+			error("Setting 'start' of node %s requires format 'villas.recording'", node_name(n));
+	}
 
 	if (eof) {
 		if      (!strcmp(eof, "exit") || !strcmp(eof, "stop"))
@@ -131,6 +225,27 @@ int file_parse(struct node *n, json_t *cfg)
 			error("Invalid mode '%s' for 'eof' setting of node %s", eof, node_name(n));
 	}
 
+	if (compression) {
+		ret = compression_parse(compression, &f->compression.type);
+		if (ret)
+			error("Unknown or unsupported compression '%s' for node %s", compression, node_name(n));
+
+		if (f->recording && f->compression.type != CompressionType::NONE && f->compression.type != CompressionType::AUTO)
+			error("Recordings of node %s can not be compressed", node_name(n));
+	}
+
+	if (overflow) {
+		if      (!strcmp(overflow, "drop"))
+			f->async.overflow = file::OverflowPolicy::DROP;
+		else if (!strcmp(overflow, "block"))
+			f->async.overflow = file::OverflowPolicy::BLOCK;
+		else
+			error("Invalid value '%s' for setting 'overflow' of node %s", overflow, node_name(n));
+	}
+
+	if (f->async.queuelen <= 0)
+		error("Setting 'queuelen' of node %s must be positive", node_name(n));
+
 	if (epoch) {
 		if     (!strcmp(epoch, "direct"))
 			f->epoch_mode = file::EpochMode::DIRECT;
@@ -205,7 +320,7 @@ char * file_print(struct node *n)
 
 	strcatf(&buf, "uri=%s, format=%s, flush=%s, eof=%s, epoch=%s, epoch=%.2f",
 		f->uri ? f->uri : f->uri_tmpl,
-		format_type_name(f->format),
+		f->recording ? "villas.recording" : format_type_name(f->format),
 		f->flush ? "yes" : "no",
 		eof_str,
 		epoch_str,
@@ -215,6 +330,31 @@ char * file_print(struct node *n)
 	if (f->rate)
 		strcatf(&buf, ", rate=%.1f", f->rate);
 
+	if (f->start.tv_sec || f->start.tv_nsec)
+		strcatf(&buf, ", start=%.2f", time_to_double(&f->start));
+
+	if (!f->recording) {
+		enum CompressionType type = f->io.state == State::OPENED
+			? f->io.compression.type
+			: f->compression.type;
+
+		if (type != CompressionType::NONE)
+			strcatf(&buf, ", compression=%s", compression_name(type));
+	}
+
+	if (f->recording && f->reader.samples)
+		strcatf(&buf, ", chunks=%zu, samples=%zu", f->reader.chunks, f->reader.samples);
+
+	if (f->async.enabled)
+		strcatf(&buf, ", async=yes, queuelen=%d, overflow=%s, written=%" PRIu64 ", dropped=%" PRIu64 ", blocked=%" PRIu64 ", errors=%" PRIu64,
+			f->async.queuelen,
+			f->async.overflow == file::OverflowPolicy::DROP ? "drop" : "block",
+			f->async.written.load(),
+			f->async.dropped.load(),
+			f->async.blocked.load(),
+			f->async.errors.load()
+		);
+
 	if (f->first.tv_sec || f->first.tv_nsec)
 		strcatf(&buf, ", first=%.2f", time_to_double(&f->first));
 
@@ -235,6 +375,161 @@ char * file_print(struct node *n)
 	return buf;
 }
 
+/** Write samples to the file or recording from the calling thread. */
+static int file_write_sync(struct node *n, struct sample *smps[], unsigned cnt)
+{
+	int ret;
+	struct file *f = (struct file *) n->_vd;
+
+	if (f->recording) {
+		if (f->writer.fd < 0) {
+			ret = recording_open(&f->writer, f->uri, RecordingMode::WRITE, f->chunk_samples);
+			if (ret)
+				serror("Failed to open recording '%s' of node %s", f->uri, node_name(n));
+		}
+
+		ret = recording_write(&f->writer, smps, cnt);
+		if (ret < 0)
+			return ret;
+
+		if (f->flush) {
+			ret = recording_flush(&f->writer);
+			if (ret)
+				return ret;
+		}
+
+		return cnt;
+	}
+
+	return io_print(&f->io, smps, cnt);
+}
+
+static void * file_writer(void *ctx)
+{
+	int ret, cnt;
+	struct node *n = (struct node *) ctx;
+	struct file *f = (struct file *) n->_vd;
+	struct sample *smps[FILE_ASYNC_BATCH];
+
+	for (;;) {
+		cnt = queue_signalled_pull_many(&f->async.queue, (void **) smps, FILE_ASYNC_BATCH);
+		if (cnt < 0)
+			break;
+
+		/* A nullptr marks the end of the stream (see file_writer_stop()) */
+		int len = cnt;
+		for (int i = 0; i < cnt; i++) {
+			if (!smps[i]) {
+				len = i;
+				break;
+			}
+		}
+
+		if (len > 0) {
+			ret = file_write_sync(n, smps, len);
+			if (ret < 0) {
+				if (f->async.errors == 0)
+					warning("Failed to write samples to node %s: reason=%d", node_name(n), ret);
+
+				ret = 0;
+			}
+
+			f->async.written += ret;
+			f->async.errors += len - ret;
+
+			sample_decref_many(smps, len);
+		}
+
+		/* Wake up file_write() or file_writer_stop() which wait for room */
+		pthread_mutex_lock(&f->async.mutex);
+		pthread_cond_broadcast(&f->async.cv);
+		pthread_mutex_unlock(&f->async.mutex);
+
+		if (len < cnt) {
+			/* Samples which were queued concurrently to the stop */
+			sample_decref_many(&smps[len + 1], cnt - len - 1);
+			break;
+		}
+	}
+
+	return nullptr;
+}
+
+static int file_writer_start(struct node *n)
+{
+	int ret;
+	struct file *f = (struct file *) n->_vd;
+
+	f->async.written = 0;
+	f->async.dropped = 0;
+	f->async.blocked = 0;
+	f->async.errors = 0;
+
+	/* The paths do not know the number of values of the samples written to this node */
+	int len = MAX(vlist_length(&n->out.signals), DEFAULT_SAMPLE_LENGTH);
+
+	ret = pool_init(&f->async.pool, f->async.queuelen, SAMPLE_LENGTH(len), &memory_heap);
+	if (ret)
+		return ret;
+
+	ret = queue_signalled_init(&f->async.queue, f->async.queuelen, &memory_heap);
+	if (ret)
+		return ret;
+
+	pthread_mutex_init(&f->async.mutex, nullptr);
+	pthread_cond_init(&f->async.cv, nullptr);
+
+	ret = pthread_create(&f->async.thread, nullptr, file_writer, n);
+	if (ret)
+		error("Failed to create writer thread of node %s: %s", node_name(n), strerror(ret));
+
+	return 0;
+}
+
+static int file_writer_stop(struct node *n)
+{
+	int ret;
+	struct file *f = (struct file *) n->_vd;
+	struct sample *smps[FILE_ASYNC_BATCH];
+	void *end = nullptr;
+
+	/* Let the writer finish all samples which have been queued before */
+	pthread_mutex_lock(&f->async.mutex);
+
+	while (queue_signalled_push(&f->async.queue, end) == 0)
+		pthread_cond_wait(&f->async.cv, &f->async.mutex);
+
+	pthread_mutex_unlock(&f->async.mutex);
+
+	ret = pthread_join(f->async.thread, nullptr);
+	if (ret)
+		return ret;
+
+	/* Release samples which have been queued concurrently to the stop */
+	while ((ret = queue_pull_many(&f->async.queue.queue, (void **) smps, FILE_ASYNC_BATCH)) > 0) {
+		for (int i = 0; i < ret; i++) {
+			if (smps[i])
+				sample_decref(smps[i]);
+		}
+	}
+
+	info("Asynchronous writer of node %s: written=%" PRIu64 ", dropped=%" PRIu64 ", blocked=%" PRIu64 ", errors=%" PRIu64,
+		node_name(n), f->async.written.load(), f->async.dropped.load(), f->async.blocked.load(), f->async.errors.load());
+
+	ret = queue_signalled_close(&f->async.queue);
+	if (ret)
+		return ret;
+
+	ret = queue_signalled_destroy(&f->async.queue);
+	if (ret)
+		return ret;
+
+	pthread_cond_destroy(&f->async.cv);
+	pthread_mutex_destroy(&f->async.mutex);
+
+	return pool_destroy(&f->async.pool);
+}
+
 int file_start(struct node *n)
 {
 	struct file *f = (struct file *) n->_vd;
@@ -270,31 +565,52 @@ int file_start(struct node *n)
 		free(cpy);
 	}
 
-	/* Open file */
-	flags = (int) SampleFlags::HAS_ALL;
-	if (f->flush)
-		flags |= (int) IOFlags::FLUSH;
+	if (f->recording) {
+		if (!aislocal(f->uri))
+			error("Recordings of node %s must be local files", node_name(n));
 
-	ret = io_init(&f->io, f->format, &n->in.signals, flags);
-	if (ret)
-		return ret;
+		f->reader.fd = -1;
+		f->writer.fd = -1;
 
-	ret = io_check(&f->io);
-	if (ret)
-		return ret;
+		ret = file_open_reader(n);
+		if (ret)
+			return ret;
+	}
+	else {
+		/* Open file */
+		flags = (int) SampleFlags::HAS_ALL;
+		if (f->flush)
+			flags |= (int) IOFlags::FLUSH;
 
-	ret = io_open(&f->io, f->uri);
-	if (ret)
-		return ret;
+		ret = io_init(&f->io, f->format, &n->in.signals, flags);
+		if (ret)
+			return ret;
 
-	if (f->buffer_size_in) {
-		ret = setvbuf(f->io.in.stream.std, nullptr, _IOFBF, f->buffer_size_in);
+		ret = io_check(&f->io);
 		if (ret)
 			return ret;
+
+		f->io.compression = f->compression;
+
+		ret = io_open(&f->io, f->uri);
+		if (ret)
+			return ret;
+
+		if (f->buffer_size_in) {
+			ret = setvbuf(f->io.in.stream.std, nullptr, _IOFBF, f->buffer_size_in);
+			if (ret)
+				return ret;
+		}
+
+		if (f->buffer_size_out) {
+			ret = setvbuf(f->io.out.stream.std, nullptr, _IOFBF, f->buffer_size_out);
+			if (ret)
+				return ret;
+		}
 	}
 
-	if (f->buffer_size_out) {
-		ret = setvbuf(f->io.out.stream.std, nullptr, _IOFBF, f->buffer_size_out);
+	if (f->async.enabled) {
+		ret = file_writer_start(n);
 		if (ret)
 			return ret;
 	}
@@ -306,9 +622,9 @@ int file_start(struct node *n)
 
 	/* Get timestamp of first line */
 	if (f->epoch_mode != file::EpochMode::ORIGINAL) {
-		io_rewind(&f->io);
+		file_rewind(n);
 
-		if (io_eof(&f->io)) {
+		if (file_eof(n)) {
 			warning("Empty file");
 		}
 		else {
@@ -317,7 +633,7 @@ int file_start(struct node *n)
 
 			s.capacity = 0;
 
-			ret = io_scan(&f->io, smps, 1);
+			ret = file_scan(n, smps, 1);
 			if (ret == 1) {
 				f->first = s.ts.origin;
 				f->offset = file_calc_offset(&f->first, &f->epoch, f->epoch_mode);
@@ -327,7 +643,7 @@ int file_start(struct node *n)
 		}
 	}
 
-	io_rewind(&f->io);
+	file_rewind(n);
 
 	return 0;
 }
@@ -341,13 +657,30 @@ int file_stop(struct node *n)
 	if (ret)
 		return ret;
 
-	ret = io_close(&f->io);
-	if (ret)
-		return ret;
+	if (f->async.enabled) {
+		ret = file_writer_stop(n);
+		if (ret)
+			return ret;
+	}
 
-	ret = io_destroy(&f->io);
-	if (ret)
-		return ret;
+	if (f->recording) {
+		ret = recording_close(&f->reader);
+		if (ret)
+			return ret;
+
+		ret = recording_close(&f->writer);
+		if (ret)
+			serror("Failed to close recording '%s' of node %s", f->uri, node_name(n));
+	}
+	else {
+		ret = io_close(&f->io);
+		if (ret)
+			return ret;
+
+		ret = io_destroy(&f->io);
+		if (ret)
+			return ret;
+	}
 
 	free(f->uri);
 
@@ -359,7 +692,7 @@ int file_restart(struct node *n)
 	struct file *f = (struct file *) n->_vd;
 
 	f->offset = file_calc_offset(&f->first, &f->epoch, f->epoch_mode);
-	io_rewind(&f->io);
+	file_rewind(n);
 
 	return 0;
 }
@@ -372,21 +705,32 @@ int file_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *rel
 
 	assert(cnt == 1);
 
-retry:	ret = io_scan(&f->io, smps, cnt);
+retry:	ret = file_scan(n, smps, cnt);
 	if (ret <= 0) {
-		if (io_eof(&f->io)) {
+		if (file_eof(n)) {
 			switch (f->eof_mode) {
 				case file::EOFBehaviour::REWIND:
 					info("Rewind input file of node %s", node_name(n));
 
 					f->offset = file_calc_offset(&f->first, &f->epoch, f->epoch_mode);
-					io_rewind(&f->io);
+					file_rewind(n);
 					goto retry;
 
 				case file::EOFBehaviour::SUSPEND:
 					/* We wait 10ms before fetching again. */
 					usleep(100000);
 
+					/* Map chunks which have been appended meanwhile */
+					if (f->recording) {
+						ret = f->reader.fd < 0
+							? file_open_reader(n)
+							: recording_refresh(&f->reader);
+						if (ret)
+							serror("Failed to refresh recording of node %s", node_name(n));
+
+						goto retry;
+					}
+
 					/* Try to download more data if this is a remote file. */
 					switch (f->io.mode) {
 						case IOMode::ADVIO:
@@ -451,7 +795,53 @@ int file_write(struct node *n, struct sample *smps[], unsigned cnt, unsigned *re
 
 	assert(cnt == 1);
 
-	ret = io_print(&f->io, smps, cnt);
+	if (f->async.enabled) {
+		struct sample *cpys[cnt];
+		int avail, pushed;
+
+		/* The samples are copied, so that a slow writer can not exhaust the pool of the path */
+		avail = sample_alloc_many(&f->async.pool, cpys, cnt);
+		if (avail < 0)
+			avail = 0;
+
+		if (avail < (int) cnt && f->async.overflow == file::OverflowPolicy::BLOCK) {
+			f->async.blocked++;
+
+			pthread_mutex_lock(&f->async.mutex);
+
+			/* The I/O thread signals file::async::cv after it has released samples */
+			while (avail < (int) cnt) {
+				ret = sample_alloc_many(&f->async.pool, &cpys[avail], cnt - avail);
+				if (ret > 0)
+					avail += ret;
+				else
+					pthread_cond_wait(&f->async.cv, &f->async.mutex);
+			}
+
+			pthread_mutex_unlock(&f->async.mutex);
+		}
+
+		sample_copy_many(cpys, smps, avail);
+
+		/* The queue is at least as large as the pool */
+		pushed = queue_signalled_push_many(&f->async.queue, (void **) cpys, avail);
+		if (pushed < 0)
+			pushed = 0;
+
+		if (pushed < avail)
+			sample_decref_many(&cpys[pushed], avail - pushed);
+
+		if (pushed < (int) cnt) {
+			if (f->async.dropped == 0)
+				warning("Writer of node %s can not keep up. Dropping samples", node_name(n));
+
+			f->async.dropped += cnt - pushed;
+		}
+
+		return cnt;
+	}
+
+	ret = file_write_sync(n, smps, cnt);
 	if (ret < 0)
 		return ret;
 
@@ -467,10 +857,11 @@ int file_poll_fds(struct node *n, int fds[])
 
 		return 1;
 	}
-	else if (f->epoch_mode == file::EpochMode::ORIGINAL) {
+	else if (f->epoch_mode == file::EpochMode::ORIGINAL && !f->recording) {
 		fds[0] = io_fd(&f->io);
 
-		return 1;
+		/* Compressed streams have no file descriptor */
+		return fds[0] < 0 ? -1 : 1;
 	}
 
 	return -1; /** @todo not supported yet */
@@ -20,7 +20,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *********************************************************************************/
 
+#include <cmath>
+#include <cerrno>
 #include <cstring>
+#include <utility>
 #include <cinttypes>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -29,12 +32,162 @@
 #include <villas/node.h>
 #include <villas/plugin.h>
 #include <villas/signal.h>
+#include <villas/timing.h>
+#include <villas/text_codec.h>
 #include <villas/node/config.h>
 #include <villas/nodes/influxdb.hpp>
 #include <villas/memory.h>
 
 using namespace villas::utils;
 
+/** Append a sample in the InfluxDB line protocol to \p buf.
+ *
+ * @return The length of the line, 0 if the sample has no supported values
+ *         or \p len if the line does not fit.
+ */
+static size_t influxdb_format(struct node *n, struct sample *smp, char *buf, size_t len)
+{
+	struct influxdb *i = (struct influxdb *) n->_vd;
+
+	size_t off = 0;
+	unsigned fields = 0;
+
+	/* Key */
+	off += text_print_str(buf + off, len - off, i->key);
+
+	/* Fields */
+	for (unsigned j = 0; j < smp->length; j++) {
+		struct signal *sig = (struct signal *) vlist_at_safe(smp->signals, j);
+		if (!sig)
+			break;
+
+		union signal_data *data = &smp->data[j];
+
+		/* InfluxDB does not accept NaN or infinite values */
+		if (sig->type == SignalType::FLOAT && !std::isfinite(data->f))
+			continue;
+
+		if (sig->type != SignalType::BOOLEAN &&
+		    sig->type != SignalType::INTEGER &&
+		    sig->type != SignalType::FLOAT)
+			continue;
+
+		off += text_print_char(buf + off, len - off, fields++ == 0 ? ' ' : ',');
+
+		if (sig->name)
+			off += text_print_str(buf + off, len - off, sig->name);
+		else {
+			off += text_print_str(buf + off, len - off, "value");
+			off += text_print_uint(buf + off, len - off, j);
+		}
+
+		off += text_print_char(buf + off, len - off, '=');
+
+		switch (sig->type) {
+			case SignalType::BOOLEAN:
+				off += text_print_str(buf + off, len - off, data->b ? "true" : "false");
+				break;
+
+			case SignalType::FLOAT:
+				off += text_print_double(buf + off, len - off, data->f);
+				break;
+
+			case SignalType::INTEGER:
+				off += text_print_int(buf + off, len - off, data->i);
+				break;
+
+			default: { }
+		}
+	}
+
+	/* A line without fields is rejected by InfluxDB */
+	if (fields == 0)
+		return 0;
+
+	/* Timestamp */
+	off += text_print_char(buf + off, len - off, ' ');
+	off += text_print_int(buf + off, len - off, smp->ts.origin.tv_sec);
+	off += text_print_uint(buf + off, len - off, smp->ts.origin.tv_nsec, 9);
+	off += text_print_char(buf + off, len - off, '\n');
+
+	return off;
+}
+
+/** Send complete lines in datagrams of at most influxdb::packet_size bytes. */
+static void influxdb_send(struct node *n, const char *buf, size_t len)
+{
+	struct influxdb *i = (struct influxdb *) n->_vd;
+
+	const char *pkt = buf, *last = buf + len;
+
+	while (pkt < last) {
+		const char *end = pkt;
+		unsigned lines = 0;
+
+		/* A line which is larger than a packet is sent on its own */
+		while (end < last) {
+			const char *nl = (const char *) memchr(end, '\n', last - end);
+			const char *next = nl ? nl + 1 : last;
+
+			if (lines > 0 && (size_t) (next - pkt) > i->packet_size)
+				break;
+
+			end = next;
+			lines++;
+		}
+
+		ssize_t ret = send(i->sd, pkt, end - pkt, 0);
+		if (ret < 0) {
+			/* Avoid flooding the log while the server is not reachable */
+			if (i->errors++ == 0)
+				warning("Failed to send to InfluxDB server of node %s: %s", node_name(n), strerror(errno));
+		}
+		else {
+			i->packets++;
+			i->sent += lines;
+		}
+
+		pkt = end;
+	}
+}
+
+static void * influxdb_flusher(void *ctx)
+{
+	struct node *n = (struct node *) ctx;
+	struct influxdb *i = (struct influxdb *) n->_vd;
+
+	struct timespec interval = time_from_double(i->flush_interval);
+
+	pthread_mutex_lock(&i->mutex);
+
+	for (;;) {
+		struct timespec now, deadline;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		deadline = time_add(&now, &interval);
+
+		/* Wait until a packet is full or the oldest line is due */
+		while (!i->stopping && i->front.len < i->packet_size) {
+			if (pthread_cond_timedwait(&i->cv, &i->mutex, &deadline) == ETIMEDOUT)
+				break;
+		}
+
+		bool stopping = i->stopping;
+
+		std::swap(i->front, i->back);
+		i->front.len = 0;
+
+		pthread_mutex_unlock(&i->mutex);
+
+		influxdb_send(n, i->back.data, i->back.len);
+
+		if (stopping)
+			return nullptr;
+
+		pthread_mutex_lock(&i->mutex);
+	}
+}
+
 int influxdb_parse(struct node *n, json_t *json)
 {
 	struct influxdb *i = (struct influxdb *) n->_vd;
@@ -45,13 +198,30 @@ int influxdb_parse(struct node *n, json_t *json)
 	char *tmp, *host, *port, *lasts;
 	const char *server, *key;
 
-	ret = json_unpack_ex(json, &err, 0, "{ s: s, s: s }",
+	int buffer_size = DEFAULT_INFLUXDB_BUFFER_SIZE;
+	int packet_size = DEFAULT_INFLUXDB_PACKET_SIZE;
+
+	i->flush_interval = DEFAULT_INFLUXDB_FLUSH_INTERVAL;
+
+	ret = json_unpack_ex(json, &err, 0, "{ s: s, s: s, s?: i, s?: i, s?: F }",
 		"server", &server,
-		"key", &key
+		"key", &key,
+		"buffer_size", &buffer_size,
+		"packet_size", &packet_size,
+		"flush_interval", &i->flush_interval
 	);
 	if (ret)
 		jerror(&err, "Failed to parse configuration of node %s", node_name(n));
 
+	if (packet_size <= 0 || buffer_size < packet_size)
+		error("Setting 'packet_size' of node %s must be positive and not exceed 'buffer_size'", node_name(n));
+
+	if (i->flush_interval <= 0)
+		error("Setting 'flush_interval' of node %s must be positive", node_name(n));
+
+	i->buffer_size = buffer_size;
+	i->packet_size = packet_size;
+
 	tmp = strdup(server);
 
 	host = strtok_r(tmp, ":", &lasts);
@@ -100,13 +270,88 @@ int influxdb_open(struct node *n)
 		break;
 	}
 
-	return p ? 0 : -1;
+	freeaddrinfo(servinfo);
+
+	if (!p)
+		return -1;
+
+	for (size_t j = 0; j < vlist_length(&n->out.signals); j++) {
+		struct signal *sig = (struct signal *) vlist_at(&n->out.signals, j);
+
+		if (sig->type != SignalType::BOOLEAN &&
+		    sig->type != SignalType::INTEGER &&
+		    sig->type != SignalType::FLOAT)
+			warning("Unsupported type of signal %s for node %s. Skipping", sig->name, node_name(n));
+	}
+
+	i->front.data = (char *) alloc(i->buffer_size);
+	i->back.data = (char *) alloc(i->buffer_size);
+	i->front.len = 0;
+	i->back.len = 0;
+
+	if (!i->front.data || !i->back.data) {
+		ret = -1;
+		goto fail;
+	}
+
+	i->stopping = false;
+	i->sent = 0;
+	i->dropped = 0;
+	i->packets = 0;
+	i->errors = 0;
+
+	pthread_mutex_init(&i->mutex, nullptr);
+
+	pthread_condattr_t cvattr;
+	pthread_condattr_init(&cvattr);
+	pthread_condattr_setclock(&cvattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&i->cv, &cvattr);
+	pthread_condattr_destroy(&cvattr);
+
+	ret = pthread_create(&i->thread, nullptr, influxdb_flusher, n);
+	if (ret) {
+		warning("Failed to create flush thread of node %s: %s", node_name(n), strerror(ret));
+
+		pthread_cond_destroy(&i->cv);
+		pthread_mutex_destroy(&i->mutex);
+
+		goto fail;
+	}
+
+	return 0;
+
+fail:	free(i->front.data);
+	free(i->back.data);
+
+	i->front.data = nullptr;
+	i->back.data = nullptr;
+
+	close(i->sd);
+
+	return ret;
 }
 
 int influxdb_close(struct node *n)
 {
 	struct influxdb *i = (struct influxdb *) n->_vd;
 
+	/* The flush thread sends all remaining lines before it terminates */
+	pthread_mutex_lock(&i->mutex);
+	i->stopping = true;
+	pthread_cond_signal(&i->cv);
+	pthread_mutex_unlock(&i->mutex);
+
+	pthread_join(i->thread, nullptr);
+
+	info("InfluxDB node %s sent %ju lines in %ju datagrams: errors=%ju, dropped=%ju", node_name(n),
+		(uintmax_t) i->sent, (uintmax_t) i->packets, (uintmax_t) i->errors, (uintmax_t) i->dropped);
+
+	pthread_cond_destroy(&i->cv);
+	pthread_mutex_destroy(&i->mutex);
+
+	free(i->front.data);
+	free(i->back.data);
+
 	close(i->sd);
 
 	if (i->host)
@@ -123,69 +368,25 @@ int influxdb_write(struct node *n, struct sample *smps[], unsigned cnt, unsigned
 {
 	struct influxdb *i = (struct influxdb *) n->_vd;
 
-	char *buf = nullptr;
-	ssize_t sentlen, buflen;
+	pthread_mutex_lock(&i->mutex);
 
 	for (unsigned k = 0; k < cnt; k++) {
-		struct sample *smp = smps[k];
-
-		/* Key */
-		strcatf(&buf, "%s", i->key);
-
-		/* Fields */
-		for (unsigned j = 0; j < smp->length; j++) {
-			struct signal *sig = (struct signal *) vlist_at(smp->signals, j);
-			union signal_data *data = &smp->data[k];
-
-			if (
-				sig->type != SignalType::BOOLEAN &&
-				sig->type != SignalType::INTEGER &&
-				sig->type != SignalType::INTEGER
-			) {
-				warning("Unsupported signal format for node %s. Skipping", node_name(n));
-				continue;
-			}
-
-			strcatf(&buf, "%c", j == 0 ? ' ' : ',');
-
-			sig = (struct signal *) vlist_at(smp->signals, j);
-			if (!sig)
-				return -1;
-
-			if (sig->name)
-				strcatf(&buf, "%s=", sig->name);
-			else
-				strcatf(&buf, "value%d=", j);
-
-			switch (sig->type) {
-				case SignalType::BOOLEAN:
-					strcatf(&buf, "%s", data->b ? "true" : "false");
-					break;
-
-				case SignalType::FLOAT:
-					strcatf(&buf, "%f", data->f);
-					break;
-
-				case SignalType::INTEGER:
-					strcatf(&buf, "%" PRIi64, data->i);
-					break;
-
-				default: { }
-			}
+		size_t avail = i->buffer_size - i->front.len;
+		size_t wlen = influxdb_format(n, smps[k], i->front.data + i->front.len, avail);
+
+		/* The buffer is full: the server or network can not keep up */
+		if (wlen >= avail) {
+			i->dropped++;
+			continue;
 		}
 
-		/* Timestamp */
-		strcatf(&buf, " %ld%09ld\n", smp->ts.origin.tv_sec, smp->ts.origin.tv_nsec);
+		i->front.len += wlen;
 	}
 
-	buflen = strlen(buf) + 1;
-	sentlen = send(i->sd, buf, buflen, 0);
-	if (sentlen < 0)
-		return -1;
-	else if (sentlen < buflen)
-		warning("Partial sent");
+	if (i->front.len >= i->packet_size)
+		pthread_cond_signal(&i->cv);
 
-	free(buf);
+	pthread_mutex_unlock(&i->mutex);
 
 	return cnt;
 }
@@ -195,7 +396,12 @@ char * influxdb_print(struct node *n)
 	struct influxdb *i = (struct influxdb *) n->_vd;
 	char *buf = nullptr;
 
-	strcatf(&buf, "host=%s, port=%s, key=%s", i->host, i->port, i->key);
+	strcatf(&buf, "host=%s, port=%s, key=%s, buffer_size=%zu, packet_size=%zu, flush_interval=%.3f",
+		i->host, i->port, i->key, i->buffer_size, i->packet_size, i->flush_interval);
+
+	if (n->state == State::STARTED)
+		strcatf(&buf, ", sent=%ju, packets=%ju, errors=%ju, dropped=%ju",
+			(uintmax_t) i->sent, (uintmax_t) i->packets, (uintmax_t) i->errors, (uintmax_t) i->dropped);
 
 	return buf;
 }
@@ -22,6 +22,7 @@
 
 #include <cstring>
 #include <cstdio>
+#include <cinttypes>
 
 #include <curl/curl.h>
 #include <jansson.h>
@@ -39,6 +40,27 @@ using namespace villas::utils;
 /* Some global settings */
 static char *name = nullptr;
 
+/** Maximum number of parallel connections to a single context broker. */
+#define NGSI_MAX_HOST_CONNECTIONS 8
+
+#if LIBCURL_VERSION_NUM >= 0x074400 /* 7.68.0 */
+  #define NGSI_ENGINE_TIMEOUT 1000
+#else
+  /* Older versions of libcurl can not wake up the engine from another thread */
+  #define NGSI_ENGINE_TIMEOUT 10
+  #define curl_multi_poll curl_multi_wait
+#endif
+
+/** A single thread which executes the HTTP requests of all NGSI nodes. */
+static struct {
+	CURLM *multi;			/**< libcurl: multi handle which also holds the connection cache */
+	pthread_t thread;
+	pthread_mutex_t mutex;		/**< Protects the list of nodes and their pending requests */
+	pthread_cond_t cv;		/**< Signals that a node has been detached */
+	struct vlist nodes;		/**< The nodes whose requests are executed by the engine */
+	bool stopping;
+} engine;
+
 enum ngsi_flags {
 	NGSI_ENTITY_ATTRIBUTES = (1 << 0),
 	NGSI_ENTITY_VALUES     = (1 << 1) | NGSI_ENTITY_ATTRIBUTES,
@@ -346,62 +368,330 @@ out:	free(post);
 	return ret;
 }
 
-static int ngsi_request_context_query(CURL *handle, const char *endpoint, json_t *entity, json_t **rentity)
+static int ngsi_request_context_update(CURL *handle, const char *endpoint, const char *action, json_t *entity)
 {
 	int ret, code;
 	char *reason;
 
 	json_t *response;
-	json_t *request = json_pack("{ s: [ o ] }", "entities", entity);
+	json_t *request = json_pack("{ s: s, s: [ O ] }",
+		"updateAction", action,
+		"contextElements", entity
+	);
 
-	ret = ngsi_request(handle, endpoint, "queryContext", request, &response);
+	ret = ngsi_request(handle, endpoint, "updateContext", request, &response);
 	if (ret)
 		goto out;
 
-	ret = ngsi_parse_context_response(response, &code, &reason, rentity);
+	json_t *rentity;
+	ret = ngsi_parse_context_response(response, &code, &reason, &rentity);
 	if (ret)
 		goto out2;
 
+	json_decref(rentity);
 out2:	json_decref(response);
 out:	json_decref(request);
 
 	return ret;
 }
 
-static int ngsi_request_context_update(CURL *handle, const char *endpoint, const char *action, json_t *entity)
+static size_t ngsi_transfer_writer(void *contents, size_t size, size_t nmemb, void *userp)
 {
-	int ret, code;
+	size_t realsize = size * nmemb;
+	struct ngsi_transfer *t = (struct ngsi_transfer *) userp;
+
+	t->response = (char *) realloc(t->response, t->response_len + realsize + 1);
+	if (t->response == nullptr) /* out of memory! */
+		error("Not enough memory (realloc returned nullptr)");
+
+	memcpy(&t->response[t->response_len], contents, realsize);
+	t->response_len += realsize;
+	t->response[t->response_len] = 0;
+
+	return realsize;
+}
+
+static void ngsi_setup_handle(struct ngsi *i, CURL *handle)
+{
+	curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, i->ssl_verify);
+	curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, i->timeout * 1e3);
+	curl_easy_setopt(handle, CURLOPT_HTTPHEADER, i->headers);
+	curl_easy_setopt(handle, CURLOPT_USERAGENT, USER_AGENT);
+	curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+}
+
+static void ngsi_transfer_init(struct node *n, struct ngsi_transfer *t, const char *operation)
+{
+	struct ngsi *i = (struct ngsi *) n->_vd;
+	char url[128];
+
+	memset(t, 0, sizeof(struct ngsi_transfer));
+
+	snprintf(url, sizeof(url), "%s/v1/%s", i->endpoint, operation);
+
+	t->handle = curl_easy_init();
+
+	ngsi_setup_handle(i, t->handle);
+
+	curl_easy_setopt(t->handle, CURLOPT_URL, url);
+	curl_easy_setopt(t->handle, CURLOPT_WRITEFUNCTION, ngsi_transfer_writer);
+	curl_easy_setopt(t->handle, CURLOPT_WRITEDATA, (void *) t);
+	curl_easy_setopt(t->handle, CURLOPT_PRIVATE, (void *) n);
+}
+
+static void ngsi_transfer_destroy(struct ngsi_transfer *t)
+{
+	curl_easy_cleanup(t->handle);
+
+	free(t->pending);
+}
+
+/** Queue a request body. A request which has not been started yet is replaced.
+ *
+ * @note The caller must hold engine::mutex.
+ */
+static void ngsi_transfer_queue(struct ngsi_transfer *t, char *body)
+{
+	if (t->pending) {
+		free(t->pending);
+		t->coalesced++;
+	}
+
+	t->pending = body;
+	t->queued = time_now();
+}
+
+/** Start the pending request if no other request is in flight.
+ *
+ * @note The caller must hold engine::mutex.
+ */
+static void ngsi_transfer_start(struct ngsi_transfer *t)
+{
+	if (t->body || !t->pending)
+		return;
+
+	t->body = t->pending;
+	t->started = t->queued;
+	t->pending = nullptr;
+
+	debug(LOG_NGSI | 18, "Request to context broker:\n%s", t->body);
+
+	curl_easy_setopt(t->handle, CURLOPT_POSTFIELDSIZE, strlen(t->body));
+	curl_easy_setopt(t->handle, CURLOPT_POSTFIELDS, t->body);
+
+	curl_multi_add_handle(engine.multi, t->handle);
+}
+
+/** Abort the request in flight or release it after its completion.
+ *
+ * @note The caller must hold engine::mutex.
+ */
+static void ngsi_transfer_reset(struct ngsi_transfer *t)
+{
+	if (t->body)
+		curl_multi_remove_handle(engine.multi, t->handle);
+
+	free(t->body);
+	free(t->response);
+
+	t->body = nullptr;
+	t->response = nullptr;
+	t->response_len = 0;
+}
+
+static void ngsi_transfer_complete(struct node *n, struct ngsi_transfer *t, CURLcode result)
+{
+	struct ngsi *i = (struct ngsi *) n->_vd;
+
+	int ret = -1, code;
 	char *reason;
+	json_error_t err;
+	json_t *response = nullptr, *rentity = nullptr;
+
+	if (result)
+		warning("HTTP request of node %s failed: %s", node_name(n), curl_easy_strerror(result));
+	else {
+		debug(LOG_NGSI | 17, "Response from context broker:\n%s", t->response);
+
+		response = json_loads(t->response ? t->response : "", 0, &err);
+		if (!response)
+			warning("Received invalid JSON: %s in %s:%u:%u\n%s", err.text, err.source, err.line, err.column, t->response);
+		else {
+			ret = ngsi_parse_context_response(response, &code, &reason, &rentity);
+			if (!ret && code != 200)
+				ret = -1;
+		}
+	}
 
-	json_t *response;
-	json_t *request = json_pack("{ s: s, s: [ o ] }",
-		"updateAction", action,
-		"contextElements", entity
-	);
+	struct timespec now = time_now();
+	double latency = time_delta(&t->started, &now);
 
-	ret = ngsi_request(handle, endpoint, "updateContext", request, &response);
-	if (ret)
-		goto out;
+	debug(LOG_NGSI | 16, "Request to context broker completed in %.4f seconds", latency);
+
+	pthread_mutex_lock(&engine.mutex);
+
+	t->requests++;
+	t->latency_total += latency;
+	if (latency > t->latency_max)
+		t->latency_max = latency;
 
-	json_t *rentity;
-	ret = ngsi_parse_context_response(response, &code, &reason, &rentity);
 	if (ret)
-		goto out2;
+		t->failed++;
+	else if (t == &i->query) {
+		json_decref(i->result);
+		i->result = rentity;
+		rentity = nullptr;
+	}
+
+	/* ngsi_print() reads the body of the request in flight */
+	ngsi_transfer_reset(t);
+
+	pthread_mutex_unlock(&engine.mutex);
 
 	json_decref(rentity);
-out2:	json_decref(response);
-out:	json_decref(request);
+	json_decref(response);
+}
 
-	return ret;
+static void * ngsi_engine_worker(void *)
+{
+	int running, left;
+	CURLMsg *msg;
+
+	pthread_mutex_lock(&engine.mutex);
+
+	while (!engine.stopping) {
+		for (size_t j = 0; j < vlist_length(&engine.nodes); j++) {
+			struct node *n = (struct node *) vlist_at(&engine.nodes, j);
+			struct ngsi *i = (struct ngsi *) n->_vd;
+
+			if (i->detach) {
+				/* Queries are not needed anymore but the latest update is still sent */
+				ngsi_transfer_reset(&i->query);
+				ngsi_transfer_start(&i->update);
+
+				if (!i->update.body) {
+					vlist_remove(&engine.nodes, j--);
+
+					i->detach = false;
+					pthread_cond_broadcast(&engine.cv);
+				}
+
+				continue;
+			}
+
+			ngsi_transfer_start(&i->update);
+			ngsi_transfer_start(&i->query);
+		}
+
+		pthread_mutex_unlock(&engine.mutex);
+
+		curl_multi_perform(engine.multi, &running);
+
+		bool completed = false;
+
+		while ((msg = curl_multi_info_read(engine.multi, &left))) {
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+
+			/* The message is invalidated by curl_multi_remove_handle() */
+			CURL *handle = msg->easy_handle;
+			CURLcode result = msg->data.result;
+
+			struct node *n;
+			curl_easy_getinfo(handle, CURLINFO_PRIVATE, (char **) &n);
+
+			struct ngsi *i = (struct ngsi *) n->_vd;
+
+			ngsi_transfer_complete(n, handle == i->update.handle ? &i->update : &i->query, result);
+
+			completed = true;
+		}
+
+		/* Pending requests are started right after the previous ones have been completed */
+		if (!completed)
+			curl_multi_poll(engine.multi, nullptr, 0, NGSI_ENGINE_TIMEOUT, nullptr);
+
+		pthread_mutex_lock(&engine.mutex);
+	}
+
+	pthread_mutex_unlock(&engine.mutex);
+
+	return nullptr;
+}
+
+static void ngsi_engine_wakeup()
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup(engine.multi);
+#endif
+}
+
+static void ngsi_engine_attach(struct node *n)
+{
+	pthread_mutex_lock(&engine.mutex);
+	vlist_push(&engine.nodes, n);
+	pthread_mutex_unlock(&engine.mutex);
+}
+
+/** Remove a node from the engine and wait until none of its requests is in flight anymore.
+ *
+ * A pending update is sent before. This takes at most twice the timeout of the node.
+ */
+static void ngsi_engine_detach(struct node *n)
+{
+	struct ngsi *i = (struct ngsi *) n->_vd;
+
+	pthread_mutex_lock(&engine.mutex);
+
+	i->detach = true;
+	ngsi_engine_wakeup();
+
+	while (i->detach)
+		pthread_cond_wait(&engine.cv, &engine.mutex);
+
+	pthread_mutex_unlock(&engine.mutex);
 }
 
 int ngsi_type_start(villas::node::SuperNode *sn)
 {
-	return curl_global_init(CURL_GLOBAL_ALL);
+	int ret;
+
+	ret = curl_global_init(CURL_GLOBAL_ALL);
+	if (ret)
+		return ret;
+
+	engine.multi = curl_multi_init();
+	if (!engine.multi)
+		return -1;
+
+	curl_multi_setopt(engine.multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) NGSI_MAX_HOST_CONNECTIONS);
+
+	engine.stopping = false;
+
+	vlist_init(&engine.nodes);
+
+	pthread_mutex_init(&engine.mutex, nullptr);
+	pthread_cond_init(&engine.cv, nullptr);
+
+	return pthread_create(&engine.thread, nullptr, ngsi_engine_worker, nullptr);
 }
 
 int ngsi_type_stop()
 {
+	pthread_mutex_lock(&engine.mutex);
+	engine.stopping = true;
+	ngsi_engine_wakeup();
+	pthread_mutex_unlock(&engine.mutex);
+
+	pthread_join(engine.thread, nullptr);
+
+	curl_multi_cleanup(engine.multi);
+
+	vlist_destroy(&engine.nodes, nullptr, false);
+
+	pthread_cond_destroy(&engine.cv);
+	pthread_mutex_destroy(&engine.mutex);
+
 	free(name);
 
 	curl_global_cleanup();
@@ -447,8 +737,28 @@ char * ngsi_print(struct node *n)
 {
 	struct ngsi *i = (struct ngsi *) n->_vd;
 
-	return strf("endpoint=%s, timeout=%.3f secs, #mappings=%zu",
+	char *buf = strf("endpoint=%s, timeout=%.3f secs, #mappings=%zu",
 		i->endpoint, i->timeout, vlist_length(&i->mapping));
+
+	if (n->state == State::STARTED) {
+		pthread_mutex_lock(&engine.mutex);
+
+		struct ngsi_transfer *ts[] = { &i->update, &i->query };
+		const char *names[] = { "updates", "queries" };
+
+		for (unsigned j = 0; j < ARRAY_LEN(ts); j++) {
+			struct ngsi_transfer *t = ts[j];
+
+			strcatf(&buf, ", %s=(requests=%ju, failed=%ju, coalesced=%ju, backlog=%d, latency=%.4f/%.4f secs)", names[j],
+				(uintmax_t) t->requests, (uintmax_t) t->failed, (uintmax_t) t->coalesced,
+				(t->pending ? 1 : 0) + (t->body ? 1 : 0),
+				t->requests ? t->latency_total / t->requests : 0.0, t->latency_max);
+		}
+
+		pthread_mutex_unlock(&engine.mutex);
+	}
+
+	return buf;
 }
 
 static int ngsi_metadata_destroy(struct ngsi_metadata *meta)
@@ -504,10 +814,7 @@ int ngsi_start(struct node *n)
 	i->headers = curl_slist_append(i->headers, "Accept: application/json");
 	i->headers = curl_slist_append(i->headers, "Content-Type: application/json");
 
-	curl_easy_setopt(i->curl, CURLOPT_SSL_VERIFYPEER, i->ssl_verify);
-	curl_easy_setopt(i->curl, CURLOPT_TIMEOUT_MS, i->timeout * 1e3);
-	curl_easy_setopt(i->curl, CURLOPT_HTTPHEADER, i->headers);
-	curl_easy_setopt(i->curl, CURLOPT_USERAGENT, USER_AGENT);
+	ngsi_setup_handle(i, i->curl);
 
 	/* Create entity and atributes */
 	json_t *entity = ngsi_build_entity(i, nullptr, 0, NGSI_ENTITY_METADATA);
@@ -518,6 +825,15 @@ int ngsi_start(struct node *n)
 
 	json_decref(entity);
 
+	/* Further requests are executed asynchronously by the engine */
+	ngsi_transfer_init(n, &i->update, "updateContext");
+	ngsi_transfer_init(n, &i->query, "queryContext");
+
+	i->result = nullptr;
+	i->detach = false;
+
+	ngsi_engine_attach(n);
+
 	return ret;
 }
 
@@ -526,6 +842,17 @@ int ngsi_stop(struct node *n)
 	struct ngsi *i = (struct ngsi *) n->_vd;
 	int ret;
 
+	ngsi_engine_detach(n);
+
+	info("NGSI node %s sent %ju updates: failed=%ju, coalesced=%ju, latency=%.4f secs (mean)", node_name(n),
+		(uintmax_t) i->update.requests, (uintmax_t) i->update.failed, (uintmax_t) i->update.coalesced,
+		i->update.requests ? i->update.latency_total / i->update.requests : 0.0);
+
+	ngsi_transfer_destroy(&i->update);
+	ngsi_transfer_destroy(&i->query);
+
+	json_decref(i->result);
+
 	/* Delete complete entity (not just attributes) */
 	json_t *entity = ngsi_build_entity(i, nullptr, 0, 0);
 
@@ -542,24 +869,36 @@ int ngsi_stop(struct node *n)
 int ngsi_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *release)
 {
 	struct ngsi *i = (struct ngsi *) n->_vd;
-	int ret;
+	int ret = 0;
 
 	if (task_wait(&i->task) == 0)
 		perror("Failed to wait for task");
 
-	json_t *rentity;
 	json_t *entity = ngsi_build_entity(i, nullptr, 0, 0);
+	json_t *request = json_pack("{ s: [ o ] }", "entities", entity);
 
-	ret = ngsi_request_context_query(i->curl, i->endpoint, entity, &rentity);
-	if (ret)
-		goto out;
+	char *body = json_dumps(request, 0);
 
-	ret = ngsi_parse_entity(rentity, i, smps, cnt);
-	if (ret)
-		goto out2;
+	json_decref(request);
+
+	/* We return the result of the previous query and issue a new one */
+	pthread_mutex_lock(&engine.mutex);
+
+	json_t *rentity = i->result;
+	i->result = nullptr;
+
+	ngsi_transfer_queue(&i->query, body);
+	ngsi_engine_wakeup();
+
+	pthread_mutex_unlock(&engine.mutex);
 
-out2:	json_decref(rentity);
-out:	json_decref(entity);
+	if (rentity) {
+		ret = ngsi_parse_entity(rentity, i, smps, cnt);
+		if (ret < 0)
+			warning("Failed to parse NGSI entity of node %s: reason=%d", node_name(n), ret);
+
+		json_decref(rentity);
+	}
 
 	return ret;
 }
@@ -567,15 +906,26 @@ out:	json_decref(entity);
 int ngsi_write(struct node *n, struct sample *smps[], unsigned cnt, unsigned *release)
 {
 	struct ngsi *i = (struct ngsi *) n->_vd;
-	int ret;
 
 	json_t *entity = ngsi_build_entity(i, smps, cnt, NGSI_ENTITY_VALUES);
+	json_t *request = json_pack("{ s: s, s: [ o ] }",
+		"updateAction", "UPDATE",
+		"contextElements", entity
+	);
 
-	ret = ngsi_request_context_update(i->curl, i->endpoint, "UPDATE", entity);
+	char *body = json_dumps(request, 0);
 
-	json_decref(entity);
+	json_decref(request);
+
+	/* Only the latest update per entity is kept if the broker can not keep up */
+	pthread_mutex_lock(&engine.mutex);
+
+	ngsi_transfer_queue(&i->update, body);
+	ngsi_engine_wakeup();
 
-	return ret ? 0 : cnt;
+	pthread_mutex_unlock(&engine.mutex);
+
+	return cnt;
 }
 
 int ngsi_poll_fds(struct node *n, int fds[])
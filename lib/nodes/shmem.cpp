@@ -70,7 +70,7 @@ int shmem_parse(struct node *n, json_t *cfg)
 	if (mode_str) {
 		if (!strcmp(mode_str, "polling"))
 			shm->conf.polling = true;
-		else if (!strcmp(mode_str, "pthread"))
+		else if (!strcmp(mode_str, "futex") || !strcmp(mode_str, "pthread"))
 			shm->conf.polling = false;
 		else
 			error("Unknown mode '%s' in node %s", mode_str, node_name(n));
@@ -131,10 +131,7 @@ int shmem_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *re
 	int recv;
 	struct sample *shared_smps[cnt];
 
-	do {
-		recv = shmem_int_read(&shm->intf, shared_smps, cnt);
-	} while (recv == 0);
-
+	recv = shmem_int_peek(&shm->intf, shared_smps, cnt);
 	if (recv < 0) {
 		/* This can only really mean that the other process has exited, so close
 		 * the interface to make sure the shared memory object is unlinked */
@@ -146,8 +143,10 @@ int shmem_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *re
 		return recv;
 	}
 
-	sample_copy_many(smps, shared_smps, recv);
-	sample_decref_many(shared_smps, recv);
+	if (recv > 0) {
+		sample_copy_many(smps, shared_smps, recv);
+		shmem_int_consume(&shm->intf, recv);
+	}
 
 	/** @todo: signal descriptions are currently not shared between processes */
 	for (int i = 0; i < recv; i++)
@@ -159,22 +158,22 @@ int shmem_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *re
 int shmem_write(struct node *n, struct sample *smps[], unsigned cnt, unsigned *release)
 {
 	struct shmem *shm = (struct shmem *) n->_vd;
-	struct sample *shared_smps[cnt]; /* Samples need to be copied to the shared pool first */
-	int avail, pushed, copied;
-
-	avail = sample_alloc_many(&shm->intf.write.shared->pool, shared_smps, cnt);
-	if (avail != (int) cnt)
-		warning("Pool underrun for shmem node %s", shm->out_name);
+	struct sample *shared_smps[cnt]; /* Samples are copied into the slots of the ring */
+	int avail;
 
-	copied = sample_copy_many(shared_smps, smps, avail);
-	if (copied < avail)
-		warning("Outgoing pool underrun for node %s", node_name(n));
+	avail = shmem_int_reserve(&shm->intf, shared_smps, cnt);
+	if (avail < 0)
+		return avail;
 
-	pushed = shmem_int_write(&shm->intf, shared_smps, copied);
-	if (pushed != avail)
+	if (avail != (int) cnt)
 		warning("Outgoing queue overrun for node %s", node_name(n));
 
-	return pushed;
+	if (avail > 0) {
+		sample_copy_many(shared_smps, smps, avail);
+		shmem_int_publish(&shm->intf, avail);
+	}
+
+	return avail;
 }
 
 char * shmem_print(struct node *n)
@@ -21,6 +21,7 @@
  *********************************************************************************/
 
 #include <unistd.h>
+#include <poll.h>
 #include <cstring>
 #include <cerrno>
 #include <arpa/inet.h>
@@ -102,6 +103,15 @@ char * socket_print(struct node *n)
 
 	buf = strf("layer=%s, format=%s, in.address=%s, out.address=%s", layer, format_type_name(s->format), local, remote);
 
+	if (s->batch)
+		strcatf(&buf, ", batch=yes");
+
+	if (s->busy_poll)
+		strcatf(&buf, ", in.busy_poll=%d", s->busy_poll);
+
+	if (s->rcvbuf)
+		strcatf(&buf, ", in.buffer_size=%d", s->rcvbuf);
+
 	if (s->multicast.enabled) {
 		char group[INET_ADDRSTRLEN];
 		char interface[INET_ADDRSTRLEN];
@@ -146,6 +156,14 @@ int socket_check(struct node *n)
 	}
 #endif /* WITH_SOCKET_LAYER_ETH */
 
+#ifndef __linux__
+	if (s->batch)
+		error("Batched mode of node %s requires recvmmsg() / sendmmsg() which are only available on Linux", node_name(n));
+
+	if (s->busy_poll)
+		error("Setting 'busy_poll' of node %s is only supported on Linux", node_name(n));
+#endif /* __linux__ */
+
 	if (s->multicast.enabled) {
 		if (s->in.saddr.sa.sa_family != AF_INET)
 			error("Multicast is only supported by IPv4 for node %s", node_name(n));
@@ -273,11 +291,71 @@ int socket_start(struct node *n)
 #endif /* __linux__ */
 	}
 
+	if (s->rcvbuf > 0) {
+		ret = setsockopt(s->sd, SOL_SOCKET, SO_RCVBUF, &s->rcvbuf, sizeof(s->rcvbuf));
+		if (ret)
+			serror("Failed to set receive buffer size");
+		else
+			debug(LOG_SOCKET | 4, "Set receive buffer size for node %s to %d bytes", node_name(n), s->rcvbuf);
+	}
+
+#ifdef SO_BUSY_POLL
+	if (s->busy_poll > 0) {
+		ret = setsockopt(s->sd, SOL_SOCKET, SO_BUSY_POLL, &s->busy_poll, sizeof(s->busy_poll));
+		if (ret)
+			warning("Failed to enable busy polling for node %s: %s", node_name(n), strerror(errno));
+		else
+			debug(LOG_SOCKET | 4, "Set busy poll timeout for node %s to %d us", node_name(n), s->busy_poll);
+	}
+#endif /* SO_BUSY_POLL */
+
 	s->out.buflen = SOCKET_INITIAL_BUFFER_LEN;
 	s->out.buf = (char *) alloc(s->out.buflen);
 	if (!s->out.buf)
 		return -1;
 
+#ifdef __linux__
+	if (s->batch) {
+		/* One buffer of SOCKET_BATCH_BUFFER_LEN bytes per datagram */
+		s->in.nmsgs = n->in.vectorize;
+		s->in.buflen = s->in.nmsgs * SOCKET_BATCH_BUFFER_LEN;
+		s->in.buf = (char *) alloc(s->in.buflen);
+		s->in.msgs = (struct mmsghdr *) alloc(s->in.nmsgs * sizeof(struct mmsghdr));
+		s->in.iovs = (struct iovec *) alloc(s->in.nmsgs * sizeof(struct iovec));
+		s->in.addrs = (union sockaddr_union *) alloc(s->in.nmsgs * sizeof(union sockaddr_union));
+		if (!s->in.buf || !s->in.msgs || !s->in.iovs || !s->in.addrs)
+			return -1;
+
+		for (unsigned i = 0; i < s->in.nmsgs; i++) {
+			struct msghdr *hdr = &s->in.msgs[i].msg_hdr;
+
+			s->in.iovs[i].iov_base = s->in.buf + i * SOCKET_BATCH_BUFFER_LEN;
+			s->in.iovs[i].iov_len = SOCKET_BATCH_BUFFER_LEN;
+
+			hdr->msg_iov = &s->in.iovs[i];
+			hdr->msg_iovlen = 1;
+			hdr->msg_name = &s->in.addrs[i];
+		}
+
+		/* The outgoing datagrams are packed into socket::out::buf */
+		s->out.nmsgs = n->out.vectorize;
+		s->out.msgs = (struct mmsghdr *) alloc(s->out.nmsgs * sizeof(struct mmsghdr));
+		s->out.iovs = (struct iovec *) alloc(s->out.nmsgs * sizeof(struct iovec));
+		if (!s->out.msgs || !s->out.iovs)
+			return -1;
+
+		for (unsigned i = 0; i < s->out.nmsgs; i++) {
+			struct msghdr *hdr = &s->out.msgs[i].msg_hdr;
+
+			hdr->msg_iov = &s->out.iovs[i];
+			hdr->msg_iovlen = 1;
+			hdr->msg_name = &s->out.saddr;
+		}
+
+		return 0;
+	}
+#endif /* __linux__ */
+
 	s->in.buflen = SOCKET_INITIAL_BUFFER_LEN;
 	s->in.buf = (char *) alloc(s->in.buflen);
 	if (!s->in.buf)
@@ -323,30 +401,26 @@ int socket_stop(struct node *n)
 	free(s->in.buf);
 	free(s->out.buf);
 
+	if (s->batch) {
+		free(s->in.msgs);
+		free(s->in.iovs);
+		free(s->in.addrs);
+
+		free(s->out.msgs);
+		free(s->out.iovs);
+	}
+
 	return 0;
 }
 
-int socket_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *release)
+/** Parse the samples of a single received datagram. */
+static int socket_read_packet(struct node *n, char *ptr, ssize_t bytes, union sockaddr_union *src, struct sample *smps[], unsigned cnt)
 {
 	int ret;
 	struct socket *s = (struct socket *) n->_vd;
 
-	char *ptr;
-	ssize_t bytes;
 	size_t rbytes;
 
-	union sockaddr_union src;
-	socklen_t srclen = sizeof(src);
-
-	/* Receive next sample */
-	bytes = recvfrom(s->sd, s->in.buf, s->in.buflen, 0, &src.sa, &srclen);
-	if (bytes < 0)
-		serror("Failed recv from node %s", node_name(n));
-	else if (bytes == 0)
-		return 0;
-
-	ptr = s->in.buf;
-
 	/* Strip IP header from packet */
 	if (s->layer == SocketLayer::IP) {
 		struct ip *iphdr = (struct ip *) ptr;
@@ -358,19 +432,19 @@ int socket_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *r
 	/* SOCK_RAW IP sockets to not provide the IP protocol number via recvmsg()
 	 * So we simply set it ourself. */
 	if (s->layer == SocketLayer::IP) {
-		switch (src.sa.sa_family) {
+		switch (src->sa.sa_family) {
 			case AF_INET:
-				src.sin.sin_port = s->out.saddr.sin.sin_port;
+				src->sin.sin_port = s->out.saddr.sin.sin_port;
 				break;
 
 			case AF_INET6:
-				src.sin6.sin6_port = s->out.saddr.sin6.sin6_port;
+				src->sin6.sin6_port = s->out.saddr.sin6.sin6_port;
 				break;
 		}
 	}
 
-	if (s->verify_source && socket_compare_addr(&src.sa, &s->out.saddr.sa) != 0) {
-		char *buf = socket_print_addr((struct sockaddr *) &src);
+	if (s->verify_source && socket_compare_addr(&src->sa, &s->out.saddr.sa) != 0) {
+		char *buf = socket_print_addr((struct sockaddr *) src);
 		warning("Received packet from unauthorized source: %s", buf);
 		free(buf);
 
@@ -384,32 +458,152 @@ int socket_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *r
 	return ret;
 }
 
-int socket_write(struct node *n, struct sample *smps[], unsigned cnt, unsigned *release)
+#ifdef __linux__
+/** Receive up to \p cnt datagrams with a single call to recvmmsg(). */
+static int socket_read_batch(struct node *n, struct sample *smps[], unsigned cnt)
+{
+	int ret, msgs;
+	struct socket *s = (struct socket *) n->_vd;
+
+	unsigned nmsgs = MIN(cnt, s->in.nmsgs);
+	unsigned recvd = 0;
+
+	for (unsigned i = 0; i < nmsgs; i++)
+		s->in.msgs[i].msg_hdr.msg_namelen = sizeof(union sockaddr_union);
+
+	/* Wait for the first datagram and take all others which are already queued */
+	msgs = recvmmsg(s->sd, s->in.msgs, nmsgs, MSG_WAITFORONE, nullptr);
+	if (msgs < 0)
+		serror("Failed recv from node %s", node_name(n));
+
+	for (int i = 0; i < msgs; i++) {
+		struct mmsghdr *m = &s->in.msgs[i];
+
+		if (m->msg_len == 0)
+			continue;
+
+		if (m->msg_hdr.msg_flags & MSG_TRUNC) {
+			warning("Received truncated packet from node %s: maximum length is %d bytes", node_name(n), SOCKET_BATCH_BUFFER_LEN);
+			continue;
+		}
+
+		if (recvd == cnt) {
+			warning("Dropped %d packets of node %s: not enough samples. Increase setting 'vectorize'", msgs - i, node_name(n));
+			break;
+		}
+
+		ret = socket_read_packet(n, (char *) m->msg_hdr.msg_iov->iov_base, m->msg_len, &s->in.addrs[i], &smps[recvd], cnt - recvd);
+		if (ret > 0)
+			recvd += ret;
+	}
+
+	return recvd;
+}
+#endif /* __linux__ */
+
+int socket_read(struct node *n, struct sample *smps[], unsigned cnt, unsigned *release)
 {
 	struct socket *s = (struct socket *) n->_vd;
 
-	int ret;
 	ssize_t bytes;
-	size_t wbytes;
 
-retry:	ret = io_sprint(&s->io, s->out.buf, s->out.buflen, &wbytes, smps, cnt);
-	if (ret < 0) {
-		warning("Failed to format payload: reason=%d", ret);
-		return ret;
+	union sockaddr_union src;
+	socklen_t srclen = sizeof(src);
+
+#ifdef __linux__
+	if (s->batch)
+		return socket_read_batch(n, smps, cnt);
+#endif /* __linux__ */
+
+	/* Receive next sample */
+	bytes = recvfrom(s->sd, s->in.buf, s->in.buflen, 0, &src.sa, &srclen);
+	if (bytes < 0)
+		serror("Failed recv from node %s", node_name(n));
+	else if (bytes == 0)
+		return 0;
+
+	return socket_read_packet(n, s->in.buf, bytes, &src, smps, cnt);
+}
+
+#ifdef __linux__
+/** Send each sample as a separate datagram with a single call to sendmmsg(). */
+static int socket_write_batch(struct node *n, struct sample *smps[], unsigned cnt, socklen_t addrlen)
+{
+	struct socket *s = (struct socket *) n->_vd;
+
+	int ret;
+	size_t wbytes, off = 0;
+
+	unsigned nmsgs = MIN(cnt, s->out.nmsgs);
+	unsigned sent = 0;
+
+	/* Pack all datagrams into the output buffer */
+	for (unsigned i = 0; i < nmsgs; i++) {
+retry:		ret = io_sprint(&s->io, s->out.buf + off, s->out.buflen - off, &wbytes, &smps[i], 1);
+		if (ret < 0) {
+			warning("Failed to format payload: reason=%d", ret);
+			return ret;
+		}
+
+		if (wbytes == 0) {
+			warning("Failed to format payload: wbytes=%zu", wbytes);
+			return -1;
+		}
+
+		if (off + wbytes > s->out.buflen) {
+			s->out.buflen = MAX(2 * s->out.buflen, off + wbytes);
+			s->out.buf = (char *) realloc(s->out.buf, s->out.buflen);
+			goto retry;
+		}
+
+		s->out.iovs[i].iov_len = wbytes;
+		off += wbytes;
 	}
 
-	if (wbytes == 0) {
-		warning("Failed to format payload: wbytes=%zu", wbytes);
-		return -1;
+	/* The buffer might have been moved by realloc() */
+	off = 0;
+	for (unsigned i = 0; i < nmsgs; i++) {
+		s->out.iovs[i].iov_base = s->out.buf + off;
+		s->out.msgs[i].msg_hdr.msg_namelen = addrlen;
+
+		off += s->out.iovs[i].iov_len;
 	}
 
-	if (wbytes > s->out.buflen) {
-		s->out.buflen = wbytes;
-		s->out.buf = (char *) realloc(s->out.buf, s->out.buflen);
-		goto retry;
+	while (sent < nmsgs) {
+		ret = sendmmsg(s->sd, &s->out.msgs[sent], nmsgs - sent, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			/* Wait until the socket buffer has room again */
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				struct pollfd pfd = { .fd = s->sd, .events = POLLOUT, .revents = 0 };
+
+				ret = poll(&pfd, 1, -1);
+				if (ret >= 0 || errno == EINTR)
+					continue;
+			}
+
+			warning("Failed sendmmsg() to node %s: %s", node_name(n), strerror(errno));
+			break;
+		}
+
+		sent += ret;
 	}
 
-	/* Send message */
+	return sent > 0 ? (int) sent : -1;
+}
+#endif /* __linux__ */
+
+int socket_write(struct node *n, struct sample *smps[], unsigned cnt, unsigned *release)
+{
+	struct socket *s = (struct socket *) n->_vd;
+
+	int ret;
+	ssize_t bytes;
+	size_t wbytes;
+
+	/* Determine length of destination address */
 	socklen_t addrlen = 0;
 	switch(s->in.saddr.ss.ss_family) {
 		case AF_INET:
@@ -433,6 +627,29 @@ retry:	ret = io_sprint(&s->io, s->out.buf, s->out.buflen, &wbytes, smps, cnt);
 			addrlen = sizeof(s->in.saddr);
 	}
 
+#ifdef __linux__
+	if (s->batch)
+		return socket_write_batch(n, smps, cnt, addrlen);
+#endif /* __linux__ */
+
+retry:	ret = io_sprint(&s->io, s->out.buf, s->out.buflen, &wbytes, smps, cnt);
+	if (ret < 0) {
+		warning("Failed to format payload: reason=%d", ret);
+		return ret;
+	}
+
+	if (wbytes == 0) {
+		warning("Failed to format payload: wbytes=%zu", wbytes);
+		return -1;
+	}
+
+	if (wbytes > s->out.buflen) {
+		s->out.buflen = wbytes;
+		s->out.buf = (char *) realloc(s->out.buf, s->out.buflen);
+		goto retry;
+	}
+
+	/* Send message */
 retry2:	bytes = sendto(s->sd, s->out.buf, wbytes, 0, (struct sockaddr *) &s->out.saddr, addrlen);
 	if (bytes < 0) {
 		if ((errno == EPERM) ||
@@ -467,16 +684,22 @@ int socket_parse(struct node *n, json_t *cfg)
 	/* Default values */
 	s->layer = SocketLayer::UDP;
 	s->verify_source = 0;
+	s->batch = 0;
+	s->busy_poll = 0;
+	s->rcvbuf = 0;
 
-	ret = json_unpack_ex(cfg, &err, 0, "{ s?: s, s?: s, s: { s: s }, s: { s: s, s?: b, s?: o } }",
+	ret = json_unpack_ex(cfg, &err, 0, "{ s?: s, s?: s, s?: b, s: { s: s }, s: { s: s, s?: b, s?: o, s?: i, s?: i } }",
 		"layer", &layer,
 		"format", &format,
+		"batch", &s->batch,
 		"out",
 			"address", &remote,
 		"in",
 			"address", &local,
 			"verify_source", &s->verify_source,
-			"multicast", &json_multicast
+			"multicast", &json_multicast,
+			"busy_poll", &s->busy_poll,
+			"buffer_size", &s->rcvbuf
 	);
 	if (ret)
 		jerror(&err, "Failed to parse configuration of node %s", node_name(n));
@@ -43,6 +43,7 @@ using namespace villas::utils;
 
 /* Private static storage */
 static struct vlist connections = { .state = State::DESTROYED };	/**< List of active libwebsocket connections which receive samples from all nodes (catch all) */
+static pthread_rwlock_t connections_lock = PTHREAD_RWLOCK_INITIALIZER;	/**< Connections are added and removed by all web service threads. */
 
 static villas::node::Web *web;
 
@@ -80,16 +81,202 @@ static void websocket_destination_destroy(struct websocket_destination *d)
 	free((char *) d->info.address);
 }
 
+static void websocket_frame_decref(struct websocket_frame *f)
+{
+	if (atomic_fetch_sub(&f->refcnt, 1) == 1)
+		free(f);
+}
+
+/** Get the encoder of node \p n for format \p fmt or create a new one. */
+static struct websocket_encoder * websocket_encoder_get(struct node *n, struct format_type *fmt)
+{
+	int ret;
+	struct websocket *w = (struct websocket *) n->_vd;
+	struct websocket_encoder *e = nullptr;
+
+	pthread_mutex_lock(&w->mutex);
+
+	for (size_t i = 0; i < vlist_length(&w->encoders); i++) {
+		struct websocket_encoder *f = (struct websocket_encoder *) vlist_at(&w->encoders, i);
+
+		if (f->format == fmt) {
+			e = f;
+			goto out;
+		}
+	}
+
+	e = (struct websocket_encoder *) alloc(sizeof(struct websocket_encoder));
+
+	e->format = fmt;
+	e->io.state = State::DESTROYED;
+
+	ret = io_init(&e->io, fmt, &n->in.signals, (int) SampleFlags::HAS_ALL & ~(int) SampleFlags::HAS_OFFSET);
+	if (!ret)
+		ret = io_check(&e->io);
+
+	if (ret) {
+		free(e);
+		e = nullptr;
+		goto out;
+	}
+
+	vlist_push(&w->encoders, e);
+
+out:	pthread_mutex_unlock(&w->mutex);
+
+	return e;
+}
+
+static int websocket_encoder_destroy(struct websocket_encoder *e)
+{
+	int ret;
+
+	ret = io_destroy(&e->io);
+	if (ret)
+		return ret;
+
+	free(e);
+
+	return 0;
+}
+
+/** Serialize samples into frames of at most websocket::batch::bytes and queue them to connections of the encoder. */
+static void websocket_encode(struct node *n, struct websocket_encoder *e, struct sample *smps[], unsigned cnt)
+{
+	int ret;
+	struct websocket *w = (struct websocket *) n->_vd;
+	unsigned off = 0;
+	bool used = false;
+
+	/* Skip formats which are not used by any connection anymore */
+	pthread_rwlock_rdlock(&connections_lock);
+
+	for (size_t i = 0; i < vlist_length(&connections) && !used; i++) {
+		struct websocket_connection *c = (struct websocket_connection *) vlist_at(&connections, i);
+
+		used = c->node == n && c->encoder == e && c->state == websocket_connection::State::INITIALIZED;
+	}
+
+	pthread_rwlock_unlock(&connections_lock);
+
+	if (!used)
+		return;
+
+	while (off < cnt) {
+		unsigned len = cnt - off;
+		size_t wbytes;
+
+		/* Halve the number of samples until they fit into a single frame */
+		for (;;) {
+			ret = io_sprint(&e->io, w->buffer, w->batch.bytes, &wbytes, &smps[off], len);
+			if (ret == (int) len && wbytes < w->batch.bytes)
+				break;
+
+			if (len == 1)
+				break;
+
+			len /= 2;
+		}
+
+		if (ret != (int) len || wbytes >= w->batch.bytes) {
+			warning("Failed to serialize sample for node %s: frame exceeds %zu bytes", node_name(n), w->batch.bytes);
+			off += len;
+			continue;
+		}
+
+		auto *f = (struct websocket_frame *) alloc(sizeof(struct websocket_frame) + LWS_PRE + wbytes);
+
+		f->refcnt = 1;
+		f->binary = e->io.flags & (int) IOFlags::HAS_BINARY_PAYLOAD;
+		f->cnt = len;
+		f->len = wbytes;
+
+		memcpy(f->data + LWS_PRE, w->buffer, wbytes);
+
+		pthread_rwlock_rdlock(&connections_lock);
+
+		for (size_t i = 0; i < vlist_length(&connections); i++) {
+			struct websocket_connection *c = (struct websocket_connection *) vlist_at(&connections, i);
+
+			if (c->node != n || c->encoder != e || c->state != websocket_connection::State::INITIALIZED)
+				continue;
+
+			f->refcnt++;
+
+			ret = queue_push(&c->queue, f);
+			if (ret != 1) {
+				f->refcnt--;
+				warning("Queue overrun in WebSocket connection: %s", websocket_connection_name(c));
+				continue;
+			}
+
+			debug(LOG_WEBSOCKET | 10, "Enqueued %u samples to %s", len, websocket_connection_name(c));
+
+			/* Client connections which are currently conecting don't have an associate c->wsi yet */
+			if (c->wsi)
+				web->callbackOnWritable(c->wsi, c->tsi);
+		}
+
+		pthread_rwlock_unlock(&connections_lock);
+
+		websocket_frame_decref(f);
+
+		off += len;
+	}
+}
+
+/** Encode all pending samples once per format. Must be called with websocket::mutex held. */
+static void websocket_flush(struct node *n)
+{
+	struct websocket *w = (struct websocket *) n->_vd;
+
+	if (w->npending == 0)
+		return;
+
+	for (size_t i = 0; i < vlist_length(&w->encoders); i++) {
+		struct websocket_encoder *e = (struct websocket_encoder *) vlist_at(&w->encoders, i);
+
+		websocket_encode(n, e, w->pending, w->npending);
+	}
+
+	sample_decref_many(w->pending, w->npending);
+	w->npending = 0;
+}
+
+/** Check if any connection of node \p n has frames which have not been sent yet. */
+static bool websocket_backlog(struct node *n)
+{
+	bool backlog = false;
+
+	pthread_rwlock_rdlock(&connections_lock);
+
+	for (size_t i = 0; i < vlist_length(&connections) && !backlog; i++) {
+		struct websocket_connection *c = (struct websocket_connection *) vlist_at(&connections, i);
+
+		backlog = c->node == n && c->state == websocket_connection::State::INITIALIZED && queue_available(&c->queue) > 0;
+	}
+
+	pthread_rwlock_unlock(&connections_lock);
+
+	return backlog;
+}
+
 static int websocket_connection_init(struct websocket_connection *c)
 {
 	int ret;
 
 	c->_name = nullptr;
 
-	ret = queue_init(&c->queue, DEFAULT_QUEUE_LENGTH, &memory_hugepage);
+	struct websocket *w = (struct websocket *) c->node->_vd;
+
+	ret = queue_init(&c->queue, w->queuelen, &memory_hugepage);
 	if (ret)
 		return ret;
 
+	c->encoder = websocket_encoder_get(c->node, c->format);
+	if (!c->encoder)
+		return -1;
+
 	ret = io_init(&c->io, c->format, &c->node->in.signals, (int) SampleFlags::HAS_ALL & ~(int) SampleFlags::HAS_OFFSET);
 	if (ret)
 		return ret;
@@ -120,11 +307,11 @@ static int websocket_connection_destroy(struct websocket_connection *c)
 	if (c->_name)
 		free(c->_name);
 
-	/* Return all samples to pool */
+	/* Release all frames which have not been sent */
 	int avail;
-	struct sample *smp;
-	while ((avail = queue_pull(&c->queue, (void **) &smp)))
-		sample_decref(smp);
+	struct websocket_frame *f;
+	while ((avail = queue_pull(&c->queue, (void **) &f)) > 0)
+		websocket_frame_decref(f);
 
 	ret = queue_destroy(&c->queue);
 	if (ret)
@@ -150,28 +337,6 @@ static int websocket_connection_destroy(struct websocket_connection *c)
 	return 0;
 }
 
-static int websocket_connection_write(struct websocket_connection *c, struct sample *smps[], unsigned cnt)
-{
-	int pushed;
-
-	if (c->state != websocket_connection::State::INITIALIZED)
-		return -1;
-
-	pushed = queue_push_many(&c->queue, (void **) smps, cnt);
-	if (pushed < (int) cnt)
-		warning("Queue overrun in WebSocket connection: %s", websocket_connection_name(c));
-
-	sample_incref_many(smps, pushed);
-
-	debug(LOG_WEBSOCKET | 10, "Enqueued %u samples to %s", pushed, websocket_connection_name(c));
-
-	/* Client connections which are currently conecting don't have an associate c->wsi yet */
-	if (c->wsi)
-		web->callbackOnWritable(c->wsi);
-
-	return 0;
-}
-
 static void websocket_connection_close(struct websocket_connection *c, struct lws *wsi, enum lws_close_status status, const char *reason)
 {
 	lws_close_reason(wsi, status, (unsigned char *) reason, strlen(reason));
@@ -188,6 +353,7 @@ int websocket_protocol_cb(struct lws *wsi, enum lws_callback_reasons reason, voi
 		case LWS_CALLBACK_CLIENT_ESTABLISHED:
 		case LWS_CALLBACK_ESTABLISHED:
 			c->wsi = wsi;
+			c->tsi = web->getServiceThread();
 			c->state = websocket_connection::State::ESTABLISHED;
 
 			info("Established WebSocket connection: %s", websocket_connection_name(c));
@@ -249,7 +415,17 @@ int websocket_protocol_cb(struct lws *wsi, enum lws_callback_reasons reason, voi
 				return -1;
 			}
 
+			pthread_rwlock_wrlock(&connections_lock);
 			vlist_push(&connections, c);
+			pthread_rwlock_unlock(&connections_lock);
+
+			/* Only has an effect if the extension has been negotiated */
+			if (((struct websocket *) c->node->_vd)->compression_level >= 0) {
+				char level[8];
+
+				snprintf(level, sizeof(level), "%d", ((struct websocket *) c->node->_vd)->compression_level);
+				lws_set_extension_option(wsi, "permessage-deflate", "compression_level", level);
+			}
 
 			debug(LOG_WEBSOCKET | 10, "Initialized WebSocket connection: %s", websocket_connection_name(c));
 			break;
@@ -268,8 +444,11 @@ int websocket_protocol_cb(struct lws *wsi, enum lws_callback_reasons reason, voi
 				/** @todo Attempt reconnect here */
 			}
 
-			if (connections.state == State::INITIALIZED)
+			if (connections.state == State::INITIALIZED) {
+				pthread_rwlock_wrlock(&connections_lock);
 				vlist_remove_all(&connections, c);
+				pthread_rwlock_unlock(&connections_lock);
+			}
 
 			if (c->state == websocket_connection::State::INITIALIZED)
 				websocket_connection_destroy(c);
@@ -281,21 +460,23 @@ int websocket_protocol_cb(struct lws *wsi, enum lws_callback_reasons reason, voi
 
 		case LWS_CALLBACK_CLIENT_WRITEABLE:
 		case LWS_CALLBACK_SERVER_WRITEABLE: {
-			struct sample **smps = (struct sample **) alloca(cnt * sizeof(struct sample *));
+			struct websocket_frame *f;
 
-			pulled = queue_pull_many(&c->queue, (void **) smps, cnt);
+			pulled = queue_pull(&c->queue, (void **) &f);
 			if (pulled > 0) {
-				size_t wbytes;
-				io_sprint(&c->io, c->buffers.send.buf + LWS_PRE, c->buffers.send.size - LWS_PRE, &wbytes, smps, pulled);
+				/* lws_write() needs headroom and masks client frames in-place. So we can not send the shared frame directly */
+				buffer_clear(&c->buffers.send);
+
+				ret = buffer_append(&c->buffers.send, f->data, LWS_PRE + f->len);
+				if (!ret)
+					ret = lws_write(wsi, (unsigned char *) c->buffers.send.buf + LWS_PRE, f->len, f->binary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT);
 
-				ret = lws_write(wsi, (unsigned char *) c->buffers.send.buf + LWS_PRE, wbytes, c->io.flags & (int) IOFlags::HAS_BINARY_PAYLOAD ? LWS_WRITE_BINARY : LWS_WRITE_TEXT);
+				debug(LOG_WEBSOCKET | 10, "Send %u samples to connection: %s, bytes=%d", f->cnt, websocket_connection_name(c), ret);
 
-				sample_decref_many(smps, pulled);
+				websocket_frame_decref(f);
 
 				if (ret < 0)
 					return ret;
-
-				debug(LOG_WEBSOCKET | 10, "Send %d samples to connection: %s, bytes=%d", pulled, websocket_connection_name(c), ret);
 			}
 
 			if (queue_available(&c->queue) > 0)
@@ -304,6 +485,17 @@ int websocket_protocol_cb(struct lws *wsi, enum lws_callback_reasons reason, voi
 				websocket_connection_close(c, wsi, LWS_CLOSE_STATUS_GOINGAWAY, "Node stopped");
 				return -1;
 			}
+			else {
+				struct websocket *w = (struct websocket *) c->node->_vd;
+
+				/* The connection has caught up: send samples which have been held back */
+				pthread_mutex_lock(&w->mutex);
+
+				if (!websocket_backlog(c->node))
+					websocket_flush(c->node);
+
+				pthread_mutex_unlock(&w->mutex);
+			}
 
 			break;
 		}
@@ -399,6 +591,10 @@ int websocket_start(struct node *n)
 	if (ret)
 		return ret;
 
+	w->pending = (struct sample **) alloc(w->batch.samples * sizeof(struct sample *));
+	w->buffer = (char *) alloc(w->batch.bytes);
+	w->npending = 0;
+
 	for (size_t i = 0; i < vlist_length(&w->destinations); i++) {
 		const char *format;
 		struct websocket_destination *d = (struct websocket_destination *) vlist_at(&w->destinations, i);
@@ -434,6 +630,8 @@ int websocket_stop(struct node *n)
 	int ret, open_connections = 0;;
 	struct websocket *w = (struct websocket *) n->_vd;
 
+	pthread_rwlock_rdlock(&connections_lock);
+
 	for (size_t i = 0; i < vlist_length(&connections); i++) {
 		struct websocket_connection *c = (struct websocket_connection *) vlist_at(&connections, i);
 
@@ -442,7 +640,8 @@ int websocket_stop(struct node *n)
 
 		c->state = websocket_connection::State::SHUTDOWN;
 
-		lws_callback_on_writable(c->wsi);
+		if (c->wsi)
+			web->callbackOnWritable(c->wsi, c->tsi);
 	}
 
 	/* Count open connections belonging to this node */
@@ -453,11 +652,26 @@ int websocket_stop(struct node *n)
 			open_connections++;
 	}
 
+	pthread_rwlock_unlock(&connections_lock);
+
 	if (open_connections > 0) {
 		info("Waiting for shutdown of %u connections...", open_connections);
 		sleep(1);
 	}
 
+	pthread_mutex_lock(&w->mutex);
+
+	sample_decref_many(w->pending, w->npending);
+	w->npending = 0;
+
+	free(w->pending);
+	free(w->buffer);
+
+	w->pending = nullptr;
+	w->buffer = nullptr;
+
+	pthread_mutex_unlock(&w->mutex);
+
 	ret = queue_signalled_close(&w->queue);
 	if (ret)
 		return ret;
@@ -482,6 +696,12 @@ int websocket_destroy(struct node *n)
 	if (ret)
 		return ret;
 
+	ret = vlist_destroy(&w->encoders, (dtor_cb_t) websocket_encoder_destroy, false);
+	if (ret)
+		return ret;
+
+	pthread_mutex_destroy(&w->mutex);
+
 	return 0;
 }
 
@@ -516,14 +736,30 @@ int websocket_write(struct node *n, struct sample *smps[], unsigned cnt, unsigne
 
 	sample_copy_many(cpys, smps, avail);
 
-	for (size_t i = 0; i < vlist_length(&connections); i++) {
-		struct websocket_connection *c = (struct websocket_connection *) vlist_at(&connections, i);
+	pthread_mutex_lock(&w->mutex);
 
-		if (c->node == n)
-			websocket_connection_write(c, cpys, cnt);
+	for (int i = 0; i < avail; i++) {
+		if (w->npending == w->batch.samples)
+			websocket_flush(n);
+
+		if (w->npending == 0)
+			w->first = time_now();
+
+		w->pending[w->npending++] = cpys[i];
 	}
 
-	sample_decref_many(cpys, avail);
+	/* Samples are held back while clients are still busy with previous frames.
+	 * This adapts the frame size to the speed of the clients. */
+	if (w->npending > 0) {
+		struct timespec now = time_now();
+
+		if (w->npending >= w->batch.samples ||
+		    time_delta(&w->first, &now) >= w->batch.delay ||
+		    !websocket_backlog(n))
+			websocket_flush(n);
+	}
+
+	pthread_mutex_unlock(&w->mutex);
 
 	return cnt;
 }
@@ -538,12 +774,42 @@ int websocket_parse(struct node *n, json_t *cfg)
 	json_t *json_dest;
 	json_error_t err;
 
-	vlist_init(&w->destinations);
+	int batch_samples = DEFAULT_WEBSOCKET_BATCH_SAMPLES;
+	int batch_bytes = DEFAULT_WEBSOCKET_BATCH_BYTES;
 
-	ret = json_unpack_ex(cfg, &err, 0, "{ s?: o }", "destinations", &json_dests);
+	vlist_init(&w->destinations);
+	vlist_init(&w->encoders);
+
+	pthread_mutex_init(&w->mutex, nullptr);
+
+	w->queuelen = DEFAULT_QUEUE_LENGTH;
+	w->batch.delay = DEFAULT_WEBSOCKET_BATCH_DELAY;
+	w->compression_level = -1;
+
+	ret = json_unpack_ex(cfg, &err, 0, "{ s?: o, s?: i, s?: { s?: i, s?: i, s?: F }, s?: i }",
+		"destinations", &json_dests,
+		"queuelen", &w->queuelen,
+		"batch",
+			"samples", &batch_samples,
+			"bytes", &batch_bytes,
+			"delay", &w->batch.delay,
+		"compression_level", &w->compression_level
+	);
 	if (ret)
 		jerror(&err, "Failed to parse configuration of node %s", node_name(n));
 
+	if (w->queuelen <= 0 || !IS_POW2(w->queuelen))
+		error("Setting 'queuelen' of node %s must be a positive power of 2", node_name(n));
+
+	if (batch_samples <= 0 || batch_bytes <= 0)
+		error("Settings 'batch.samples' and 'batch.bytes' of node %s must be positive", node_name(n));
+
+	if (w->compression_level > 9)
+		error("Setting 'compression_level' of node %s must be between 0 and 9", node_name(n));
+
+	w->batch.samples = batch_samples;
+	w->batch.bytes = batch_bytes;
+
 	if (json_dests) {
 		if (!json_is_array(json_dests))
 			error("The 'destinations' setting of node %s must be an array of URLs", node_name(n));
@@ -597,7 +863,11 @@ char * websocket_print(struct node *n)
 		);
 	}
 
-	buf = strcatf(&buf, "]");
+	buf = strcatf(&buf, "], queuelen=%d, batch.samples=%u, batch.bytes=%zu, batch.delay=%.3f",
+		w->queuelen, w->batch.samples, w->batch.bytes, w->batch.delay);
+
+	if (w->compression_level >= 0)
+		buf = strcatf(&buf, ", compression_level=%d", w->compression_level);
 
 	return buf;
 }
@@ -27,6 +27,8 @@
 
 #include <unistd.h>
 #include <poll.h>
+#include <sched.h>
+#include <pthread.h>
 
 #include <villas/node/config.h>
 #include <villas/utils.hpp>
@@ -44,6 +46,10 @@
 #include <villas/path_source.h>
 #include <villas/path_destination.h>
 
+#ifdef HAS_EPOLL
+  #include <villas/path_scheduler.hpp>
+#endif /* HAS_EPOLL */
+
 using namespace villas;
 using namespace villas::node;
 using namespace villas::utils;
@@ -61,14 +67,95 @@ static void * path_run_single(void *arg)
 		if (ret <= 0)
 			continue;
 
-		for (size_t i = 0; i < vlist_length(&p->destinations); i++) {
-			struct path_destination *pd = (struct path_destination *) vlist_at(&p->destinations, i);
+		path_write_destinations(p);
+	}
+
+	return nullptr;
+}
+
+void path_process_fd(struct path *p, int i)
+{
+	struct path_source *ps = (struct path_source *) vlist_at(&p->sources, i);
+
+	/* Timeout: re-enqueue the last sample */
+	if (p->reader.pfds[i].fd == task_fd(&p->timeout)) {
+		task_wait(&p->timeout);
+
+		if (p->copy_on_write) {
+			/* The last sample might be still referenced by the destination queues */
+			struct sample *smp = sample_clone(p->last_sample);
+			if (!smp) {
+				p->logger->warn("Pool underrun in path {}", path_name(p));
+				return;
+			}
+
+			smp->sequence = p->last_sequence++;
+
+			path_destination_enqueue(p, &smp, 1);
+
+			sample_decref(smp);
+		}
+		else {
+			p->last_sample->sequence = p->last_sequence++;
 
-			path_destination_write(pd, p);
+			path_destination_enqueue(p, &p->last_sample, 1);
 		}
 	}
+	/* A source is ready to receive samples */
+	else
+		path_source_read(ps, p, i);
+}
 
-	return nullptr;
+void path_write_destinations(struct path *p)
+{
+	for (size_t i = 0; i < vlist_length(&p->destinations); i++) {
+		struct path_destination *pd = (struct path_destination *) vlist_at(&p->destinations, i);
+
+		path_destination_write(pd, p);
+	}
+}
+
+/** Wait until one of the sources of a path is ready.
+ *
+ * In busy polling mode we first spin on poll(2) without a timeout
+ * for the configured budget before we block.
+ */
+static int path_poll(struct path *p)
+{
+	int ret;
+	struct timespec start, now;
+
+	if (p->busy_poll) {
+		double budget = p->busy_poll * 1e-6;
+
+		start = time_now();
+
+		do {
+			ret = poll(p->reader.pfds, p->reader.nfds, 0);
+
+			now = time_now();
+
+			if (ret != 0) {
+				p->busy.spin_time += time_delta(&start, &now);
+				p->busy.spins++;
+
+				return ret;
+			}
+		} while (p->busy_poll < 0 || time_delta(&start, &now) < budget);
+
+		p->busy.spin_time += time_delta(&start, &now);
+	}
+
+	start = time_now();
+
+	ret = poll(p->reader.pfds, p->reader.nfds, -1);
+
+	now = time_now();
+
+	p->busy.sleep_time += time_delta(&start, &now);
+	p->busy.sleeps++;
+
+	return ret;
 }
 
 /** Main thread function per path: read samples -> write samples */
@@ -78,35 +165,18 @@ static void * path_run_poll(void *arg)
 	struct path *p = (struct path *) arg;
 
 	while (p->state == State::STARTED) {
-		ret = poll(p->reader.pfds, p->reader.nfds, -1);
+		ret = path_poll(p);
 		if (ret < 0)
 			serror("Failed to poll");
 
 		p->logger->debug("Path {} returned from poll(2)", path_name(p));
 
 		for (int i = 0; i < p->reader.nfds; i++) {
-			struct path_source *ps = (struct path_source *) vlist_at(&p->sources, i);
-
-			if (p->reader.pfds[i].revents & POLLIN) {
-				/* Timeout: re-enqueue the last sample */
-				if (p->reader.pfds[i].fd == task_fd(&p->timeout)) {
-					task_wait(&p->timeout);
-
-					p->last_sample->sequence = p->last_sequence++;
-
-					path_destination_enqueue(p, &p->last_sample, 1);
-				}
-				/* A source is ready to receive samples */
-				else
-					path_source_read(ps, p, i);
-			}
+			if (p->reader.pfds[i].revents & POLLIN)
+				path_process_fd(p, i);
 		}
 
-		for (size_t i = 0; i < vlist_length(&p->destinations); i++) {
-			struct path_destination *pd = (struct path_destination *) vlist_at(&p->destinations, i);
-
-			path_destination_write(pd, p);
-		}
+		path_write_destinations(p);
 	}
 
 	return nullptr;
@@ -151,6 +221,8 @@ int path_init(struct path *p)
 	p->reader.pfds = nullptr;
 	p->reader.nfds = 0;
 
+	p->scheduler = nullptr;
+
 	/* Default values */
 	p->mode = PathMode::ANY;
 	p->rate = 0; /* Disabled */
@@ -161,6 +233,17 @@ int path_init(struct path *p)
 	p->poll = -1;
 	p->queuelen = DEFAULT_QUEUE_LENGTH;
 	p->original_sequence_no = -1;
+	p->copy_on_write = 0;
+	p->last_shared = 0;
+	p->affinity = 0;
+	p->priority = 0;
+	p->sched = SCHED_FIFO;
+	p->numa_node = -1;
+	p->busy_poll = 0;
+	p->busy.spins = 0;
+	p->busy.sleeps = 0;
+	p->busy.spin_time = 0;
+	p->busy.sleep_time = 0;
 
 	p->state = State::INITIALIZED;
 
@@ -227,18 +310,34 @@ int path_prepare(struct path *p)
 
 	/* Initialize destinations */
 	struct memory_type *pool_mt = &memory_hugepage;
+	struct memory_type *queue_mt = &memory_hugepage;
+
+	if (p->numa_node >= 0) {
+		pool_mt = queue_mt = memory_numa(p->numa_node);
+		if (!pool_mt) {
+			p->logger->error("NUMA node {} of path {} does not exist", p->numa_node, path_name(p));
+			return -1;
+		}
+	}
 	unsigned pool_size = MAX(1UL, vlist_length(&p->destinations)) * p->queuelen;
 
+	/* The destination queues are filled by path_destination_enqueue() and drained by
+	 * path_destination_write(). Both are only called by the thread which runs the path
+	 * or by the scheduler worker which currently owns it. So there is never more than
+	 * one producer and one consumer at a time. */
+	enum QueueMode queue_mode = QueueMode::SPSC;
+
 	for (size_t i = 0; i < vlist_length(&p->destinations); i++) {
 		struct path_destination *pd = (struct path_destination *) vlist_at(&p->destinations, i);
 
 		if (node_type(pd->node)->pool_size > pool_size)
 			pool_size = node_type(pd->node)->pool_size;
 
+		/* Node specific memory types take precedence over the NUMA placement */
 		if (node_type(pd->node)->memory_type)
 			pool_mt = node_memory_type(pd->node, &memory_hugepage);
 
-		ret = path_destination_init(pd, p->queuelen);
+		ret = path_destination_init(pd, p->queuelen, queue_mt, queue_mode);
 		if (ret)
 			return ret;
 	}
@@ -298,11 +397,30 @@ int path_prepare(struct path *p)
 	hook_list_prepare(&p->hooks, &p->signals, m, p, nullptr);
 #endif /* WITH_HOOKS */
 
+	if (p->copy_on_write) {
+#ifdef WITH_HOOKS
+		/* We can only keep a reference to the last muxed sample if the path hooks leave it untouched */
+		p->last_shared = hook_list_is_read_only(&p->hooks);
+
+		for (size_t i = 0; i < vlist_length(&p->destinations); i++) {
+			struct path_destination *pd = (struct path_destination *) vlist_at(&p->destinations, i);
+
+			pd->unshare = !hook_list_is_read_only(&pd->node->out.hooks);
+		}
+#else
+		p->last_shared = 1;
+#endif /* WITH_HOOKS */
+	}
+
 	/* Initialize pool */
 	ret = pool_init(&p->pool, pool_size, SAMPLE_LENGTH(vlist_length(&p->signals)), pool_mt);
 	if (ret)
 		return ret;
 
+	ret = pool_cache_init(&p->pool);
+	if (ret)
+		return ret;
+
 	if (p->original_sequence_no == -1)
 		p->original_sequence_no = vlist_length(&p->sources) == 1;
 
@@ -322,12 +440,13 @@ int path_parse(struct path *p, json_t *cfg, struct vlist *nodes)
 	json_t *json_mask = nullptr;
 
 	const char *mode = nullptr;
+	const char *sched = nullptr;
 
 	struct vlist destinations = { .state = State::DESTROYED };
 
 	vlist_init(&destinations);
 
-	ret = json_unpack_ex(cfg, &err, 0, "{ s: o, s?: o, s?: o, s?: b, s?: b, s?: b, s?: i, s?: s, s?: b, s?: F, s?: o, s?: b}",
+	ret = json_unpack_ex(cfg, &err, 0, "{ s: o, s?: o, s?: o, s?: b, s?: b, s?: b, s?: i, s?: s, s?: b, s?: F, s?: o, s?: b, s?: b, s?: i, s?: i, s?: s, s?: i, s?: i }",
 		"in", &json_in,
 		"out", &json_out,
 		"hooks", &json_hooks,
@@ -339,7 +458,13 @@ int path_parse(struct path *p, json_t *cfg, struct vlist *nodes)
 		"poll", &p->poll,
 		"rate", &p->rate,
 		"mask", &json_mask,
-		"original_sequence_no", &p->original_sequence_no
+		"original_sequence_no", &p->original_sequence_no,
+		"copy_on_write", &p->copy_on_write,
+		"affinity", &p->affinity,
+		"priority", &p->priority,
+		"sched", &sched,
+		"numa_node", &p->numa_node,
+		"busy_poll", &p->busy_poll
 	);
 	if (ret)
 		jerror(&err, "Failed to parse path configuration");
@@ -352,6 +477,17 @@ int path_parse(struct path *p, json_t *cfg, struct vlist *nodes)
 	}
 
 	/* Optional settings */
+	if (sched) {
+		if      (!strcmp(sched, "fifo"))
+			p->sched = SCHED_FIFO;
+		else if (!strcmp(sched, "rr"))
+			p->sched = SCHED_RR;
+		else {
+			p->logger->error("Invalid scheduling policy '{}' of path {}", sched, path_name(p));
+			return -1;
+		}
+	}
+
 	if (mode) {
 		if      (!strcmp(mode, "any"))
 			p->mode = PathMode::ANY;
@@ -412,6 +548,7 @@ int path_parse(struct path *p, json_t *cfg, struct vlist *nodes)
 		struct path_destination *pd = (struct path_destination *) alloc(sizeof(struct path_destination));
 
 		pd->node = n;
+		pd->unshare = false;
 
 		if (!node_is_enabled(pd->node)) {
 			p->logger->error("Destination {} of path {} is not enabled", node_name(pd->node), path_name(p));
@@ -509,6 +646,26 @@ int path_check(struct path *p)
 		return -1;
 	}
 
+	if (p->priority < 0 || p->priority > sched_get_priority_max(p->sched)) {
+		p->logger->error("Setting 'priority' of path {} must be in the range 0 to {}", path_name(p), sched_get_priority_max(p->sched));
+		return -1;
+	}
+
+	if (p->busy_poll && !p->poll) {
+		p->logger->error("Setting 'busy_poll' of path {} requires setting 'poll'", path_name(p));
+		return -1;
+	}
+
+	if (p->busy_poll < -1) {
+		p->logger->error("Setting 'busy_poll' of path {} must be a positive number or -1", path_name(p));
+		return -1;
+	}
+
+	if (p->numa_node < -1) {
+		p->logger->error("Setting 'numa_node' of path {} must be a positive number", path_name(p));
+		return -1;
+	}
+
 	if (p->poll) {
 		if (p->rate <= 0) {
 			/* Check that all path sources provide a file descriptor for polling */
@@ -587,7 +744,8 @@ int path_start(struct path *p)
 
 	p->logger->info("Starting path {}: #signals={}, #hooks={}, #sources={}, "
 	                "#destinations={}, mode={}, poll={}, mask={:b}, rate={}, "
-					"enabled={}, reversed={}, queuelen={}, original_sequence_no={}",
+					"enabled={}, reversed={}, queuelen={}, original_sequence_no={}, copy_on_write={}, "
+					"affinity={:#x}, priority={}, numa_node={}, busy_poll={}",
 		path_name(p),
 		vlist_length(&p->signals),
 		vlist_length(&p->hooks),
@@ -600,7 +758,12 @@ int path_start(struct path *p)
 		path_is_enabled(p) ? "yes" : "no",
 		path_is_reversed(p) ? "yes" : "no",
 		p->queuelen,
-		p->original_sequence_no ? "yes" : "no"
+		p->original_sequence_no ? "yes" : "no",
+		p->copy_on_write ? "yes" : "no",
+		p->affinity,
+		p->priority,
+		p->numa_node,
+		p->busy_poll
 	);
 
 #ifdef WITH_HOOKS
@@ -636,6 +799,15 @@ int path_start(struct path *p)
 
 	p->state = State::STARTED;
 
+#ifdef HAS_EPOLL
+	/* Polling paths can be multiplexed onto the worker threads of the scheduler */
+	if (p->scheduler) {
+		p->scheduler->add(p);
+
+		return 0;
+	}
+#endif /* HAS_EPOLL */
+
 	/* Start one thread per path for sending to destinations
 	 *
 	 * Special case: If the path only has a single source and this source
@@ -646,6 +818,29 @@ int path_start(struct path *p)
 	if (ret)
 		return ret;
 
+	if (p->affinity) {
+		cpu_set_t cset;
+
+		CPU_ZERO(&cset);
+		for (int i = 0; i < (int) sizeof(p->affinity) * 8; i++) {
+			if (p->affinity & (1u << i))
+				CPU_SET(i, &cset);
+		}
+
+		ret = pthread_setaffinity_np(p->tid, sizeof(cset), &cset);
+		if (ret)
+			p->logger->warn("Failed to set affinity of path {}: {}", path_name(p), strerror(ret));
+	}
+
+	if (p->priority > 0) {
+		struct sched_param param;
+		param.sched_priority = p->priority;
+
+		ret = pthread_setschedparam(p->tid, p->sched, &param);
+		if (ret)
+			p->logger->warn("Failed to set real-time priority of path {}: {}", path_name(p), strerror(ret));
+	}
+
 	return 0;
 }
 
@@ -661,17 +856,25 @@ int path_stop(struct path *p)
 	if (p->state != State::STOPPING)
 		p->state = State::STOPPING;
 
-	/* Cancel the thread in case is currently in a blocking syscall.
-	 *
-	 * We dont care if the thread has already been terminated.
-	 */
-	ret = pthread_cancel(p->tid);
-	if (ret && ret != ESRCH)
-	 	return ret;
+	/* Scheduled paths have no thread of their own.
+	 * The workers of the scheduler have already been stopped by the super-node. */
+	if (!p->scheduler) {
+		/* Cancel the thread in case is currently in a blocking syscall.
+		 *
+		 * We dont care if the thread has already been terminated.
+		 */
+		ret = pthread_cancel(p->tid);
+		if (ret && ret != ESRCH)
+			return ret;
 
-	ret = pthread_join(p->tid, nullptr);
-	if (ret)
-		return ret;
+		ret = pthread_join(p->tid, nullptr);
+		if (ret)
+			return ret;
+	}
+
+	if (p->busy_poll)
+		p->logger->info("Busy polling of path {}: spins={}, sleeps={}, spin_time={:.3f}s, sleep_time={:.3f}s",
+			path_name(p), p->busy.spins, p->busy.sleeps, p->busy.spin_time, p->busy.sleep_time);
 
 #ifdef WITH_HOOKS
 	hook_list_stop(&p->hooks);
@@ -679,6 +882,15 @@ int path_stop(struct path *p)
 
 	sample_decref(p->last_sample);
 
+	/* Return the blocks which the stopped threads kept in their caches */
+	for (size_t i = 0; i < vlist_length(&p->sources); i++) {
+		struct path_source *ps = (struct path_source *) vlist_at(&p->sources, i);
+
+		pool_cache_flush(&ps->pool);
+	}
+
+	pool_cache_flush(&p->pool);
+
 	p->state = State::STOPPED;
 
 	return 0;
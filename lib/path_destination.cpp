@@ -27,11 +27,11 @@
 #include <villas/path.h>
 #include <villas/path_destination.h>
 
-int path_destination_init(struct path_destination *pd, int queuelen)
+int path_destination_init(struct path_destination *pd, int queuelen, struct memory_type *mt, enum QueueMode mode)
 {
 	int ret;
 
-	ret = queue_init(&pd->queue, queuelen, &memory_hugepage);
+	ret = queue_init(&pd->queue, queuelen, mt, mode);
 	if (ret)
 		return ret;
 
@@ -51,33 +51,65 @@ int path_destination_destroy(struct path_destination *pd)
 
 void path_destination_enqueue(struct path *p, struct sample *smps[], unsigned cnt)
 {
-	unsigned enqueued, cloned;
+	int enqueued;
+	unsigned cloned;
 
 	struct sample *clones[cnt];
+	struct sample **shared;
 
-	cloned = sample_clone_many(clones, smps, cnt);
-	if (cloned < cnt)
-		p->logger->warn("Pool underrun in path {}", path_name(p));
+	/* In copy-on-write mode all destinations share the muxed samples.
+	 * They are only cloned later on if a write hook modifies them. */
+	if (p->copy_on_write) {
+		shared = smps;
+		cloned = cnt;
+	}
+	else {
+		cloned = sample_clone_many(clones, smps, cnt);
+		if (cloned < cnt)
+			p->logger->warn("Pool underrun in path {}", path_name(p));
+
+		shared = clones;
+	}
 
 	for (size_t i = 0; i < vlist_length(&p->destinations); i++) {
 		struct path_destination *pd = (struct path_destination *) vlist_at(&p->destinations, i);
 
-		enqueued = queue_push_many(&pd->queue, (void **) clones, cloned);
-		if (enqueued != cnt)
+		enqueued = queue_push_many(&pd->queue, (void **) shared, cloned);
+		if (enqueued != (int) cnt)
 			p->logger->warn("Queue overrun for path {}", path_name(p));
 
 		/* Increase reference counter of these samples as they are now also owned by the queue. */
-		sample_incref_many(clones, cloned);
+		if (enqueued > 0)
+			sample_incref_many(shared, enqueued);
 
 		p->logger->debug("Enqueued {} samples to destination {} of path {}", enqueued, node_name(pd->node), path_name(p));
 	}
 
-	sample_decref_many(clones, cloned);
+	if (!p->copy_on_write)
+		sample_decref_many(clones, cloned);
+}
+
+int path_destination_unshare(struct sample *smps[], int cnt)
+{
+	for (int i = 0; i < cnt; i++) {
+		if (atomic_load(&smps[i]->refcnt) == 1)
+			continue;
+
+		struct sample *clone = sample_clone(smps[i]);
+		if (!clone)
+			return -1;
+
+		sample_decref(smps[i]);
+		smps[i] = clone;
+	}
+
+	return 0;
 }
 
 void path_destination_write(struct path_destination *pd, struct path *p)
 {
 	int cnt = pd->node->out.vectorize;
+	int ret;
 	int sent;
 	int released;
 	int allocated;
@@ -95,6 +127,15 @@ void path_destination_write(struct path_destination *pd, struct path *p)
 
 		p->logger->debug("Dequeued {} samples from queue of node {} which is part of path {}", allocated, node_name(pd->node), path_name(p));
 
+		if (pd->unshare) {
+			ret = path_destination_unshare(smps, allocated);
+			if (ret) {
+				p->logger->warn("Pool underrun for destination {} of path {}", node_name(pd->node), path_name(p));
+				sample_decref_many(smps, allocated);
+				return;
+			}
+		}
+
 		release = allocated;
 
 		sent = node_write(pd->node, smps, allocated, &release);
@@ -0,0 +1,399 @@
+/** A scheduler which multiplexes paths onto a pool of worker threads.
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <villas/utils.hpp>
+#include <villas/path.h>
+#include <villas/path_scheduler.hpp>
+#include <villas/node/exceptions.hpp>
+
+using namespace villas;
+using namespace villas::node;
+
+/** Maximum number of events returned by a single call to epoll_wait(). */
+#define SCHEDULER_MAX_EVENTS 64
+
+PathScheduler::PathScheduler() :
+	state(State::INITIALIZED),
+	enabled(0),
+	priority(0),
+	affinity(0),
+	count(0),
+	running(false),
+	next(0)
+{
+	logger = logging.get("scheduler");
+}
+
+PathScheduler::~PathScheduler()
+{
+	assert(state != State::STARTED);
+
+	for (Task *t : tasks) {
+		delete[] t->events;
+		delete t;
+	}
+
+	for (Worker *w : workers) {
+		close(w->epfd);
+		close(w->wakefd);
+
+		delete w;
+	}
+}
+
+void PathScheduler::parse(json_t *cfg)
+{
+	int ret;
+	json_error_t err;
+
+	enabled = 1;
+
+	ret = json_unpack_ex(cfg, &err, JSON_STRICT, "{ s?: b, s?: i, s?: i, s?: i }",
+		"enabled", &enabled,
+		"workers", &count,
+		"affinity", &affinity,
+		"priority", &priority
+	);
+	if (ret)
+		throw ConfigError(cfg, err, "node-config-scheduler");
+
+	if (count < 0)
+		throw ConfigError(cfg, "node-config-scheduler", "Setting 'workers' must be a positive number");
+
+	state = State::PARSED;
+}
+
+void PathScheduler::prepare()
+{
+	std::vector<int> cores;
+
+	for (int i = 0; i < (int) sizeof(affinity) * 8; i++) {
+		if (affinity & (1u << i))
+			cores.push_back(i);
+	}
+
+	/* By default we start one worker per core */
+	if (count == 0)
+		count = cores.size() > 0 ? cores.size() : std::thread::hardware_concurrency();
+
+	for (int i = 0; i < count; i++) {
+		auto *w = new Worker;
+
+		w->id = i;
+		w->core = cores.size() > 0 ? cores[i % cores.size()] : -1;
+		w->sleeping = false;
+		w->runs = 0;
+		w->steals = 0;
+
+		w->epfd = epoll_create1(EPOLL_CLOEXEC);
+		if (w->epfd < 0)
+			throw RuntimeError("Failed to create epoll set: {}", strerror(errno));
+
+		w->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (w->wakefd < 0)
+			throw RuntimeError("Failed to create eventfd: {}", strerror(errno));
+
+		/* The wake-up fd is the only one without a user pointer */
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = nullptr;
+
+		if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->wakefd, &ev))
+			throw RuntimeError("Failed to add eventfd to epoll set: {}", strerror(errno));
+
+		workers.push_back(w);
+	}
+
+	state = State::PREPARED;
+}
+
+void PathScheduler::add(struct path *p)
+{
+	assert(state == State::PREPARED);
+
+	auto *t = new Task;
+
+	t->path = p;
+	t->home = workers[next++ % workers.size()];
+	t->queued = false;
+	t->active = 0;
+	t->nevents = p->reader.nfds;
+	t->events = new Event[t->nevents];
+
+	for (int i = 0; i < t->nevents; i++) {
+		Event *e = &t->events[i];
+
+		e->task = t;
+		e->index = i;
+		e->ready = false;
+
+		/* Each file descriptor is armed again after the path has processed it.
+		 * This guarantees that a path is never executed by two workers at once. */
+		struct epoll_event ev;
+		ev.events = EPOLLIN | EPOLLONESHOT;
+		ev.data.ptr = e;
+
+		if (epoll_ctl(t->home->epfd, EPOLL_CTL_ADD, p->reader.pfds[i].fd, &ev))
+			throw RuntimeError("Failed to add file descriptor of path {} to epoll set: {}", path_name(p), strerror(errno));
+	}
+
+	tasks.push_back(t);
+
+	logger->debug("Assigned path {} to worker {}", path_name(p), t->home->id);
+}
+
+void PathScheduler::start()
+{
+	assert(state == State::PREPARED);
+
+	logger->info("Starting sub-system: workers={}, paths={}, affinity={:#x}, priority={}",
+		workers.size(), tasks.size(), affinity, priority);
+
+	running = true;
+
+	for (Worker *w : workers)
+		w->thread = std::thread(&PathScheduler::work, this, w);
+
+	state = State::STARTED;
+}
+
+void PathScheduler::stop()
+{
+	if (state != State::STARTED)
+		return;
+
+	logger->info("Stopping sub-system");
+
+	running = false;
+
+	for (Worker *w : workers)
+		wake(w);
+
+	for (Worker *w : workers) {
+		w->thread.join();
+
+		logger->info("Worker {}: runs={}, steals={}", w->id, w->runs, w->steals);
+	}
+
+	state = State::STOPPED;
+}
+
+bool PathScheduler::enqueue(Worker *w, Task *t)
+{
+	bool expected = false;
+
+	if (!t->queued.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+		return false;
+
+	std::unique_lock<std::mutex> guard(w->mtx);
+
+	w->runqueue.push_back(t);
+
+	return true;
+}
+
+PathScheduler::Task * PathScheduler::dequeue(Worker *w)
+{
+	std::unique_lock<std::mutex> guard(w->mtx);
+
+	if (w->runqueue.empty())
+		return nullptr;
+
+	Task *t = w->runqueue.front();
+	w->runqueue.pop_front();
+
+	return t;
+}
+
+PathScheduler::Task * PathScheduler::steal(Worker *w)
+{
+	for (size_t i = 1; i < workers.size(); i++) {
+		Worker *v = workers[(w->id + i) % workers.size()];
+
+		std::unique_lock<std::mutex> guard(v->mtx);
+
+		if (v->runqueue.empty())
+			continue;
+
+		/* We steal from the back to keep the FIFO order of the victim intact */
+		Task *t = v->runqueue.back();
+		v->runqueue.pop_back();
+
+		w->steals++;
+
+		return t;
+	}
+
+	return nullptr;
+}
+
+void PathScheduler::wake(Worker *w)
+{
+	uint64_t incr = 1;
+	ssize_t ret;
+
+	ret = write(w->wakefd, &incr, sizeof(incr));
+	if (ret != sizeof(incr))
+		logger->warn("Failed to wake worker {}", w->id);
+}
+
+void PathScheduler::wakeIdle(Worker *w)
+{
+	for (size_t i = 1; i < workers.size(); i++) {
+		Worker *v = workers[(w->id + i) % workers.size()];
+
+		bool expected = true;
+		if (v->sleeping.compare_exchange_strong(expected, false)) {
+			wake(v);
+			break;
+		}
+	}
+}
+
+void PathScheduler::run(Worker *w, Task *t)
+{
+	struct path *p = t->path;
+
+	if (t->active.fetch_add(1, std::memory_order_acquire) > 0)
+		logger->error("Path {} is executed by more than one worker at once", path_name(p));
+
+	if (p->state == State::STARTED) {
+		for (int i = 0; i < t->nevents; i++) {
+			Event *e = &t->events[i];
+
+			if (!e->ready.exchange(false, std::memory_order_acquire))
+				continue;
+
+			path_process_fd(p, e->index);
+
+			/* Arm the file descriptor again */
+			struct epoll_event ev;
+			ev.events = EPOLLIN | EPOLLONESHOT;
+			ev.data.ptr = e;
+
+			if (epoll_ctl(t->home->epfd, EPOLL_CTL_MOD, p->reader.pfds[e->index].fd, &ev))
+				logger->error("Failed to re-arm file descriptor of path {}: {}", path_name(p), strerror(errno));
+		}
+
+		path_write_destinations(p);
+	}
+
+	w->runs++;
+
+	t->active.fetch_sub(1, std::memory_order_release);
+	t->queued.store(false, std::memory_order_release);
+
+	/* Check for events which have been signalled while we were busy */
+	for (int i = 0; i < t->nevents; i++) {
+		if (t->events[i].ready.load(std::memory_order_acquire)) {
+			enqueue(w, t);
+			break;
+		}
+	}
+}
+
+void PathScheduler::work(Worker *w)
+{
+	int ret;
+	struct epoll_event evs[SCHEDULER_MAX_EVENTS];
+
+	if (w->core >= 0) {
+		cpu_set_t cset;
+
+		CPU_ZERO(&cset);
+		CPU_SET(w->core, &cset);
+
+		ret = pthread_setaffinity_np(pthread_self(), sizeof(cset), &cset);
+		if (ret)
+			logger->warn("Failed to pin worker {} to core {}: {}", w->id, w->core, strerror(ret));
+	}
+
+	if (priority > 0) {
+		struct sched_param param;
+		param.sched_priority = priority;
+
+		ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (ret)
+			logger->warn("Failed to set real-time priority of worker {}: {}", w->id, strerror(ret));
+	}
+
+	logger->debug("Started worker {} on core {}", w->id, w->core);
+
+	while (running) {
+		Task *t = dequeue(w);
+		if (!t)
+			t = steal(w);
+
+		if (t) {
+			run(w, t);
+			continue;
+		}
+
+		w->sleeping = true;
+
+		ret = epoll_wait(w->epfd, evs, SCHEDULER_MAX_EVENTS, -1);
+
+		w->sleeping = false;
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			serror("Failed to wait for events");
+		}
+
+		int queued = 0;
+		for (int i = 0; i < ret; i++) {
+			auto *e = (Event *) evs[i].data.ptr;
+
+			/* Wake-up from a sibling or from stop() */
+			if (!e) {
+				uint64_t cnt;
+
+				if (read(w->wakefd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+					logger->warn("Failed to read from eventfd of worker {}", w->id);
+
+				continue;
+			}
+
+			e->ready.store(true, std::memory_order_release);
+
+			if (enqueue(w, e->task))
+				queued++;
+		}
+
+		/* We have more work than we can handle right now */
+		if (queued > 1)
+			wakeIdle(w);
+	}
+
+	logger->debug("Stopped worker {}", w->id);
+}
@@ -41,6 +41,14 @@ int path_source_init(struct path_source *ps)
 	if (ret)
 		return ret;
 
+	ret = pool_cache_init(&ps->pool);
+	if (ret)
+		return ret;
+
+	ret = mapping_plan_init(&ps->plan, &ps->mappings);
+	if (ret)
+		return ret;
+
 	return 0;
 }
 
@@ -52,6 +60,10 @@ int path_source_destroy(struct path_source *ps)
 	if (ret)
 		return ret;
 
+	ret = mapping_plan_destroy(&ps->plan);
+	if (ret)
+		return ret;
+
 	ret = vlist_destroy(&ps->mappings, nullptr, false);
 	if (ret)
 		return ret;
@@ -130,12 +142,20 @@ int path_source_read(struct path_source *ps, struct path *p, int i)
 		muxed_smps[i]->ts = tomux_smps[i]->ts;
 		muxed_smps[i]->flags |= tomux_smps[i]->flags & ((int) SampleFlags::HAS_TS_ORIGIN | (int) SampleFlags::HAS_TS_RECEIVED);
 
-		ret = mapping_list_remap(&ps->mappings, muxed_smps[i], tomux_smps[i]);
+		ret = mapping_plan_remap(&ps->plan, muxed_smps[i], tomux_smps[i]);
 		if (ret)
 			return ret;
 	}
 
-	sample_copy(p->last_sample, muxed_smps[tomux-1]);
+	/* Remember the last muxed sample before the path hooks are applied */
+	if (p->last_shared) {
+		sample_incref(muxed_smps[tomux-1]);
+		sample_decref(p->last_sample);
+
+		p->last_sample = muxed_smps[tomux-1];
+	}
+	else
+		sample_copy(p->last_sample, muxed_smps[tomux-1]);
 
 	p->logger->debug("Path {} received = {}", path_name(p), p->received.to_ullong());
 
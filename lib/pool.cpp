@@ -20,6 +20,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *********************************************************************************/
 
+#include <cstring>
+
 #include <villas/utils.hpp>
 #include <villas/pool.h>
 #include <villas/memory.h>
@@ -44,6 +46,10 @@ int pool_init(struct pool *p, size_t cnt, size_t blocksz, struct memory_type *m)
 
 	p->buffer_off = (char*) buffer - (char*) p;
 
+	p->cache = nullptr;
+	p->cachesz = 0;
+	p->cache_next = 0;
+
 	ret = queue_init(&p->queue, LOG2_CEIL(cnt), m);
 	if (ret)
 		return ret;
@@ -65,6 +71,14 @@ int pool_destroy(struct pool *p)
 
 	queue_destroy(&p->queue);
 
+	if (p->cache) {
+		ret = memory_free(p->cache);
+		if (ret)
+			return ret;
+
+		p->cache = nullptr;
+	}
+
 	void *buffer = (char *) p + p->buffer_off;
 	ret = memory_free(buffer);
 	if (ret == 0)
@@ -72,3 +86,190 @@ int pool_destroy(struct pool *p)
 
 	return ret;
 }
+
+int pool_cache_init(struct pool *p)
+{
+	size_t cnt = p->len / p->blocksz;
+
+	assert(p->state == State::INITIALIZED);
+
+	if (p->cache)
+		return 0;
+
+	/* Never keep more than an eighth of the blocks in the caches */
+	p->cachesz = MIN(POOL_CACHE_SIZE, cnt / (8 * POOL_CACHE_SLOTS));
+	if (p->cachesz < 4) {
+		p->cachesz = 0;
+		return 0;
+	}
+
+	p->cache = (struct pool_cache *) memory_alloc_aligned(&memory_heap, POOL_CACHE_SLOTS * sizeof(struct pool_cache), CACHELINE_SIZE);
+	if (!p->cache)
+		return -1;
+
+	for (unsigned i = 0; i < POOL_CACHE_SLOTS; i++) {
+		p->cache[i].busy = false;
+		p->cache[i].count = 0;
+	}
+
+	debug(LOG_POOL | 4, "Enabled per-thread caches with %zu blocks for memory pool", p->cachesz);
+
+	return 0;
+}
+
+/** Get the slot of the calling thread in the caches of a pool.
+ *
+ * Each pool hands out its slots round-robin to the threads which use it.
+ * A thread remembers its slots for the last POOL_CACHE_THREAD_POOLS pools.
+ */
+static unsigned pool_cache_slot(struct pool *p)
+{
+	static thread_local struct {
+		const struct pool *pool;
+		unsigned slot;
+	} slots[POOL_CACHE_THREAD_POOLS];
+	static thread_local unsigned next;
+
+	for (unsigned i = 0; i < POOL_CACHE_THREAD_POOLS; i++) {
+		if (slots[i].pool == p)
+			return slots[i].slot;
+	}
+
+	unsigned slot = p->cache_next++ % POOL_CACHE_SLOTS;
+
+	slots[next].pool = p;
+	slots[next].slot = slot;
+
+	next = (next + 1) % POOL_CACHE_THREAD_POOLS;
+
+	return slot;
+}
+
+/** Get exclusive access to the cache of the calling thread or nullptr. */
+static struct pool_cache * pool_cache_acquire(struct pool *p)
+{
+	struct pool_cache *c = &p->cache[pool_cache_slot(p)];
+
+	if (c->busy.exchange(true, std::memory_order_acquire))
+		return nullptr;
+
+	return c;
+}
+
+static void pool_cache_release(struct pool_cache *c)
+{
+	c->busy.store(false, std::memory_order_release);
+}
+
+/** Take up to \p cnt blocks from the caches of other threads.
+ *
+ * Caches which are currently in use are skipped.
+ */
+static size_t pool_cache_steal(struct pool *p, struct pool_cache *self, void *blocks[], size_t cnt)
+{
+	size_t n = 0;
+
+	for (unsigned i = 0; i < POOL_CACHE_SLOTS && n < cnt; i++) {
+		struct pool_cache *c = &p->cache[i];
+
+		if (c == self || c->busy.exchange(true, std::memory_order_acquire))
+			continue;
+
+		size_t m = MIN(cnt - n, c->count);
+
+		c->count -= m;
+		memcpy(blocks + n, c->blocks + c->count, m * sizeof(void *));
+		n += m;
+
+		pool_cache_release(c);
+	}
+
+	return n;
+}
+
+int pool_cache_flush(struct pool *p)
+{
+	if (!p->cache)
+		return 0;
+
+	for (unsigned i = 0; i < POOL_CACHE_SLOTS; i++) {
+		struct pool_cache *c = &p->cache[i];
+
+		if (c->busy.exchange(true, std::memory_order_acquire))
+			continue;
+
+		queue_push_many(&p->queue, c->blocks, c->count);
+		c->count = 0;
+
+		pool_cache_release(c);
+	}
+
+	return 0;
+}
+
+ssize_t pool_cache_get_many(struct pool *p, void *blocks[], size_t cnt)
+{
+	ssize_t ret;
+	size_t n = 0;
+	struct pool_cache *c;
+
+	c = pool_cache_acquire(p);
+	if (c) {
+		/* Refill the cache in a single bulk operation */
+		if (c->count < cnt) {
+			ret = queue_pull_many(&p->queue, c->blocks + c->count, p->cachesz - c->count);
+			if (ret > 0)
+				c->count += ret;
+		}
+
+		n = MIN(cnt, c->count);
+
+		c->count -= n;
+		memcpy(blocks, c->blocks + c->count, n * sizeof(void *));
+	}
+
+	/* Requests larger than the cache are served by the queue */
+	if (n < cnt) {
+		ret = queue_pull_many(&p->queue, blocks + n, cnt - n);
+		if (ret > 0)
+			n += ret;
+	}
+
+	/* The queue ran dry. The remaining blocks are parked in the caches of other threads */
+	if (n < cnt)
+		n += pool_cache_steal(p, c, blocks + n, cnt - n);
+
+	if (c)
+		pool_cache_release(c);
+
+	return n;
+}
+
+ssize_t pool_cache_put_many(struct pool *p, void *blocks[], size_t cnt)
+{
+	struct pool_cache *c;
+
+	c = pool_cache_acquire(p);
+	if (!c)
+		return queue_push_many(&p->queue, blocks, cnt);
+
+	/* Flush the upper half of the cache in a single bulk operation */
+	if (c->count + cnt > p->cachesz) {
+		size_t keep = MIN(c->count, p->cachesz / 2);
+
+		queue_push_many(&p->queue, c->blocks + keep, c->count - keep);
+		c->count = keep;
+	}
+
+	size_t n = MIN(cnt, p->cachesz - c->count);
+
+	memcpy(c->blocks + c->count, blocks, n * sizeof(void *));
+	c->count += n;
+
+	if (n < cnt)
+		queue_push_many(&p->queue, blocks + n, cnt - n);
+
+	pool_cache_release(c);
+
+	return cnt;
+}
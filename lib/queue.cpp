@@ -36,7 +36,7 @@
 #include <villas/memory.h>
 
 /** Initialize MPMC queue */
-int queue_init(struct queue *q, size_t size, struct memory_type *m)
+int queue_init(struct queue *q, size_t size, struct memory_type *m, enum QueueMode mode)
 {
 	assert(q->state == State::DESTROYED);
 
@@ -47,6 +47,7 @@ int queue_init(struct queue *q, size_t size, struct memory_type *m)
 		warning("A queue size was changed from %zu to %zu", old_size, size);
 	}
 
+	q->mode = mode;
 	q->buffer_mask = size - 1;
 	struct queue_cell *buffer = (struct queue_cell *) memory_alloc(m, sizeof(struct queue_cell) * size);
 	if (!buffer)
@@ -65,6 +66,9 @@ int queue_init(struct queue *q, size_t size, struct memory_type *m)
 	std::atomic_store_explicit(&q->head, 0u, std::memory_order_relaxed);
 
 #endif
+	q->head_cache = 0;
+	q->tail_cache = 0;
+
 	q->state = State::INITIALIZED;
 
 	return 0;
@@ -91,12 +95,73 @@ size_t queue_available(struct queue *q)
 		std::atomic_load_explicit(&q->head, std::memory_order_relaxed);
 }
 
+static int queue_spsc_push_many(struct queue *q, void *ptr[], size_t cnt)
+{
+	struct queue_cell *buffer;
+	size_t tail, avail, size = q->buffer_mask + 1;
+
+	if (std::atomic_load_explicit(&q->state, std::memory_order_relaxed) == State::STOPPED)
+		return -1;
+
+	buffer = (struct queue_cell *) ((char *) q + q->buffer_off);
+	tail = std::atomic_load_explicit(&q->tail, std::memory_order_relaxed);
+
+	/* Only look at the consumers index if our cached copy indicates a full queue */
+	avail = size - (tail - q->head_cache);
+	if (avail < cnt) {
+		q->head_cache = std::atomic_load_explicit(&q->head, std::memory_order_acquire);
+		avail = size - (tail - q->head_cache);
+	}
+
+	cnt = MIN(cnt, avail);
+
+	for (size_t i = 0; i < cnt; i++)
+		buffer[(tail + i) & q->buffer_mask].data_off = (char *) ptr[i] - (char *) q;
+
+	/* Publish the whole batch at once */
+	std::atomic_store_explicit(&q->tail, tail + cnt, std::memory_order_release);
+
+	return cnt;
+}
+
+static int queue_spsc_pull_many(struct queue *q, void *ptr[], size_t cnt)
+{
+	struct queue_cell *buffer;
+	size_t head, avail;
+
+	if (std::atomic_load_explicit(&q->state, std::memory_order_relaxed) == State::STOPPED)
+		return -1;
+
+	buffer = (struct queue_cell *) ((char *) q + q->buffer_off);
+	head = std::atomic_load_explicit(&q->head, std::memory_order_relaxed);
+
+	/* Only look at the producers index if our cached copy indicates an empty queue */
+	avail = q->tail_cache - head;
+	if (avail < cnt) {
+		q->tail_cache = std::atomic_load_explicit(&q->tail, std::memory_order_acquire);
+		avail = q->tail_cache - head;
+	}
+
+	cnt = MIN(cnt, avail);
+
+	for (size_t i = 0; i < cnt; i++)
+		ptr[i] = (char *) q + buffer[(head + i) & q->buffer_mask].data_off;
+
+	/* Release all cells of the batch at once */
+	std::atomic_store_explicit(&q->head, head + cnt, std::memory_order_release);
+
+	return cnt;
+}
+
 int queue_push(struct queue *q, void *ptr)
 {
 	struct queue_cell *cell, *buffer;
 	size_t pos, seq;
 	intptr_t diff;
 
+	if (q->mode == QueueMode::SPSC)
+		return queue_spsc_push_many(q, &ptr, 1);
+
 	if (std::atomic_load_explicit(&q->state, std::memory_order_relaxed) == State::STOPPED)
 		return -1;
 
@@ -129,6 +194,9 @@ int queue_pull(struct queue *q, void **ptr)
 	size_t pos, seq;
 	intptr_t diff;
 
+	if (q->mode == QueueMode::SPSC)
+		return queue_spsc_pull_many(q, ptr, 1);
+
 	if (std::atomic_load_explicit(&q->state, std::memory_order_relaxed) == State::STOPPED)
 		return -1;
 
@@ -160,6 +228,9 @@ int queue_push_many(struct queue *q, void *ptr[], size_t cnt)
 	int ret;
 	size_t i;
 
+	if (q->mode == QueueMode::SPSC)
+		return queue_spsc_push_many(q, ptr, cnt);
+
 	for (i = 0; i < cnt; i++) {
 		ret = queue_push(q, ptr[i]);
 		if (ret <= 0)
@@ -177,6 +248,9 @@ int queue_pull_many(struct queue *q, void *ptr[], size_t cnt)
 	int ret;
 	size_t i;
 
+	if (q->mode == QueueMode::SPSC)
+		return queue_spsc_pull_many(q, ptr, cnt);
+
 	for (i = 0; i < cnt; i++) {
 		ret = queue_pull(q, &ptr[i]);
 		if (ret <= 0)
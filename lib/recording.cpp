@@ -0,0 +1,634 @@
+/** An indexed, columnar binary format for recording and replaying samples.
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <villas/utils.hpp>
+#include <villas/list.h>
+#include <villas/sample.h>
+#include <villas/recording.h>
+
+using namespace villas::utils;
+
+/** Length of the header including the signal types. */
+#define RECORDING_HEADER_LENGTH(signals)	ALIGN(sizeof(struct recording_header) + (signals), sizeof(uint64_t))
+
+/** Length of a chunk with \p count samples.
+ *
+ * Each sample consumes two timestamps, a sequence number, its length, its flags and its values. */
+#define RECORDING_CHUNK_LENGTH(signals, count)	(sizeof(struct recording_chunk) + \
+	(3 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + (signals) * sizeof(union signal_data)) * (count))
+
+static int64_t recording_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static struct timespec recording_ts(int64_t ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000LL;
+	ts.tv_nsec = ns % 1000000000LL;
+
+	if (ts.tv_nsec < 0) {
+		ts.tv_sec--;
+		ts.tv_nsec += 1000000000LL;
+	}
+
+	return ts;
+}
+
+/** Pointers to the columns of a mapped chunk. */
+struct recording_columns {
+	const int64_t *origin;
+	const int64_t *received;
+	const uint64_t *sequence;
+	const uint32_t *lengths;
+	const uint32_t *flags;
+	const union signal_data *values;
+};
+
+static struct recording_columns recording_chunk_columns(const struct recording_chunk *c)
+{
+	struct recording_columns cols;
+
+	cols.origin = (const int64_t *) (c + 1);
+	cols.received = cols.origin + c->count;
+	cols.sequence = (const uint64_t *) (cols.received + c->count);
+	cols.lengths = (const uint32_t *) (cols.sequence + c->count);
+	cols.flags = cols.lengths + c->count;
+	cols.values = (const union signal_data *) (cols.flags + c->count);
+
+	return cols;
+}
+
+static int recording_index_push(struct recording *r, const struct recording_index *e)
+{
+	if (r->chunks == r->allocated) {
+		size_t allocated = r->allocated ? 2 * r->allocated : 64;
+
+		auto *index = (struct recording_index *) realloc(r->index, allocated * sizeof(struct recording_index));
+		if (!index)
+			return -1;
+
+		r->index = index;
+		r->allocated = allocated;
+	}
+
+	r->index[r->chunks++] = *e;
+	r->samples += e->count;
+
+	return 0;
+}
+
+/** Check that the chunk at \p off is complete and lies within the first \p limit bytes. */
+static bool recording_chunk_valid(const struct recording *r, const char *base, size_t limit, size_t off)
+{
+	if (off < RECORDING_HEADER_LENGTH(r->signals) || off % sizeof(uint64_t) ||
+	    off > limit || limit - off < sizeof(struct recording_chunk))
+		return false;
+
+	auto *c = (const struct recording_chunk *) (base + off);
+
+	return c->magic == RECORDING_CHUNK_MAGIC && c->count > 0 &&
+	       c->length == RECORDING_CHUNK_LENGTH(r->signals, c->count) &&
+	       c->length <= limit - off;
+}
+
+/** Walk the chunk headers behind recording::end up to \p limit and add them to the index. */
+static int recording_scan(struct recording *r, const char *base, size_t limit)
+{
+	int ret;
+
+	/* The last chunk might not have been written completely yet */
+	while (recording_chunk_valid(r, base, limit, r->end)) {
+		auto *c = (const struct recording_chunk *) (base + r->end);
+
+		struct recording_columns cols = recording_chunk_columns(c);
+		struct recording_index e = {
+			.offset = r->end,
+			.first = cols.origin[0],
+			.last = cols.origin[c->count - 1],
+			.sequence = cols.sequence[0],
+			.count = c->count
+		};
+
+		ret = recording_index_push(r, &e);
+		if (ret)
+			return ret;
+
+		r->end += c->length;
+	}
+
+	return 0;
+}
+
+/** Drop the index and rebuild it by walking all chunks of the mapping. */
+static int recording_rebuild(struct recording *r)
+{
+	r->chunks = 0;
+	r->samples = 0;
+	r->end = RECORDING_HEADER_LENGTH(r->signals);
+
+	return recording_scan(r, r->base, r->length);
+}
+
+/** Validate the header of a mapped recording and build the index. */
+static int recording_load(struct recording *r, const char *base, size_t length)
+{
+	auto *h = (const struct recording_header *) base;
+
+	if (length < sizeof(struct recording_header) ||
+	    memcmp(h->magic, RECORDING_MAGIC, sizeof(h->magic)) ||
+	    h->version != RECORDING_VERSION ||
+	    length < RECORDING_HEADER_LENGTH(h->signals)) {
+		errno = EPROTO;
+		return -1;
+	}
+
+	r->signals = h->signals;
+	r->chunk_samples = h->chunk_samples;
+
+	r->types = (uint8_t *) alloc(r->signals + 1);
+	if (!r->types)
+		return -1;
+
+	memcpy(r->types, h + 1, r->signals);
+
+	r->end = RECORDING_HEADER_LENGTH(r->signals);
+
+	/* Use the index if the recording has been closed properly */
+	if (h->index_offset && h->index_offset <= length &&
+	    h->chunks <= (length - h->index_offset) / sizeof(struct recording_index)) {
+		auto *index = (const struct recording_index *) (base + h->index_offset);
+		size_t i;
+
+		for (i = 0; i < h->chunks; i++) {
+			const struct recording_index *e = &index[i];
+
+			if (!recording_chunk_valid(r, base, h->index_offset, e->offset) ||
+			    ((const struct recording_chunk *) (base + e->offset))->count != e->count)
+				break;
+
+			int ret = recording_index_push(r, e);
+			if (ret)
+				return ret;
+		}
+
+		if (i == h->chunks) {
+			r->end = h->index_offset;
+
+			return 0;
+		}
+
+		/* The index is damaged. So we walk the chunks instead */
+		r->chunks = 0;
+		r->samples = 0;
+	}
+
+	return recording_scan(r, base, length);
+}
+
+static int recording_map(struct recording *r)
+{
+	struct stat sb;
+
+	if (fstat(r->fd, &sb))
+		return -1;
+
+	if (sb.st_size == 0) {
+		errno = ENODATA;
+		return -1;
+	}
+
+	void *base = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, r->fd, 0);
+	if (base == MAP_FAILED)
+		return -1;
+
+	/* Replays usually read the whole file front to back */
+	madvise(base, sb.st_size, MADV_SEQUENTIAL);
+
+	r->base = (char *) base;
+	r->length = sb.st_size;
+
+	return 0;
+}
+
+static int recording_alloc_buffers(struct recording *r)
+{
+	size_t cnt = r->chunk_samples;
+
+	r->origin = (int64_t *) alloc(cnt * sizeof(int64_t));
+	r->received = (int64_t *) alloc(cnt * sizeof(int64_t));
+	r->sequence = (uint64_t *) alloc(cnt * sizeof(uint64_t));
+	r->lengths = (uint32_t *) alloc(cnt * sizeof(uint32_t));
+	r->flags = (uint32_t *) alloc(cnt * sizeof(uint32_t));
+	r->values = (union signal_data *) alloc(MAX(cnt * r->signals, 1) * sizeof(union signal_data));
+
+	if (!r->origin || !r->received || !r->sequence || !r->lengths || !r->flags || !r->values)
+		return -1;
+
+	return 0;
+}
+
+/** Write all of \p iov at \p off. */
+static int recording_pwritev(int fd, struct iovec *iov, int iovcnt, off_t off)
+{
+	while (iovcnt > 0) {
+		ssize_t ret = pwritev(fd, iov, MIN(iovcnt, IOV_MAX), off);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return -1;
+		}
+
+		off += ret;
+
+		/* Skip over the vectors which have been written completely */
+		while (iovcnt > 0 && (size_t) ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt > 0) {
+			iov->iov_base = (char *) iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 0;
+}
+
+static int recording_write_header(struct recording *r, uint64_t index_offset)
+{
+	size_t len = RECORDING_HEADER_LENGTH(r->signals);
+	char buf[len];
+
+	memset(buf, 0, len);
+
+	auto *h = (struct recording_header *) buf;
+
+	memcpy(h->magic, RECORDING_MAGIC, sizeof(h->magic));
+	h->version = RECORDING_VERSION;
+	h->signals = r->signals;
+	h->chunk_samples = r->chunk_samples;
+	h->index_offset = index_offset;
+	h->chunks = index_offset ? r->chunks : 0;
+	h->samples = index_offset ? r->samples : 0;
+
+	memcpy(h + 1, r->types, r->signals);
+
+	return pwrite(r->fd, buf, len, 0) == (ssize_t) len ? 0 : -1;
+}
+
+int recording_open(struct recording *r, const char *uri, enum RecordingMode mode, unsigned chunk_samples)
+{
+	int ret;
+
+	memset(r, 0, sizeof(struct recording));
+
+	r->mode = mode;
+	r->chunk_samples = chunk_samples ? chunk_samples : DEFAULT_RECORDING_CHUNK_SAMPLES;
+
+	r->fd = open(uri, mode == RecordingMode::READ ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+	if (r->fd < 0)
+		return -1;
+
+	if (mode == RecordingMode::READ) {
+		ret = recording_map(r);
+		if (ret)
+			goto fail;
+
+		ret = recording_load(r, r->base, r->length);
+		if (ret)
+			goto fail;
+	}
+	else {
+		struct stat sb;
+
+		ret = fstat(r->fd, &sb);
+		if (ret)
+			goto fail;
+
+		/* Continue an existing recording */
+		if (sb.st_size > 0) {
+			ret = recording_map(r);
+			if (ret)
+				goto fail;
+
+			ret = recording_load(r, r->base, r->length);
+
+			munmap(r->base, r->length);
+			r->base = nullptr;
+
+			if (ret)
+				goto fail;
+
+			/* The index is written again when the recording is closed */
+			ret = ftruncate(r->fd, r->end);
+			if (ret)
+				goto fail;
+
+			ret = recording_write_header(r, 0);
+			if (ret)
+				goto fail;
+
+			ret = recording_alloc_buffers(r);
+			if (ret)
+				goto fail;
+		}
+	}
+
+	return 0;
+
+fail:	recording_close(r);
+
+	return -1;
+}
+
+int recording_close(struct recording *r)
+{
+	int ret = 0;
+
+	if (r->fd < 0)
+		return 0;
+
+	if (r->mode == RecordingMode::WRITE && r->end > 0) {
+		ret = recording_flush(r);
+
+		/* The flush might have added another chunk to the index */
+		size_t len = r->chunks * sizeof(struct recording_index);
+
+		if (!ret)
+			ret = pwrite(r->fd, r->index, len, r->end) == (ssize_t) len ? 0 : -1;
+		if (!ret)
+			ret = recording_write_header(r, r->end);
+		if (!ret)
+			ret = ftruncate(r->fd, r->end + len);
+	}
+
+	if (r->base)
+		munmap(r->base, r->length);
+
+	close(r->fd);
+
+	free(r->index);
+	free(r->types);
+	free(r->origin);
+	free(r->received);
+	free(r->sequence);
+	free(r->lengths);
+	free(r->flags);
+	free(r->values);
+
+	memset(r, 0, sizeof(struct recording));
+	r->fd = -1;
+
+	return ret;
+}
+
+int recording_read(struct recording *r, struct sample *smps[], unsigned cnt)
+{
+	unsigned i = 0;
+
+	while (i < cnt && r->chunk < r->chunks) {
+		size_t off = r->index[r->chunk].offset;
+
+		if (!recording_chunk_valid(r, r->base, r->length, off)) {
+			if (recording_rebuild(r))
+				return -1;
+
+			continue;
+		}
+
+		auto *c = (const struct recording_chunk *) (r->base + off);
+		struct recording_columns cols = recording_chunk_columns(c);
+
+		for (; i < cnt && r->pos < c->count; i++, r->pos++) {
+			struct sample *smp = smps[i];
+
+			smp->ts.origin = recording_ts(cols.origin[r->pos]);
+			smp->ts.received = recording_ts(cols.received[r->pos]);
+			smp->sequence = cols.sequence[r->pos];
+			smp->flags = cols.flags[r->pos];
+			smp->length = MIN(MIN(cols.lengths[r->pos], r->signals), smp->capacity);
+
+			for (unsigned j = 0; j < smp->length; j++)
+				smp->data[j] = cols.values[j * c->count + r->pos];
+		}
+
+		if (r->pos >= c->count) {
+			r->chunk++;
+			r->pos = 0;
+		}
+	}
+
+	return i;
+}
+
+int recording_write(struct recording *r, struct sample *smps[], unsigned cnt)
+{
+	int ret;
+
+	for (unsigned i = 0; i < cnt; i++) {
+		struct sample *smp = smps[i];
+
+		/* The first sample of a new recording determines its columns */
+		if (r->end == 0) {
+			r->signals = smp->signals ? vlist_length(smp->signals) : smp->length;
+
+			r->types = (uint8_t *) alloc(r->signals + 1);
+			if (!r->types)
+				return -1;
+
+			for (unsigned j = 0; j < r->signals; j++)
+				r->types[j] = (uint8_t) sample_format(smp, j);
+
+			ret = recording_write_header(r, 0);
+			if (ret)
+				return ret;
+
+			ret = recording_alloc_buffers(r);
+			if (ret)
+				return ret;
+
+			r->end = RECORDING_HEADER_LENGTH(r->signals);
+		}
+
+		unsigned len = MIN(smp->length, r->signals);
+
+		r->origin[r->count] = recording_ns(&smp->ts.origin);
+		r->received[r->count] = recording_ns(&smp->ts.received);
+		r->sequence[r->count] = smp->sequence;
+		r->lengths[r->count] = len;
+		r->flags[r->count] = smp->flags;
+
+		for (unsigned j = 0; j < r->signals; j++) {
+			union signal_data *d = &r->values[j * r->chunk_samples + r->count];
+
+			if (j < len)
+				*d = smp->data[j];
+			else
+				d->i = 0;
+		}
+
+		if (++r->count == r->chunk_samples) {
+			ret = recording_flush(r);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return cnt;
+}
+
+int recording_flush(struct recording *r)
+{
+	int ret;
+	unsigned cnt = r->count;
+
+	if (cnt == 0)
+		return 0;
+
+	struct recording_chunk c = {
+		.magic = RECORDING_CHUNK_MAGIC,
+		.count = cnt,
+		.length = RECORDING_CHUNK_LENGTH(r->signals, cnt)
+	};
+
+	/* The buffered columns are only partially filled. So we gather them */
+	struct iovec iov[6 + r->signals];
+
+	iov[0] = { &c, sizeof(c) };
+	iov[1] = { r->origin, cnt * sizeof(int64_t) };
+	iov[2] = { r->received, cnt * sizeof(int64_t) };
+	iov[3] = { r->sequence, cnt * sizeof(uint64_t) };
+	iov[4] = { r->lengths, cnt * sizeof(uint32_t) };
+	iov[5] = { r->flags, cnt * sizeof(uint32_t) };
+
+	for (unsigned j = 0; j < r->signals; j++)
+		iov[6 + j] = { &r->values[j * r->chunk_samples], cnt * sizeof(union signal_data) };
+
+	ret = recording_pwritev(r->fd, iov, 6 + r->signals, r->end);
+	if (ret)
+		return ret;
+
+	struct recording_index e = {
+		.offset = r->end,
+		.first = r->origin[0],
+		.last = r->origin[cnt - 1],
+		.sequence = r->sequence[0],
+		.count = cnt
+	};
+
+	ret = recording_index_push(r, &e);
+	if (ret)
+		return ret;
+
+	r->end += c.length;
+	r->count = 0;
+
+	return 0;
+}
+
+int recording_seek(struct recording *r, const struct timespec *ts)
+{
+	int64_t t = recording_ns(ts);
+
+	/* Find the first chunk which ends at or after t */
+	auto *last = r->index + r->chunks;
+	auto *e = std::partition_point(r->index, last, [t](const struct recording_index &e) {
+		return e.last < t;
+	});
+
+	r->chunk = e - r->index;
+	r->pos = 0;
+
+	if (e == last)
+		return 0;
+
+	auto *c = (const struct recording_chunk *) (r->base + e->offset);
+	struct recording_columns cols = recording_chunk_columns(c);
+
+	r->pos = std::lower_bound(cols.origin, cols.origin + c->count, t) - cols.origin;
+
+	return 0;
+}
+
+void recording_rewind(struct recording *r)
+{
+	r->chunk = 0;
+	r->pos = 0;
+}
+
+int recording_eof(struct recording *r)
+{
+	return r->chunk >= r->chunks;
+}
+
+int recording_refresh(struct recording *r)
+{
+	int ret;
+	struct stat sb;
+
+	ret = fstat(r->fd, &sb);
+	if (ret)
+		return ret;
+
+	if ((size_t) sb.st_size <= r->length)
+		return 0;
+
+	munmap(r->base, r->length);
+	r->base = nullptr;
+
+	ret = recording_map(r);
+	if (ret)
+		return ret;
+
+	/* The writer has closed the recording meanwhile */
+	auto *h = (const struct recording_header *) r->base;
+	size_t limit = h->index_offset ? h->index_offset : r->length;
+
+	return recording_scan(r, r->base, limit);
+}
+
+int recording_first(struct recording *r, struct timespec *ts)
+{
+	if (r->chunks == 0)
+		return -1;
+
+	*ts = recording_ts(r->index[0].first);
+
+	return 0;
+}
@@ -114,13 +114,38 @@ void sample_free_many(struct sample *smps[], int cnt)
 
 int sample_decref_many(struct sample *smps[], int cnt)
 {
-	int released = 0;
+	int released = 0, nfree = 0;
+	struct sample *free_smps[cnt];
+	struct pool *free_pool = nullptr;
 
 	for (int i = 0; i < cnt; i++) {
-		if (sample_decref(smps[i]) == 0)
-			released++;
+		int prev = atomic_fetch_sub(&smps[i]->refcnt, 1);
+
+		/* Did we had the last reference? */
+		if (prev != 1)
+			continue;
+
+		released++;
+
+		struct pool *p = sample_pool(smps[i]);
+		if (!p) {
+			free(smps[i]);
+			continue;
+		}
+
+		/* Return consecutive samples of the same pool in a single batch */
+		if (p != free_pool && nfree > 0) {
+			pool_put_many(free_pool, (void **) free_smps, nfree);
+			nfree = 0;
+		}
+
+		free_pool = p;
+		free_smps[nfree++] = smps[i];
 	}
 
+	if (nfree > 0)
+		pool_put_many(free_pool, (void **) free_smps, nfree);
+
 	return released;
 }
 
@@ -22,40 +22,170 @@
  *********************************************************************************/
 
 #include <cerrno>
+#include <climits>
 #include <fcntl.h>
+#include <sched.h>
 #include <semaphore.h>
+#include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 
-#include <villas/kernel/kernel.h>
+#ifdef __linux__
+  #include <sys/syscall.h>
+  #include <linux/futex.h>
+#endif
+
 #include <villas/memory.h>
 #include <villas/utils.hpp>
 #include <villas/sample.h>
 #include <villas/shmem.h>
 
+/** Offset of the first slot relative to the beginning of the region. */
+#define SHMEM_SLOTS_OFFSET	ALIGN(offsetof(struct shmem_shared, slots), CACHELINE_SIZE)
+
+static struct sample * shmem_slot(struct shmem_shared *s, size_t idx)
+{
+	return (struct sample *) ((char *) s + SHMEM_SLOTS_OFFSET + (idx & s->mask) * s->slotsz);
+}
+
+static void shmem_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/* The futex words are located in shared mappings.
+ * So we can not use the FUTEX_PRIVATE_FLAG. */
+static void shmem_futex_wait(std::atomic<uint32_t> *addr, uint32_t val)
+{
+#ifdef __linux__
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, nullptr, nullptr, 0);
+#else
+	sched_yield();
+#endif
+}
+
+static void shmem_futex_wake(std::atomic<uint32_t> *addr, int cnt)
+{
+#ifdef __linux__
+	syscall(SYS_futex, addr, FUTEX_WAKE, cnt, nullptr, nullptr, 0);
+#endif
+}
+
+static void shmem_unmap(struct shmem_dir *dir)
+{
+	munmap(dir->base, dir->len);
+
+	pool_destroy(&dir->pool);
+	pthread_mutex_destroy(&dir->mutex);
+}
+
+/** Drop a reference which has been taken by the reading or writing side and unmap the region if the interface has been closed meanwhile. */
+static void shmem_release(struct shmem_int *shm, std::atomic<int> *users, struct shmem_dir *dir)
+{
+	if (atomic_fetch_sub(users, 1) == 1 && atomic_load(&shm->closed) == 1)
+		shmem_unmap(dir);
+}
+
+/** Wait until the input ring contains readable slots.
+ *
+ * The consumer spins first. The spin budget is increased if a spin was
+ * successful and decreased if the consumer had to sleep on the futex.
+ *
+ * @return The number of readable slots or -1 if the interface has been closed.
+ */
+static ssize_t shmem_wait(struct shmem_int *shm)
+{
+	struct shmem_dir *dir = &shm->read;
+	struct shmem_shared *s = dir->shared;
+	size_t tail = s->tail.load(std::memory_order_relaxed);
+
+	if (s->head_cache != tail)
+		return s->head_cache - tail;
+
+	for (;;) {
+		for (unsigned i = 0; i < dir->spin; i++) {
+			s->head_cache = s->head.load(std::memory_order_acquire);
+			if (s->head_cache != tail) {
+				if (i > 0)
+					dir->spin = MIN(dir->spin * 2, SHMEM_SPIN_MAX);
+
+				return s->head_cache - tail;
+			}
+
+			if (s->closed || shm->closed)
+				return -1;
+
+			shmem_relax();
+		}
+
+		if (s->polling) {
+			sched_yield();
+			continue;
+		}
+
+		dir->spin = MAX(dir->spin / 2, SHMEM_SPIN_MIN);
+
+		/* Announce that we are going to sleep before we check the ring a last time.
+		 * Either we see the new head or the producer sees us waiting. */
+		s->waiting.store(1, std::memory_order_seq_cst);
+
+		uint32_t seq = s->futex.load(std::memory_order_seq_cst);
+
+		s->head_cache = s->head.load(std::memory_order_seq_cst);
+		if (s->head_cache == tail && !s->closed && !shm->closed)
+			shmem_futex_wait(&s->futex, seq);
+
+		s->waiting.store(0, std::memory_order_relaxed);
+	}
+}
+
+static void shmem_ring_init(struct shmem_shared *s, struct shmem_conf *conf)
+{
+	size_t slots = LOG2_CEIL(conf->queuelen);
+
+	s->polling = conf->polling;
+	s->mask = slots - 1;
+	s->slotsz = ALIGN(SAMPLE_LENGTH(conf->samplelen), CACHELINE_SIZE);
+	s->capacity = conf->samplelen;
+
+	s->head = 0;
+	s->tail = 0;
+	s->head_cache = 0;
+	s->tail_cache = 0;
+	s->futex = 0;
+	s->waiting = 0;
+	s->closed = 0;
+
+	for (size_t i = 0; i < slots; i++) {
+		struct sample *smp = shmem_slot(s, i);
+
+		smp->pool_off = SAMPLE_NON_POOL;
+		smp->capacity = conf->samplelen;
+		smp->length = 0;
+		smp->flags = 0;
+		smp->signals = nullptr;
+		smp->refcnt = 1;
+	}
+
+	s->magic = SHMEM_MAGIC;
+	s->version = SHMEM_VERSION;
+}
+
 size_t shmem_total_size(int queuelen, int samplelen)
 {
-	/* We have the constant const of the memory_type header */
-	return sizeof(struct memory_type)
-		/* and the shared struct itself */
-		+ sizeof(struct shmem_shared)
-		/* the size of the actual queue and the queue for the pool */
-		+ queuelen * (2 * sizeof(struct queue_cell))
-		/* the size of the pool */
-		+ queuelen * kernel_get_cacheline_size() * CEIL(SAMPLE_LENGTH(samplelen), kernel_get_cacheline_size())
-		/* a memblock for each allocation (1 shmem_shared, 2 queues, 1 pool) */
-		+ 4 * sizeof(struct memory_block)
-		/* and some extra buffer for alignment */
-		+ 1024;
+	/* The header of the ring */
+	return SHMEM_SLOTS_OFFSET
+		/* and the slots for the samples */
+		+ LOG2_CEIL(queuelen) * ALIGN(SAMPLE_LENGTH(samplelen), CACHELINE_SIZE);
 }
 
 int shmem_int_open(const char *wname, const char* rname, struct shmem_int *shm, struct shmem_conf *conf)
 {
-	char *cptr;
 	int fd, ret;
 	size_t len;
 	void *base;
-	struct memory_type *manager;
 	struct shmem_shared *shared;
 	struct stat stat_buf;
 	sem_t *sem_own, *sem_other;
@@ -93,29 +223,13 @@ retry:	fd = shm_open(wname, O_RDWR|O_CREAT|O_EXCL, 0600);
 
 	close(fd);
 
-	manager = memory_managed(base, len);
-	shared = (struct shmem_shared *) memory_alloc(manager, sizeof(struct shmem_shared));
-	if (!shared) {
-		errno = ENOMEM;
-		return -5;
-	}
-
-	shared->polling = conf->polling;
-
-	int flags = (int) QueueSignalledFlags::PROCESS_SHARED;
-	enum QueueSignalledMode mode = conf->polling
-					? QueueSignalledMode::POLLING
-					: QueueSignalledMode::PTHREAD;
-
-	shared->queue.queue.state = State::DESTROYED;
-	ret = queue_signalled_init(&shared->queue, conf->queuelen, manager, mode, flags);
-	if (ret) {
-		errno = ENOMEM;
-		return -6;
-	}
+	shared = (struct shmem_shared *) base;
+	shmem_ring_init(shared, conf);
 
-	shared->pool.state = State::DESTROYED;
-	ret = pool_init(&shared->pool, conf->queuelen, SAMPLE_LENGTH(conf->samplelen), manager);
+	/* Samples which are passed to shmem_int_write() */
+	shm->write.pool.state = State::DESTROYED;
+	shm->write.pool.queue.state = State::DESTROYED;
+	ret = pool_init(&shm->write.pool, conf->queuelen, SAMPLE_LENGTH(conf->samplelen), &memory_heap);
 	if (ret) {
 		errno = ENOMEM;
 		return -7;
@@ -125,6 +239,9 @@ retry:	fd = shm_open(wname, O_RDWR|O_CREAT|O_EXCL, 0600);
 	shm->write.name = wname;
 	shm->write.len = len;
 	shm->write.shared = shared;
+	shm->write.spin = SHMEM_SPIN_MIN;
+
+	pthread_mutex_init(&shm->write.mutex, nullptr);
 
 	/* Post own semaphore and wait on the other one, so both processes know that
 	 * both regions are initialized */
@@ -145,12 +262,31 @@ retry:	fd = shm_open(wname, O_RDWR|O_CREAT|O_EXCL, 0600);
 	if (base == MAP_FAILED)
 		return -10;
 
-	cptr = (char *) base + sizeof(struct memory_type) + sizeof(struct memory_block);
-	shared = (struct shmem_shared *) cptr;
+	close(fd);
+
+	shared = (struct shmem_shared *) base;
+	if (len < sizeof(struct shmem_shared) || shared->magic != SHMEM_MAGIC || shared->version != SHMEM_VERSION) {
+		munmap(base, len);
+		errno = EPROTO;
+		return -11;
+	}
+
+	/* Samples which are returned by shmem_int_read() */
+	shm->read.pool.state = State::DESTROYED;
+	shm->read.pool.queue.state = State::DESTROYED;
+	ret = pool_init(&shm->read.pool, shared->mask + 1, SAMPLE_LENGTH(shared->capacity), &memory_heap);
+	if (ret) {
+		errno = ENOMEM;
+		return -6;
+	}
+
 	shm->read.base = base;
 	shm->read.name = rname;
 	shm->read.len = len;
 	shm->read.shared = shared;
+	shm->read.spin = SHMEM_SPIN_MIN;
+
+	pthread_mutex_init(&shm->read.mutex, nullptr);
 
 	shm->readers = 0;
 	shm->writers = 0;
@@ -164,48 +300,173 @@ retry:	fd = shm_open(wname, O_RDWR|O_CREAT|O_EXCL, 0600);
 
 int shmem_int_close(struct shmem_int *shm)
 {
+	struct shmem_shared *w = shm->write.shared;
+	struct shmem_shared *r = shm->read.shared;
+
 	atomic_store(&shm->closed, 1);
 
-	queue_signalled_close(&shm->write.shared->queue);
+	/* Wake up the consumer of the other process */
+	w->closed = 1;
+	w->futex++;
+	shmem_futex_wake(&w->futex, INT_MAX);
+
+	/* and our own one which might still wait for samples of the other process */
+	r->futex++;
+	shmem_futex_wake(&r->futex, INT_MAX);
 
 	shm_unlink(shm->write.name);
 	if (atomic_load(&shm->readers) == 0)
-		munmap(shm->read.base, shm->read.len);
+		shmem_unmap(&shm->read);
 	if (atomic_load(&shm->writers) == 0)
-		munmap(shm->write.base, shm->write.len);
+		shmem_unmap(&shm->write);
 
 	return 0;
 }
 
-int shmem_int_read(struct shmem_int *shm, struct sample *smps[], unsigned cnt)
+int shmem_int_reserve(struct shmem_int *shm, struct sample *smps[], unsigned cnt)
+{
+	struct shmem_shared *s = shm->write.shared;
+	size_t head, slots = s->mask + 1;
+
+	atomic_fetch_add(&shm->writers, 1);
+
+	/* Concurrent writers of this process would reserve the same slots */
+	pthread_mutex_lock(&shm->write.mutex);
+
+	if (atomic_load(&shm->closed)) {
+		pthread_mutex_unlock(&shm->write.mutex);
+		shmem_release(shm, &shm->writers, &shm->write);
+		return -1;
+	}
+
+	head = s->head.load(std::memory_order_relaxed);
+
+	if (head - s->tail_cache + cnt > slots)
+		s->tail_cache = s->tail.load(std::memory_order_acquire);
+
+	cnt = MIN(cnt, slots - (head - s->tail_cache));
+	if (cnt == 0) {
+		pthread_mutex_unlock(&shm->write.mutex);
+		shmem_release(shm, &shm->writers, &shm->write);
+		return 0;
+	}
+
+	for (unsigned i = 0; i < cnt; i++)
+		smps[i] = shmem_slot(s, head + i);
+
+	return cnt;
+}
+
+int shmem_int_publish(struct shmem_int *shm, unsigned cnt)
+{
+	struct shmem_shared *s = shm->write.shared;
+
+	s->head.store(s->head.load(std::memory_order_relaxed) + cnt, std::memory_order_release);
+
+	if (!s->polling) {
+		/* Pairs with the store to shmem_shared::waiting in shmem_wait() */
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (s->waiting.load(std::memory_order_relaxed)) {
+			s->futex++;
+			shmem_futex_wake(&s->futex, 1);
+		}
+	}
+
+	pthread_mutex_unlock(&shm->write.mutex);
+	shmem_release(shm, &shm->writers, &shm->write);
+
+	return cnt;
+}
+
+int shmem_int_peek(struct shmem_int *shm, struct sample *smps[], unsigned cnt)
 {
-	int ret;
+	struct shmem_shared *s = shm->read.shared;
+	ssize_t avail;
+	size_t tail;
 
 	atomic_fetch_add(&shm->readers, 1);
 
-	ret = queue_signalled_pull_many(&shm->read.shared->queue, (void **) smps, cnt);
+	pthread_mutex_lock(&shm->read.mutex);
 
-	if (atomic_fetch_sub(&shm->readers, 1) == 1 && atomic_load(&shm->closed) == 1)
-		munmap(shm->read.base, shm->read.len);
+	avail = shmem_wait(shm);
+	if (avail < 0) {
+		pthread_mutex_unlock(&shm->read.mutex);
+		shmem_release(shm, &shm->readers, &shm->read);
+		return -1;
+	}
 
-	return ret;
+	cnt = MIN(cnt, (size_t) avail);
+	if (cnt == 0) {
+		pthread_mutex_unlock(&shm->read.mutex);
+		shmem_release(shm, &shm->readers, &shm->read);
+		return 0;
+	}
+
+	tail = s->tail.load(std::memory_order_relaxed);
+
+	for (unsigned i = 0; i < cnt; i++)
+		smps[i] = shmem_slot(s, tail + i);
+
+	return cnt;
+}
+
+int shmem_int_consume(struct shmem_int *shm, unsigned cnt)
+{
+	struct shmem_shared *s = shm->read.shared;
+
+	s->tail.store(s->tail.load(std::memory_order_relaxed) + cnt, std::memory_order_release);
+
+	pthread_mutex_unlock(&shm->read.mutex);
+	shmem_release(shm, &shm->readers, &shm->read);
+
+	return cnt;
+}
+
+int shmem_int_read(struct shmem_int *shm, struct sample *smps[], unsigned cnt)
+{
+	int avail, alloced;
+	struct sample *slots[cnt];
+
+	avail = shmem_int_peek(shm, slots, cnt);
+	if (avail <= 0)
+		return avail;
+
+	alloced = sample_alloc_many(&shm->read.pool, smps, avail);
+	if (alloced < 0)
+		alloced = 0;
+
+	sample_copy_many(smps, slots, alloced);
+
+	/* Pointers of the other process are meaningless here */
+	for (int i = 0; i < alloced; i++)
+		smps[i]->signals = nullptr;
+
+	/* Slots which we could not copy remain in the ring */
+	shmem_int_consume(shm, alloced);
+
+	return alloced;
 }
 
 int shmem_int_write(struct shmem_int *shm, struct sample *smps[], unsigned cnt)
 {
-	int ret;
+	int avail;
+	struct sample *slots[cnt];
 
-	atomic_fetch_add(&shm->writers, 1);
+	avail = shmem_int_reserve(shm, slots, cnt);
+	if (avail <= 0)
+		return avail;
 
-	ret = queue_signalled_push_many(&shm->write.shared->queue, (void **) smps, cnt);
+	sample_copy_many(slots, smps, avail);
+	shmem_int_publish(shm, avail);
 
-	if (atomic_fetch_sub(&shm->writers, 1) == 1 && atomic_load(&shm->closed) == 1)
-		munmap(shm->write.base, shm->write.len);
+	/* The samples have been copied into the ring */
+	sample_decref_many(smps, avail);
 
-	return ret;
+	return avail;
 }
 
 int shmem_int_alloc(struct shmem_int *shm, struct sample *smps[], unsigned cnt)
 {
-	return sample_alloc_many(&shm->write.shared->pool, smps, cnt);
+	return sample_alloc_many(&shm->write.pool, smps, cnt);
 }
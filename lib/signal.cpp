@@ -20,6 +20,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *********************************************************************************/
 
+#include <cmath>
 #include <cstring>
 #include <cinttypes>
 #include <villas/signal.h>
@@ -27,6 +28,8 @@
 #include <villas/utils.hpp>
 #include <villas/node.h>
 #include <villas/mapping.h>
+#include <villas/io.h>
+#include <villas/text_codec.h>
 
 using namespace villas;
 using namespace villas::utils;
@@ -337,8 +340,10 @@ void signal_list_dump(const struct vlist *list, const union signal_data *data, u
 
 		if (data && i < len) {
 			char val[32];
+			int vlen;
 
-			signal_data_print_str(&data[i], sig, val, sizeof(val));
+			vlen = signal_data_print_str(&data[i], sig, val, sizeof(val) - 1);
+			val[vlen] = '\0';
 
 			strcatf(&buf, " = %s", val);
 		}
@@ -364,6 +369,25 @@ int signal_list_copy(struct vlist *dst, const struct vlist *src)
 	return 0;
 }
 
+enum SignalType signal_list_type(const struct vlist *list, unsigned len)
+{
+	enum SignalType type = SignalType::INVALID;
+
+	if (!list || len > vlist_length(list))
+		return SignalType::INVALID;
+
+	for (unsigned i = 0; i < len; i++) {
+		struct signal *sig = (struct signal *) vlist_at(list, i);
+
+		if (i == 0)
+			type = sig->type;
+		else if (sig->type != type)
+			return SignalType::INVALID;
+	}
+
+	return type;
+}
+
 /* Signal type */
 
 enum SignalType signal_type_from_str(const char *str)
@@ -569,42 +593,44 @@ void signal_data_cast(union signal_data *data, const struct signal *from, const
 	}
 }
 
-int signal_data_parse_str(union signal_data *data, const struct signal *sig, const char *ptr, char **end)
+int signal_data_parse_str(union signal_data *data, const struct signal *sig, const char *ptr, size_t len, char **end)
 {
+	const char *last = ptr + len;
+
 	switch (sig->type) {
 		case SignalType::FLOAT:
-			data->f = strtod(ptr, end);
+			data->f = text_parse_double(ptr, last, end);
 			break;
 
 		case SignalType::INTEGER:
-			data->i = strtol(ptr, end, 10);
+			data->i = text_parse_int(ptr, last, end);
 			break;
 
 		case SignalType::BOOLEAN:
-			data->b = strtol(ptr, end, 10);
+			data->b = text_parse_int(ptr, last, end);
 			break;
 
 		case SignalType::COMPLEX: {
 			float real, imag = 0;
 
-			real = strtod(ptr, end);
+			real = text_parse_float(ptr, last, end);
 			if (*end == ptr)
 				return -1;
 
 			ptr = *end;
 
-			if (*ptr == 'i' || *ptr == 'j') {
+			if (ptr < last && (*ptr == 'i' || *ptr == 'j')) {
 				imag = real;
 				real = 0;
 
 				(*end)++;
 			}
-			else if (*ptr == '-' || *ptr == '+') {
-				imag = strtod(ptr, end);
+			else if (ptr < last && (*ptr == '-' || *ptr == '+')) {
+				imag = text_parse_float(ptr, last, end);
 				if (*end == ptr)
 					return -1;
 
-				if (**end != 'i' && **end != 'j')
+				if (*end == last || (**end != 'i' && **end != 'j'))
 					return -1;
 
 				(*end)++;
@@ -660,20 +686,57 @@ int signal_data_parse_json(union signal_data *data, const struct signal *sig, js
 	return 0;
 }
 
-int signal_data_print_str(const union signal_data *data, const struct signal *sig, char *buf, size_t len)
+int signal_data_print_str(const union signal_data *data, const struct signal *sig, char *buf, size_t len, int flags)
 {
+	int ret;
+	size_t off = 0;
+
+	if (flags & (int) IOFlags::PRINTF_COMPAT) {
+		switch (sig->type) {
+			case SignalType::FLOAT:
+				ret = snprintf(buf, len, "%.6f", data->f);
+				break;
+
+			case SignalType::INTEGER:
+				ret = snprintf(buf, len, "%" PRIi64, data->i);
+				break;
+
+			case SignalType::BOOLEAN:
+				ret = snprintf(buf, len, "%u", data->b);
+				break;
+
+			case SignalType::COMPLEX:
+				ret = snprintf(buf, len, "%.6f%+.6fi", std::real(data->z), std::imag(data->z));
+				break;
+
+			default:
+				ret = 0;
+		}
+
+		return ret < 0 ? 0 : MIN((size_t) ret, len);
+	}
+
 	switch (sig->type) {
 		case SignalType::FLOAT:
-			return snprintf(buf, len, "%.6f", data->f);
+			return text_print_double(buf, len, data->f);
 
 		case SignalType::INTEGER:
-			return snprintf(buf, len, "%" PRIi64, data->i);
+			return text_print_int(buf, len, data->i);
 
 		case SignalType::BOOLEAN:
-			return snprintf(buf, len, "%u", data->b);
+			return text_print_uint(buf, len, data->b);
 
 		case SignalType::COMPLEX:
-			return snprintf(buf, len, "%.6f%+.6fi", std::real(data->z), std::imag(data->z));
+			off += text_print_float(buf + off, len - off, std::real(data->z));
+
+			/* The imaginary part always starts with a sign */
+			if (!std::signbit(std::imag(data->z)))
+				off += text_print_char(buf + off, len - off, '+');
+
+			off += text_print_float(buf + off, len - off, std::imag(data->z));
+			off += text_print_char(buf + off, len - off, 'i');
+
+			return off;
 
 		default:
 			return 0;
@@ -61,7 +61,9 @@ SuperNode::SuperNode() :
 #endif
 	priority(0),
 	affinity(0),
-	hugepages(DEFAULT_NR_HUGEPAGES)
+	hugepages(DEFAULT_NR_HUGEPAGES),
+	arenaSize(DEFAULT_HUGEPAGE_ARENA_SIZE >> 20),
+	giganticPages(0)
 {
 	nodes.state = State::DESTROYED;
 	paths.state = State::DESTROYED;
@@ -101,17 +103,21 @@ void SuperNode::parse(json_t *cfg)
 	json_t *json_paths = nullptr;
 	json_t *json_logging = nullptr;
 	json_t *json_web = nullptr;
+	json_t *json_scheduler = nullptr;
 
 	json_error_t err;
 
 	idleStop = true;
 
-	ret = json_unpack_ex(cfg, &err, JSON_STRICT, "{ s?: o, s?: o, s?: o, s?: o, s?: i, s?: i, s?: i, s?: s, s?: b }",
+	ret = json_unpack_ex(cfg, &err, JSON_STRICT, "{ s?: o, s?: o, s?: o, s?: o, s?: o, s?: i, s?: i, s?: b, s?: i, s?: i, s?: s, s?: b }",
 		"http", &json_web,
+		"scheduler", &json_scheduler,
 		"logging", &json_logging,
 		"nodes", &json_nodes,
 		"paths", &json_paths,
 		"hugepages", &hugepages,
+		"arena_size", &arenaSize,
+		"gigantic_pages", &giganticPages,
 		"affinity", &affinity,
 		"priority", &priority,
 		"name", &nme,
@@ -123,11 +129,22 @@ void SuperNode::parse(json_t *cfg)
 	if (nme)
 		name = nme;
 
+	if (arenaSize < 0)
+		throw ConfigError(cfg, "node-config-arena-size", "Setting 'arena_size' must be a positive number");
+
 #ifdef WITH_WEB
 	if (json_web)
 		web.parse(json_web);
 #endif /* WITH_WEB */
 
+	if (json_scheduler) {
+#ifdef HAS_EPOLL
+		scheduler.parse(json_scheduler);
+#else
+		logger->warn("The path scheduler is not supported on this platform. Using one thread per path.");
+#endif /* HAS_EPOLL */
+	}
+
 	if (json_logging)
 		logging.parse(json_logging);
 
@@ -301,6 +318,11 @@ void SuperNode::startPaths()
 		if (ret)
 			throw RuntimeError("Failed to start path: {}", path_name(p));
 	}
+
+#ifdef HAS_EPOLL
+	if (scheduler.isEnabled())
+		scheduler.start();
+#endif /* HAS_EPOLL */
 }
 
 void SuperNode::prepareNodes()
@@ -338,6 +360,13 @@ void SuperNode::preparePaths()
 		ret = path_prepare(p);
 		if (ret)
 			throw RuntimeError("Failed to prepare path: {}", path_name(p));
+
+#ifdef HAS_EPOLL
+		/* Paths without poll(2) support block in node_read() and keep their own thread.
+		 * So do paths which request their own affinity, priority or busy polling. */
+		if (scheduler.isEnabled() && p->poll && !p->affinity && !p->priority && !p->busy_poll)
+			p->scheduler = &scheduler;
+#endif /* HAS_EPOLL */
 	}
 }
 
@@ -347,12 +376,19 @@ void SuperNode::prepare()
 
 	assert(state == State::CHECKED);
 
+	memory_hugepage_arenas((size_t) arenaSize << 20, giganticPages);
+
 	ret = memory_init(hugepages);
 	if (ret)
 		throw RuntimeError("Failed to initialize memory system");
 
 	kernel::rt::init(priority, affinity);
 
+#ifdef HAS_EPOLL
+	if (scheduler.isEnabled())
+		scheduler.prepare();
+#endif /* HAS_EPOLL */
+
 	prepareNodes();
 	preparePaths();
 
@@ -391,6 +427,11 @@ void SuperNode::stopPaths()
 {
 	int ret;
 
+#ifdef HAS_EPOLL
+	/* Scheduled paths must not be executed anymore while they are stopped */
+	scheduler.stop();
+#endif /* HAS_EPOLL */
+
 	for (size_t i = 0; i < vlist_length(&paths); i++) {
 		auto *p = (struct path *) vlist_at(&paths, i);
 
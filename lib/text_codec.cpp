@@ -0,0 +1,262 @@
+/** Locale-independent conversion of numbers for text formats.
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <charconv>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+#include <locale.h>
+
+#include <villas/text_codec.h>
+
+/* libstdc++ supports floating point types in <charconv> since GCC 11 */
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  #define TEXT_CODEC_CHARCONV_FP
+#endif
+
+/** The "C" locale which is used for floating point numbers which std::from_chars() or std::to_chars() can not handle. */
+static locale_t text_locale()
+{
+	static locale_t loc = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+
+	return loc;
+}
+
+template<typename T>
+static size_t text_print(char *buf, size_t len, T v)
+{
+	auto res = std::to_chars(buf, buf + len, v);
+	if (res.ec != std::errc())
+		return len;
+
+	return res.ptr - buf;
+}
+
+/** Skip leading whitespace and a '+' sign like strtod() does. */
+static const char * text_skip(const char *ptr, const char *last, bool sign)
+{
+	while (ptr < last && isspace(*ptr))
+		ptr++;
+
+	/* std::from_chars() does not accept a plus sign */
+	if (sign && ptr < last && *ptr == '+')
+		ptr++;
+
+	return ptr;
+}
+
+/** Get the value of a number in [\p p, \p q) which does not fit into T.
+ *
+ * Floating point numbers are converted with strtod_l() or strtof_l() which
+ * return +-HUGE_VAL on overflow and a denormal number or 0 on underflow.
+ * Integers are clamped to the limits of T.
+ */
+template<typename T>
+static T text_parse_out_of_range(const char *p, const char *q)
+{
+	if constexpr (std::is_floating_point<T>::value) {
+		std::string buf(p, q);
+
+		if constexpr (std::is_same<T, float>::value)
+			return strtof_l(buf.c_str(), nullptr, text_locale());
+		else
+			return strtod_l(buf.c_str(), nullptr, text_locale());
+	}
+	else
+		return *p == '-' ? std::numeric_limits<T>::min() : std::numeric_limits<T>::max();
+}
+
+template<typename T>
+static T text_parse(const char *ptr, const char *last, char **end)
+{
+	T v = 0;
+	const char *p = text_skip(ptr, last, true);
+
+	auto res = std::from_chars(p, last, v);
+	if (res.ec == std::errc::invalid_argument) {
+		*end = (char *) ptr;
+		return 0;
+	}
+
+	/* Values which are out of range are clamped like strtod() and strtoll() do */
+	if (res.ec == std::errc::result_out_of_range)
+		v = text_parse_out_of_range<T>(p, res.ptr);
+
+	*end = (char *) res.ptr;
+
+	return v;
+}
+
+#ifndef TEXT_CODEC_CHARCONV_FP
+static size_t text_print_fallback(char *buf, size_t len, int precision, double v)
+{
+	locale_t old = uselocale(text_locale());
+
+	int ret = snprintf(buf, len, "%.*g", precision, v);
+
+	uselocale(old);
+
+	return ret < 0 || (size_t) ret >= len ? len : ret;
+}
+
+/** Parse a floating point number with strtod_l() or strtof_l().
+ *
+ * Those require a null-terminated string. So the characters which might
+ * belong to the number are copied first. This also covers "inf", "nan" and
+ * hexadecimal numbers. */
+template<typename T>
+static T text_parse_fallback(const char *ptr, const char *last, char **end, T (*conv)(const char *, char **, locale_t))
+{
+	char sbuf[64], *buf, *e;
+	std::string lbuf;
+	const char *p, *q;
+	size_t n;
+	T v;
+
+	p = text_skip(ptr, last, false);
+
+	for (q = p; q < last && (isalnum(*q) || *q == '.' || *q == '+' || *q == '-'); q++);
+
+	n = q - p;
+	if (n < sizeof(sbuf)) {
+		memcpy(sbuf, p, n);
+		sbuf[n] = '\0';
+
+		buf = sbuf;
+	}
+	else {
+		lbuf.assign(p, n);
+
+		buf = &lbuf[0];
+	}
+
+	v = conv(buf, &e, text_locale());
+
+	*end = e == buf ? (char *) ptr : (char *) p + (e - buf);
+
+	return v;
+}
+#endif /* TEXT_CODEC_CHARCONV_FP */
+
+size_t text_print_double(char *buf, size_t len, double v, int precision)
+{
+#ifdef TEXT_CODEC_CHARCONV_FP
+	if (precision > 0) {
+		auto res = std::to_chars(buf, buf + len, v, std::chars_format::general, precision);
+		if (res.ec != std::errc())
+			return len;
+
+		return res.ptr - buf;
+	}
+
+	return text_print(buf, len, v);
+#else
+	return text_print_fallback(buf, len, precision > 0 ? precision : 17, v);
+#endif
+}
+
+size_t text_print_float(char *buf, size_t len, float v)
+{
+#ifdef TEXT_CODEC_CHARCONV_FP
+	return text_print(buf, len, v);
+#else
+	return text_print_fallback(buf, len, 9, v);
+#endif
+}
+
+size_t text_print_int(char *buf, size_t len, int64_t v)
+{
+	return text_print(buf, len, v);
+}
+
+size_t text_print_uint(char *buf, size_t len, uint64_t v, int width)
+{
+	char digits[24];
+	size_t n, pad;
+
+	n = text_print(digits, sizeof(digits), v);
+	pad = width > 0 && (size_t) width > n ? width - n : 0;
+
+	if (pad + n > len)
+		return len;
+
+	memset(buf, '0', pad);
+	memcpy(buf + pad, digits, n);
+
+	return pad + n;
+}
+
+size_t text_print_char(char *buf, size_t len, char c)
+{
+	if (len == 0)
+		return 0;
+
+	buf[0] = c;
+
+	return 1;
+}
+
+size_t text_print_str(char *buf, size_t len, const char *str)
+{
+	size_t n = strlen(str);
+
+	if (n > len)
+		return len;
+
+	memcpy(buf, str, n);
+
+	return n;
+}
+
+double text_parse_double(const char *ptr, const char *last, char **end)
+{
+#ifdef TEXT_CODEC_CHARCONV_FP
+	return text_parse<double>(ptr, last, end);
+#else
+	return text_parse_fallback<double>(ptr, last, end, strtod_l);
+#endif
+}
+
+float text_parse_float(const char *ptr, const char *last, char **end)
+{
+#ifdef TEXT_CODEC_CHARCONV_FP
+	return text_parse<float>(ptr, last, end);
+#else
+	return text_parse_fallback<float>(ptr, last, end, strtof_l);
+#endif
+}
+
+int64_t text_parse_int(const char *ptr, const char *last, char **end)
+{
+	return text_parse<int64_t>(ptr, last, end);
+}
+
+uint64_t text_parse_uint(const char *ptr, const char *last, char **end)
+{
+	return text_parse<uint64_t>(ptr, last, end);
+}
@@ -163,28 +163,37 @@ void Web::lwsLogger(int lws_lvl, const char *msg) {
 	}
 }
 
-void Web::worker()
+thread_local int Web::tsi = 0;
+
+void Web::worker(Service *s)
 {
 	lws *wsi;
 
-	logger->info("Started worker");
+	tsi = s->tsi;
+
+	logger->info("Started worker {}", s->tsi);
 
 	while (running) {
-		lws_service(context, 100);
+		lws_service_tsi(context, 100, s->tsi);
+
+		/* Reset before draining so that a concurrent push wakes us up again */
+		s->pending = false;
 
-		while (!writables.empty()) {
-			wsi = writables.pop();
+		while (!s->writables.empty()) {
+			wsi = s->writables.pop();
 
 			lws_callback_on_writable(wsi);
 		}
 	}
 
-	logger->info("Stopped worker");
+	logger->info("Stopped worker {}", s->tsi);
 }
 
 Web::Web(Api *a) :
 	state(State::INITIALIZED),
 	htdocs(WEB_PATH),
+	compression(1),
+	threads(1),
 	api(a)
 {
 	int lvl = LLL_ERR | LLL_WARN | LLL_NOTICE;
@@ -207,16 +216,21 @@ int Web::parse(json_t *cfg)
 	const char *htd = nullptr;
 	json_error_t err;
 
-	ret = json_unpack_ex(cfg, &err, JSON_STRICT, "{ s?: s, s?: s, s?: s, s?: i, s?: b }",
+	ret = json_unpack_ex(cfg, &err, JSON_STRICT, "{ s?: s, s?: s, s?: s, s?: i, s?: b, s?: b, s?: i }",
 		"ssl_cert", &cert,
 		"ssl_private_key", &pkey,
 		"htdocs", &htd,
 		"port", &port,
-		"enabled", &enabled
+		"enabled", &enabled,
+		"compression", &compression,
+		"threads", &threads
 	);
 	if (ret)
 		throw ConfigError(cfg, err, "node-config-http");
 
+	if (threads < 0)
+		throw ConfigError(cfg, "node-config-http", "Setting 'threads' must be a positive number");
+
 	if (cert)
 		ssl_cert = cert;
 
@@ -241,9 +255,21 @@ void Web::start()
 
 	memset(&ctx_info, 0, sizeof(ctx_info));
 
+	/* By default we start one service thread per core */
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+
+#ifdef LWS_MAX_SMP
+	if (threads > LWS_MAX_SMP) {
+		logger->warn("libwebsockets supports at most {} service threads", LWS_MAX_SMP);
+		threads = LWS_MAX_SMP;
+	}
+#endif
+
 	ctx_info.port = port;
+	ctx_info.count_threads = threads;
 	ctx_info.protocols = protocols;
-	ctx_info.extensions = extensions;
+	ctx_info.extensions = compression ? extensions : nullptr;
 	ctx_info.ssl_cert_filepath = ssl_cert.empty() ? nullptr : ssl_cert.c_str();
 	ctx_info.ssl_private_key_filepath = ssl_private_key.empty() ? nullptr : ssl_private_key.c_str();
 	ctx_info.gid = -1;
@@ -256,7 +282,7 @@ void Web::start()
  #endif
 	ctx_info.mounts = mounts;
 
-	logger->info("Starting sub-system: htdocs={}", htdocs.c_str());
+	logger->info("Starting sub-system: htdocs={}, compression={}, threads={}", htdocs.c_str(), compression ? "yes" : "no", threads);
 
 	/* update web root of mount point */
 	mounts[ARRAY_LEN(mounts)-1].origin = htdocs.c_str();
@@ -277,9 +303,23 @@ void Web::start()
 	if (vhost == nullptr)
 		throw RuntimeError("Failed to initialize virtual host");
 
-	/* Start thread */
+	/* libwebsockets distributes new connections among the service threads */
+	threads = lws_get_count_threads(context);
+
+	/* Start threads */
 	running = true;
-	thread = std::thread(&Web::worker, this);
+
+	for (int i = 0; i < threads; i++) {
+		auto *s = new Service;
+
+		s->tsi = i;
+		s->pending = false;
+
+		services.push_back(s);
+	}
+
+	for (Service *s : services)
+		s->thread = std::thread(&Web::worker, this, s);
 
 	state = State::STARTED;
 }
@@ -291,14 +331,29 @@ void Web::stop()
 	logger->info("Stopping sub-system");
 
 	running = false;
-	thread.join();
+
+	lws_cancel_service(context);
+
+	for (Service *s : services) {
+		s->thread.join();
+
+		delete s;
+	}
+
+	services.clear();
 
 	lws_context_destroy(context);
 
 	state = State::STOPPED;
 }
 
-void Web::callbackOnWritable(lws *wsi)
+void Web::callbackOnWritable(lws *wsi, int tsi)
 {
-	writables.push(wsi);
+	Service *s = services[tsi];
+
+	s->writables.push(wsi);
+
+	/* lws_callback_on_writable() must be called by the service thread owning the wsi */
+	if (!s->pending.exchange(true))
+		lws_cancel_service(context);
 }
@@ -253,35 +253,20 @@ check:			if (optarg == endptr)
 
 			logger->debug("Read {} smps from stdin", recv);
 
-			unsigned send = 0;
-			for (int processed = 0; processed < recv; processed++) {
-				struct sample *smp = smps[processed];
+			for (int i = 0; i < recv; i++) {
+				struct sample *smp = smps[i];
 
 				if (!(smp->flags & (int) SampleFlags::HAS_TS_RECEIVED)){
 					smp->ts.received = now;
 					smp->flags |= (int) SampleFlags::HAS_TS_RECEIVED;
 				}
-
-				auto ret = h->process(smp);
-				switch (ret) {
-					using Reason = villas::node::Hook::Reason;
-
-					case Reason::ERROR:
-						throw RuntimeError("Failed to process samples");
-
-					case Reason::OK:
-						smps[send++] = smp;
-						break;
-
-					case Reason::SKIP_SAMPLE:
-						break;
-
-					case Reason::STOP_PROCESSING:
-						goto stop;
-				}
 			}
 
-stop:			sent = io_print(&io, smps, send);
+			int send = h->process(smps, recv);
+			if (send < 0)
+				throw RuntimeError("Failed to process samples");
+
+			sent = io_print(&io, smps, send);
 			if (sent < 0)
 				throw RuntimeError("Failed to write to stdout");
 
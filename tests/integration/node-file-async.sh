@@ -0,0 +1,124 @@
+#!/bin/bash
+#
+# Integration test for the asynchronous writer of the file node.
+#
+# @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+# @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+# @license GNU General Public License (version 3)
+#
+# VILLASnode
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+##################################################################################
+
+SCRIPT=$(realpath $0)
+SCRIPTPATH=$(dirname ${SCRIPT})
+source ${SCRIPTPATH}/../../tools/villas-helper.sh
+
+CONFIG_FILE=$(mktemp)
+INPUT_FILE=$(mktemp)
+OUTPUT_FILE=$(mktemp)
+LOG_FILE=$(mktemp)
+FIFO=$(mktemp -u)
+
+NUM_SAMPLES=${NUM_SAMPLES:-5000}
+
+# Generate test data
+villas-signal -l ${NUM_SAMPLES} -n random > ${INPUT_FILE}
+
+# Get a counter of the asynchronous writer from the log
+function counter() {
+	sed -n "s/.*Asynchronous writer of node node1: .*$1=\([0-9]*\).*/\1/p" ${LOG_FILE}
+}
+
+RC=0
+
+for OVERFLOW in block drop; do
+
+cat > ${CONFIG_FILE} <<EOF
+{
+	"nodes" : {
+		"node1" : {
+			"type" : "file",
+			"uri" : "${FIFO}",
+
+			"in" : {
+				"epoch_mode" : "original"
+			},
+			"out" : {
+				"flush" : true,
+				"async" : true,
+				"queuelen" : 16,
+				"overflow" : "${OVERFLOW}"
+			}
+		}
+	}
+}
+EOF
+
+	mkfifo ${FIFO}
+
+	# The reader stalls the writer thread until the pipe buffer and the small queue are full
+	{ sleep 2; cat; } < ${FIFO} > ${OUTPUT_FILE} &
+	READER=$!
+
+	VILLAS_LOG_PREFIX=$(colorize "[Pipe] ") \
+	villas-pipe -s -L ${NUM_SAMPLES} ${CONFIG_FILE} node1 < ${INPUT_FILE} 2> ${LOG_FILE}
+
+	wait ${READER}
+	rm ${FIFO}
+
+	WRITTEN=$(counter written)
+	DROPPED=$(counter dropped)
+	BLOCKED=$(counter blocked)
+	ERRORS=$(counter errors)
+
+	# Samples are written in the order in which they were queued
+	SEQUENCES=$(grep -v '^#' ${OUTPUT_FILE} | sed -n 's/^[^(]*(\([0-9]*\)).*/\1/p')
+	LINES=$(echo "${SEQUENCES}" | grep -c .)
+
+	if ! echo "${SEQUENCES}" | sort -n -c -u; then
+		echo "Samples of mode '${OVERFLOW}' have been reordered"
+		RC=1
+	fi
+
+	if [ "${WRITTEN}" -ne "${LINES}" ] || [ "${ERRORS}" -ne 0 ] || \
+	   [ $((WRITTEN + DROPPED)) -ne ${NUM_SAMPLES} ]; then
+		echo "Counters of mode '${OVERFLOW}' do not match: written=${WRITTEN}, dropped=${DROPPED}, errors=${ERRORS}, lines=${LINES}"
+		RC=1
+	fi
+
+	case ${OVERFLOW} in
+		block)
+			# The stalled writer must have blocked the sender and nothing is lost
+			if [ "${BLOCKED}" -eq 0 ] || [ "${DROPPED}" -ne 0 ]; then
+				echo "Mode 'block' did not block: blocked=${BLOCKED}, dropped=${DROPPED}"
+				RC=1
+			fi
+
+			villas-test-cmp ${INPUT_FILE} ${OUTPUT_FILE} || RC=1
+			;;
+
+		drop)
+			if [ "${DROPPED}" -eq 0 ] || [ "${BLOCKED}" -ne 0 ]; then
+				echo "Mode 'drop' did not drop: blocked=${BLOCKED}, dropped=${DROPPED}"
+				RC=1
+			fi
+			;;
+	esac
+done
+
+rm ${CONFIG_FILE} ${INPUT_FILE} ${OUTPUT_FILE} ${LOG_FILE}
+
+exit ${RC}
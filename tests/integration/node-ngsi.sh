@@ -0,0 +1,135 @@
+#!/bin/bash
+#
+# Integration test for the ngsi node-type with a stand-in context broker.
+#
+# @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+# @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+# @license GNU General Public License (version 3)
+#
+# VILLASnode
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+##################################################################################
+
+SCRIPT=$(realpath $0)
+SCRIPTPATH=$(dirname ${SCRIPT})
+source ${SCRIPTPATH}/../../tools/villas-helper.sh
+
+CONFIG_FILE=$(mktemp)
+BROKER_FILE=$(mktemp)
+BROKER_LOG=$(mktemp)
+
+PORT=${PORT:-1026}
+NUM_SAMPLES=${NUM_SAMPLES:-500}
+
+# A minimal and slow NGSI v1 context broker which records the latest update
+cat > ${BROKER_FILE} <<EOF
+import http.server, json, sys, time
+
+entity = None
+updates = 0
+
+class Handler(http.server.BaseHTTPRequestHandler):
+	protocol_version = 'HTTP/1.1'
+
+	def do_POST(self):
+		global entity, updates
+
+		req = json.loads(self.rfile.read(int(self.headers['Content-Length'])))
+
+		# The broker can not keep up with the rate of the signal node
+		time.sleep(0.01)
+
+		if self.path.endswith('/updateContext') and req['updateAction'] != 'DELETE':
+			entity = req['contextElements'][0]
+			if req['updateAction'] == 'UPDATE':
+				updates += 1
+
+		with open(sys.argv[2], 'w') as f:
+			json.dump({ 'updates': updates, 'entity': entity }, f)
+
+		body = json.dumps({
+			'contextResponses': [{
+				'contextElement': entity,
+				'statusCode': { 'code': '200', 'reasonPhrase': 'OK' }
+			}]
+		}).encode()
+
+		self.send_response(200)
+		self.send_header('Content-Type', 'application/json')
+		self.send_header('Content-Length', len(body))
+		self.end_headers()
+		self.wfile.write(body)
+
+	def log_message(self, *args):
+		pass
+
+http.server.ThreadingHTTPServer(('localhost', int(sys.argv[1])), Handler).serve_forever()
+EOF
+
+cat > ${CONFIG_FILE} <<EOF
+{
+	"nodes": {
+		"signal_1": {
+			"type": "signal",
+			"signal": "sine",
+			"values": 1,
+			"limit": ${NUM_SAMPLES},
+			"rate": 1000
+		},
+		"ngsi_1": {
+			"type": "ngsi",
+			"endpoint": "http://localhost:${PORT}",
+			"entity_id": "test_entity",
+			"entity_type": "test",
+			"timeout": 0.1,
+			"mapping": [
+				"voltage(V)"
+			]
+		}
+	},
+	"paths": [
+		{
+			"in": "signal_1",
+			"out": "ngsi_1"
+		}
+	]
+}
+EOF
+
+# Start broker
+python3 ${BROKER_FILE} ${PORT} ${BROKER_LOG} &
+BPID=$!
+
+sleep 1
+
+# Start node
+VILLAS_LOG_PREFIX=$(colorize "[Node]  ") \
+villas-node ${CONFIG_FILE} &
+PID=$!
+
+sleep 3
+
+kill ${PID}
+wait ${PID}
+
+kill ${BPID}
+
+# Updates are coalesced as the broker can not keep up, but the latest sample must always arrive
+jq -e ".updates > 0 and .updates < ${NUM_SAMPLES} and .entity.attributes[0].value[-1][2] == ${NUM_SAMPLES} - 1" ${BROKER_LOG} > /dev/null
+RC=$?
+
+rm ${CONFIG_FILE} ${BROKER_FILE} ${BROKER_LOG}
+
+exit ${RC}
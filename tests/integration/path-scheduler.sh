@@ -0,0 +1,128 @@
+#!/bin/bash
+#
+# Integration test for the path scheduler running more paths than workers.
+#
+# @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+# @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+# @license GNU General Public License (version 3)
+#
+# VILLASnode
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+##################################################################################
+
+SCRIPT=$(realpath $0)
+SCRIPTPATH=$(dirname ${SCRIPT})
+source ${SCRIPTPATH}/../../tools/villas-helper.sh
+
+CONFIG_FILE=$(mktemp)
+LOG_FILE=$(mktemp)
+OUTPUT_DIR=$(mktemp -d)
+
+NUM_PATHS=${NUM_PATHS:-6}
+NUM_WORKERS=${NUM_WORKERS:-2}
+NUM_SAMPLES=${NUM_SAMPLES:-500}
+RATE=${RATE:-500}
+
+# Generate a configuration with one signal -> file path per source
+NODES=""
+PATHS=""
+for ((I=0; I<NUM_PATHS; I++)); do
+	[ ${I} -gt 0 ] && { NODES+=","; PATHS+=","; }
+
+	NODES+="
+		\"sig${I}\" : {
+			\"type\" : \"signal\",
+			\"signal\" : \"counter\",
+			\"values\" : 1,
+			\"rate\" : ${RATE},
+			\"limit\" : ${NUM_SAMPLES}
+		},
+		\"file${I}\" : {
+			\"type\" : \"file\",
+			\"uri\" : \"${OUTPUT_DIR}/file${I}.dat\"
+		}"
+
+	PATHS+="
+		{
+			\"in\" : \"sig${I}\",
+			\"out\" : \"file${I}\",
+			\"poll\" : true
+		}"
+done
+
+cat > ${CONFIG_FILE} <<EOF2
+{
+	"idle_stop" : true,
+	"scheduler" : {
+		"workers" : ${NUM_WORKERS}
+	},
+	"nodes" : {${NODES}
+	},
+	"paths" : [${PATHS}
+	]
+}
+EOF2
+
+RC=0
+
+# The super-node stops by itself once all signal generators reached their limit
+if ! timeout 60 villas-node ${CONFIG_FILE} 2> ${LOG_FILE}; then
+	echo "villas-node did not terminate properly"
+	RC=1
+fi
+
+# All paths have been multiplexed onto the workers
+WORKERS=$(grep -c "Worker .*: runs=" ${LOG_FILE})
+if [ "${WORKERS}" -ne ${NUM_WORKERS} ]; then
+	echo "Expected ${NUM_WORKERS} workers but found ${WORKERS}"
+	RC=1
+fi
+
+# A path must never be executed by two workers at the same time
+if grep "executed by more than one worker" ${LOG_FILE}; then
+	RC=1
+fi
+
+# Every path must have run until its source reached the limit
+LIMITS=$(grep -c "Reached limit." ${LOG_FILE})
+if [ "${LIMITS}" -ne ${NUM_PATHS} ]; then
+	echo "Only ${LIMITS} of ${NUM_PATHS} paths reached their limit"
+	RC=1
+fi
+
+for ((I=0; I<NUM_PATHS; I++)); do
+	OUTPUT_FILE=${OUTPUT_DIR}/file${I}.dat
+
+	SEQUENCES=$(grep -v '^#' ${OUTPUT_FILE} | sed -n 's/^[^(]*(\([0-9]*\)).*/\1/p')
+	LINES=$(echo "${SEQUENCES}" | grep -c .)
+
+	# Timer expirations which the generator missed are not lost by the scheduler
+	MISSED=$(sed -n "s/.*Node .*sig${I}[^0-9][^ ]* missed a total of \([0-9]*\) steps.*/\1/p" ${LOG_FILE})
+	MISSED=${MISSED:-0}
+
+	if ! echo "${SEQUENCES}" | sort -n -c -u; then
+		echo "Samples of path ${I} have been reordered"
+		RC=1
+	fi
+
+	if [ $((LINES + MISSED)) -ne ${NUM_SAMPLES} ]; then
+		echo "Path ${I} lost samples: lines=${LINES}, missed=${MISSED}, expected=${NUM_SAMPLES}"
+		RC=1
+	fi
+done
+
+rm -rf ${CONFIG_FILE} ${LOG_FILE} ${OUTPUT_DIR}
+
+exit ${RC}
@@ -29,6 +29,7 @@ source ${SCRIPTPATH}/../../tools/villas-helper.sh
 CONFIG_FILE=$(mktemp)
 INPUT_FILE=$(mktemp)
 OUTPUT_FILE=$(mktemp)
+LOG_FILE=$(mktemp)
 
 NUM_SAMPLES=${NUM_SAMPLES:-100}
 
@@ -38,6 +39,16 @@ villas-signal -l ${NUM_SAMPLES} -n random > ${INPUT_FILE}
 FORMAT="protobuf"
 VECTORIZE="10"
 
+rabbitmq-server -detached
+
+sleep 5
+
+# Confirm windows which are smaller than the number of messages wrap around
+for PREFETCH_WINDOW in 0:0 1:1 16:4 64:64; do
+
+PREFETCH=${PREFETCH_WINDOW%:*}
+CONFIRM_WINDOW=${PREFETCH_WINDOW#*:}
+
 cat > ${CONFIG_FILE} << EOF
 {
 	"nodes" : {
@@ -51,6 +62,9 @@ cat > ${CONFIG_FILE} << EOF
 
 			"exchange" : "mytestexchange",
 			"routing_key" : "abc",
+
+			"prefetch" : ${PREFETCH},
+			"confirm_window" : ${CONFIRM_WINDOW},
 		
 			"ssl" : {
 				"verify_hostname" : true,
@@ -65,18 +79,34 @@ cat > ${CONFIG_FILE} << EOF
 }
 EOF
 
-rabbitmq-server -detached
-
-sleep 5
-
-villas-pipe -l ${NUM_SAMPLES} ${CONFIG_FILE} node1 > ${OUTPUT_FILE} < ${INPUT_FILE}
-
-rabbitmqctl stop
+villas-pipe -l ${NUM_SAMPLES} ${CONFIG_FILE} node1 > ${OUTPUT_FILE} < ${INPUT_FILE} 2> >(tee ${LOG_FILE} >&2)
 
 # Compare data
 villas-test-cmp ${CMPFLAGS} ${INPUT_FILE} ${OUTPUT_FILE}
 RC=$?
 
-rm ${OUTPUT_FILE} ${INPUT_FILE} ${CONFIG_FILE}
+# All published messages must have been confirmed by the broker
+if (( ${RC} == 0 && ${CONFIRM_WINDOW} > 0 )); then
+	STATS=$(grep -o "published [0-9]* messages (acked=[0-9]*, nacked=[0-9]*)" ${LOG_FILE})
+	read PUBLISHED ACKED NACKED <<< $(echo ${STATS} | tr -c '0-9' ' ')
+
+	if [ -z "${NACKED}" ] || (( ${PUBLISHED} == 0 || ${ACKED} != ${PUBLISHED} || ${NACKED} != 0 )); then
+		echo "Missing publisher confirms: ${STATS}"
+		RC=1
+	fi
+fi
+
+if (( ${RC} != 0 )); then
+	echo "=========== Sub-test failed for: prefetch=${PREFETCH}, confirm_window=${CONFIRM_WINDOW}"
+	break
+else
+	echo "=========== Sub-test succeeded for: prefetch=${PREFETCH}, confirm_window=${CONFIRM_WINDOW}"
+fi
+
+done
+
+rabbitmqctl stop
+
+rm ${OUTPUT_FILE} ${INPUT_FILE} ${CONFIG_FILE} ${LOG_FILE}
 
 exit $RC
@@ -28,7 +28,7 @@ OUTPUT_FILE=$(mktemp)
 
 NUM_SAMPLES=${NUM_SAMPLES:-10}
 
-for MODE in polling pthread; do
+for MODE in polling futex; do
 for VECTORIZE in 1 5 25; do
 for SIGNAL_COUNT in 1 10 100; do
 
@@ -0,0 +1,131 @@
+/** Unit tests for streaming compression.
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include <criterion/criterion.h>
+#include <criterion/parameterized.h>
+
+#include <villas/node/config.h>
+#include <villas/utils.hpp>
+#include <villas/compression.h>
+
+#define NUM_LINES	10000
+
+ParameterizedTestParameters(compression, readback)
+{
+	static enum CompressionType types[] = {
+		CompressionType::NONE,
+#if defined(WITH_COMPRESSION) && defined(ZSTD_FOUND)
+		CompressionType::ZSTD,
+#endif
+#if defined(WITH_COMPRESSION) && defined(LZ4_FOUND)
+		CompressionType::LZ4,
+#endif
+	};
+
+	return cr_make_param_array(enum CompressionType, types, ARRAY_LEN(types));
+}
+
+ParameterizedTest(enum CompressionType *type, compression, readback)
+{
+	int ret;
+	char fn[] = "/tmp/villas.XXXXXX";
+	char line[64];
+	struct compression c = { *type, 0, 0 };
+
+	ret = mkstemp(fn);
+	cr_assert_geq(ret, 0);
+
+	close(ret);
+
+	/* Two writers append separate frames */
+	for (int j = 0; j < 2; j++) {
+		FILE *f = fopen(fn, "a+");
+		cr_assert_not_null(f);
+
+		if (c.type != CompressionType::NONE) {
+			f = compressor_open(f, &c, "w", nullptr);
+			cr_assert_not_null(f);
+		}
+
+		for (int i = 0; i < NUM_LINES; i++)
+			fprintf(f, "%d\t%f\n", j * NUM_LINES + i, i * 0.1);
+
+		ret = fclose(f);
+		cr_assert_eq(ret, 0);
+	}
+
+	FILE *f = fopen(fn, "r");
+	cr_assert_not_null(f);
+
+	if (c.type != CompressionType::NONE) {
+		f = compressor_open(f, &c, "r", nullptr);
+		cr_assert_not_null(f);
+	}
+
+	for (int k = 0; k < 2; k++) {
+		int i = 0;
+
+		rewind(f);
+
+		while (fgets(line, sizeof(line), f)) {
+			cr_assert_eq(atoi(line), i, "Mismatch in line %d: %s", i, line);
+			i++;
+		}
+
+		cr_assert_eq(i, 2 * NUM_LINES);
+	}
+
+	fclose(f);
+
+	ret = unlink(fn);
+	cr_assert_eq(ret, 0);
+}
+
+Test(compression, suffix)
+{
+	cr_assert_eq(compression_from_uri("logs/input.log.zst"), CompressionType::ZSTD);
+	cr_assert_eq(compression_from_uri("logs/input.csv.lz4"), CompressionType::LZ4);
+	cr_assert_eq(compression_from_uri("logs/input.log"), CompressionType::NONE);
+}
+
+#ifndef WITH_COMPRESSION
+Test(compression, unsupported)
+{
+	enum CompressionType type;
+	struct compression c = { CompressionType::ZSTD, 0, 0 };
+
+	cr_assert_neq(compression_parse("zstd", &type), 0);
+	cr_assert_neq(compression_parse("lz4", &type), 0);
+	cr_assert_eq(compression_parse("none", &type), 0);
+
+	FILE *f = tmpfile();
+	cr_assert_not_null(f);
+
+	cr_assert_null(compressor_open(f, &c, "w", nullptr));
+
+	fclose(f);
+}
+#endif
@@ -0,0 +1,161 @@
+/** Unit tests for the vectorized conversion kernels of binary formats
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#include <criterion/criterion.h>
+
+#include <villas/formats/convert.h>
+
+/* Lengths which cover empty, partial and full vectors of SSE2 and AVX2 plus remainders */
+static const size_t lengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 100 };
+
+static const char *implementations[] = { "sse2", "avx2" };
+
+/* Buffers in the wire representation are offset by one byte to exercise unaligned loads and stores */
+#define OFF 1
+
+static void fill(void *buf, size_t len, unsigned seed)
+{
+	unsigned char *p = (unsigned char *) buf;
+
+	for (size_t i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		p[i] = seed >> 16;
+	}
+}
+
+/** Run \p fn with the scalar and the named implementation and compare the outputs */
+template<typename F>
+static void compare(const char *impl, size_t outlen, size_t off, F fn)
+{
+	std::vector<uint64_t> ref(outlen / 8 + 2), out(outlen / 8 + 2);
+	char *r = (char *) ref.data() + off;
+	char *o = (char *) out.data() + off;
+
+	cr_assert_eq(convert_select("scalar"), 0);
+	fn(r);
+
+	cr_assert_eq(convert_select(impl), 0);
+	fn(o);
+
+	cr_assert_arr_eq(r, o, outlen, "Mismatch of %s implementation", impl);
+}
+
+Test(convert, float)
+{
+	for (const char *impl : implementations) {
+		if (convert_select(impl))
+			continue;
+
+		for (size_t len : lengths) {
+			std::vector<double> dbl(len + 1);
+			std::vector<char> flt[2];
+
+			for (size_t i = 0; i < len; i++)
+				dbl[i] = (i % 2 ? -1.0 : 1.0) * (i + 0.25) * 1e3;
+
+			/* Floats in host and in swapped byte order */
+			for (int swap = 0; swap < 2; swap++) {
+				flt[swap].resize(len * 4 + OFF);
+
+				for (size_t i = 0; i < len; i++) {
+					float f = dbl[i] / 3;
+					uint32_t u;
+
+					memcpy(&u, &f, sizeof(u));
+					u = swap ? __builtin_bswap32(u) : u;
+					memcpy(flt[swap].data() + OFF + i * 4, &u, sizeof(u));
+				}
+			}
+
+			for (bool swap : { false, true }) {
+				compare(impl, len * 4, OFF, [&](void *dst) {
+					convert_f64_to_f32(dst, dbl.data(), len, swap);
+				});
+
+				compare(impl, len * 8, 0, [&](void *dst) {
+					convert_f32_to_f64((double *) dst, flt[swap].data() + OFF, len, swap);
+				});
+			}
+		}
+	}
+
+	convert_select(nullptr);
+}
+
+Test(convert, integer)
+{
+	for (const char *impl : implementations) {
+		if (convert_select(impl))
+			continue;
+
+		for (size_t len : lengths) {
+			std::vector<int64_t> i64(len + 1);
+			std::vector<char> i32(len * 4 + OFF);
+
+			fill(i64.data(), len * 8, len + 1);
+			fill(i32.data() + OFF, len * 4, len + 2);
+
+			for (bool swap : { false, true }) {
+				compare(impl, len * 4, OFF, [&](void *dst) {
+					convert_i64_to_i32(dst, i64.data(), len, swap);
+				});
+
+				for (bool sign : { false, true }) {
+					compare(impl, len * 8, 0, [&](void *dst) {
+						convert_i32_to_i64((int64_t *) dst, i32.data() + OFF, len, swap, sign);
+					});
+				}
+
+				compare(impl, len * 8, OFF, [&](void *dst) {
+					convert_copy64(dst, i64.data(), len, swap);
+				});
+			}
+		}
+	}
+
+	convert_select(nullptr);
+}
+
+Test(convert, scalar)
+{
+	uint32_t be[3];
+	int64_t out[3];
+	const int32_t in[3] = { 1, -2, 0x12345678 };
+
+	cr_assert_eq(convert_select("scalar"), 0);
+
+	for (int i = 0; i < 3; i++)
+		be[i] = __builtin_bswap32((uint32_t) in[i]);
+
+	convert_i32_to_i64(out, be, 3, true, true);
+
+	for (int i = 0; i < 3; i++)
+		cr_assert_eq(out[i], in[i]);
+
+	cr_assert_eq(convert_select("unknown"), -1);
+
+	convert_select(nullptr);
+}
@@ -0,0 +1,141 @@
+/** Unit tests and benchmark for the dynamic phasor hook
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <cmath>
+#include <complex>
+
+#include <criterion/criterion.h>
+
+#include <villas/hook.hpp>
+#include <villas/sample.h>
+#include <villas/signal.h>
+#include <villas/timing.h>
+#include <villas/log.hpp>
+#include <villas/utils.hpp>
+
+using namespace villas;
+using namespace villas::node;
+
+extern void init_memory();
+
+#define RATE		5000.0
+#define F0		50.0
+#define NUM_SAMPLES	(1 << 16)
+#define NUM_HARMONICS	3
+
+/** Feed a sine wave through the dp hook and return the elapsed time in seconds. */
+static double run_dp(const char *method, std::complex<float> out[][NUM_HARMONICS])
+{
+	int ret;
+	struct vlist signals = { .state = State::DESTROYED };
+
+	ret = vlist_init(&signals);
+	cr_assert_eq(ret, 0);
+
+	ret = signal_list_generate(&signals, 1, SignalType::FLOAT);
+	cr_assert_eq(ret, 0);
+
+	auto hf = plugin::Registry::lookup<HookFactory>("dp");
+	cr_assert_not_null(hf);
+
+	Hook *h = hf->make(nullptr, nullptr);
+	cr_assert_not_null(h);
+
+	json_t *cfg = json_pack("{ s: i, s: f, s: f, s: [ i, i, i ], s: s }",
+		"signal", 0,
+		"f0", F0,
+		"rate", RATE,
+		"harmonics", 0, 1, 3,
+		"method", method
+	);
+	cr_assert_not_null(cfg);
+
+	h->parse(cfg);
+	h->check();
+	h->prepare(&signals);
+	h->start();
+
+	struct sample *smp = sample_alloc_mem(NUM_HARMONICS + 1);
+	cr_assert_not_null(smp);
+
+	struct timespec start = time_now();
+
+	for (int i = 0; i < NUM_SAMPLES; i++) {
+		smp->length = 1;
+		smp->data[0].f = 1.0 + sin(2 * M_PI * F0 * i / RATE) + 0.2 * sin(2 * M_PI * 3 * F0 * i / RATE);
+
+		Hook::Reason reason = h->process(smp);
+		cr_assert_eq(reason, Hook::Reason::OK);
+		cr_assert_eq(smp->length, NUM_HARMONICS);
+
+		for (int k = 0; k < NUM_HARMONICS; k++)
+			out[i][k] = smp->data[k].z;
+	}
+
+	struct timespec end = time_now();
+
+	h->stop();
+
+	sample_free(smp);
+	json_decref(cfg);
+	delete h;
+
+	ret = vlist_destroy(&signals, (dtor_cb_t) signal_decref, false);
+	cr_assert_eq(ret, 0);
+
+	return time_delta(&start, &end);
+}
+
+Test(dp, sliding, .init = init_memory)
+{
+	Logger logger = logging.get("test:dp:sliding");
+
+	auto *dft = new std::complex<float>[NUM_SAMPLES][NUM_HARMONICS];
+	auto *sdft = new std::complex<float>[NUM_SAMPLES][NUM_HARMONICS];
+
+	double t_dft = run_dp("dft", dft);
+	double t_sdft = run_dp("sdft", sdft);
+
+	/* Both methods must agree */
+	double max_err = 0;
+	for (int i = 0; i < NUM_SAMPLES; i++) {
+		for (int k = 0; k < NUM_HARMONICS; k++)
+			max_err = MAX(max_err, std::abs(dft[i][k] - sdft[i][k]));
+	}
+
+	cr_assert_lt(max_err, 1e-4, "Sliding DFT deviates from full DFT: %g", max_err);
+
+	/* After one period, the phasors represent the amplitudes of the input signal */
+	int N = RATE / F0;
+	for (int i = N; i < NUM_SAMPLES; i += N) {
+		cr_assert_float_eq(std::abs(sdft[i][0]), 1.0, 1e-4);
+		cr_assert_float_eq(std::abs(sdft[i][1]), 0.5, 1e-4);
+		cr_assert_float_eq(std::abs(sdft[i][2]), 0.1, 1e-4);
+	}
+
+	logger->info("dft:  {:.1f} ns/sample", 1e9 * t_dft / NUM_SAMPLES);
+	logger->info("sdft: {:.1f} ns/sample", 1e9 * t_sdft / NUM_SAMPLES);
+	logger->info("max. deviation: {:g}", max_err);
+
+	delete[] dft;
+	delete[] sdft;
+}
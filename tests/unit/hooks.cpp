@@ -0,0 +1,351 @@
+/** Unit tests for batched hooks
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <vector>
+#include <cinttypes>
+
+#include <criterion/criterion.h>
+
+#include <villas/hook.hpp>
+#include <villas/hook_list.hpp>
+#include <villas/pool.h>
+#include <villas/sample.h>
+#include <villas/signal.h>
+#include <villas/utils.hpp>
+
+using namespace villas;
+using namespace villas::node;
+
+extern void init_memory();
+
+#define NUM_SAMPLES	10
+#define NUM_VALUES	4
+#define BATCH_SIZE	4
+
+struct fixture {
+	struct pool pool;
+	struct vlist signals;
+
+	struct sample *smps[NUM_SAMPLES];
+};
+
+static void fixture_init(struct fixture *f, SignalType type, int len)
+{
+	int ret;
+
+	f->pool.state = State::DESTROYED;
+	f->pool.queue.state = State::DESTROYED;
+	f->signals.state = State::DESTROYED;
+
+	ret = pool_init(&f->pool, NUM_SAMPLES, SAMPLE_LENGTH(NUM_VALUES), &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	ret = vlist_init(&f->signals);
+	cr_assert_eq(ret, 0);
+
+	ret = signal_list_generate(&f->signals, len, type);
+	cr_assert_eq(ret, 0);
+
+	ret = sample_alloc_many(&f->pool, f->smps, NUM_SAMPLES);
+	cr_assert_eq(ret, NUM_SAMPLES);
+
+	for (int i = 0; i < NUM_SAMPLES; i++) {
+		f->smps[i]->sequence = i;
+		f->smps[i]->length = len;
+		f->smps[i]->signals = &f->signals;
+		f->smps[i]->flags = (int) SampleFlags::HAS_SEQUENCE | (int) SampleFlags::HAS_DATA;
+	}
+}
+
+static void fixture_destroy(struct fixture *f)
+{
+	int ret;
+
+	sample_decref_many(f->smps, NUM_SAMPLES);
+
+	ret = pool_destroy(&f->pool);
+	cr_assert_eq(ret, 0);
+
+	ret = vlist_destroy(&f->signals, (dtor_cb_t) signal_decref, false);
+	cr_assert_eq(ret, 0);
+}
+
+static Hook * hook_create(const char *name, json_t *cfg, struct vlist *signals)
+{
+	auto hf = plugin::Registry::lookup<HookFactory>(name);
+	cr_assert_not_null(hf);
+
+	Hook *h = hf->make(nullptr, nullptr);
+	cr_assert_not_null(h);
+
+	h->parse(cfg);
+	h->check();
+	h->prepare(signals);
+	h->start();
+
+	json_decref(cfg);
+
+	return h;
+}
+
+/** Pass the samples in batches of BATCH_SIZE through a hook.
+ *
+ * @return The sequence numbers of the passed samples in order.
+ */
+static std::vector<uint64_t> run_batched(Hook *h, struct sample *smps[], unsigned cnt)
+{
+	std::vector<uint64_t> seqs;
+
+	for (unsigned i = 0; i < cnt; i += BATCH_SIZE) {
+		unsigned len = MIN(BATCH_SIZE, cnt - i);
+
+		int passed = h->process(&smps[i], len);
+		cr_assert_geq(passed, 0);
+		cr_assert_leq(passed, (int) len);
+
+		for (int j = 0; j < passed; j++)
+			seqs.push_back(smps[i + j]->sequence);
+	}
+
+	return seqs;
+}
+
+static std::vector<uint64_t> run_scalar(Hook *h, struct sample *smps[], unsigned cnt)
+{
+	std::vector<uint64_t> seqs;
+
+	for (unsigned i = 0; i < cnt; i++) {
+		Hook::Reason reason = h->process(smps[i]);
+		cr_assert(reason == Hook::Reason::OK || reason == Hook::Reason::SKIP_SAMPLE);
+
+		if (reason == Hook::Reason::OK)
+			seqs.push_back(smps[i]->sequence);
+	}
+
+	return seqs;
+}
+
+static void check_seqs(const std::vector<uint64_t> &seqs, const std::vector<uint64_t> &expected)
+{
+	cr_assert_eq(seqs.size(), expected.size(), "Passed %zu samples instead of %zu", seqs.size(), expected.size());
+
+	for (size_t i = 0; i < expected.size(); i++)
+		cr_assert_eq(seqs[i], expected[i], "Sample %zu has sequence %" PRIu64 " instead of %" PRIu64, i, seqs[i], expected[i]);
+}
+
+Test(hooks, decimate, .init = init_memory)
+{
+	struct fixture f;
+	std::vector<uint64_t> expected = { 0, 3, 6, 9 };
+
+	fixture_init(&f, SignalType::FLOAT, 1);
+
+	Hook *h = hook_create("decimate", json_pack("{ s: i }", "ratio", 3), &f.signals);
+
+	check_seqs(run_batched(h, f.smps, NUM_SAMPLES), expected);
+
+	h->stop();
+	delete h;
+
+	h = hook_create("decimate", json_pack("{ s: i }", "ratio", 3), &f.signals);
+
+	for (int i = 0; i < NUM_SAMPLES; i++)
+		f.smps[i]->sequence = i;
+
+	check_seqs(run_scalar(h, f.smps, NUM_SAMPLES), expected);
+
+	h->stop();
+	delete h;
+
+	fixture_destroy(&f);
+}
+
+Test(hooks, drop, .init = init_memory)
+{
+	struct fixture f;
+	uint64_t seqs[NUM_SAMPLES] = { 0, 1, 3, 2, 4, 4, 5, 1, 6, 9 };
+	std::vector<uint64_t> expected = { 0, 1, 3, 4, 5, 6, 9 };
+
+	fixture_init(&f, SignalType::FLOAT, 1);
+
+	for (int i = 0; i < NUM_SAMPLES; i++)
+		f.smps[i]->sequence = seqs[i];
+
+	Hook *h = hook_create("drop", json_object(), &f.signals);
+
+	check_seqs(run_batched(h, f.smps, NUM_SAMPLES), expected);
+
+	h->stop();
+
+	/* Restore the original order as the batched process() moved the dropped samples */
+	for (int i = 0; i < NUM_SAMPLES; i++)
+		f.smps[i]->sequence = seqs[i];
+
+	h->start();
+
+	check_seqs(run_scalar(h, f.smps, NUM_SAMPLES), expected);
+
+	h->stop();
+	delete h;
+
+	fixture_destroy(&f);
+}
+
+Test(hooks, gate, .init = init_memory)
+{
+	struct fixture f;
+	double values[NUM_SAMPLES] = { 0, 1, 0, 0, 0, 0, 1, 1, 0, 0 };
+	std::vector<uint64_t> expected = { 1, 2, 3, 6, 7, 8 };
+
+	fixture_init(&f, SignalType::FLOAT, 1);
+
+	Hook *h = hook_create("gate", json_pack("{ s: i, s: s, s: f, s: i }",
+		"signal", 0,
+		"mode", "above",
+		"threshold", 0.5,
+		"samples", 3
+	), &f.signals);
+
+	for (int i = 0; i < NUM_SAMPLES; i++)
+		f.smps[i]->data[0].f = values[f.smps[i]->sequence];
+
+	check_seqs(run_batched(h, f.smps, NUM_SAMPLES), expected);
+
+	h->stop();
+	delete h;
+
+	h = hook_create("gate", json_pack("{ s: i, s: s, s: f, s: i }",
+		"signal", 0,
+		"mode", "above",
+		"threshold", 0.5,
+		"samples", 3
+	), &f.signals);
+
+	for (int i = 0; i < NUM_SAMPLES; i++) {
+		f.smps[i]->sequence = i;
+		f.smps[i]->data[0].f = values[i];
+	}
+
+	check_seqs(run_scalar(h, f.smps, NUM_SAMPLES), expected);
+
+	h->stop();
+	delete h;
+
+	fixture_destroy(&f);
+}
+
+Test(hooks, hook_list, .init = init_memory)
+{
+	int ret;
+	struct fixture f;
+	struct vlist hooks = { .state = State::DESTROYED };
+	uint64_t seqs[NUM_SAMPLES] = { 0, 1, 2, 3, 2, 4, 6, 5, 8, 9 };
+
+	fixture_init(&f, SignalType::FLOAT, 1);
+
+	for (int i = 0; i < NUM_SAMPLES; i++)
+		f.smps[i]->sequence = seqs[i];
+
+	ret = vlist_init(&hooks);
+	cr_assert_eq(ret, 0);
+
+	/* The drop hook sees only the samples which passed the decimate hook */
+	vlist_push(&hooks, hook_create("decimate", json_pack("{ s: i }", "ratio", 2), &f.signals));
+	vlist_push(&hooks, hook_create("drop", json_object(), &f.signals));
+
+	ret = hook_list_process(&hooks, f.smps, NUM_SAMPLES);
+	cr_assert_eq(ret, 4);
+
+	std::vector<uint64_t> passed(ret);
+	for (int i = 0; i < ret; i++)
+		passed[i] = f.smps[i]->sequence;
+
+	check_seqs(passed, { 0, 2, 6, 8 });
+
+	/* All samples are still in the array */
+	uint64_t sum = 0;
+	for (int i = 0; i < NUM_SAMPLES; i++)
+		sum += f.smps[i]->sequence;
+
+	cr_assert_eq(sum, 40);
+
+	for (size_t i = 0; i < vlist_length(&hooks); i++) {
+		Hook *h = (Hook *) vlist_at(&hooks, i);
+
+		h->stop();
+		delete h;
+	}
+
+	ret = vlist_destroy(&hooks, nullptr, false);
+	cr_assert_eq(ret, 0);
+
+	fixture_destroy(&f);
+}
+
+Test(hooks, average, .init = init_memory)
+{
+	int ret;
+	struct fixture f;
+	struct vlist integers = { .state = State::DESTROYED };
+
+	fixture_init(&f, SignalType::FLOAT, 2);
+
+	ret = vlist_init(&integers);
+	cr_assert_eq(ret, 0);
+
+	ret = signal_list_generate(&integers, 2, SignalType::INTEGER);
+	cr_assert_eq(ret, 0);
+
+	Hook *h = hook_create("average", json_pack("{ s: i, s: [ i, i ] }",
+		"offset", 0,
+		"signals", 0, 1
+	), &f.signals);
+
+	/* Samples of a batch do not need to share the same signal list */
+	for (int i = 0; i < NUM_SAMPLES; i++) {
+		if (i % 3 == 1) {
+			f.smps[i]->signals = &integers;
+			f.smps[i]->data[0].i = i;
+			f.smps[i]->data[1].i = 3 * i;
+		}
+		else {
+			f.smps[i]->data[0].f = i;
+			f.smps[i]->data[1].f = 3 * i;
+		}
+	}
+
+	std::vector<uint64_t> seqs = run_batched(h, f.smps, NUM_SAMPLES);
+	cr_assert_eq(seqs.size(), (size_t) NUM_SAMPLES);
+
+	for (int i = 0; i < NUM_SAMPLES; i++) {
+		cr_assert_eq(f.smps[i]->length, 3);
+		cr_assert_float_eq(f.smps[i]->data[0].f, 2.0 * i, 1e-9);
+	}
+
+	h->stop();
+	delete h;
+
+	ret = vlist_destroy(&integers, (dtor_cb_t) signal_decref, false);
+	cr_assert_eq(ret, 0);
+
+	fixture_destroy(&f);
+}
@@ -0,0 +1,318 @@
+/** Unit tests for the InfluxDB node
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <cstring>
+
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <criterion/criterion.h>
+
+#include <jansson.h>
+
+#include <villas/utils.hpp>
+#include <villas/node.h>
+#include <villas/pool.h>
+#include <villas/sample.h>
+#include <villas/signal.h>
+#include <villas/timing.h>
+#include <villas/nodes/influxdb.hpp>
+
+extern void init_memory();
+
+#define NUM_SAMPLES	100
+#define NUM_VALUES	2
+
+using namespace villas::utils;
+
+struct influxdb_fixture {
+	int sd;			/**< The socket of the local UDP listener. */
+
+	struct node n;
+	struct pool pool;
+	struct sample *smps[NUM_SAMPLES];
+};
+
+static void influxdb_fixture_init(struct influxdb_fixture *f, int buffer_size, int packet_size, double flush_interval)
+{
+	int ret;
+	char server[64];
+	struct sockaddr_in sa;
+	socklen_t salen = sizeof(sa);
+
+	/* The listener takes the role of the InfluxDB server */
+	f->sd = socket(AF_INET, SOCK_DGRAM, 0);
+	cr_assert_geq(f->sd, 0);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	ret = bind(f->sd, (struct sockaddr *) &sa, sizeof(sa));
+	cr_assert_eq(ret, 0);
+
+	ret = getsockname(f->sd, (struct sockaddr *) &sa, &salen);
+	cr_assert_eq(ret, 0);
+
+	snprintf(server, sizeof(server), "127.0.0.1:%u", ntohs(sa.sin_port));
+
+	f->n.name = strdup("influxdb");
+	f->n._name = strdup("influxdb");
+	f->n._vd = alloc(sizeof(struct influxdb));
+
+	f->n.out.signals.state = State::DESTROYED;
+	vlist_init(&f->n.out.signals);
+
+	ret = signal_list_generate(&f->n.out.signals, NUM_VALUES, SignalType::FLOAT);
+	cr_assert_eq(ret, 0);
+
+	json_t *json = json_pack("{ s: s, s: s, s: i, s: i, s: f }",
+		"server", server,
+		"key", "villas",
+		"buffer_size", buffer_size,
+		"packet_size", packet_size,
+		"flush_interval", flush_interval
+	);
+	cr_assert_not_null(json);
+
+	ret = influxdb_parse(&f->n, json);
+	cr_assert_eq(ret, 0);
+
+	json_decref(json);
+
+	ret = influxdb_open(&f->n);
+	cr_assert_eq(ret, 0);
+
+	f->pool.state = State::DESTROYED;
+	f->pool.queue.state = State::DESTROYED;
+
+	ret = pool_init(&f->pool, NUM_SAMPLES, SAMPLE_LENGTH(NUM_VALUES), &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	ret = sample_alloc_many(&f->pool, f->smps, NUM_SAMPLES);
+	cr_assert_eq(ret, NUM_SAMPLES);
+
+	for (unsigned i = 0; i < NUM_SAMPLES; i++) {
+		struct sample *smp = f->smps[i];
+
+		smp->length = NUM_VALUES;
+		smp->sequence = i;
+		smp->signals = &f->n.out.signals;
+		smp->ts.origin = time_now();
+
+		for (unsigned j = 0; j < NUM_VALUES; j++)
+			smp->data[j].f = i + j * 0.5;
+	}
+}
+
+static void influxdb_fixture_destroy(struct influxdb_fixture *f)
+{
+	int ret;
+
+	sample_decref_many(f->smps, NUM_SAMPLES);
+
+	ret = pool_destroy(&f->pool);
+	cr_assert_eq(ret, 0);
+
+	ret = signal_list_destroy(&f->n.out.signals);
+	cr_assert_eq(ret, 0);
+
+	free(f->n._vd);
+	free(f->n._name);
+	free(f->n.name);
+
+	close(f->sd);
+}
+
+/** Receive a single datagram.
+ *
+ * @return The length of the datagram or 0 if none arrived within \p timeout milliseconds.
+ */
+static size_t influxdb_recv(struct influxdb_fixture *f, char *buf, size_t len, int timeout)
+{
+	struct pollfd pfd = { f->sd, POLLIN, 0 };
+
+	int ret = poll(&pfd, 1, timeout);
+	cr_assert_geq(ret, 0);
+
+	if (ret == 0)
+		return 0;
+
+	ssize_t bytes = recv(f->sd, buf, len, 0);
+	cr_assert_gt(bytes, 0);
+
+	return bytes;
+}
+
+/** Check that a datagram only consists of complete lines.
+ *
+ * @return The number of lines in the datagram.
+ */
+static unsigned influxdb_check_datagram(const char *buf, size_t len)
+{
+	unsigned lines = 0;
+
+	cr_assert_eq(buf[len - 1], '\n', "Datagram ends in the middle of a line");
+
+	for (const char *line = buf; line < buf + len; lines++) {
+		const char *nl = (const char *) memchr(line, '\n', buf + len - line);
+
+		cr_assert_eq(strncmp(line, "villas ", 7), 0, "Line does not start with the key");
+
+		line = nl + 1;
+	}
+
+	return lines;
+}
+
+Test(influxdb, packet_size, .init = init_memory)
+{
+	int ret;
+	char buf[4096];
+	size_t len;
+	unsigned lines = 0, packets = 0;
+	struct influxdb_fixture f;
+
+	influxdb_fixture_init(&f, 1 << 16, 256, 10);
+
+	auto *i = (struct influxdb *) f.n._vd;
+
+	for (unsigned k = 0; k < NUM_SAMPLES; k++) {
+		ret = influxdb_write(&f.n, &f.smps[k], 1, nullptr);
+		cr_assert_eq(ret, 1);
+	}
+
+	/* Full packets are sent long before the flush interval expires */
+	while (lines < NUM_SAMPLES / 2) {
+		len = influxdb_recv(&f, buf, sizeof(buf), 1000);
+		cr_assert_gt(len, 0, "Full packets have not been sent");
+		cr_assert_leq(len, 256);
+
+		lines += influxdb_check_datagram(buf, len);
+		packets++;
+	}
+
+	/* Closing the node sends the remaining lines */
+	ret = influxdb_close(&f.n);
+	cr_assert_eq(ret, 0);
+
+	while ((len = influxdb_recv(&f, buf, sizeof(buf), 100)) > 0) {
+		cr_assert_leq(len, 256);
+
+		lines += influxdb_check_datagram(buf, len);
+		packets++;
+	}
+
+	cr_assert_eq(lines, NUM_SAMPLES);
+	cr_assert_eq(i->sent, NUM_SAMPLES);
+	cr_assert_eq(i->packets, packets);
+	cr_assert_eq(i->dropped, 0);
+
+	influxdb_fixture_destroy(&f);
+}
+
+Test(influxdb, flush_interval, .init = init_memory)
+{
+	int ret;
+	char buf[4096];
+	size_t len;
+	struct timespec start, now;
+	struct influxdb_fixture f;
+
+	influxdb_fixture_init(&f, 1 << 16, 1400, 0.5);
+
+	start = time_now();
+
+	ret = influxdb_write(&f.n, f.smps, 1, nullptr);
+	cr_assert_eq(ret, 1);
+
+	/* A single line does not fill a packet. So it is held back until the interval expires */
+	len = influxdb_recv(&f, buf, sizeof(buf), 100);
+	cr_assert_eq(len, 0);
+
+	len = influxdb_recv(&f, buf, sizeof(buf), 2000);
+	cr_assert_gt(len, 0, "The line has not been flushed");
+	cr_assert_eq(influxdb_check_datagram(buf, len), 1);
+
+	now = time_now();
+	cr_assert_geq(time_delta(&start, &now), 0.4);
+
+	ret = influxdb_close(&f.n);
+	cr_assert_eq(ret, 0);
+
+	influxdb_fixture_destroy(&f);
+}
+
+Test(influxdb, flush_on_close, .init = init_memory)
+{
+	int ret;
+	char buf[4096];
+	size_t len;
+	struct influxdb_fixture f;
+
+	influxdb_fixture_init(&f, 1 << 16, 1400, 60);
+
+	ret = influxdb_write(&f.n, f.smps, 3, nullptr);
+	cr_assert_eq(ret, 3);
+
+	ret = influxdb_close(&f.n);
+	cr_assert_eq(ret, 0);
+
+	len = influxdb_recv(&f, buf, sizeof(buf), 1000);
+	cr_assert_gt(len, 0, "Lines have not been sent on close");
+	cr_assert_eq(influxdb_check_datagram(buf, len), 3);
+
+	influxdb_fixture_destroy(&f);
+}
+
+Test(influxdb, dropped, .init = init_memory)
+{
+	int ret;
+	char buf[4096];
+	size_t len;
+	unsigned lines = 0;
+	struct influxdb_fixture f;
+
+	influxdb_fixture_init(&f, 1024, 256, 60);
+
+	auto *i = (struct influxdb *) f.n._vd;
+
+	/* The flush thread can not empty the buffer while all samples are appended at once */
+	ret = influxdb_write(&f.n, f.smps, NUM_SAMPLES, nullptr);
+	cr_assert_eq(ret, NUM_SAMPLES);
+
+	cr_assert_gt(i->dropped, 0);
+
+	ret = influxdb_close(&f.n);
+	cr_assert_eq(ret, 0);
+
+	while ((len = influxdb_recv(&f, buf, sizeof(buf), 100)) > 0)
+		lines += influxdb_check_datagram(buf, len);
+
+	cr_assert_eq(lines, i->sent);
+	cr_assert_eq(i->sent + i->dropped, NUM_SAMPLES);
+
+	influxdb_fixture_destroy(&f);
+}
@@ -35,6 +35,7 @@
 #include <villas/pool.h>
 #include <villas/io.h>
 #include <villas/log.hpp>
+#include <villas/formats/json.h>
 
 using namespace villas;
 
@@ -59,11 +60,14 @@ static struct param params[] = {
 	{ "raw.64.be",		1, 64 },
 	{ "raw.64.le",		1, 64 },
 	{ "villas.human",	10, 0 },
+	{ "villas.human.compat", 10, 0 },
 	{ "villas.binary",	10, 0 },
 	{ "csv",		10, 0 },
+	{ "csv.compat",		10, 0 },
 	{ "json",		10, 0 },
 #ifdef PROTOBUF_FOUND
-	{ "protobuf",		10, 0 }
+	{ "protobuf",		10, 0 },
+	{ "protobuf.packed",	10, 0 }
 #endif
 };
 
@@ -386,3 +390,237 @@ ParameterizedTest(struct param *p, io, highlevel, .init = init_memory)
 	ret = pool_destroy(&pool);
 	cr_assert_eq(ret, 0);
 }
+
+Test(io, json_streaming, .init = init_memory)
+{
+	int ret;
+	unsigned cnt = 100, iters = 200;
+	size_t wbytes, wbytes_jansson, rbytes;
+	struct timespec start, end;
+	double t;
+
+	Logger logger = logging.get("test:io:json_streaming");
+
+	struct pool pool = { .state = State::DESTROYED };
+	struct io io = { .state = State::DESTROYED };
+	struct vlist signals = { .state = State::DESTROYED };
+	struct sample *smps[cnt];
+	struct sample *smpt[cnt];
+
+	char *buf = new char[1 << 20];
+	char *buf_jansson = new char[1 << 20];
+
+	ret = pool_init(&pool, 2 * cnt, SAMPLE_LENGTH(NUM_VALUES), &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	vlist_init(&signals);
+	ret = signal_list_generate2(&signals, "4f2i2b2c");
+	cr_assert_eq(ret, 0);
+
+	ret = sample_alloc_many(&pool, smps, cnt);
+	cr_assert_eq(ret, cnt);
+
+	ret = sample_alloc_many(&pool, smpt, cnt);
+	cr_assert_eq(ret, cnt);
+
+	fill_sample_data(&signals, smps, cnt);
+
+	ret = io_init(&io, format_type_lookup("json"), &signals, (int) SampleFlags::HAS_ALL);
+	cr_assert_eq(ret, 0);
+
+	ret = io_check(&io);
+	cr_assert_eq(ret, 0);
+
+	/* The streaming encoder must produce the same output as jansson */
+	ret = json_sprint(&io, buf, 1 << 20, &wbytes, smps, cnt);
+	cr_assert_eq(ret, cnt);
+
+	ret = json_sprint_jansson(&io, buf_jansson, 1 << 20, &wbytes_jansson, smps, cnt);
+	cr_assert_eq(ret, cnt);
+
+	cr_assert_eq(wbytes, wbytes_jansson);
+	cr_assert_arr_eq(buf, buf_jansson, wbytes);
+
+	ret = json_sscan(&io, buf, wbytes, &rbytes, smpt, cnt);
+	cr_assert_eq(ret, cnt);
+	cr_assert_eq(rbytes, wbytes);
+
+	for (unsigned i = 0; i < cnt; i++)
+		cr_assert_eq_sample(smps[i], smpt[i], (int) SampleFlags::HAS_ALL);
+
+	/* Compare the throughput of both implementations */
+	start = time_now();
+	for (unsigned i = 0; i < iters; i++)
+		json_sprint_jansson(&io, buf_jansson, 1 << 20, &wbytes_jansson, smps, cnt);
+	end = time_now();
+	t = time_delta(&start, &end);
+	logger->info("sprint jansson:   {:.0f} samples/s", iters * cnt / t);
+
+	start = time_now();
+	for (unsigned i = 0; i < iters; i++)
+		json_sprint(&io, buf, 1 << 20, &wbytes, smps, cnt);
+	end = time_now();
+	t = time_delta(&start, &end);
+	logger->info("sprint streaming: {:.0f} samples/s", iters * cnt / t);
+
+	start = time_now();
+	for (unsigned i = 0; i < iters; i++)
+		json_sscan_jansson(&io, buf, wbytes, &rbytes, smpt, cnt);
+	end = time_now();
+	t = time_delta(&start, &end);
+	logger->info("sscan jansson:    {:.0f} samples/s", iters * cnt / t);
+
+	start = time_now();
+	for (unsigned i = 0; i < iters; i++)
+		json_sscan(&io, buf, wbytes, &rbytes, smpt, cnt);
+	end = time_now();
+	t = time_delta(&start, &end);
+	logger->info("sscan streaming:  {:.0f} samples/s", iters * cnt / t);
+
+	ret = io_destroy(&io);
+	cr_assert_eq(ret, 0);
+
+	sample_free_many(smps, cnt);
+	sample_free_many(smpt, cnt);
+
+	ret = pool_destroy(&pool);
+	cr_assert_eq(ret, 0);
+
+	delete[] buf;
+	delete[] buf_jansson;
+}
+
+Test(io, json_sprint_partial, .init = init_memory)
+{
+	int ret;
+	unsigned cnt = 3;
+	char buf[4096];
+	size_t wbytes, rbytes;
+
+	struct pool pool = { .state = State::DESTROYED };
+	struct io io = { .state = State::DESTROYED };
+	struct vlist signals = { .state = State::DESTROYED };
+	struct sample *smps[cnt];
+	struct sample *smpt[cnt];
+
+	ret = pool_init(&pool, 2 * cnt, SAMPLE_LENGTH(NUM_VALUES), &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	vlist_init(&signals);
+	ret = signal_list_generate(&signals, NUM_VALUES - 1, SignalType::FLOAT);
+	cr_assert_eq(ret, 0);
+
+	ret = sample_alloc_many(&pool, smps, cnt);
+	cr_assert_eq(ret, cnt);
+
+	ret = sample_alloc_many(&pool, smpt, cnt);
+	cr_assert_eq(ret, cnt);
+
+	fill_sample_data(&signals, smps, cnt);
+
+	/* The second sample has a value without a signal and can not be encoded */
+	smps[1]->length = NUM_VALUES;
+
+	ret = io_init(&io, format_type_lookup("json"), &signals, (int) SampleFlags::HAS_ALL);
+	cr_assert_eq(ret, 0);
+
+	ret = io_check(&io);
+	cr_assert_eq(ret, 0);
+
+	ret = json_sprint(&io, buf, sizeof(buf), &wbytes, smps, cnt);
+	cr_assert_eq(ret, 1);
+
+	ret = json_sprint_jansson(&io, buf, sizeof(buf), &wbytes, smps, cnt);
+	cr_assert_eq(ret, 1);
+
+	/* Only the samples which have been written are in the output */
+	ret = json_sscan(&io, buf, wbytes, &rbytes, smpt, cnt);
+	cr_assert_eq(ret, 1);
+
+	cr_assert_eq_sample(smps[0], smpt[0], (int) SampleFlags::HAS_ALL);
+
+	ret = io_destroy(&io);
+	cr_assert_eq(ret, 0);
+
+	sample_free_many(smps, cnt);
+	sample_free_many(smpt, cnt);
+
+	ret = pool_destroy(&pool);
+	cr_assert_eq(ret, 0);
+}
+
+#ifdef PROTOBUF_FOUND
+Test(io, protobuf_packed, .init = init_memory)
+{
+	int ret;
+	unsigned cnt = 10;
+	char buf[8192];
+	size_t wbytes, rbytes;
+
+	struct pool pool = { .state = State::DESTROYED };
+	struct io io = { .state = State::DESTROYED };
+	struct io io_short = { .state = State::DESTROYED };
+	struct vlist signals = { .state = State::DESTROYED };
+	struct vlist signals_short = { .state = State::DESTROYED };
+	struct sample *smps[cnt];
+	struct sample *smpt[cnt];
+
+	ret = pool_init(&pool, 2 * cnt, SAMPLE_LENGTH(NUM_VALUES), &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	/* Complex values occupy two slots in values_f, booleans share values_i with integers */
+	vlist_init(&signals);
+	ret = signal_list_generate2(&signals, "4f2i2b2c");
+	cr_assert_eq(ret, 0);
+
+	vlist_init(&signals_short);
+	ret = signal_list_generate2(&signals_short, "4f2i2b");
+	cr_assert_eq(ret, 0);
+
+	ret = sample_alloc_many(&pool, smps, cnt);
+	cr_assert_eq(ret, cnt);
+
+	ret = sample_alloc_many(&pool, smpt, cnt);
+	cr_assert_eq(ret, cnt);
+
+	fill_sample_data(&signals, smps, cnt);
+
+	ret = io_init(&io, format_type_lookup("protobuf.packed"), &signals, (int) SampleFlags::HAS_ALL);
+	cr_assert_eq(ret, 0);
+
+	ret = io_check(&io);
+	cr_assert_eq(ret, 0);
+
+	ret = io_init(&io_short, format_type_lookup("protobuf.packed"), &signals_short, (int) SampleFlags::HAS_ALL);
+	cr_assert_eq(ret, 0);
+
+	ret = io_check(&io_short);
+	cr_assert_eq(ret, 0);
+
+	ret = io_sprint(&io, buf, sizeof(buf), &wbytes, smps, cnt);
+	cr_assert_eq(ret, cnt);
+
+	ret = io_sscan(&io, buf, wbytes, &rbytes, smpt, cnt);
+	cr_assert_eq(ret, cnt);
+	cr_assert_eq(rbytes, wbytes);
+
+	for (unsigned i = 0; i < cnt; i++)
+		cr_assert_eq_sample(smps[i], smpt[i], (int) SampleFlags::HAS_ALL);
+
+	/* The values can not be mapped to a different signal list */
+	ret = io_sscan(&io_short, buf, wbytes, &rbytes, smpt, cnt);
+	cr_assert_lt(ret, 0);
+
+	ret = io_destroy(&io);
+	cr_assert_eq(ret, 0);
+
+	ret = io_destroy(&io_short);
+	cr_assert_eq(ret, 0);
+
+	sample_free_many(smps, cnt);
+	sample_free_many(smpt, cnt);
+
+	ret = pool_destroy(&pool);
+	cr_assert_eq(ret, 0);
+}
+#endif /* PROTOBUF_FOUND */
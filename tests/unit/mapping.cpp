@@ -27,9 +27,12 @@
 #include <villas/list.h>
 #include <villas/utils.hpp>
 #include <villas/signal.h>
+#include <villas/sample.h>
 
 using namespace villas;
 
+extern void init_memory();
+
 Test(mapping, parse_nodes)
 {
 	int ret;
@@ -186,3 +189,86 @@ Test(mapping, parse)
 	ret = mapping_parse_str(&m, "data[5-3]", nullptr);
 	cr_assert_neq(ret, 0);
 }
+
+Test(mapping, plan, .init = init_memory)
+{
+	int ret;
+	struct vlist ml = { .state = State::DESTROYED };
+	struct mapping_plan mp;
+
+	const char *mappings[] = {
+		"data[0-3]",
+		"data[4-5]",
+		"hdr.sequence",
+		"data[8]",
+		"data[9-10]",
+		"ts.origin",
+		"data[2]"
+	};
+
+	vlist_init(&ml);
+
+	for (unsigned i = 0; i < ARRAY_LEN(mappings); i++) {
+		struct mapping_entry *me = (struct mapping_entry *) alloc(sizeof(struct mapping_entry));
+
+		ret = mapping_parse_str(me, mappings[i], nullptr);
+		cr_assert_eq(ret, 0);
+
+		vlist_push(&ml, me);
+	}
+
+	ret = mapping_list_prepare(&ml);
+	cr_assert_eq(ret, 0);
+
+	ret = mapping_plan_init(&mp, &ml);
+	cr_assert_eq(ret, 0);
+
+	/* data[0-3] and data[4-5] as well as data[8] and data[9-10] are merged */
+	cr_assert_eq(mp.nranges, 3);
+	cr_assert_eq(mp.nfixups, 2);
+	cr_assert_eq(mp.length, 13);
+
+	struct sample *orig = sample_alloc_mem(16);
+	struct sample *expected = sample_alloc_mem(16);
+	struct sample *remapped = sample_alloc_mem(16);
+
+	orig->sequence = 1234;
+	orig->ts.origin = { 1, 2 };
+
+	/* Check full and truncated samples */
+	for (unsigned len = 16; len > 0; len--) {
+		orig->length = len;
+		for (unsigned i = 0; i < len; i++)
+			orig->data[i].f = i * 1.5;
+
+		expected->length = remapped->length = 0;
+		for (unsigned i = 0; i < 16; i++)
+			expected->data[i].i = remapped->data[i].i = -1;
+
+		ret = mapping_list_remap(&ml, expected, orig);
+		cr_assert_eq(ret, 0);
+
+		ret = mapping_plan_remap(&mp, remapped, orig);
+		cr_assert_eq(ret, 0);
+
+		cr_assert_eq(remapped->length, expected->length, "len=%u: %u != %u", len, remapped->length, expected->length);
+		cr_assert_arr_eq(remapped->data, expected->data, 16 * sizeof(union signal_data));
+	}
+
+	/* The plan does not fit into a sample with a smaller capacity */
+	struct sample *small = sample_alloc_mem(8);
+
+	ret = mapping_plan_remap(&mp, small, orig);
+	cr_assert_neq(ret, 0);
+
+	sample_free(small);
+	sample_free(orig);
+	sample_free(expected);
+	sample_free(remapped);
+
+	ret = mapping_plan_destroy(&mp);
+	cr_assert_eq(ret, 0);
+
+	ret = vlist_destroy(&ml, nullptr, true);
+	cr_assert_eq(ret, 0);
+}
@@ -24,10 +24,15 @@
 #include <criterion/theories.h>
 
 #include <cerrno>
+#include <cstdlib>
+#include <utility>
 
 #include <villas/memory.h>
 #include <villas/utils.hpp>
 #include <villas/log.hpp>
+#include <villas/timing.h>
+
+using namespace villas;
 
 extern void init_memory();
 
@@ -52,7 +57,8 @@ Theory((size_t len, size_t align, enum MemoryFlags memory_type), memory, aligned
 	cr_assert(IS_ALIGNED(ptr, align), "Memory at %p is not alligned to %#zx byte bounary", ptr, align);
 
 #ifndef __APPLE__
-	if (mt == &memory_hugepage) {
+	/* Small allocations are carved from shared arenas */
+	if (mt == &memory_hugepage && !memory_get_allocation(ptr)->parent) {
 		cr_assert(IS_ALIGNED(ptr, HUGEPAGESIZE), "Memory at %p is not alligned to %#x byte bounary", ptr, HUGEPAGESIZE);
 	}
 #endif
@@ -61,6 +67,38 @@ Theory((size_t len, size_t align, enum MemoryFlags memory_type), memory, aligned
 	cr_assert_eq(ret, 0, "Failed to release memory: ret=%d, ptr=%p, len=%zu: %s", ret, ptr, len, strerror(errno));
 }
 
+Test(memory, arenas, .init = init_memory) {
+	int ret;
+	void *ptrs[64];
+	struct memory_arena_stats s;
+
+	size_t cnt = memory_hugepage_arena_count();
+
+	for (unsigned i = 0; i < ARRAY_LEN(ptrs); i++) {
+		ptrs[i] = memory_alloc_aligned(&memory_hugepage, 4096, 64);
+		cr_assert_not_null(ptrs[i]);
+		cr_assert(IS_ALIGNED(ptrs[i], 64));
+		cr_assert_not_null(memory_get_allocation(ptrs[i])->parent);
+	}
+
+	/* All allocations fit into a single arena */
+	cr_assert_leq(memory_hugepage_arena_count(), cnt + 1);
+
+	ret = memory_hugepage_arena_stats(memory_hugepage_arena_count() - 1, &s);
+	cr_assert_eq(ret, 0);
+	cr_assert_geq(s.length, DEFAULT_HUGEPAGE_ARENA_SIZE);
+	cr_assert_geq(s.managed.requested, ARRAY_LEN(ptrs) * 4096);
+
+	for (unsigned i = 0; i < ARRAY_LEN(ptrs); i++) {
+		ret = memory_free(ptrs[i]);
+		cr_assert_eq(ret, 0);
+	}
+
+	ret = memory_hugepage_arena_stats(memory_hugepage_arena_count() - 1, &s);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(s.managed.requested, 0);
+}
+
 Test(memory, manager, .init = init_memory) {
 	size_t total_size;
 	size_t max_block;
@@ -69,8 +107,7 @@ Test(memory, manager, .init = init_memory) {
 	void *p, *p1, *p2, *p3;
 	struct memory_type *m;
 
-	total_size = 1 << 10;
-	max_block = total_size - sizeof(struct memory_type) - sizeof(struct memory_block);
+	total_size = 1 << 12;
 
 	p = memory_alloc(&memory_heap, total_size);
 	cr_assert_not_null(p);
@@ -104,6 +141,16 @@ Test(memory, manager, .init = init_memory) {
 	ret = memory_free(p3);
 	cr_assert(ret == 0);
 
+	struct memory_managed_stats stats;
+
+	ret = memory_managed_stats(m, &stats);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(stats.used, 0);
+	cr_assert_eq(stats.requested, 0);
+	cr_assert_eq(stats.allocs, stats.frees);
+
+	max_block = stats.largest;
+
 	p1 = memory_alloc(m, max_block);
 	cr_assert_not_null(p1);
 
@@ -113,3 +160,60 @@ Test(memory, manager, .init = init_memory) {
 	ret = memory_free(p);
 	cr_assert(ret == 0);
 }
+
+#define MANAGED_BLOCKS	1024
+#define MANAGED_ROUNDS	100
+
+Test(memory, managed_benchmark, .init = init_memory) {
+	int ret;
+	void *p, *ptrs[MANAGED_BLOCKS];
+	struct memory_type *m;
+	struct memory_managed_stats stats;
+	size_t total_size = 64 << 20;
+
+	Logger logger = logging.get("test:memory:managed");
+
+	p = memory_alloc(&memory_heap, total_size);
+	cr_assert_not_null(p);
+
+	m = memory_managed(p, total_size);
+	cr_assert_not_null(m);
+
+	unsigned seed = 1234;
+	struct timespec start = time_now();
+
+	/* Allocate and release blocks of mixed sizes in random order */
+	for (int r = 0; r < MANAGED_ROUNDS; r++) {
+		for (int i = 0; i < MANAGED_BLOCKS; i++) {
+			ptrs[i] = memory_alloc(m, 16 + rand_r(&seed) % 8192);
+			cr_assert_not_null(ptrs[i]);
+		}
+
+		for (int i = 0; i < MANAGED_BLOCKS; i++) {
+			int j = rand_r(&seed) % MANAGED_BLOCKS;
+			std::swap(ptrs[i], ptrs[j]);
+		}
+
+		for (int i = 0; i < MANAGED_BLOCKS; i++) {
+			ret = memory_free(ptrs[i]);
+			cr_assert_eq(ret, 0);
+		}
+	}
+
+	struct timespec end = time_now();
+
+	ret = memory_managed_stats(m, &stats);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(stats.used, 0);
+	cr_assert_eq(stats.allocs, MANAGED_BLOCKS * MANAGED_ROUNDS);
+	cr_assert_eq(stats.frees, MANAGED_BLOCKS * MANAGED_ROUNDS);
+
+	/* Blocks are reused: we never consume more than a few rounds worth of memory */
+	cr_assert_lt(stats.total - stats.remaining, total_size / 2);
+
+	logger->info("Managed memory: {:.1f} ns per alloc/free, cached={}, remaining={}",
+		time_delta(&start, &end) * 1e9 / (MANAGED_BLOCKS * MANAGED_ROUNDS), stats.cached, stats.remaining);
+
+	ret = memory_free(p);
+	cr_assert_eq(ret, 0);
+}
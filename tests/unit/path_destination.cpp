@@ -0,0 +1,109 @@
+/** Unit tests for copy-on-write fan-out of path destinations
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <criterion/criterion.h>
+
+#include <villas/pool.h>
+#include <villas/sample.h>
+#include <villas/path_destination.h>
+#include <villas/memory.h>
+#include <villas/utils.hpp>
+
+extern void init_memory();
+
+#define NUM_VALUES	4
+
+/* A writing hook on one destination must not change the sample which another destination sees */
+Test(path_destination, copy_on_write, .init = init_memory)
+{
+	int ret;
+	struct pool pool = { .state = State::DESTROYED };
+	struct path_destination pda, pdb;
+	struct sample *smp, *a, *b;
+
+	ret = pool_init(&pool, 8, SAMPLE_LENGTH(NUM_VALUES), &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	pda.queue.state = State::DESTROYED;
+	pdb.queue.state = State::DESTROYED;
+
+	ret = path_destination_init(&pda, 8, &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	ret = path_destination_init(&pdb, 8, &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	smp = sample_alloc(&pool);
+	cr_assert_not_null(smp);
+
+	smp->length = NUM_VALUES;
+	for (unsigned i = 0; i < NUM_VALUES; i++)
+		smp->data[i].f = i;
+
+	/* Fan-out by reference as path_destination_enqueue() does in copy-on-write mode */
+	cr_assert_eq(queue_push(&pda.queue, smp), 1);
+	cr_assert_eq(queue_push(&pdb.queue, smp), 1);
+	sample_incref(smp);
+	sample_incref(smp);
+
+	/* The path drops its own reference */
+	sample_decref(smp);
+	cr_assert_eq(atomic_load(&smp->refcnt), 2);
+
+	/* Destination A has write hooks */
+	cr_assert_eq(queue_pull(&pda.queue, (void **) &a), 1);
+	cr_assert_eq(a, smp);
+
+	ret = path_destination_unshare(&a, 1);
+	cr_assert_eq(ret, 0);
+	cr_assert_neq(a, smp, "Shared sample has not been cloned");
+	cr_assert_eq(atomic_load(&a->refcnt), 1);
+	cr_assert_eq(atomic_load(&smp->refcnt), 1);
+
+	for (unsigned i = 0; i < NUM_VALUES; i++)
+		a->data[i].f = -1;
+
+	/* Destination B sees the original values */
+	cr_assert_eq(queue_pull(&pdb.queue, (void **) &b), 1);
+	cr_assert_eq(b, smp);
+	cr_assert_eq(b->length, NUM_VALUES);
+
+	for (unsigned i = 0; i < NUM_VALUES; i++)
+		cr_assert_float_eq(b->data[i].f, i, 1e-9);
+
+	/* A sample which is not shared anymore is not cloned again */
+	ret = path_destination_unshare(&b, 1);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(b, smp);
+
+	sample_decref(a);
+	sample_decref(b);
+
+	ret = path_destination_destroy(&pda);
+	cr_assert_eq(ret, 0);
+
+	ret = path_destination_destroy(&pdb);
+	cr_assert_eq(ret, 0);
+
+	ret = pool_destroy(&pool);
+	cr_assert_eq(ret, 0);
+}
@@ -24,6 +24,9 @@
 #include <criterion/parameterized.h>
 
 #include <signal.h>
+#include <pthread.h>
+
+#include <algorithm>
 
 #include <villas/pool.h>
 #include <villas/utils.hpp>
@@ -84,3 +87,126 @@ ParameterizedTest(struct param *p, pool, basic, .init = init_memory)
 	cr_assert_eq(ret, 0, "Failed to destroy pool");
 
 }
+
+#define CACHE_THREADS	4
+#define CACHE_POOL_SIZE	1024
+#define CACHE_BATCH	8
+#define CACHE_ROUNDS	10000
+
+static void * cache_worker(void *ctx)
+{
+	struct pool *pool = (struct pool *) ctx;
+	void *ptrs[CACHE_BATCH];
+
+	for (int i = 0; i < CACHE_ROUNDS; i++) {
+		ssize_t got = pool_get_many(pool, ptrs, CACHE_BATCH);
+		if (got < 0)
+			return (void *) -1;
+
+		pool_put_many(pool, ptrs, got);
+	}
+
+	return nullptr;
+}
+
+Test(pool, cache, .init = init_memory)
+{
+	int ret;
+	struct pool pool = { .state = State::DESTROYED };
+	pthread_t threads[CACHE_THREADS];
+	void *ptrs[CACHE_POOL_SIZE];
+
+	ret = pool_init(&pool, CACHE_POOL_SIZE, 64, &memory_heap);
+	cr_assert_eq(ret, 0, "Failed to create pool");
+
+	ret = pool_cache_init(&pool);
+	cr_assert_eq(ret, 0);
+	cr_assert_not_null(pool.cache);
+
+	for (int i = 0; i < CACHE_THREADS; i++) {
+		ret = pthread_create(&threads[i], nullptr, cache_worker, &pool);
+		cr_assert_eq(ret, 0);
+	}
+
+	for (int i = 0; i < CACHE_THREADS; i++) {
+		void *status;
+
+		ret = pthread_join(threads[i], &status);
+		cr_assert_eq(ret, 0);
+		cr_assert_null(status);
+	}
+
+	ret = pool_cache_flush(&pool);
+	cr_assert_eq(ret, 0);
+
+	/* All blocks must be available again and none of them twice */
+	ssize_t got = pool_get_many(&pool, ptrs, CACHE_POOL_SIZE);
+	cr_assert_eq(got, CACHE_POOL_SIZE);
+
+	std::sort(ptrs, ptrs + got);
+	for (int i = 1; i < got; i++)
+		cr_assert_neq(ptrs[i-1], ptrs[i]);
+
+	pool_put_many(&pool, ptrs, got);
+
+	ret = pool_destroy(&pool);
+	cr_assert_eq(ret, 0, "Failed to destroy pool");
+}
+
+static void * cache_park(void *ctx)
+{
+	struct pool *pool = (struct pool *) ctx;
+	void *ptrs[CACHE_BATCH];
+
+	/* Leaves the blocks in the cache of this thread */
+	ssize_t got = pool_get_many(pool, ptrs, CACHE_BATCH);
+	if (got != CACHE_BATCH)
+		return (void *) -1;
+
+	pool_put_many(pool, ptrs, got);
+
+	return nullptr;
+}
+
+Test(pool, cache_underrun, .init = init_memory)
+{
+	int ret;
+	struct pool pool = { .state = State::DESTROYED };
+	pthread_t threads[CACHE_THREADS];
+	void *ptrs[CACHE_POOL_SIZE];
+
+	ret = pool_init(&pool, CACHE_POOL_SIZE, 64, &memory_heap);
+	cr_assert_eq(ret, 0, "Failed to create pool");
+
+	ret = pool_cache_init(&pool);
+	cr_assert_eq(ret, 0);
+	cr_assert_not_null(pool.cache);
+
+	for (int i = 0; i < CACHE_THREADS; i++) {
+		void *status;
+
+		ret = pthread_create(&threads[i], nullptr, cache_park, &pool);
+		cr_assert_eq(ret, 0);
+
+		ret = pthread_join(threads[i], &status);
+		cr_assert_eq(ret, 0);
+		cr_assert_null(status);
+	}
+
+	/* The threads got different slots of this pool */
+	for (int i = 0; i < CACHE_THREADS; i++)
+		cr_assert_gt(pool.cache[i].count, 0);
+
+	/* Blocks in the caches of stopped threads are still available without a flush */
+	ssize_t got = pool_get_many(&pool, ptrs, CACHE_POOL_SIZE);
+	cr_assert_eq(got, CACHE_POOL_SIZE);
+
+	std::sort(ptrs, ptrs + got);
+	for (int i = 1; i < got; i++)
+		cr_assert_neq(ptrs[i-1], ptrs[i]);
+
+	pool_put_many(&pool, ptrs, got);
+
+	ret = pool_destroy(&pool);
+	cr_assert_eq(ret, 0, "Failed to destroy pool");
+}
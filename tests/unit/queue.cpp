@@ -35,6 +35,7 @@
 #include <villas/memory.h>
 #include <villas/tsc.h>
 #include <villas/log.hpp>
+#include <villas/timing.h>
 
 using namespace villas;
 
@@ -376,3 +377,97 @@ Test(queue, init_destroy, .init = init_memory)
 	ret = queue_destroy(&q);
 	cr_assert_eq(ret, 0); /* Should succeed */
 }
+
+#define SPSC_ITER_COUNT	(1 << 22)
+#define SPSC_BATCH_SIZE	16
+
+struct spsc_param {
+	struct queue queue;
+	bool ordered;
+};
+
+static void * spsc_producer(void *ctx)
+{
+	struct spsc_param *p = (struct spsc_param *) ctx;
+	void *ptrs[SPSC_BATCH_SIZE];
+
+	for (intptr_t count = 1; count <= SPSC_ITER_COUNT; ) {
+		int cnt = MIN(SPSC_BATCH_SIZE, SPSC_ITER_COUNT - count + 1);
+
+		for (int i = 0; i < cnt; i++)
+			ptrs[i] = (void *) (count + i);
+
+		int pushed = queue_push_many(&p->queue, ptrs, cnt);
+		if (pushed <= 0)
+			pthread_yield(); /* queue full, let the consumer proceed */
+		else
+			count += pushed;
+	}
+
+	return nullptr;
+}
+
+static void * spsc_consumer(void *ctx)
+{
+	struct spsc_param *p = (struct spsc_param *) ctx;
+	void *ptrs[SPSC_BATCH_SIZE];
+
+	p->ordered = true;
+
+	for (intptr_t count = 1; count <= SPSC_ITER_COUNT; ) {
+		int pulled = queue_pull_many(&p->queue, ptrs, SPSC_BATCH_SIZE);
+		if (pulled <= 0) {
+			pthread_yield(); /* queue empty, let the producer proceed */
+			continue;
+		}
+
+		for (int i = 0; i < pulled; i++) {
+			if ((intptr_t) ptrs[i] != count++)
+				p->ordered = false;
+		}
+	}
+
+	return nullptr;
+}
+
+/** Compare the throughput of a single producer and consumer in both queue modes */
+Test(queue, spsc, .timeout = 60, .init = init_memory)
+{
+	int ret;
+	double rates[2];
+	enum QueueMode modes[] = { QueueMode::MPMC, QueueMode::SPSC };
+
+	Logger logger = logging.get("test:queue:spsc");
+
+	for (unsigned i = 0; i < ARRAY_LEN(modes); i++) {
+		struct spsc_param p;
+		pthread_t producer_thread, consumer_thread;
+		struct timespec start, end;
+
+		p.queue.state = ATOMIC_VAR_INIT(State::DESTROYED);
+
+		ret = queue_init(&p.queue, SIZE, &memory_heap, modes[i]);
+		cr_assert_eq(ret, 0, "Failed to create queue");
+
+		start = time_now();
+
+		pthread_create(&consumer_thread, nullptr, spsc_consumer, &p);
+		pthread_create(&producer_thread, nullptr, spsc_producer, &p);
+
+		pthread_join(producer_thread, nullptr);
+		pthread_join(consumer_thread, nullptr);
+
+		end = time_now();
+
+		cr_assert(p.ordered, "Elements have been reordered");
+		cr_assert_eq(queue_available(&p.queue), 0);
+
+		rates[i] = SPSC_ITER_COUNT / time_delta(&start, &end);
+
+		ret = queue_destroy(&p.queue);
+		cr_assert_eq(ret, 0, "Failed to destroy queue");
+	}
+
+	logger->info("Throughput: mpmc={:.3g} elements/s, spsc={:.3g} elements/s, speedup={:.2f}",
+		rates[0], rates[1], rates[1] / rates[0]);
+}
@@ -0,0 +1,352 @@
+/** Unit tests for indexed recordings.
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <criterion/criterion.h>
+
+#include <villas/utils.hpp>
+#include <villas/timing.h>
+#include <villas/sample.h>
+#include <villas/signal.h>
+#include <villas/pool.h>
+#include <villas/recording.h>
+
+extern void init_memory();
+
+extern void fill_sample_data(struct vlist *signals, struct sample *smps[], unsigned cnt);
+extern void cr_assert_eq_sample(struct sample *a, struct sample *b, int flags);
+
+#define NUM_VALUES	10
+#define NUM_SAMPLES	100
+#define CHUNK_SAMPLES	16
+
+Test(recording, readback, .init = init_memory)
+{
+	int ret, cnt;
+	char *retp, *fn, dir[64];
+
+	struct recording r;
+	struct pool pool = { .state = State::DESTROYED };
+	struct vlist signals = { .state = State::DESTROYED };
+
+	struct sample *smps[NUM_SAMPLES];
+	struct sample *smpt[NUM_SAMPLES];
+
+	ret = pool_init(&pool, 2 * NUM_SAMPLES, SAMPLE_LENGTH(NUM_VALUES), &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	ret = sample_alloc_many(&pool, smps, NUM_SAMPLES);
+	cr_assert_eq(ret, NUM_SAMPLES);
+
+	ret = sample_alloc_many(&pool, smpt, NUM_SAMPLES);
+	cr_assert_eq(ret, NUM_SAMPLES);
+
+	vlist_init(&signals);
+	signal_list_generate(&signals, NUM_VALUES, SignalType::FLOAT);
+
+	fill_sample_data(&signals, smps, NUM_SAMPLES);
+
+	strncpy(dir, "/tmp/villas.XXXXXX", sizeof(dir));
+
+	retp = mkdtemp(dir);
+	cr_assert_not_null(retp);
+
+	ret = asprintf(&fn, "%s/recording", dir);
+	cr_assert_gt(ret, 0);
+
+	ret = recording_open(&r, fn, RecordingMode::WRITE, CHUNK_SAMPLES);
+	cr_assert_eq(ret, 0);
+
+	cnt = recording_write(&r, smps, NUM_SAMPLES);
+	cr_assert_eq(cnt, NUM_SAMPLES);
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	ret = recording_open(&r, fn, RecordingMode::READ);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(r.signals, NUM_VALUES);
+	cr_assert_eq(r.samples, NUM_SAMPLES);
+	cr_assert_eq(r.chunks, CEIL(NUM_SAMPLES, CHUNK_SAMPLES));
+
+	cnt = recording_read(&r, smpt, NUM_SAMPLES);
+	cr_assert_eq(cnt, NUM_SAMPLES);
+	cr_assert(recording_eof(&r));
+
+	for (int i = 0; i < cnt; i++) {
+		smpt[i]->signals = &signals;
+
+		cr_assert_eq_sample(smps[i], smpt[i], smps[i]->flags);
+	}
+
+	/* Seek into the middle of a chunk */
+	ret = recording_seek(&r, &smps[42]->ts.origin);
+	cr_assert_eq(ret, 0);
+
+	cnt = recording_read(&r, smpt, 1);
+	cr_assert_eq(cnt, 1);
+	cr_assert_eq(smpt[0]->sequence, smps[42]->sequence);
+
+	recording_rewind(&r);
+
+	cnt = recording_read(&r, smpt, 1);
+	cr_assert_eq(cnt, 1);
+	cr_assert_eq(smpt[0]->sequence, smps[0]->sequence);
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	/* Append to the recording */
+	ret = recording_open(&r, fn, RecordingMode::WRITE);
+	cr_assert_eq(ret, 0);
+
+	cnt = recording_write(&r, smps, 1);
+	cr_assert_eq(cnt, 1);
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	ret = recording_open(&r, fn, RecordingMode::READ);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(r.samples, NUM_SAMPLES + 1);
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	ret = unlink(fn);
+	cr_assert_eq(ret, 0);
+
+	ret = rmdir(dir);
+	cr_assert_eq(ret, 0);
+
+	free(fn);
+
+	ret = signal_list_destroy(&signals);
+	cr_assert_eq(ret, 0);
+
+	ret = pool_destroy(&pool);
+	cr_assert_eq(ret, 0);
+}
+
+struct recording_fixture {
+	struct pool pool;
+	struct vlist signals;
+
+	struct sample *smps[NUM_SAMPLES];
+	struct sample *smpt[NUM_SAMPLES];
+
+	char dir[64];
+	char *fn;
+};
+
+static void recording_fixture_init(struct recording_fixture *f)
+{
+	int ret;
+	char *retp;
+
+	f->pool.state = State::DESTROYED;
+	f->pool.queue.state = State::DESTROYED;
+	f->signals.state = State::DESTROYED;
+
+	ret = pool_init(&f->pool, 2 * NUM_SAMPLES, SAMPLE_LENGTH(NUM_VALUES), &memory_heap);
+	cr_assert_eq(ret, 0);
+
+	ret = sample_alloc_many(&f->pool, f->smps, NUM_SAMPLES);
+	cr_assert_eq(ret, NUM_SAMPLES);
+
+	ret = sample_alloc_many(&f->pool, f->smpt, NUM_SAMPLES);
+	cr_assert_eq(ret, NUM_SAMPLES);
+
+	vlist_init(&f->signals);
+	signal_list_generate(&f->signals, NUM_VALUES, SignalType::FLOAT);
+
+	fill_sample_data(&f->signals, f->smps, NUM_SAMPLES);
+
+	strncpy(f->dir, "/tmp/villas.XXXXXX", sizeof(f->dir));
+
+	retp = mkdtemp(f->dir);
+	cr_assert_not_null(retp);
+
+	ret = asprintf(&f->fn, "%s/recording", f->dir);
+	cr_assert_gt(ret, 0);
+}
+
+static void recording_fixture_destroy(struct recording_fixture *f)
+{
+	int ret;
+
+	ret = unlink(f->fn);
+	cr_assert_eq(ret, 0);
+
+	ret = rmdir(f->dir);
+	cr_assert_eq(ret, 0);
+
+	free(f->fn);
+
+	ret = signal_list_destroy(&f->signals);
+	cr_assert_eq(ret, 0);
+
+	ret = pool_destroy(&f->pool);
+	cr_assert_eq(ret, 0);
+}
+
+/** Read \p cnt samples and compare them to the first ones which have been written. */
+static void recording_check(struct recording_fixture *f, struct recording *r, int cnt)
+{
+	int ret;
+
+	ret = recording_read(r, f->smpt, NUM_SAMPLES);
+	cr_assert_eq(ret, cnt);
+	cr_assert(recording_eof(r));
+
+	for (int i = 0; i < cnt; i++) {
+		f->smpt[i]->signals = &f->signals;
+
+		cr_assert_eq_sample(f->smps[i], f->smpt[i], f->smps[i]->flags);
+	}
+}
+
+Test(recording, no_index, .init = init_memory)
+{
+	int ret, cnt;
+	struct recording w, r;
+	struct recording_fixture f;
+
+	recording_fixture_init(&f);
+
+	ret = recording_open(&w, f.fn, RecordingMode::WRITE, CHUNK_SAMPLES);
+	cr_assert_eq(ret, 0);
+
+	cnt = recording_write(&w, f.smps, NUM_SAMPLES);
+	cr_assert_eq(cnt, NUM_SAMPLES);
+
+	ret = recording_flush(&w);
+	cr_assert_eq(ret, 0);
+
+	/* The writer is still open. So the index is rebuilt from the chunks */
+	ret = recording_open(&r, f.fn, RecordingMode::READ);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(r.samples, NUM_SAMPLES);
+	cr_assert_eq(r.chunks, CEIL(NUM_SAMPLES, CHUNK_SAMPLES));
+
+	recording_check(&f, &r, NUM_SAMPLES);
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	ret = recording_close(&w);
+	cr_assert_eq(ret, 0);
+
+	recording_fixture_destroy(&f);
+}
+
+Test(recording, damaged_index, .init = init_memory)
+{
+	int ret, cnt;
+	uint64_t index_offset, bad = 1;
+	struct recording r;
+	struct recording_fixture f;
+
+	recording_fixture_init(&f);
+
+	ret = recording_open(&r, f.fn, RecordingMode::WRITE, CHUNK_SAMPLES);
+	cr_assert_eq(ret, 0);
+
+	cnt = recording_write(&r, f.smps, NUM_SAMPLES);
+	cr_assert_eq(cnt, NUM_SAMPLES);
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	/* Let the last index entry point into the middle of a chunk */
+	int fd = open(f.fn, O_RDWR);
+	cr_assert_geq(fd, 0);
+
+	ret = pread(fd, &index_offset, sizeof(index_offset), offsetof(struct recording_header, index_offset));
+	cr_assert_eq(ret, sizeof(index_offset));
+
+	off_t off = index_offset + (CEIL(NUM_SAMPLES, CHUNK_SAMPLES) - 1) * sizeof(struct recording_index) + offsetof(struct recording_index, offset);
+
+	ret = pwrite(fd, &bad, sizeof(bad), off);
+	cr_assert_eq(ret, sizeof(bad));
+
+	close(fd);
+
+	ret = recording_open(&r, f.fn, RecordingMode::READ);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(r.samples, NUM_SAMPLES);
+	cr_assert_eq(r.chunks, CEIL(NUM_SAMPLES, CHUNK_SAMPLES));
+
+	recording_check(&f, &r, NUM_SAMPLES);
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	recording_fixture_destroy(&f);
+}
+
+Test(recording, truncated, .init = init_memory)
+{
+	int ret, cnt;
+	off_t off;
+	struct recording r;
+	struct recording_fixture f;
+
+	recording_fixture_init(&f);
+
+	ret = recording_open(&r, f.fn, RecordingMode::WRITE, CHUNK_SAMPLES);
+	cr_assert_eq(ret, 0);
+
+	cnt = recording_write(&r, f.smps, NUM_SAMPLES);
+	cr_assert_eq(cnt, NUM_SAMPLES);
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	ret = recording_open(&r, f.fn, RecordingMode::READ);
+	cr_assert_eq(ret, 0);
+
+	off = r.index[2].offset;
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	/* Cut off the index and the third chunk behind its header */
+	ret = truncate(f.fn, off + sizeof(struct recording_chunk) + 8);
+	cr_assert_eq(ret, 0);
+
+	ret = recording_open(&r, f.fn, RecordingMode::READ);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(r.chunks, 2);
+	cr_assert_eq(r.samples, 2 * CHUNK_SAMPLES);
+
+	recording_check(&f, &r, 2 * CHUNK_SAMPLES);
+
+	ret = recording_close(&r);
+	cr_assert_eq(ret, 0);
+
+	recording_fixture_destroy(&f);
+}
@@ -0,0 +1,366 @@
+/** Unit tests for the shared memory interface
+ *
+ * @author Steffen Vogel <stvogel@eonerc.rwth-aachen.de>
+ * @copyright 2014-2019, Institute for Automation of Complex Power Systems, EONERC
+ * @license GNU General Public License (version 3)
+ *
+ * VILLASnode
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************************/
+
+#include <criterion/criterion.h>
+
+#include <cstdio>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <villas/utils.hpp>
+#include <villas/sample.h>
+#include <villas/shmem.h>
+
+extern void init_memory();
+
+#define QUEUELEN	4
+#define SAMPLELEN	4
+
+struct opener {
+	char wname[64];
+	char rname[64];
+	struct shmem_int *shm;
+	struct shmem_conf *conf;
+	int ret;
+};
+
+static void * open_side(void *ctx)
+{
+	struct opener *o = (struct opener *) ctx;
+
+	o->ret = shmem_int_open(o->wname, o->rname, o->shm, o->conf);
+
+	return nullptr;
+}
+
+/** Connect two interfaces within the same process.
+ *
+ * Interface \p a writes to the ring which is read by \p b and vice versa. */
+static void shmem_pair(const char *test, struct shmem_int *a, struct shmem_int *b, int polling)
+{
+	int ret;
+	pthread_t thr;
+	struct shmem_conf conf = { polling, QUEUELEN, SAMPLELEN };
+
+	/* The names are referenced by the interfaces until they are closed */
+	static struct opener oa, ob;
+
+	snprintf(oa.wname, sizeof(oa.wname), "/villas-test-%s-a-%d", test, getpid());
+	snprintf(oa.rname, sizeof(oa.rname), "/villas-test-%s-b-%d", test, getpid());
+	snprintf(ob.wname, sizeof(ob.wname), "%s", oa.rname);
+	snprintf(ob.rname, sizeof(ob.rname), "%s", oa.wname);
+
+	oa.shm = a;
+	oa.conf = &conf;
+	ob.shm = b;
+	ob.conf = &conf;
+
+	ret = pthread_create(&thr, nullptr, open_side, &oa);
+	cr_assert_eq(ret, 0);
+
+	open_side(&ob);
+
+	ret = pthread_join(thr, nullptr);
+	cr_assert_eq(ret, 0);
+
+	cr_assert_eq(oa.ret, 0);
+	cr_assert_eq(ob.ret, 0);
+}
+
+static void shmem_publish_seq(struct shmem_int *shm, unsigned cnt, uint64_t *seq)
+{
+	int ret;
+	struct sample *smps[QUEUELEN];
+
+	ret = shmem_int_reserve(shm, smps, cnt);
+	cr_assert_eq(ret, (int) cnt);
+
+	for (unsigned i = 0; i < cnt; i++) {
+		smps[i]->sequence = *seq;
+		smps[i]->length = 1;
+		smps[i]->data[0].i = *seq;
+
+		(*seq)++;
+	}
+
+	ret = shmem_int_publish(shm, cnt);
+	cr_assert_eq(ret, (int) cnt);
+}
+
+Test(shmem, ordering, .init = init_memory)
+{
+	int ret;
+	uint64_t seq = 0;
+	struct shmem_int a, b;
+	struct sample *smps[QUEUELEN];
+
+	shmem_pair("ordering", &a, &b, 1);
+
+	shmem_publish_seq(&a, 3, &seq);
+
+	/* Peeking does not remove the samples from the ring */
+	ret = shmem_int_peek(&b, smps, 2);
+	cr_assert_eq(ret, 2);
+	cr_assert_eq(smps[0]->sequence, 0);
+	cr_assert_eq(smps[1]->sequence, 1);
+
+	ret = shmem_int_consume(&b, 1);
+	cr_assert_eq(ret, 1);
+
+	ret = shmem_int_peek(&b, smps, QUEUELEN);
+	cr_assert_eq(ret, 2);
+	cr_assert_eq(smps[0]->sequence, 1);
+	cr_assert_eq(smps[1]->sequence, 2);
+	cr_assert_eq(smps[1]->data[0].i, 2);
+
+	ret = shmem_int_consume(&b, 2);
+	cr_assert_eq(ret, 2);
+
+	shmem_int_close(&a);
+	shmem_int_close(&b);
+}
+
+Test(shmem, full, .init = init_memory)
+{
+	int ret;
+	uint64_t seq = 0;
+	struct shmem_int a, b;
+	struct sample *smps[2 * QUEUELEN];
+
+	shmem_pair("full", &a, &b, 1);
+
+	ret = shmem_int_reserve(&a, smps, ARRAY_LEN(smps));
+	cr_assert_eq(ret, QUEUELEN);
+
+	for (int i = 0; i < ret; i++)
+		smps[i]->sequence = seq++;
+
+	shmem_int_publish(&a, ret);
+
+	/* The ring is full until the consumer frees a slot */
+	ret = shmem_int_reserve(&a, smps, 1);
+	cr_assert_eq(ret, 0);
+
+	ret = shmem_int_peek(&b, smps, 1);
+	cr_assert_eq(ret, 1);
+	cr_assert_eq(smps[0]->sequence, 0);
+	shmem_int_consume(&b, 1);
+
+	ret = shmem_int_reserve(&a, smps, ARRAY_LEN(smps));
+	cr_assert_eq(ret, 1);
+
+	smps[0]->sequence = seq++;
+	shmem_int_publish(&a, 1);
+
+	/* The consumer might return the slots which it already knew about first */
+	for (uint64_t expected = 1; expected < seq;) {
+		ret = shmem_int_peek(&b, smps, ARRAY_LEN(smps));
+		cr_assert_gt(ret, 0);
+
+		for (int i = 0; i < ret; i++)
+			cr_assert_eq(smps[i]->sequence, expected++);
+
+		shmem_int_consume(&b, ret);
+	}
+
+	shmem_int_close(&a);
+	shmem_int_close(&b);
+}
+
+Test(shmem, wrap_around, .init = init_memory)
+{
+	int ret;
+	uint64_t wseq = 0, rseq = 0;
+	struct shmem_int a, b;
+	struct sample *smps[QUEUELEN];
+
+	shmem_pair("wrap", &a, &b, 1);
+
+	/* Batches of 3 slots cross the end of the ring of 4 slots in most rounds */
+	for (int round = 0; round < 20; round++) {
+		ret = shmem_int_alloc(&a, smps, 3);
+		cr_assert_eq(ret, 3);
+
+		for (int i = 0; i < ret; i++) {
+			smps[i]->sequence = wseq;
+			smps[i]->length = 1;
+			smps[i]->data[0].i = wseq * 10;
+
+			wseq++;
+		}
+
+		ret = shmem_int_write(&a, smps, 3);
+		cr_assert_eq(ret, 3);
+
+		ret = shmem_int_read(&b, smps, QUEUELEN);
+		cr_assert_eq(ret, 3);
+
+		for (int i = 0; i < ret; i++) {
+			cr_assert_eq(smps[i]->sequence, rseq);
+			cr_assert_eq(smps[i]->length, 1);
+			cr_assert_eq(smps[i]->data[0].i, (int64_t) rseq * 10);
+
+			rseq++;
+		}
+
+		sample_decref_many(smps, ret);
+	}
+
+	shmem_int_close(&a);
+	shmem_int_close(&b);
+}
+
+struct blocked_reader {
+	struct shmem_int *shm;
+	int first, second;
+	uint64_t sequence;
+};
+
+static void * blocked_read(void *ctx)
+{
+	struct blocked_reader *r = (struct blocked_reader *) ctx;
+	struct sample *smp;
+
+	r->first = shmem_int_read(r->shm, &smp, 1);
+	if (r->first == 1) {
+		r->sequence = smp->sequence;
+		sample_decref(smp);
+	}
+
+	/* Blocks until the other side closes the interface */
+	r->second = shmem_int_read(r->shm, &smp, 1);
+
+	return nullptr;
+}
+
+Test(shmem, close_wakes_reader, .init = init_memory, .timeout = 10)
+{
+	int ret;
+	uint64_t seq = 42;
+	pthread_t thr;
+	struct shmem_int a, b;
+	struct blocked_reader r = { &b, 0, 0, 0 };
+
+	shmem_pair("close", &a, &b, 0);
+
+	ret = pthread_create(&thr, nullptr, blocked_read, &r);
+	cr_assert_eq(ret, 0);
+
+	/* Give the reader time to fall asleep on the futex */
+	usleep(100000);
+	shmem_publish_seq(&a, 1, &seq);
+
+	usleep(100000);
+	shmem_int_close(&a);
+
+	ret = pthread_join(thr, nullptr);
+	cr_assert_eq(ret, 0);
+
+	cr_assert_eq(r.first, 1);
+	cr_assert_eq(r.sequence, 42);
+	cr_assert_eq(r.second, -1);
+
+	shmem_int_close(&b);
+}
+
+struct concurrent_writer {
+	struct shmem_int *shm;
+	unsigned id;
+	unsigned cnt;
+};
+
+static void * concurrent_write(void *ctx)
+{
+	struct concurrent_writer *w = (struct concurrent_writer *) ctx;
+	struct sample *smps[2];
+
+	for (unsigned i = 0; i < w->cnt;) {
+		int ret = shmem_int_reserve(w->shm, smps, MIN(ARRAY_LEN(smps), w->cnt - i));
+		cr_assert_geq(ret, 0);
+
+		if (ret == 0) {
+			sched_yield();
+			continue;
+		}
+
+		for (int j = 0; j < ret; j++) {
+			smps[j]->sequence = i++;
+			smps[j]->length = 1;
+			smps[j]->data[0].i = w->id;
+		}
+
+		/* Let the other writers run between reserving and publishing the slots */
+		sched_yield();
+
+		shmem_int_publish(w->shm, ret);
+	}
+
+	return nullptr;
+}
+
+Test(shmem, concurrent_writers, .init = init_memory, .timeout = 30)
+{
+	int ret;
+	struct shmem_int a, b;
+	struct sample *smps[QUEUELEN];
+
+	pthread_t thrs[4];
+	struct concurrent_writer ws[ARRAY_LEN(thrs)];
+	uint64_t next[ARRAY_LEN(thrs)] = { 0 };
+	unsigned total = 0, cnt = 10000;
+
+	shmem_pair("concurrent", &a, &b, 1);
+
+	for (unsigned i = 0; i < ARRAY_LEN(thrs); i++) {
+		ws[i] = { &a, i, cnt };
+
+		ret = pthread_create(&thrs[i], nullptr, concurrent_write, &ws[i]);
+		cr_assert_eq(ret, 0);
+	}
+
+	/* Every sample arrives exactly once and in the order of its writer */
+	while (total < ARRAY_LEN(thrs) * cnt) {
+		ret = shmem_int_peek(&b, smps, QUEUELEN);
+		cr_assert_gt(ret, 0);
+
+		for (int i = 0; i < ret; i++) {
+			int64_t id = smps[i]->data[0].i;
+
+			cr_assert(id >= 0 && id < (int64_t) ARRAY_LEN(thrs));
+			cr_assert_eq(smps[i]->sequence, next[id]++);
+		}
+
+		shmem_int_consume(&b, ret);
+		total += ret;
+	}
+
+	for (unsigned i = 0; i < ARRAY_LEN(thrs); i++) {
+		ret = pthread_join(thrs[i], nullptr);
+		cr_assert_eq(ret, 0);
+
+		cr_assert_eq(next[i], cnt);
+	}
+
+	shmem_int_close(&a);
+	shmem_int_close(&b);
+}
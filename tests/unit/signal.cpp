@@ -22,6 +22,10 @@
 
 #include <criterion/criterion.h>
 
+#include <cmath>
+#include <cstring>
+
+#include <villas/io.h>
 #include <villas/signal.h>
 
 extern void init_memory();
@@ -37,7 +41,7 @@ Test(signal, parse, .init = init_memory) {
 	str = "1";
 	sig.type = SignalType::INTEGER;
 	
-	ret = signal_data_parse_str(&sd, &sig, str, &end);
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
 	cr_assert_eq(ret, 0);
 	cr_assert_eq(end, str + strlen(str));
 	cr_assert_eq(sd.i, 1);
@@ -45,7 +49,7 @@ Test(signal, parse, .init = init_memory) {
 	str = "1.2";
 	sig.type = SignalType::FLOAT;
 	
-	ret = signal_data_parse_str(&sd, &sig, str, &end);
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
 	cr_assert_eq(ret, 0);
 	cr_assert_eq(end, str + strlen(str));
 	cr_assert_float_eq(sd.f, 1.2, 1e-6);
@@ -53,7 +57,7 @@ Test(signal, parse, .init = init_memory) {
 	str = "1";
 	sig.type = SignalType::BOOLEAN;
 	
-	ret = signal_data_parse_str(&sd, &sig, str, &end);
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
 	cr_assert_eq(ret, 0);
 	cr_assert_eq(end, str + strlen(str));
 	cr_assert_eq(sd.b, 1);
@@ -61,7 +65,7 @@ Test(signal, parse, .init = init_memory) {
 	str = "1";
 	sig.type = SignalType::COMPLEX;
 	
-	ret = signal_data_parse_str(&sd, &sig, str, &end);
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
 	cr_assert_eq(ret, 0);
 	cr_assert_eq(end, str + strlen(str));
 	cr_assert_float_eq(std::real(sd.z), 1, 1e-6);
@@ -70,7 +74,7 @@ Test(signal, parse, .init = init_memory) {
 	str = "-1-3i";
 	sig.type = SignalType::COMPLEX;
 	
-	ret = signal_data_parse_str(&sd, &sig, str, &end);
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
 	cr_assert_eq(ret, 0);
 	cr_assert_eq(end, str + strlen(str));
 	cr_assert_float_eq(std::real(sd.z), -1, 1e-6);
@@ -79,9 +83,112 @@ Test(signal, parse, .init = init_memory) {
 	str = "-3i";
 	sig.type = SignalType::COMPLEX;
 	
-	ret = signal_data_parse_str(&sd, &sig, str, &end);
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
 	cr_assert_eq(ret, 0);
 	cr_assert_eq(end, str + strlen(str));
 	cr_assert_float_eq(std::real(sd.z), 0, 1e-6);
 	cr_assert_float_eq(std::imag(sd.z), -3, 1e-6);
 }
+
+Test(signal, parse_out_of_range, .init = init_memory) {
+	int ret;
+	struct signal sig;
+	union signal_data sd;
+	const char *str;
+	char *end;
+
+	/* Like strtod(), values out of range are consumed and clamped */
+	str = "1e400";
+	sig.type = SignalType::FLOAT;
+
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(end, str + strlen(str));
+	cr_assert_eq(sd.f, HUGE_VAL);
+
+	str = "-1e400";
+
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(end, str + strlen(str));
+	cr_assert_eq(sd.f, -HUGE_VAL);
+
+	str = "1e-400";
+
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(end, str + strlen(str));
+	cr_assert_eq(sd.f, 0);
+
+	str = "1e40+1i";
+	sig.type = SignalType::COMPLEX;
+
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(end, str + strlen(str));
+	cr_assert_eq(std::real(sd.z), HUGE_VALF);
+	cr_assert_eq(std::imag(sd.z), 1);
+
+	str = "-99999999999999999999";
+	sig.type = SignalType::INTEGER;
+
+	ret = signal_data_parse_str(&sd, &sig, str, strlen(str), &end);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(end, str + strlen(str));
+	cr_assert_eq(sd.i, INT64_MIN);
+}
+
+Test(signal, print, .init = init_memory) {
+	int ret;
+	struct signal sig;
+	union signal_data sd, se;
+	char buf[64];
+	char *end;
+
+	sig.type = SignalType::FLOAT;
+	sd.f = 0.1;
+
+	/* Without std::to_chars() for floating point numbers the output is not the shortest one */
+	ret = signal_data_print_str(&sd, &sig, buf, sizeof(buf));
+	cr_assert_lt(ret, (int) sizeof(buf));
+	buf[ret] = '\0';
+
+	ret = signal_data_parse_str(&se, &sig, buf, strlen(buf), &end);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(end, buf + strlen(buf));
+	cr_assert_eq(se.f, sd.f);
+
+	ret = signal_data_print_str(&sd, &sig, buf, sizeof(buf), (int) IOFlags::PRINTF_COMPAT);
+	cr_assert_eq(ret, 8);
+	cr_assert_arr_eq(buf, "0.100000", 8);
+
+	/* Shortest representation parses back to the same value */
+	sd.f = 1.0 / 3;
+
+	ret = signal_data_print_str(&sd, &sig, buf, sizeof(buf));
+	buf[ret] = '\0';
+
+	ret = signal_data_parse_str(&se, &sig, buf, strlen(buf), &end);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(end, buf + strlen(buf));
+	cr_assert_eq(se.f, sd.f);
+
+	sig.type = SignalType::COMPLEX;
+	sd.z = std::complex<float>(1.5, 0.25);
+
+	ret = signal_data_print_str(&sd, &sig, buf, sizeof(buf));
+	cr_assert_eq(ret, 9);
+	cr_assert_arr_eq(buf, "1.5+0.25i", 9);
+
+	ret = signal_data_parse_str(&se, &sig, buf, ret, &end);
+	cr_assert_eq(ret, 0);
+	cr_assert_eq(std::real(se.z), 1.5);
+	cr_assert_eq(std::imag(se.z), 0.25);
+
+	/* Truncated values return the buffer length */
+	sig.type = SignalType::INTEGER;
+	sd.i = 123456;
+
+	ret = signal_data_print_str(&sd, &sig, buf, 4);
+	cr_assert_eq(ret, 4);
+}